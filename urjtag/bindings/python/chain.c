@@ -34,6 +34,8 @@
 
 #include "py_urjtag.h"
 
+PyObject *UrjtagError;
+
 typedef struct
 {
     PyObject_HEAD urj_chain_t *urchain;
@@ -159,6 +161,137 @@ urj_pyc_precheck (urj_chain_t *urc, int checks_needed)
     return 1;
 }
 
+/* convert bits msb..lsb of a tap register into a python object,
+ * without going through the '0'/'1' string representation unless
+ * a string is what the caller asked for.
+ */
+PyObject *
+urj_py_reg_get (urj_tap_register_t *r, int fmt, int msb, int lsb)
+{
+    PyObject *bytes, *val;
+    const char *value_string;
+    size_t n;
+
+    if (msb == -1)
+    {
+        msb = r->len - 1;
+        lsb = 0;
+    }
+    if (lsb == -1)
+        lsb = msb;
+
+    if (fmt == URJ_PY_FMT_STRING)
+    {
+        value_string = urj_tap_register_get_string_bit_range (r, msb, lsb);
+        if (value_string == NULL)
+            return urj_py_chkret (URJ_STATUS_FAIL);
+        return Py_BuildValue ("s", value_string);
+    }
+
+    n = ((msb >= lsb ? msb - lsb : lsb - msb) + 8) / 8;
+    bytes = PyBytes_FromStringAndSize (NULL, n);
+    if (bytes == NULL)
+        return NULL;
+    if (urj_tap_register_get_bytes_bit_range (r,
+                                   (uint8_t *) PyBytes_AS_STRING (bytes),
+                                   n, msb, lsb) != URJ_STATUS_OK)
+    {
+        Py_DECREF (bytes);
+        return urj_py_chkret (URJ_STATUS_FAIL);
+    }
+
+    if (fmt == URJ_PY_FMT_BYTES)
+        return bytes;
+
+    val = PyObject_CallMethod ((PyObject *) &PyLong_Type, "from_bytes",
+                               "Os", bytes, "little");
+    Py_DECREF (bytes);
+    return val;
+}
+
+/* set bits msb..lsb of a tap register from a python object:
+ * a '0'/'1' (or "0x...") string, an integer of any width, or any object
+ * supporting the buffer protocol (bytes, bytearray, memoryview...) with
+ * the bits packed LSB first.
+ */
+PyObject *
+urj_py_reg_set (urj_tap_register_t *r, PyObject *obj, int msb, int lsb)
+{
+    Py_buffer view;
+    PyObject *bytes;
+    size_t n;
+    int rc;
+
+    if (PyUnicode_Check (obj))
+    {
+        const char *str = PyUnicode_AsUTF8 (obj);
+
+        if (str == NULL)
+            return NULL;
+        if (msb == -1)
+            return urj_py_chkret (urj_tap_register_set_string (r, str));
+        if (lsb == -1)
+            lsb = msb;
+        return urj_py_chkret (urj_tap_register_set_string_bit_range (r, str,
+                                                                     msb,
+                                                                     lsb));
+    }
+
+    if (msb == -1)
+    {
+        msb = r->len - 1;
+        lsb = 0;
+    }
+    if (lsb == -1)
+        lsb = msb;
+    n = ((msb >= lsb ? msb - lsb : lsb - msb) + 8) / 8;
+
+    if (PyLong_Check (obj))
+    {
+        PyObject *one, *width, *bit, *mask, *val;
+
+        /* truncate to the field width, as the former 64 bit path did */
+        one = PyLong_FromLong (1);
+        width = PyLong_FromLong ((msb >= lsb ? msb - lsb : lsb - msb) + 1);
+        bit = (one && width) ? PyNumber_Lshift (one, width) : NULL;
+        mask = bit ? PyNumber_Subtract (bit, one) : NULL;
+        Py_XDECREF (bit);
+        Py_XDECREF (width);
+        Py_XDECREF (one);
+        if (mask == NULL)
+            return NULL;
+        val = PyNumber_And (obj, mask);
+        Py_DECREF (mask);
+        if (val == NULL)
+            return NULL;
+        bytes = PyObject_CallMethod (val, "to_bytes", "ns",
+                                     (Py_ssize_t) n, "little");
+        Py_DECREF (val);
+        if (bytes == NULL)
+            return NULL;
+        rc = urj_tap_register_set_bytes_bit_range (r,
+                                   (const uint8_t *) PyBytes_AS_STRING (bytes),
+                                   n, msb, lsb);
+        Py_DECREF (bytes);
+        return urj_py_chkret (rc);
+    }
+
+    if (PyObject_GetBuffer (obj, &view, PyBUF_SIMPLE) != 0)
+        return NULL;
+    if (view.len != (Py_ssize_t) n)
+    {
+        PyBuffer_Release (&view);
+        PyErr_Format (PyExc_ValueError,
+                      _("register field needs %zd bytes, got %zd"),
+                      (Py_ssize_t) n, view.len);
+        return NULL;
+    }
+    rc = urj_tap_register_set_bytes_bit_range (r, view.buf, view.len,
+                                               msb, lsb);
+    PyBuffer_Release (&view);
+    return urj_py_chkret (rc);
+}
+
 
 /* urj_chain_t / urjtag.chain methods */
 
@@ -218,13 +351,17 @@ urj_pyc_tap_detect (urj_pychain_t *self, PyObject *args)
 {
     urj_chain_t *urc = self->urchain;
     int maxirlen = 0;
+    int rc;
     if (!PyArg_ParseTuple (args, "|i", &maxirlen))
         return NULL;
     if (!urj_pyc_precheck (urc, UPRC_CBL))
         return NULL;
 
     urj_pyc_invalidate_reglist(self);
-    return urj_py_chkret (urj_tap_detect (urc, maxirlen));
+    Py_BEGIN_ALLOW_THREADS
+    rc = urj_tap_detect (urc, maxirlen);
+    Py_END_ALLOW_THREADS
+    return urj_py_chkret (rc);
 }
 
 static PyObject *
@@ -398,26 +535,36 @@ static PyObject *
 urj_pyc_shift_ir (urj_pychain_t *self)
 {
     urj_chain_t *urc = self->urchain;
+    int rc;
+
     if (!urj_pyc_precheck (urc, UPRC_CBL))
         return NULL;
 
-    return urj_py_chkret (urj_tap_chain_shift_instructions (urc));
+    Py_BEGIN_ALLOW_THREADS
+    rc = urj_tap_chain_shift_instructions (urc);
+    Py_END_ALLOW_THREADS
+    return urj_py_chkret (rc);
 }
 
 static PyObject *
 urj_pyc_shift_dr (urj_pychain_t *self)
 {
     urj_chain_t *urc = self->urchain;
+    int rc;
+
     if (!urj_pyc_precheck (urc, UPRC_CBL))
         return NULL;
 
     /*  TODO: need a way to not capture the TDO output
      */
-    return urj_py_chkret (urj_tap_chain_shift_data_registers (urc, 1));
+    Py_BEGIN_ALLOW_THREADS
+    rc = urj_tap_chain_shift_data_registers (urc, 1);
+    Py_END_ALLOW_THREADS
+    return urj_py_chkret (rc);
 }
 
 static PyObject *
-urj_pyc_get_dr (urj_pychain_t *self, int in, int string, PyObject *args)
+urj_pyc_get_dr (urj_pychain_t *self, int in, int fmt, PyObject *args)
 {
     urj_chain_t *urc = self->urchain;
     urj_part_t *part;
@@ -426,12 +573,9 @@ urj_pyc_get_dr (urj_pychain_t *self, int in, int string, PyObject *args)
     urj_part_instruction_t *active_ir;
     int lsb = -1;
     int msb = -1;
-    const char *value_string;
 
     if (!PyArg_ParseTuple (args, "|ii", &msb, &lsb))
         return NULL;
-    if (lsb == -1)
-        lsb = msb;
     if (!urj_pyc_precheck (urc, UPRC_CBL))
         return NULL;
 
@@ -460,50 +604,43 @@ urj_pyc_get_dr (urj_pychain_t *self, int in, int string, PyObject *args)
     else
         r = dr->out;            /* recently captured+scanned-out values */
 
-    if (in)
-        r = dr->in;             /* input buffer for next shift_dr */
-    else
-        r = dr->out;            /* recently captured+scanned-out values */
-
-    if (msb == -1)
-        value_string = urj_tap_register_get_string (r);
-    else
-        value_string = urj_tap_register_get_string_bit_range (r, msb, lsb);
-    if (value_string == NULL)
-    {
-        PyErr_SetString (UrjtagError,
-                         _("error obtaining tap register value"));
-        return NULL;
-    }
-
-    if (string)
-        return Py_BuildValue ("s", value_string);
-    else
-        return PyLong_FromString((char *)value_string, NULL, 2);
+    return urj_py_reg_get (r, fmt, msb, lsb);
 }
 
 static PyObject *
 urj_pyc_get_str_dr_out (urj_pychain_t *self, PyObject *args)
 {
-    return urj_pyc_get_dr (self, 0, 1, args);
+    return urj_pyc_get_dr (self, 0, URJ_PY_FMT_STRING, args);
 }
 
 static PyObject *
 urj_pyc_get_str_dr_in (urj_pychain_t *self, PyObject *args)
 {
-    return urj_pyc_get_dr (self, 1, 1, args);
+    return urj_pyc_get_dr (self, 1, URJ_PY_FMT_STRING, args);
 }
 
 static PyObject *
 urj_pyc_get_int_dr_out (urj_pychain_t *self, PyObject *args)
 {
-    return urj_pyc_get_dr (self, 0, 0, args);
+    return urj_pyc_get_dr (self, 0, URJ_PY_FMT_INT, args);
 }
 
 static PyObject *
 urj_pyc_get_int_dr_in (urj_pychain_t *self, PyObject *args)
 {
-    return urj_pyc_get_dr (self, 1, 0, args);
+    return urj_pyc_get_dr (self, 1, URJ_PY_FMT_INT, args);
+}
+
+static PyObject *
+urj_pyc_get_bytes_dr_out (urj_pychain_t *self, PyObject *args)
+{
+    return urj_pyc_get_dr (self, 0, URJ_PY_FMT_BYTES, args);
+}
+
+static PyObject *
+urj_pyc_get_bytes_dr_in (urj_pychain_t *self, PyObject *args)
+{
+    return urj_pyc_get_dr (self, 1, URJ_PY_FMT_BYTES, args);
 }
 
 static PyObject *
@@ -514,17 +651,12 @@ urj_pyc_set_dr (urj_pychain_t *self, int in, PyObject *args)
     urj_tap_register_t *r;
     urj_data_register_t *dr;
     urj_part_instruction_t *active_ir;
-    char *newstr = NULL;
-    uint64_t newval;
+    PyObject *newval;
     int lsb = -1;
     int msb = -1;
 
-    if (!PyArg_ParseTuple (args, "s|ii", &newstr, &msb, &lsb))
-    {
-        PyErr_Clear ();
-        if (!PyArg_ParseTuple (args, "K|ii", &newval, &msb, &lsb))
-            return NULL;
-    }
+    if (!PyArg_ParseTuple (args, "O|ii", &newval, &msb, &lsb))
+        return NULL;
 
     if (!urj_pyc_precheck (urc, UPRC_CBL))
         return NULL;
@@ -554,23 +686,7 @@ urj_pyc_set_dr (urj_pychain_t *self, int in, PyObject *args)
     else
         r = dr->out;
 
-    if (msb == -1)
-    {
-        if (newstr)
-            return urj_py_chkret (urj_tap_register_set_string(r, newstr));
-        else
-            return urj_py_chkret (urj_tap_register_set_value(r, newval));
-    }
-    else
-    {
-        if (lsb == -1)
-            lsb = msb;
-
-        if (newstr)
-            return urj_py_chkret (urj_tap_register_set_string_bit_range(r, newstr, msb, lsb));
-        else
-            return urj_py_chkret (urj_tap_register_set_value_bit_range(r, newval, msb, lsb));
-    }
+    return urj_py_reg_set (r, newval, msb, lsb);
 }
 
 static PyObject *
@@ -585,6 +701,7 @@ urj_pyc_set_dr_in (urj_pychain_t *self, PyObject *args)
     return urj_pyc_set_dr (self, 1, args);
 }
 
+#if ENABLE_SVF
 static PyObject *
 urj_pyc_run_svf (urj_pychain_t *self, PyObject *args)
 {
@@ -593,7 +710,7 @@ urj_pyc_run_svf (urj_pychain_t *self, PyObject *args)
     int stop = 0;
     unsigned long ref_freq = 0;
     FILE *svf_file;
-    PyObject *rc;
+    int rc;
 
     if (!PyArg_ParseTuple (args, "s|iI", &fname, &stop, &ref_freq))
         return NULL;
@@ -606,11 +723,15 @@ urj_pyc_run_svf (urj_pychain_t *self, PyObject *args)
         PyErr_SetFromErrnoWithFilename(PyExc_IOError, fname);
         return NULL;
     }
-    rc = urj_py_chkret (urj_svf_run (urc, svf_file, stop, ref_freq));
+    Py_BEGIN_ALLOW_THREADS
+    rc = urj_svf_run (urc, svf_file, stop, ref_freq);
+    Py_END_ALLOW_THREADS
     fclose (svf_file);
-    return rc;
+    return urj_py_chkret (rc);
 }
 
+#endif /* ENABLE_SVF */
+
 static PyObject *
 urj_pyc_addpart (urj_pychain_t *self, PyObject *args)
 {
@@ -733,14 +854,17 @@ urj_pyc_setpart (urj_pychain_t *self, PyObject *args)
 static PyObject *
 urj_pyc_initbus (urj_pychain_t *self, PyObject *args)
 {
-    char *bus_params[5] = { NULL, NULL, NULL, NULL, NULL };
+    char *bus_params[11] = { NULL };
     char *drivername;
     urj_chain_t *urc = self->urchain;
 
-    if (!PyArg_ParseTuple (args, "s|ssss",
+    /* buses like "prototype" need more than a handful of parameters */
+    if (!PyArg_ParseTuple (args, "s|ssssssssss",
                            &drivername,
                            &bus_params[0], &bus_params[1], &bus_params[2],
-                           &bus_params[3]))
+                           &bus_params[3], &bus_params[4], &bus_params[5],
+                           &bus_params[6], &bus_params[7], &bus_params[8],
+                           &bus_params[9]))
         return NULL;
     if (!urj_pyc_precheck (urc, UPRC_CBL|UPRC_DET))
         return NULL;
@@ -753,14 +877,16 @@ urj_pyc_detectflash (urj_pychain_t *self, PyObject *args)
 {
     urj_chain_t *urc = self->urchain;
     int adr;
+    int r;
     if (!PyArg_ParseTuple (args, "i", &adr))
         return NULL;
     if (!urj_pyc_precheck (urc, UPRC_CBL|UPRC_BUS))
         return NULL;
 
-    return Py_BuildValue ("i",
-                          urj_flash_detectflash (URJ_LOG_LEVEL_NORMAL,
-                                                 urj_bus, adr));
+    Py_BEGIN_ALLOW_THREADS
+    r = urj_flash_detectflash (URJ_LOG_LEVEL_NORMAL, urj_bus, adr);
+    Py_END_ALLOW_THREADS
+    return Py_BuildValue ("i", r);
 }
 
 static PyObject *
@@ -814,12 +940,76 @@ urj_pyc_poke (urj_pychain_t *self, PyObject *args)
     return Py_BuildValue ("");
 }
 
+static PyObject *
+urj_pyc_readmem (urj_pychain_t *self, PyObject *args)
+{
+    urj_chain_t *urc = self->urchain;
+    unsigned int adr, len;
+    PyObject *data;
+    uint8_t *buf;
+    int r;
+
+    if (!PyArg_ParseTuple (args, "II", &adr, &len))
+        return NULL;
+
+    if (!urj_pyc_precheck (urc, UPRC_CBL|UPRC_BUS))
+        return NULL;
+
+    data = PyBytes_FromStringAndSize (NULL, len);
+    if (data == NULL)
+        return NULL;
+    buf = (uint8_t *) PyBytes_AS_STRING (data);
+
+    Py_BEGIN_ALLOW_THREADS
+    r = urj_bus_read_block (urj_bus, adr, buf, len);
+    Py_END_ALLOW_THREADS
+
+    if (r != URJ_STATUS_OK)
+    {
+        Py_DECREF (data);
+        return urj_py_chkret (r);
+    }
+    return data;
+}
+
+static PyObject *
+urj_pyc_writemem (urj_pychain_t *self, PyObject *args)
+{
+    urj_chain_t *urc = self->urchain;
+    unsigned int adr;
+    Py_buffer data;
+    int r;
+
+    if (!PyArg_ParseTuple (args, "Iy*", &adr, &data))
+        return NULL;
+
+    if (!urj_pyc_precheck (urc, UPRC_CBL|UPRC_BUS))
+    {
+        PyBuffer_Release (&data);
+        return NULL;
+    }
+    if (data.len > UINT32_MAX)
+    {
+        PyBuffer_Release (&data);
+        PyErr_SetString (PyExc_ValueError, _("data too large"));
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    r = urj_bus_write_block (urj_bus, adr, data.buf, data.len);
+    Py_END_ALLOW_THREADS
+
+    PyBuffer_Release (&data);
+    return urj_py_chkret (r);
+}
+
 static PyObject *
 urj_pyc_flashmem (urj_pychain_t *self, PyObject *args)
 {
     urj_chain_t *urc = self->urchain;
     int msbin;
     int noverify = 0;
+    int crc = 0;
     long unsigned adr = 0;
     FILE *f;
     char *optstr = NULL;
@@ -830,7 +1020,7 @@ urj_pyc_flashmem (urj_pychain_t *self, PyObject *args)
         return NULL;
 
     if (!PyArg_ParseTuple
-        (args, "ss|i", &optstr, &fname, &noverify))
+        (args, "ss|ii", &optstr, &fname, &noverify, &crc))
         return NULL;
 
     msbin = strcasecmp ("msbin", optstr) == 0;
@@ -844,10 +1034,14 @@ urj_pyc_flashmem (urj_pychain_t *self, PyObject *args)
         return NULL;
     }
 
+    Py_BEGIN_ALLOW_THREADS
     if (msbin)
         r = urj_flashmsbin (urj_bus, f, noverify);
+    else if (crc && !noverify)
+        r = urj_flashmem_crc (urj_bus, f, adr);
     else
         r = urj_flashmem (urj_bus, f, adr, noverify);
+    Py_END_ALLOW_THREADS
 
     fclose (f);
     return Py_BuildValue ("i", r);
@@ -955,12 +1149,18 @@ static PyMethodDef urj_pyc_methods[] =
      "get bits that will be scanned in on next shift_dr, as integer"},
     {"get_dr_out", (PyCFunction) urj_pyc_get_int_dr_out, METH_VARARGS,
      "retrieve values scanned out from the data registers on the last shift_dr, as integer"},
+    {"get_dr_in_bytes", (PyCFunction) urj_pyc_get_bytes_dr_in, METH_VARARGS,
+     "get bits that will be scanned in on next shift_dr, as bytes packed LSB first"},
+    {"get_dr_out_bytes", (PyCFunction) urj_pyc_get_bytes_dr_out, METH_VARARGS,
+     "retrieve values scanned out from the data registers on the last shift_dr, as bytes packed LSB first"},
     {"set_dr_in", (PyCFunction) urj_pyc_set_dr_in, METH_VARARGS,
-     "set bits that will be scanned in on next shiftdr"},
+     "set bits that will be scanned in on next shiftdr, from a string, an integer or a bytes-like object"},
     {"set_dr_out", (PyCFunction) urj_pyc_set_dr_out, METH_VARARGS,
      "set the holding register for values scanned out from the data registers"},
+#if ENABLE_SVF
     {"run_svf", (PyCFunction) urj_pyc_run_svf, METH_VARARGS,
      "Play a named SVF file; optionally setting stop-on-mismatch and runtest frequency"},
+#endif
     {"addpart", (PyCFunction) urj_pyc_addpart, METH_VARARGS,
      "manually adds parts on the JTAG chain"},
     {"add_instruction", (PyCFunction) urj_pyc_add_instruction, METH_VARARGS,
@@ -977,6 +1177,10 @@ static PyMethodDef urj_pyc_methods[] =
      "read a single word"},
     {"poke", (PyCFunction) urj_pyc_poke, METH_VARARGS,
      "write a single word"},
+    {"readmem", (PyCFunction) urj_pyc_readmem, METH_VARARGS,
+     "read a block of memory, returned as bytes"},
+    {"writemem", (PyCFunction) urj_pyc_writemem, METH_VARARGS,
+     "write a bytes-like object to memory"},
     {"flashmem", (PyCFunction) urj_pyc_flashmem, METH_VARARGS,
      "burn flash memory with data from a file"},
     {"get_register", (PyCFunction)urj_pyc_get_register, METH_VARARGS,
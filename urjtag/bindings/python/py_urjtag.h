@@ -41,3 +41,12 @@ extern int urj_pyc_precheck (urj_chain_t *urc, int checks_needed);
 #define UPRC_CBL 1
 #define UPRC_DET 2
 #define UPRC_BUS 4
+
+/* tap register <-> python object conversion, see chain.c */
+extern PyObject *urj_py_reg_get (urj_tap_register_t *r, int fmt,
+                                 int msb, int lsb);
+extern PyObject *urj_py_reg_set (urj_tap_register_t *r, PyObject *obj,
+                                 int msb, int lsb);
+#define URJ_PY_FMT_STRING 0
+#define URJ_PY_FMT_INT    1
+#define URJ_PY_FMT_BYTES  2
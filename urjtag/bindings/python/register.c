@@ -57,19 +57,16 @@ urj_pyr_str (PyObject *s)
 
 
 static PyObject *
-urj_pyr_get_dr (urj_pyregister_t *self, int in, int string, PyObject *args)
+urj_pyr_get_dr (urj_pyregister_t *self, int in, int fmt, PyObject *args)
 {
     urj_data_register_t *dr = self->urreg;
     urj_chain_t *urc = self->urc;
     urj_tap_register_t *r;
     int lsb = -1;
     int msb = -1;
-    const char *value_string;
 
     if (!PyArg_ParseTuple (args, "|ii", &msb, &lsb))
         return NULL;
-    if (lsb == -1)
-        lsb = msb;
     if (!urj_pyc_precheck (urc, UPRC_CBL))
         return NULL;
 
@@ -85,45 +82,43 @@ urj_pyr_get_dr (urj_pyregister_t *self, int in, int string, PyObject *args)
     else
         r = dr->out;            /* recently captured+scanned-out values */
 
-    if (msb == -1)
-        value_string = urj_tap_register_get_string (r);
-    else
-        value_string = urj_tap_register_get_string_bit_range (r, msb, lsb);
-    if (value_string == NULL)
-    {
-        PyErr_SetString (UrjtagError,
-                         _("error obtaining tap register value"));
-        return NULL;
-    }
-
-    if (string)
-        return Py_BuildValue ("s", value_string);
-    else
-        return PyLong_FromString ((char *)value_string, NULL, 2);
+    return urj_py_reg_get (r, fmt, msb, lsb);
 }
 
 static PyObject *
 urj_pyr_get_str_dr_out (urj_pyregister_t *self, PyObject *args)
 {
-    return urj_pyr_get_dr (self, 0, 1, args);
+    return urj_pyr_get_dr (self, 0, URJ_PY_FMT_STRING, args);
 }
 
 static PyObject *
 urj_pyr_get_str_dr_in (urj_pyregister_t *self, PyObject *args)
 {
-    return urj_pyr_get_dr (self, 1, 1, args);
+    return urj_pyr_get_dr (self, 1, URJ_PY_FMT_STRING, args);
 }
 
 static PyObject *
 urj_pyr_get_int_dr_out (urj_pyregister_t *self, PyObject *args)
 {
-    return urj_pyr_get_dr (self, 0, 0, args);
+    return urj_pyr_get_dr (self, 0, URJ_PY_FMT_INT, args);
 }
 
 static PyObject *
 urj_pyr_get_int_dr_in (urj_pyregister_t *self, PyObject *args)
 {
-    return urj_pyr_get_dr (self, 1, 0, args);
+    return urj_pyr_get_dr (self, 1, URJ_PY_FMT_INT, args);
+}
+
+static PyObject *
+urj_pyr_get_bytes_dr_out (urj_pyregister_t *self, PyObject *args)
+{
+    return urj_pyr_get_dr (self, 0, URJ_PY_FMT_BYTES, args);
+}
+
+static PyObject *
+urj_pyr_get_bytes_dr_in (urj_pyregister_t *self, PyObject *args)
+{
+    return urj_pyr_get_dr (self, 1, URJ_PY_FMT_BYTES, args);
 }
 
 static PyObject *
@@ -131,18 +126,12 @@ urj_pyr_set_dr (urj_pyregister_t *self, int in, PyObject *args)
 {
     urj_data_register_t *dr = self->urreg;
     urj_tap_register_t *r;
-    char *newstr = NULL;
-    uint64_t newval;
+    PyObject *newval;
     int lsb = -1;
     int msb = -1;
 
-
-    if (!PyArg_ParseTuple (args, "s|ii", &newstr, &msb, &lsb))
-    {
-        PyErr_Clear ();
-        if (!PyArg_ParseTuple (args, "L|ii", &newval, &msb, &lsb))
-            return NULL;
-    }
+    if (!PyArg_ParseTuple (args, "O|ii", &newval, &msb, &lsb))
+        return NULL;
 
     if (dr == NULL)
     {
@@ -156,23 +145,7 @@ urj_pyr_set_dr (urj_pyregister_t *self, int in, PyObject *args)
     else
         r = dr->out;
 
-    if (msb == -1)
-    {
-        if (newstr)
-            return urj_py_chkret (urj_tap_register_set_string (r, newstr));
-        else
-            return urj_py_chkret (urj_tap_register_set_value (r, newval));
-    }
-    else
-    {
-        if (lsb == -1)
-            lsb = msb;
-
-        if (newstr)
-            return urj_py_chkret (urj_tap_register_set_string_bit_range (r, newstr, msb, lsb));
-        else
-            return urj_py_chkret (urj_tap_register_set_value_bit_range (r, newval, msb, lsb));
-    }
+    return urj_py_reg_set (r, newval, msb, lsb);
 }
 
 static PyObject *
@@ -195,6 +168,7 @@ urj_pyr_shift_dr (urj_pyregister_t *self, PyObject *args)
     int partn = self->part;
     char *instname = NULL;
     urj_part_t *part;
+    int rc;
 
     if (!PyArg_ParseTuple (args, "|s", &instname))
         return NULL;
@@ -231,7 +205,10 @@ urj_pyr_shift_dr (urj_pyregister_t *self, PyObject *args)
         part->active_instruction = self->inst;
     }
 
-    return urj_py_chkret (urj_tap_chain_shift_data_registers (urc, 1));
+    Py_BEGIN_ALLOW_THREADS
+    rc = urj_tap_chain_shift_data_registers (urc, 1);
+    Py_END_ALLOW_THREADS
+    return urj_py_chkret (rc);
 }
 
 static PyObject *
@@ -240,6 +217,7 @@ urj_pyr_shift_ir (urj_pyregister_t *self,  PyObject *args)
     urj_chain_t *urc = self->urc;
     char *instname = NULL;
     urj_part_t *part;
+    int rc;
 
     if (!PyArg_ParseTuple (args, "|s", &instname)) 
         return NULL;
@@ -267,7 +245,10 @@ urj_pyr_shift_ir (urj_pyregister_t *self,  PyObject *args)
         part->active_instruction = self->inst;
     }
 
-    return urj_py_chkret (urj_tap_chain_shift_instructions (urc));
+    Py_BEGIN_ALLOW_THREADS
+    rc = urj_tap_chain_shift_instructions (urc);
+    Py_END_ALLOW_THREADS
+    return urj_py_chkret (rc);
 }
 
 
@@ -282,9 +263,13 @@ static PyMethodDef urj_pyr_methods[] =
      "retrieve values scanned out from the data registers on the last shift_dr, as integer"},
     {"get_dr_out_string", (PyCFunction) urj_pyr_get_str_dr_out, METH_VARARGS,
      "retrieve values scanned out from the data registers on the last shift_dr, as string"},
+    {"get_dr_in_bytes", (PyCFunction) urj_pyr_get_bytes_dr_in, METH_VARARGS,
+     "get bits that will be scanned in on next shift_dr, as bytes packed LSB first"},
+    {"get_dr_out_bytes", (PyCFunction) urj_pyr_get_bytes_dr_out, METH_VARARGS,
+     "retrieve values scanned out from the data register on the last shift_dr, as bytes packed LSB first"},
 
     {"set_dr_in", (PyCFunction) urj_pyr_set_dr_in, METH_VARARGS,
-     "set bits that will be scanned in on next shiftdr"},
+     "set bits that will be scanned in on next shiftdr, from a string, an integer or a bytes-like object"},
     {"set_dr_out", (PyCFunction) urj_pyr_set_dr_out, METH_VARARGS,
      "set the holding register for values scanned out from the data register"},
     {"shift_dr", (PyCFunction) urj_pyr_shift_dr, METH_VARARGS,
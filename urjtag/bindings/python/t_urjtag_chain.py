@@ -78,3 +78,14 @@ printf("IDREG dr result: %s\n", drval)
 
 urc.set_instruction("BYPASS")
 urc.shift_ir()
+
+urc.set_instruction("SAMPLE/PRELOAD")
+urc.shift_ir()
+urc.shift_dr()
+bsr = urc.get_dr_out_bytes()
+printf("BSR dr_out bytes: %s\n", bsr)
+urc.set_dr_in(bsr)
+printf("BSR dr_in as integer: %x\n", urc.get_dr_in())
+
+urc.set_instruction("BYPASS")
+urc.shift_ir()
@@ -115,6 +115,8 @@ struct bfin_part_data
 
     uint32_t emupc;
     uint32_t emupc_orig;
+
+    int wait_clocks;            /* for the cable of the chain, -1 = unknown */
 };
 
 #define BFIN_PART_DATA(part)       ((struct bfin_part_data *)((part)->params->data))
@@ -182,6 +184,9 @@ enum {
     LEAVE_NOP_NO
 };
 
+/* Settings of the program using the library, only read by it: checking
+   EMUREADY after EMUIR scans, and the wait clocks after them (-1 picks a
+   default for the cable of each chain) */
 extern int bfin_check_emuready;
 extern int bfin_wait_clocks;
 
@@ -275,6 +280,12 @@ uint32_t part_mmr_read_clobber_r0 (urj_chain_t *, int, int32_t, int);
 void part_mmr_write_clobber_r0 (urj_chain_t *, int, int32_t, uint32_t, int);
 uint32_t part_mmr_read (urj_chain_t *, int, uint32_t, int);
 void part_mmr_write (urj_chain_t *, int, uint32_t, uint32_t, int);
+/* The block transfers return URJ_STATUS_OK on success; URJ_STATUS_FAIL if
+   the core faulted, left emulation or lost EMUDAT words.  */
+int part_mem_read_block_clobber (urj_chain_t *, int, uint32_t, uint32_t *, uint32_t, int);
+int part_mem_write_block_clobber (urj_chain_t *, int, uint32_t, const uint32_t *, uint32_t, int);
+int part_mem_read_block (urj_chain_t *, int, uint32_t, uint32_t *, uint32_t, int);
+int part_mem_write_block (urj_chain_t *, int, uint32_t, const uint32_t *, uint32_t, int);
 
 /* From src/bfin/insn-gen.c */
 
@@ -31,12 +31,75 @@
 
 #include "bus_driver.h"
 
-extern urj_bus_t *urj_bus;
+/** Active bus of the calling thread's context, see context.h */
+urj_bus_t **urj_context_bus (void);
+#define urj_bus (*urj_context_bus ())
+
+/** File formats of readmem and writemem */
+typedef enum URJ_BUS_MEMFILE_FORMAT
+{
+    URJ_BUS_MEMFILE_BINARY = 0, /**< raw bytes at the file position */
+    URJ_BUS_MEMFILE_IHEX,       /**< Intel HEX */
+    URJ_BUS_MEMFILE_SREC,       /**< Motorola S-records */
+    URJ_BUS_MEMFILE_ELF,        /**< loadable segments of an ELF file */
+}
+urj_bus_memfile_format_t;
+
+/**
+ * Look up a format by its name: "binary", "ihex", "srec" or "elf".
+ *
+ * @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on an unknown name
+ */
+int urj_bus_memfile_format (const char *name,
+                            urj_bus_memfile_format_t *format);
 
 /** @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error */
 int urj_bus_readmem (urj_bus_t *bus, FILE *f, uint32_t addr, uint32_t len);
 /** @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error */
 int urj_bus_writemem (urj_bus_t *bus, FILE *f, uint32_t addr, uint32_t len);
+/**
+ * Copy @len bytes of memory at @addr to @f.  A binary image goes to the
+ * current file position; a file opened for reading and writing is memory
+ * mapped.  The other formats record @addr with the data.
+ *
+ * @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error
+ */
+int urj_bus_readmem_format (urj_bus_t *bus, FILE *f, uint32_t addr,
+                            uint32_t len, urj_bus_memfile_format_t format);
+/**
+ * Write memory from @f.  A binary image supplies @len bytes for @addr from
+ * the current file position.  The other formats place their data at the
+ * addresses they record; only the parts within @addr .. @addr + @len - 1
+ * are written, words partly covered are merged with the memory content.
+ *
+ * @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error
+ */
+int urj_bus_writemem_format (urj_bus_t *bus, FILE *f, uint32_t addr,
+                             uint32_t len, urj_bus_memfile_format_t format);
+/**
+ * Read/write a block of memory to/from a caller supplied buffer. Words are
+ * packed according to the file endianness (see urj_set_file_endian()).
+ * @param addr and @param len must be multiples of the bus width.
+ *
+ * @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error
+ */
+int urj_bus_read_block (urj_bus_t *bus, uint32_t addr, uint8_t *buf,
+                        uint32_t len);
+int urj_bus_write_block (urj_bus_t *bus, uint32_t addr, const uint8_t *buf,
+                         uint32_t len);
+/**
+ * Update *crc with the CRC-32 (as zlib's crc32()) of the bus words in a
+ * block of memory, each word taken least significant byte first.  Start
+ * with *crc = 0.  Busses with a flash stub work area have the target
+ * compute it, others read the block in as few transactions as they can.
+ * @param addr and @param len must be multiples of the bus width.
+ *
+ * @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error
+ */
+int urj_bus_crc32 (urj_bus_t *bus, uint32_t addr, uint32_t len,
+                   uint32_t *crc);
+/** @return crc updated with the width bytes of data, least significant first */
+uint32_t urj_bus_crc32_word (uint32_t crc, uint32_t data, uint32_t width);
 
 typedef struct
 {
@@ -45,7 +108,8 @@ typedef struct
 }
 urj_buses_t;
 
-extern urj_buses_t urj_buses;
+urj_buses_t *urj_context_buses (void);
+#define urj_buses (*urj_context_buses ())
 extern const urj_bus_driver_t * const urj_bus_drivers[];
 
 void urj_bus_buses_free (void);
@@ -86,6 +86,7 @@ typedef enum URJ_BUS_PARAM_KEY
     URJ_BUS_PARAM_KEY_SCK,      /* string (= signal name)       spi */
     URJ_BUS_PARAM_KEY_MOSI,     /* string (= signal name)       spi */
     URJ_BUS_PARAM_KEY_MISO,     /* string (= signal name)       spi */
+    URJ_BUS_PARAM_KEY_WORKAREA, /* ulong (= target address)     ejtag bfin_emu arm9tdmi */
 }
 urj_bus_param_key_t;
 
@@ -97,6 +98,47 @@ typedef enum URJ_BUS_TYPE
 }
 urj_bus_type_t;
 
+/*
+ * Target-resident flash stubs (see src/flash/stub.c)
+ *
+ * Buses that can execute code on the target keep a small flash programming
+ * loop in a work area of target RAM.  The work area is laid out as below;
+ * all offsets are in bytes and the mailbox and buffer hold 32-bit words.
+ *
+ * For each of count units of the stub's width, starting at dst, the stub
+ * writes the ncycles command cycles (an address of ~0 stands for the
+ * current unit), stores the next buffer word at the unit if write is set,
+ * and reads the unit back until it equals the buffer word (smask 0) or
+ * until all smask bits are set, failing if any emask bit is set then.  It
+ * gives up on a unit after timeout reads.  Finally status is set to 0, or
+ * to the number of units left when it failed.
+ *
+ * With write set to URJ_BUS_STUB_CRC the stub instead runs a reflected CRC
+ * over the count units at dst, bit 0 of each unit first, starting from the
+ * remainder in emask with the polynomial in smask.  The remainder is left
+ * in status; cycles, src and timeout are not used.
+ */
+#define URJ_BUS_STUB_CODE           0x000       /* stub code, up to 512 bytes */
+#define URJ_BUS_STUB_MAILBOX        0x200       /* parameters, see below */
+#define URJ_BUS_STUB_BUFFER         0x280       /* one word per unit */
+#define URJ_BUS_STUB_SIZE           0x1000      /* size of the work area */
+
+#define URJ_BUS_STUB_MB_STATUS      0x00
+#define URJ_BUS_STUB_MB_DST         0x04
+#define URJ_BUS_STUB_MB_SRC         0x08
+#define URJ_BUS_STUB_MB_COUNT       0x0c
+#define URJ_BUS_STUB_MB_WRITE       0x10
+#define URJ_BUS_STUB_MB_SMASK       0x14
+#define URJ_BUS_STUB_MB_EMASK       0x18
+#define URJ_BUS_STUB_MB_TIMEOUT     0x1c
+#define URJ_BUS_STUB_MB_NCYCLES     0x20
+#define URJ_BUS_STUB_MB_CYCLES      0x24        /* address/data pairs */
+#define URJ_BUS_STUB_MAX_CYCLES     8
+#define URJ_BUS_STUB_MB_WORDS       ((URJ_BUS_STUB_MB_CYCLES / 4) \
+                                     + 2 * URJ_BUS_STUB_MAX_CYCLES)
+
+#define URJ_BUS_STUB_CRC            2           /* write: checksum only */
+
 struct URJ_BUS_DRIVER
 {
     const char *name;
@@ -124,6 +166,22 @@ struct URJ_BUS_DRIVER
     int (*enable) (urj_bus_t *bus);
     int (*disable) (urj_bus_t *bus);
     urj_bus_type_t bus_type;
+    /* Optional, NULL if not supported: transfer count words of the
+     * width of the area starting at adr.
+     * @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error */
+    int (*read_block) (urj_bus_t *bus, uint32_t adr, uint32_t *data,
+                       uint32_t count);
+    int (*write_block) (urj_bus_t *bus, uint32_t adr, const uint32_t *data,
+                        uint32_t count);
+    /* Optional, NULL if the bus can not execute code on the target.
+     * stub_area returns the bus address of the stub work area.
+     * @return URJ_STATUS_OK on success; URJ_STATUS_FAIL if there is none */
+    int (*stub_area) (urj_bus_t *bus, uint32_t *adr);
+    /* Load the stub for units of width bytes unless it is loaded already,
+     * store the URJ_BUS_STUB_MB_WORDS mailbox words (bus addresses) and
+     * run the stub until it returns.
+     * @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error */
+    int (*stub_run) (urj_bus_t *bus, const uint32_t *mailbox, int width);
 };
 
 struct URJ_BUS
@@ -68,6 +68,12 @@ typedef enum URJ_CABLE_PARAM_KEY
     URJ_CABLE_PARAM_KEY_INDEX,          /* lu           ftdi */
     URJ_CABLE_PARAM_KEY_TRST,           /* lu           ft4232_generic */
     URJ_CABLE_PARAM_KEY_RESET,          /* lu           ft4232_generic */
+    URJ_CABLE_PARAM_KEY_CHAIN,          /* string       jim */
+    URJ_CABLE_PARAM_KEY_MEMFILE,        /* string       jim */
+    URJ_CABLE_PARAM_KEY_MEMSIZE,        /* lu           jim */
+    URJ_CABLE_PARAM_KEY_LATENCY,        /* lu           jim */
+    URJ_CABLE_PARAM_KEY_BANDWIDTH,      /* lu           jim */
+    URJ_CABLE_PARAM_KEY_CHUNK,          /* lu           xpc_ext */
 }
 urj_cable_param_key_t;
 
@@ -120,7 +126,8 @@ struct URJ_CABLE_QUEUE
         URJ_TAP_CABLE_GET_TDO,
         URJ_TAP_CABLE_TRANSFER,
         URJ_TAP_CABLE_SET_SIGNAL,
-        URJ_TAP_CABLE_GET_SIGNAL
+        URJ_TAP_CABLE_GET_SIGNAL,
+        URJ_TAP_CABLE_CLOCK_TMS         /* clock.tms: one bit per clock, LSB first */
     } action;
     union
     {
@@ -162,6 +169,32 @@ struct URJ_CABLE_QUEUE_INFO
     int next_free;
 };
 
+/* Flush durations are binned in powers of two microseconds: bucket 0 holds
+ * flushes below 1 us, bucket i those below 2^i us, the last one the rest */
+#define URJ_CABLE_STATS_BUCKETS         24
+#define URJ_CABLE_STATS_ACTIONS         (URJ_TAP_CABLE_CLOCK_TMS + 1)
+#define URJ_CABLE_STATS_FLUSH_AMOUNTS   (URJ_TAP_CABLE_COMPLETELY + 1)
+
+typedef struct URJ_CABLE_STATS urj_cable_stats_t;
+
+struct URJ_CABLE_STATS
+{
+    unsigned long long bits;            /* TCK cycles requested */
+    /* queue items by action, and the same operations issued directly */
+    unsigned long items[URJ_CABLE_STATS_ACTIONS];
+    unsigned long direct[URJ_CABLE_STATS_ACTIONS];
+    int high_water;                     /* most items waiting in todo */
+    /* flushes of a non-empty todo queue, by urj_cable_flush_amount_t;
+     * latency and flush_secs only while urj_cable_t.stats_timing is set */
+    unsigned long flushes[URJ_CABLE_STATS_FLUSH_AMOUNTS];
+    unsigned long latency[URJ_CABLE_STATS_FLUSH_AMOUNTS]
+                         [URJ_CABLE_STATS_BUCKETS];
+    double flush_secs[URJ_CABLE_STATS_FLUSH_AMOUNTS];
+    unsigned long round_trips;          /* USB reads, parport reads */
+    unsigned long long bytes_out;
+    unsigned long long bytes_in;
+};
+
 struct URJ_CABLE
 {
     const urj_cable_driver_t *driver;
@@ -177,6 +210,9 @@ struct URJ_CABLE
     urj_cable_queue_info_t done;
     uint32_t delay;
     uint32_t frequency;
+    urj_cable_stats_t stats;
+    int stats_timing;                   /* time flushes, see "stats timing" */
+    struct URJ_TAP_TRACE *trace;        /* recording, see trace.h */
 };
 
 void urj_tap_cable_free (urj_cable_t *cable);
@@ -190,6 +226,14 @@ void urj_tap_cable_flush (urj_cable_t *cable,
 /** @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on failure */
 void urj_tap_cable_clock (urj_cable_t *cable, int tms, int tdi, int n);
 int urj_tap_cable_defer_clock (urj_cable_t *cable, int tms, int tdi, int n);
+/**
+ * Queue @n clocks, 1 to 31, with TMS taken from the bits of @tms, the first
+ * clock in the LSB, as one item: a TAP state change in one cable operation.
+ *
+ * @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on failure
+ */
+int urj_tap_cable_defer_clock_tms (urj_cable_t *cable, uint32_t tms, int tdi,
+                                   int n);
 /** @return 0 or 1 on success; -1 on failure */
 int urj_tap_cable_get_tdo (urj_cable_t *cable);
 /** @return 0 or 1 on success; -1 on failure */
@@ -217,6 +261,7 @@ int urj_tap_cable_defer_transfer (urj_cable_t *cable, int len, char *in,
 void urj_tap_cable_set_frequency (urj_cable_t *cable, uint32_t frequency);
 uint32_t urj_tap_cable_get_frequency (urj_cable_t *cable);
 void urj_tap_cable_wait (urj_cable_t *cable);
+void urj_tap_cable_stats_reset (urj_cable_t *cable);
 void urj_tap_cable_purge_queue (urj_cable_queue_info_t *q, int io);
 /** @return queue item number on success; -1 on failure */
 int urj_tap_cable_add_queue_item (urj_cable_t *cable,
@@ -25,6 +25,8 @@
 #ifndef URJ_CHAIN_H
 #define URJ_CHAIN_H
 
+#include <stdint.h>
+
 #include "types.h"
 
 #include "pod.h"
@@ -45,6 +47,10 @@ struct URJ_CHAIN
     urj_cable_t *cable;
     urj_bsdl_globs_t bsdl;
     int main_part;
+    /* whole-chain scan vector, kept between scans */
+    urj_tap_register_t *scan_in;
+    /* captures of whole-chain scans not picked up yet, oldest first */
+    struct URJ_CHAIN_SCAN *scan_queue;
 };
 
 urj_chain_t *urj_tap_chain_alloc (void);
@@ -64,6 +70,24 @@ void urj_tap_chain_disconnect (urj_chain_t *chain);
 int urj_tap_chain_clock (urj_chain_t *chain, int tms, int tdi, int n);
 /** @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error */
 int urj_tap_chain_defer_clock (urj_chain_t *chain, int tms, int tdi, int n);
+/**
+ * Move the TAP controllers to @state on the shortest path, queued as a
+ * single TMS sequence (see urj_tap_state_path())
+ *
+ * @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error
+ */
+int urj_tap_chain_defer_goto_state (urj_chain_t *chain, int state);
+/**
+ * Stay in the current, stable TAP state for @clocks TCK cycles with TMS
+ * low, and for at least @secs seconds: at a known TCK @frequency the time
+ * is made of cycles, otherwise the host waits after the cycles went out.
+ * A @frequency of 0 with no @clocks is a plain host wait, for
+ * Test-Logic-Reset, which TMS low would leave.
+ *
+ * @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error
+ */
+int urj_tap_chain_defer_wait (urj_chain_t *chain, uint32_t frequency,
+                              unsigned long long clocks, double secs);
 /** @return trst = 0 or 1 on success; -1 on error */
 int urj_tap_chain_set_trst (urj_chain_t *chain, int trst);
 /** @return 0 or 1 on success; -1 on error */
@@ -81,6 +105,20 @@ int urj_tap_chain_shift_data_registers (urj_chain_t *chain,
 int urj_tap_chain_shift_data_registers_mode (urj_chain_t *chain,
                                              int capture_output, int capture,
                                              int chain_exit);
+/**
+ * Queue a data register scan without waiting for its result. With
+ * capture_output, the captured values have to be picked up in the same
+ * order with urj_tap_chain_shift_data_registers_output(), which copies
+ * them into the data registers' out fields.
+ *
+ * @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error
+ */
+int urj_tap_chain_defer_shift_data_registers_mode (urj_chain_t *chain,
+                                                   int capture_output,
+                                                   int capture,
+                                                   int chain_exit);
+void urj_tap_chain_shift_data_registers_output (urj_chain_t *chain,
+                                                int chain_exit);
 void urj_tap_chain_flush (urj_chain_t *chain);
 /** @return 0 or 1 on success; -1 on failure */
 int urj_tap_chain_set_pod_signal (urj_chain_t *chain, int mask, int val);
@@ -0,0 +1,62 @@
+/*
+ * $Id$
+ *
+ * Per-thread library state
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ */
+
+#ifndef URJ_CONTEXT_H
+#define URJ_CONTEXT_H
+
+#include "types.h"
+
+/*
+ * The active bus and the bus list (urj_bus, urj_buses), the detected flash
+ * array and the log and error state (urj_log_state, urj_error_state) live
+ * in a context.  Those names are macros for the fields of the calling
+ * thread's current context, much like errno.
+ *
+ * A thread uses the process-wide default context until it selects another
+ * one with urj_context_use(), so single threaded programs see no change.
+ * To drive several cables concurrently, give each thread its own chain and
+ * context; the part database and BSDL files are shared.
+ */
+
+/**
+ * Allocate a context with no bus and no flash, and the log settings of the
+ * calling thread's current context.
+ *
+ * @return the new context; NULL on error
+ */
+urj_context_t *urj_context_alloc (void);
+/**
+ * Free the buses and flash array of a context and the context itself.  It
+ * must not be current in any thread.
+ */
+void urj_context_free (urj_context_t *ctx);
+/**
+ * Make ctx the current context of the calling thread; NULL selects the
+ * default context.
+ *
+ * @return the previously current context
+ */
+urj_context_t *urj_context_use (urj_context_t *ctx);
+/** @return the current context of the calling thread */
+urj_context_t *urj_context_current (void);
+
+#endif /* URJ_CONTEXT_H */
@@ -96,7 +96,9 @@ typedef struct URJ_ERROR_STATE
 }
 urj_error_state_t;
 
-extern urj_error_state_t        urj_error_state;
+/** Error state of the calling thread's context, see context.h */
+urj_error_state_t *urj_context_error_state (void);
+#define urj_error_state (*urj_context_error_state ())
 
 /**
  * Descriptive string for error type
@@ -73,6 +73,11 @@ void urj_flash_cleanup (void);
 
 /** @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error */
 int urj_flashmem (urj_bus_t *bus, FILE *f, uint32_t addr, int);
+/**
+ * urj_flashmem() verifying a CRC-32 per erase block instead of every word
+ * @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error
+ */
+int urj_flashmem_crc (urj_bus_t *bus, FILE *f, uint32_t addr);
 /** @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error */
 int urj_flashmsbin (urj_bus_t *bus, FILE *f, int);
 
@@ -0,0 +1,73 @@
+/*
+ * $Id$
+ *
+ * Gang programming: one job on several cables in parallel
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ */
+
+#ifndef URJ_GANG_H
+#define URJ_GANG_H
+
+#include "types.h"
+#include "chain.h"
+#include "error.h"
+
+typedef struct URJ_GANG_RESULT
+{
+    int status;                 /* URJ_STATUS_OK or URJ_STATUS_FAIL */
+    double secs;                /* wall time of the job on this target */
+    char error[URJ_ERROR_MSG_LEN + 64];
+}
+urj_gang_result_t;
+
+/*
+ * Each target is a chain with its own cable and a context of its own for
+ * the bus, the flash array and the error state (see context.h).  Jobs run
+ * in one thread per target.
+ */
+typedef struct URJ_GANG
+{
+    urj_chains_t targets;       /* targets.chains[0 .. count-1] */
+    int count;
+    urj_context_t **contexts;
+    urj_gang_result_t *results; /* of the last urj_gang_run() */
+    int running;                /* set while urj_gang_run() runs the jobs */
+}
+urj_gang_t;
+
+urj_gang_t *urj_gang_alloc (void);
+/** Disconnect all cables and free the gang; not while it is running */
+void urj_gang_free (urj_gang_t *gang);
+/**
+ * Connect another target, see urj_tap_chain_connect().  Refused while the
+ * gang is running.
+ *
+ * @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error
+ */
+int urj_gang_add (urj_gang_t *gang, const char *drivername, char *params[]);
+/**
+ * Run the command @params on every target at the same time and wait for
+ * all of them to finish.  The outcome per target is left in gang->results.
+ * The jobs may not add targets, free the gang or run it again.
+ *
+ * @return URJ_STATUS_OK if the command succeeded on all targets;
+ *      URJ_STATUS_FAIL otherwise
+ */
+int urj_gang_run (urj_gang_t *gang, char *params[]);
+
+#endif /* URJ_GANG_H */
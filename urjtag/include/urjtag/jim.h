@@ -37,6 +37,8 @@
 #include <stdint.h>
 #include <stddef.h>
 
+#include "types.h"
+
 typedef enum jim_tap_state
 {
     URJ_JIM_RESET = 0,
@@ -76,6 +78,9 @@ struct URJ_JIM_DEVICE
                       uint8_t *shmem, size_t shmem_size);
     void (*tck_fall) (urj_jim_device_t *dev, uint8_t *shmem,
                       size_t shmem_size);
+    /* nonzero if tck_rise/tck_fall ignore SHIFT_DR/SHIFT_IR, so that
+     * urj_jim_shift() may move whole blocks without calling them */
+    int passive_shift;
     void (*dev_free) (urj_jim_device_t *dev);
     void *state;
     int num_sregs;
@@ -90,6 +95,7 @@ typedef struct URJ_JIM_STATE
     int trst;
     uint8_t *shmem;
     size_t shmem_size;
+    int shmem_mapped;           /* shmem is an mmap'd file */
     urj_jim_device_t *last_device_in_chain;
 }
 urj_jim_state_t;
@@ -120,14 +126,49 @@ typedef struct
 }
 urj_jim_attached_part_t;
 
+/** Round trip and bandwidth model of the jim cable */
+typedef struct
+{
+    unsigned long latency;      /**< microseconds per USB round trip */
+    unsigned long bandwidth;    /**< bytes per second, 0 for unlimited */
+    unsigned long round_trips;
+    unsigned long long bytes;
+    double usecs;               /**< modelled wall time */
+}
+urj_jim_cable_model_t;
+
 void urj_jim_set_trst (urj_jim_state_t *s, int trst);
 int urj_jim_get_trst (urj_jim_state_t *s);
 int urj_jim_get_tdo (urj_jim_state_t *s);
 void urj_jim_tck_rise (urj_jim_state_t *s, int tms, int tdi);
 void urj_jim_tck_fall (urj_jim_state_t *s);
+/** Clocks len bits from in[] into the chain with TMS held low, storing TDO
+ * as seen before each clock in out[] (if non-NULL).
+ * @return len */
+int urj_jim_shift (urj_jim_state_t *s, int len, const char *in, char *out);
 urj_jim_device_t *urj_jim_alloc_device (int num_sregs, const int reg_size[]);
-urj_jim_state_t *urj_jim_init (void);
+void urj_jim_free_device (urj_jim_device_t *dev);
+/** Builds the simulated chain.
+ * @param chain comma separated device list, first entry closest to TDO;
+ *      each entry is "some_cpu", "fjmem[:WORDS]",
+ *      IDCODE:IR_LENGTH[:BSR_LENGTH] or a BSDL file name, optionally prefixed
+ *      by a repeat count "N*". NULL means "some_cpu".
+ * @param memfile if non-NULL, file to mmap as device memory
+ * @param memsize size of device memory in bytes, 0 for the default 16 MByte
+ * @return the new state, or NULL on error */
+urj_jim_state_t *urj_jim_init (const char *chain, const char *memfile,
+                               size_t memsize);
 void urj_jim_free (urj_jim_state_t *s);
 urj_jim_device_t *urj_jim_some_cpu (void);
+urj_jim_device_t *urj_jim_generic_device (uint32_t idcode, int ir_len,
+                                          int bsr_len);
+urj_jim_device_t *urj_jim_bsdl_device (const char *filename);
+/** An FPGA with the fjmem core behind USER1.
+ * @param burst words per burst transfer, 0 for a core without burst mode */
+urj_jim_device_t *urj_jim_fjmem (int burst);
+
+/** Reads the traffic counters and modelled wall time of a jim cable.
+ * @return URJ_STATUS_OK on success; URJ_STATUS_FAIL if cable is not jim */
+int urj_tap_cable_jim_model (urj_cable_t *cable, urj_jim_cable_model_t *model);
 
 #endif
@@ -59,5 +59,7 @@ urj_endian_t urj_endian_from_string (const char *);
  */
 void urj_set_argv0(const char *argv0);
 const char *urj_get_data_dir (void);
+/** Use dir instead of the installed data directory; NULL restores it */
+void urj_set_data_dir (const char *dir);
 
 #endif /* URJ_JTAG_H */
@@ -38,7 +38,9 @@ typedef struct URJ_LOG_STATE
 }
 urj_log_state_t;
 
-extern urj_log_state_t urj_log_state;
+/** Log state of the calling thread's context, see context.h */
+urj_log_state_t *urj_context_log_state (void);
+#define urj_log_state (*urj_context_log_state ())
 
 int urj_do_log (urj_log_level_t level, const char *file, size_t line,
                 const char *func, const char *fmt, ...)
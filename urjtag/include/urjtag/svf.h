@@ -40,6 +40,9 @@
  * register). Initializes all svf-global variables and performs clean-up
  * afterwards.
  *
+ * The file is parsed in a single pass from its current position; progress
+ * is reported by file offset when SVF_FILE is a regular file.
+ *
  * @param chain            pointer to global chain
  * @param SVF_FILE         file handle of SVF file
  * @param stop_on_mismatch 1 = stop upon tdo mismatch
@@ -26,6 +26,7 @@
 #define URJ_TAP_REGISTER_H
 
 #include "types.h"
+#include <stddef.h>
 #include <stdint.h>
 
 struct URJ_TAP_REGISTER
@@ -48,6 +49,16 @@ const char *urj_tap_register_get_string (const urj_tap_register_t *tr);
 const char *urj_tap_register_get_string_bit_range (const urj_tap_register_t *tr, int msb, int lsb);
 uint64_t urj_tap_register_get_value (const urj_tap_register_t *tr);
 uint64_t urj_tap_register_get_value_bit_range (const urj_tap_register_t *tr, int msb, int lsb);
+/**
+ * Packed access to register bits: bit lsb is stored in bit 0 of buf[0],
+ * the following ones in ascending bit and byte order.
+ *
+ * @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error
+ */
+int urj_tap_register_set_bytes (urj_tap_register_t *tr, const uint8_t *buf, size_t buflen);
+int urj_tap_register_set_bytes_bit_range (urj_tap_register_t *tr, const uint8_t *buf, size_t buflen, int msb, int lsb);
+int urj_tap_register_get_bytes (const urj_tap_register_t *tr, uint8_t *buf, size_t buflen);
+int urj_tap_register_get_bytes_bit_range (const urj_tap_register_t *tr, uint8_t *buf, size_t buflen, int msb, int lsb);
 /** @return 0 or 1 on success; -1 on error */
 int urj_tap_register_all_bits_same_value (const urj_tap_register_t *tr);
 urj_tap_register_t *urj_tap_register_init (urj_tap_register_t *tr,
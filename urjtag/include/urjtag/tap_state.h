@@ -25,6 +25,8 @@
 #ifndef URJ_TAP_STATE_H
 #define URJ_TAP_STATE_H
 
+#include <stdint.h>
+
 #include "bitmask.h"
 
 #include "types.h"
@@ -61,6 +63,22 @@ int urj_tap_state_init (urj_chain_t *chain);
 int urj_tap_state_done (urj_chain_t *chain);
 int urj_tap_state_reset (urj_chain_t *chain);
 int urj_tap_state_set_trst (urj_chain_t *chain, int old_trst, int new_trst);
+/**
+ * The state the TAP moves to from @state on one clock with @tms, without
+ * touching any chain.
+ *
+ * @return the next state; URJ_TAP_STATE_UNKNOWN_STATE if @state is unknown
+ */
+int urj_tap_state_next (int state, int tms);
 int urj_tap_state_clock (urj_chain_t *chain, int tms);
+/**
+ * Look up the shortest TMS sequence from state @from to state @to.  From
+ * an unknown state the sequence starts with five clocks of TMS=1.
+ *
+ * @param tms receives the TMS values, the first clock in the LSB
+ *
+ * @return the number of clocks (0 if @from is @to); -1 if @to is not a state
+ */
+int urj_tap_state_path (int from, int to, uint32_t *tms);
 
 #endif /* URJ_TAP_STATE_H */
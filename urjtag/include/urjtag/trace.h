@@ -0,0 +1,126 @@
+/*
+ * $Id$
+ *
+ * Binary trace of cable operations
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ */
+
+#ifndef URJ_TRACE_H
+#define URJ_TRACE_H
+
+#include "types.h"
+
+/*
+ * A trace file starts with the 8 byte magic "URJTRC01" followed by one
+ * record per cable API call.  A record is an opcode byte, the time since
+ * the previous record in microseconds and the arguments of the call; the
+ * calls that return data also carry the result the cable delivered.
+ * Numbers are LEB128 varints (signed ones zigzag coded), TDI/TDO vectors
+ * are packed eight bits per byte, first bit in the LSB.
+ */
+typedef enum URJ_TAP_TRACE_OP
+{
+    URJ_TAP_TRACE_CLOCK = 1,            /* tms, tdi, n */
+    URJ_TAP_TRACE_DEFER_CLOCK,          /* tms, tdi, n */
+    URJ_TAP_TRACE_GET_TDO,              /* result */
+    URJ_TAP_TRACE_DEFER_GET_TDO,        /* - */
+    URJ_TAP_TRACE_GET_TDO_LATE,         /* result */
+    URJ_TAP_TRACE_SET_SIGNAL,           /* mask, val, result */
+    URJ_TAP_TRACE_DEFER_SET_SIGNAL,     /* mask, val */
+    URJ_TAP_TRACE_GET_SIGNAL,           /* sig, result */
+    URJ_TAP_TRACE_DEFER_GET_SIGNAL,     /* sig */
+    URJ_TAP_TRACE_GET_SIGNAL_LATE,      /* sig, result */
+    URJ_TAP_TRACE_TRANSFER,             /* len, has_out, TDI, [TDO], result */
+    URJ_TAP_TRACE_DEFER_TRANSFER,       /* len, has_out, TDI */
+    URJ_TAP_TRACE_TRANSFER_LATE,        /* len, TDO, result */
+    URJ_TAP_TRACE_SET_FREQUENCY,        /* frequency */
+    URJ_TAP_TRACE_DEFER_CLOCK_TMS,      /* tms, tdi, n */
+}
+urj_tap_trace_op_t;
+
+typedef struct URJ_TAP_TRACE urj_tap_trace_t;
+
+typedef struct URJ_TAP_TRACE_REPORT
+{
+    unsigned long records;
+    unsigned long long bits;            /* TCK cycles replayed */
+    unsigned long mismatches;           /* results that differ */
+    unsigned long first_mismatch;       /* record number, 0 for none */
+    double recorded_secs;               /* time span of the recording */
+    double replayed_secs;
+}
+urj_tap_trace_report_t;
+
+typedef enum URJ_TAP_TRACE_FORMAT
+{
+    URJ_TAP_TRACE_SVF,
+    URJ_TAP_TRACE_XSVF,
+}
+urj_tap_trace_format_t;
+
+/* flags for urj_tap_trace_export() */
+#define URJ_TAP_TRACE_EXPORT_TDO        1       /* check the recorded TDO */
+#define URJ_TAP_TRACE_EXPORT_NOPOLL     2       /* keep polling loops */
+
+typedef struct URJ_TAP_TRACE_EXPORT_REPORT
+{
+    unsigned long records;
+    unsigned long scans;                /* SIR/SDR written */
+    unsigned long polls;                /* polling loops turned into waits */
+    unsigned long dropped;              /* loop iterations left out */
+}
+urj_tap_trace_export_report_t;
+
+/**
+ * Start recording every operation on @cable to @filename
+ * @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error
+ */
+int urj_tap_trace_start (urj_cable_t *cable, const char *filename);
+/**
+ * Stop a recording started by urj_tap_trace_start()
+ * @return URJ_STATUS_OK on success; URJ_STATUS_FAIL if the trace could not
+ *      be written completely
+ */
+int urj_tap_trace_stop (urj_cable_t *cable);
+/**
+ * Issue the operations of a trace on @cable and compare every result with
+ * the recorded one.  The TAP state machine is driven behind the chain's
+ * back; the trace should begin with a reset.
+ * @param report filled in with record count, mismatches and timing
+ * @return URJ_STATUS_OK if the trace was replayed, even with mismatches;
+ *      URJ_STATUS_FAIL on I/O or format errors
+ */
+int urj_tap_trace_replay (urj_cable_t *cable, const char *filename,
+                          urj_tap_trace_report_t *report);
+/**
+ * Convert a trace to an SVF or XSVF file for a programmer that has never
+ * seen UrJTAG.  The TAP state is followed through the TMS of the recorded
+ * clocks, so the trace must contain a reset before the first scan.  A
+ * sequence of identical scans that read the same TDO, repeated until the
+ * TDO changed, a polling loop, becomes its first iteration, a wait for the
+ * time the loop took and its last iteration.  Scans that capture no TDO
+ * are always kept.
+ * @param flags URJ_TAP_TRACE_EXPORT_* bits
+ * @param report filled in with record, scan and loop counts
+ * @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on I/O or format errors
+ */
+int urj_tap_trace_export (const char *tracefile, const char *outfile,
+                          urj_tap_trace_format_t format, int flags,
+                          urj_tap_trace_export_report_t *report);
+
+#endif /* URJ_TRACE_H */
@@ -42,6 +42,7 @@ typedef struct URJ_PART_INIT urj_part_init_t;
 typedef struct URJ_DATA_REGISTER urj_data_register_t;
 typedef struct URJ_BSBIT urj_bsbit_t;
 typedef struct URJ_TAP_REGISTER urj_tap_register_t;
+typedef struct URJ_CONTEXT urj_context_t;
 
 /**
  * Log levels
@@ -0,0 +1,43 @@
+/*
+ * $Id$
+ *
+ * XSVF player
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ */
+
+#ifndef URJ_XSVF_H
+#define URJ_XSVF_H
+
+#include <stdio.h>
+
+#include "types.h"
+
+/**
+ * Play the Xilinx XSVF file @XSVF_FILE (XAPP503) on the whole chain.
+ * Unlike the SVF player it needs no detected parts: the file describes
+ * every scan of the chain.
+ *
+ * @param chain     chain with a cable
+ * @param XSVF_FILE file handle of the XSVF file, opened in binary mode
+ *
+ * @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error or on a TDO
+ *      mismatch that persisted through the XREPEAT retries
+ */
+int urj_xsvf_run (urj_chain_t *chain, FILE *XSVF_FILE);
+
+#endif /* URJ_XSVF_H */
@@ -393,13 +393,14 @@ main (int argc, char *const argv[])
             {"interactive", no_argument, 0, 'i'},
             {"help", no_argument, 0, 'h'},
             {"quiet", no_argument, 0, 'q'},
+            {"datadir", required_argument, 0, 'd'},
             {0, 0, 0, 0}
         };
 
         /* `getopt_long' stores the option index here. */
         int option_index = 0;
 
-        c = getopt_long (argc, argv, "vnhiq", long_options, &option_index);
+        c = getopt_long (argc, argv, "vnhiqd:", long_options, &option_index);
 
         /* Detect the end of the options. */
         if (c == -1)
@@ -427,6 +428,10 @@ main (int argc, char *const argv[])
         case 'q':
             quiet = 1;
             break;
+
+        case 'd':
+            urj_set_data_dir (optarg);
+            break;
         }
     }
 
@@ -445,6 +450,7 @@ main (int argc, char *const argv[])
         printf (_("  -n, --norc          disable reading ~/.jtag/rc on startup\n"));
         printf (_("  -i, --interactive   enter interactive mode after reading files\n"));
         printf (_("  -q, --quiet         Do not print help on startup\n"));
+        printf (_("  -d, --datadir=DIR   read the part database from DIR\n"));
         printf ("\n");
         printf (_("  [FILE]              file containing commands to execute\n"));
         printf ("\n");
@@ -31,6 +31,7 @@
 #include <urjtag/tap_register.h>
 #include <urjtag/data_register.h>
 #include <urjtag/part_instruction.h>
+#include <urjtag/error.h>
 #include <urjtag/bfin.h>
 
 const char * const scans[] = {
@@ -1192,6 +1193,200 @@ part_mmr_write (urj_chain_t *chain, int n, uint32_t addr, uint32_t data, int siz
     part_register_set (chain, n, BFIN_REG_R0, r0);
 }
 
+/* Bulk memory access.  P0 is pointed at the start address only once,
+   then a two instruction EMUIR loop (a post-increment load or store plus
+   a move from or to EMUDAT) runs once per word each time the TAP passes
+   through Run-Test/Idle.  The EMUDAT scans are only deferred, so a whole
+   batch of words goes out to the cable in a single flush.  */
+
+#define BFIN_MEM_BATCH 256
+
+static void
+part_emudat_defer_set (urj_chain_t *chain, int n, uint32_t value, int exit)
+{
+    int i;
+    urj_parts_t *ps;
+
+    assert (exit == URJ_CHAIN_EXITMODE_UPDATE || exit == URJ_CHAIN_EXITMODE_IDLE);
+
+    if (part_scan_select (chain, n, EMUDAT_SCAN) < 0)
+        abort ();
+
+    ps = chain->parts;
+    emudat_init_value (ps->parts[n]->active_instruction->data_register->in, value);
+
+    urj_tap_capture_dr (chain);
+
+    /* With EXITMODE_IDLE the last shift also defers the wait_ready clocks.  */
+    for (i = 0; i < ps->len; i++)
+        urj_tap_defer_shift_register (chain, ps->parts[i]->active_instruction->data_register->in,
+                                      NULL,
+                                      (i + 1) == ps->len ? exit : URJ_CHAIN_EXITMODE_SHIFT);
+}
+
+static void
+part_emuir_loop_set (urj_chain_t *chain, int n, int enable)
+{
+    part_scan_select (chain, n, DBGCTL_SCAN);
+    if (enable)
+        part_dbgctl_bit_set_emuirlpsz_2 (chain, n);
+    else
+        part_dbgctl_bit_clear_emuirlpsz_2 (chain, n);
+    urj_tap_chain_shift_data_registers_mode (chain, 0, 1, URJ_CHAIN_EXITMODE_UPDATE);
+}
+
+/* A faulting access shows up as a core fault or takes the core out of
+   emulation, a word lost on EMUDAT as an overflow.  */
+static int
+part_mem_block_check (urj_chain_t *chain, int n, uint32_t addr,
+                      const char *what)
+{
+    part_dbgstat_get (chain, n);
+
+    if (part_dbgstat_is_core_fault (chain, n))
+    {
+        urj_error_set (URJ_ERROR_BFIN,
+                       _("core fault while %s memory at 0x%08lx"), what,
+                       (long unsigned) addr);
+        return URJ_STATUS_FAIL;
+    }
+    if (!part_dbgstat_is_emuready (chain, n))
+    {
+        urj_error_set (URJ_ERROR_BFIN,
+                       _("core left emulation while %s memory at 0x%08lx"),
+                       what, (long unsigned) addr);
+        return URJ_STATUS_FAIL;
+    }
+    if (part_dbgstat_is_emudiovf (chain, n)
+        || part_dbgstat_is_emudoovf (chain, n))
+    {
+        part_dbgstat_clear_ovfs (chain, n);
+        urj_error_set (URJ_ERROR_BFIN,
+                       _("EMUDAT overflow while %s memory at 0x%08lx"), what,
+                       (long unsigned) addr);
+        return URJ_STATUS_FAIL;
+    }
+
+    return URJ_STATUS_OK;
+}
+
+int
+part_mem_read_block_clobber (urj_chain_t *chain, int n, uint32_t addr,
+                             uint32_t *data, uint32_t count, int size)
+{
+    uint32_t insn;
+    uint32_t i, j, batch;
+
+    assert (size == 1 || size == 2 || size == 4);
+
+    if (count == 0)
+        return URJ_STATUS_OK;
+
+    if (size == 1)
+        insn = gen_load8zpi (BFIN_REG_R0, BFIN_REG_P0);
+    else if (size == 2)
+        insn = gen_load16zpi (BFIN_REG_R0, BFIN_REG_P0);
+    else
+        insn = gen_load32pi (BFIN_REG_R0, BFIN_REG_P0);
+
+    part_register_set (chain, n, BFIN_REG_P0, addr);
+
+    part_emuir_loop_set (chain, n, 1);
+    part_emuir_set_2 (chain, n, insn, gen_move (BFIN_REG_EMUDAT, BFIN_REG_R0),
+                      URJ_CHAIN_EXITMODE_UPDATE);
+
+    for (i = 0; i < count; i += batch)
+    {
+        batch = count - i < BFIN_MEM_BATCH ? count - i : BFIN_MEM_BATCH;
+
+        for (j = 0; j < batch; j++)
+            part_emudat_defer_get (chain, n, URJ_CHAIN_EXITMODE_IDLE);
+        for (j = 0; j < batch; j++)
+            data[i + j] = part_emudat_get_done (chain, n, URJ_CHAIN_EXITMODE_IDLE);
+    }
+
+    part_emuir_loop_set (chain, n, 0);
+
+    return part_mem_block_check (chain, n, addr, "reading");
+}
+
+int
+part_mem_write_block_clobber (urj_chain_t *chain, int n, uint32_t addr,
+                              const uint32_t *data, uint32_t count, int size)
+{
+    uint32_t insn;
+    uint32_t i;
+
+    assert (size == 1 || size == 2 || size == 4);
+
+    if (count == 0)
+        return URJ_STATUS_OK;
+
+    if (size == 1)
+        insn = gen_store8pi (BFIN_REG_P0, BFIN_REG_R0);
+    else if (size == 2)
+        insn = gen_store16pi (BFIN_REG_P0, BFIN_REG_R0);
+    else
+        insn = gen_store32pi (BFIN_REG_P0, BFIN_REG_R0);
+
+    part_register_set (chain, n, BFIN_REG_P0, addr);
+
+    part_emuir_loop_set (chain, n, 1);
+    part_emuir_set_2 (chain, n, gen_move (BFIN_REG_R0, BFIN_REG_EMUDAT), insn,
+                      URJ_CHAIN_EXITMODE_UPDATE);
+
+    for (i = 0; i < count; i++)
+    {
+        part_emudat_defer_set (chain, n, data[i], URJ_CHAIN_EXITMODE_IDLE);
+        if ((i + 1) % BFIN_MEM_BATCH == 0)
+            urj_tap_chain_flush (chain);
+    }
+    urj_tap_chain_flush (chain);
+
+    part_emuir_loop_set (chain, n, 0);
+
+    /* Make sure the stores have left the core before anybody looks.  */
+    part_emuir_set (chain, n, INSN_SSYNC, URJ_CHAIN_EXITMODE_IDLE);
+
+    return part_mem_block_check (chain, n, addr, "writing");
+}
+
+int
+part_mem_read_block (urj_chain_t *chain, int n, uint32_t addr,
+                     uint32_t *data, uint32_t count, int size)
+{
+    uint32_t p0, r0;
+    int r;
+
+    p0 = part_register_get (chain, n, BFIN_REG_P0);
+    r0 = part_register_get (chain, n, BFIN_REG_R0);
+
+    r = part_mem_read_block_clobber (chain, n, addr, data, count, size);
+
+    part_register_set (chain, n, BFIN_REG_P0, p0);
+    part_register_set (chain, n, BFIN_REG_R0, r0);
+
+    return r;
+}
+
+int
+part_mem_write_block (urj_chain_t *chain, int n, uint32_t addr,
+                      const uint32_t *data, uint32_t count, int size)
+{
+    uint32_t p0, r0;
+    int r;
+
+    p0 = part_register_get (chain, n, BFIN_REG_P0);
+    r0 = part_register_get (chain, n, BFIN_REG_R0);
+
+    r = part_mem_write_block_clobber (chain, n, addr, data, count, size);
+
+    part_register_set (chain, n, BFIN_REG_P0, p0);
+    part_register_set (chain, n, BFIN_REG_R0, r0);
+
+    return r;
+}
+
 struct bfin_part_data bfin_part_data_initializer =
 {
     0, /* bypass */
@@ -1241,12 +1436,16 @@ struct bfin_part_data bfin_part_data_initializer =
 
     -1, /* emupc */
     -1, /* emupc_orig */
+
+    -1, /* wait_clocks */
 };
 
 static void
 bfin_wait_ready (void *data)
 {
     urj_chain_t *chain = (urj_chain_t *) data;
+    urj_part_t *part = chain->parts->parts[chain->main_part];
+    int wait_clocks = BFIN_PART_DATA (part)->wait_clocks;
 
     /* The following default numbers of wait clock for various cables are
        tested on a BF537 stamp board, on which U-Boot is running.
@@ -1262,7 +1461,9 @@ bfin_wait_ready (void *data)
        With an incorrect number of wait clocks, the first 4 bytes will be
        duplicated by the second 4 bytes.  */
 
-    if (bfin_wait_clocks == -1)
+    if (bfin_wait_clocks != -1)
+        wait_clocks = bfin_wait_clocks;
+    else if (wait_clocks == -1)
     {
         urj_cable_t *cable = chain->cable;
         uint32_t frequency = cable->frequency;
@@ -1271,35 +1472,36 @@ bfin_wait_ready (void *data)
         if (strcmp (name, "gnICE+") == 0)
         {
             if (frequency <= 6000000)
-                bfin_wait_clocks = 5;
+                wait_clocks = 5;
             else if (frequency <= 15000000)
-                bfin_wait_clocks = 12;
+                wait_clocks = 12;
             else /* <= 30MHz */
-                bfin_wait_clocks = 21;
+                wait_clocks = 21;
         }
         else if (strcmp (name, "gnICE") == 0)
-            bfin_wait_clocks = 3;
+            wait_clocks = 3;
         else if (strcmp (name, "ICE-100B") == 0)
         {
             if (frequency <= 5000000)
-                bfin_wait_clocks = 5;
+                wait_clocks = 5;
             else if (frequency <= 10000000)
-                bfin_wait_clocks = 11;
+                wait_clocks = 11;
             else if (frequency <= 17000000)
-                bfin_wait_clocks = 19;
+                wait_clocks = 19;
             else /* <= 25MHz */
-                bfin_wait_clocks = 30;
+                wait_clocks = 30;
         }
 
-        if (bfin_wait_clocks == -1)
+        if (wait_clocks == -1)
         {
-            bfin_wait_clocks = 30;
+            wait_clocks = 30;
             urj_warning (_("%s: untested cable, set wait_clocks to %d\n"),
-                         name, bfin_wait_clocks);
+                         name, wait_clocks);
         }
+        BFIN_PART_DATA (part)->wait_clocks = wait_clocks;
     }
 
-    urj_tap_chain_defer_clock (chain, 0, 0, bfin_wait_clocks);
+    urj_tap_chain_defer_clock (chain, 0, 0, wait_clocks);
 }
 
 static void
@@ -33,6 +33,7 @@
 #include <urjtag/part.h>
 #include <urjtag/bsbit.h>
 #include <urjtag/data_register.h>
+#include <urjtag/tap_register.h>
 #include <urjtag/bssignal.h>
 #include <urjtag/log.h>
 
@@ -184,7 +185,9 @@ create_register (urj_bsdl_jtag_ctrl_t *jc, char *reg_name, size_t len)
 /*****************************************************************************
  * int urj_bsdl_process_idcode( urj_bsdl_jtag_ctrl_t *jc )
  *
- * Creates the DIR register based on the extracted idcode.
+ * Creates the DIR register based on the extracted idcode. A part that was
+ * not read from a chain and has no IDCODE yet takes the one of the file,
+ * with the don't care bits cleared.
  *
  * Parameters
  *   jc : jtag control structure
@@ -198,7 +201,23 @@ urj_bsdl_process_idcode (urj_bsdl_jtag_ctrl_t *jc)
     int result = URJ_STATUS_OK;
 
     if (jc->idcode)
+    {
         result = create_register (jc, "DIR", strlen (jc->idcode));
+
+        if (result == URJ_STATUS_OK
+            && (jc->proc_mode & URJ_BSDL_MODE_INSTR_EXEC)
+            && jc->part->id == NULL)
+        {
+            int len = strlen (jc->idcode);
+            int i;
+
+            jc->part->id = urj_tap_register_alloc (len);
+            if (jc->part->id == NULL)
+                return URJ_STATUS_FAIL;
+            for (i = 0; i < len; i++)
+                jc->part->id->data[i] = jc->idcode[len - 1 - i] == '1';
+        }
+    }
     else
         urj_bsdl_warn (jc->proc_mode,
                        _("No IDCODE specification found.\n"));
@@ -50,13 +50,14 @@ typedef struct
 {
     urj_data_register_t *ahbjtag_areg;
     urj_data_register_t *ahbjtag_dreg;
+    uint32_t next_waddr;
+    uint32_t read_addr;
 } bus_params_t;
 
 #define AHBJTAG_AREG  ((bus_params_t *) bus->params)->ahbjtag_areg
 #define AHBJTAG_DREG  ((bus_params_t *) bus->params)->ahbjtag_dreg
-
-static uint32_t next_waddr = 0;
-static uint32_t read_addr = 0;
+#define NEXT_WADDR    ((bus_params_t *) bus->params)->next_waddr
+#define READ_ADDR     ((bus_params_t *) bus->params)->read_addr
 
 /**
  * bus->driver->(*new_bus)
@@ -191,8 +192,8 @@ ahbjtag_bus_read_start (urj_bus_t *bus, uint32_t adr)
     dr->in->data[34] = 0;
 
     urj_tap_chain_shift_data_registers (chain, 0);
-    next_waddr = 0;
-    read_addr = adr;
+    NEXT_WADDR = 0;
+    READ_ADDR = adr;
 
     return URJ_STATUS_OK;
 }
@@ -229,7 +230,7 @@ ahbjtag_bus_read_next (urj_bus_t *bus, uint32_t adr)
         ahbjtag_bus_read_start (bus, adr + 4);
 
     urj_log (URJ_LOG_LEVEL_DETAIL, _("ahbjtag read : 0x%08x : 0x%08x\n"), adr, d);
-    read_addr = adr + 4;
+    READ_ADDR = adr + 4;
 
     return d;
 }
@@ -258,7 +259,7 @@ ahbjtag_bus_read_end (urj_bus_t *bus)
         if (dr->out->data[idx])
             d |= 1 << idx;
 
-    urj_log (URJ_LOG_LEVEL_DETAIL, _("ahbjtag read : 0x%08x : 0x%08x\n"), read_addr, d);
+    urj_log (URJ_LOG_LEVEL_DETAIL, _("ahbjtag read : 0x%08x : 0x%08x\n"), READ_ADDR, d);
     return d;
 }
 
@@ -274,7 +275,7 @@ ahbjtag_bus_write (urj_bus_t *bus, uint32_t adr, uint32_t data)
 
     urj_log (URJ_LOG_LEVEL_DETAIL, _("ahbjtag write: 0x%08x : 0x%08x\n"), adr, data);
 
-    if ((next_waddr != adr) || ((adr & 0x3fc) == 0))
+    if ((NEXT_WADDR != adr) || ((adr & 0x3fc) == 0))
     {
 	urj_part_set_instruction (bus->part, AHBJTAG_ADDR_NAME);
 	urj_tap_chain_shift_instructions (bus->chain);
@@ -296,7 +297,7 @@ ahbjtag_bus_write (urj_bus_t *bus, uint32_t adr, uint32_t data)
     dr->in->data[32] = 1;  // auto-increment
 
     urj_tap_chain_shift_data_registers (chain, 1);
-    next_waddr = adr + 4;
+    NEXT_WADDR = adr + 4;
 }
 
 const urj_bus_driver_t urj_bus_ahbjtag_bus = {
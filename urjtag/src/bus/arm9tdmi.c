@@ -36,6 +36,7 @@
 #include <urjtag/tap_state.h>
 #include <urjtag/tap_register.h>
 #include <urjtag/data_register.h>
+#include <urjtag/fclock.h>
 
 #include "buses.h"
 #include "generic_bus.h"
@@ -43,23 +44,29 @@
 typedef struct
 {
     uint32_t chain;           /* Chain number */
+    int has_workarea;         /* workarea parameter given */
+    uint32_t workarea;        /* target RAM for the flash stub */
+    int stub;                 /* width of the flash stub loaded, 0 = none */
+    urj_data_register_t *scann;
+    urj_data_register_t *scan1;
+    urj_data_register_t *scan2;
+    uint32_t data_read;       /* word read by the last read_start/next */
 } bus_params_t;
 
 #define BP              ((bus_params_t *) bus->params)
 
 #define ARM9TDMI_ICE_DBGCTL  0x00
 #define ARM9TDMI_ICE_DBGSTAT 0x01
+#define ARM9TDMI_ICE_COMCTL  0x04
+#define ARM9TDMI_ICE_COMDATA 0x05
 
 #define DEBUG_SPEED          0
 #define SYSTEM_SPEED         1
 
 #define ARM_NOP 0xE1A00000
 
-static urj_data_register_t *scann = NULL;
-static urj_data_register_t *scan1 = NULL;
-static urj_data_register_t *scan2 = NULL;
-
-static uint32_t _data_read;
+#define STUB_WORDS           (URJ_BUS_STUB_MAILBOX / 4)
+#define STUB_WAIT            60.0   /* seconds a flash stub may run */
 
 /**
  * bus->driver->(*new_bus)
@@ -69,7 +76,39 @@ static urj_bus_t *
 arm9tdmi_bus_new (urj_chain_t *chain, const urj_bus_driver_t *driver,
                   const urj_param_t *cmd_params[])
 {
-    return urj_bus_generic_new (chain, driver, sizeof (bus_params_t));
+    urj_bus_t *bus;
+    int i;
+
+    bus = urj_bus_generic_new (chain, driver, sizeof (bus_params_t));
+    if (bus == NULL)
+        return NULL;
+
+    for (i = 0; cmd_params[i] != NULL; i++)
+    {
+        switch (cmd_params[i]->key)
+        {
+        case URJ_BUS_PARAM_KEY_WORKAREA:
+            if (cmd_params[i]->value.lu & 3)
+            {
+                urj_bus_generic_free (bus);
+                urj_error_set (URJ_ERROR_SYNTAX,
+                               _("workarea 0x%08lx is not word aligned"),
+                               cmd_params[i]->value.lu);
+                return NULL;
+            }
+            BP->has_workarea = 1;
+            BP->workarea = cmd_params[i]->value.lu;
+            break;
+
+        default:
+            urj_bus_generic_free (bus);
+            urj_error_set (URJ_ERROR_SYNTAX, "unrecognised bus parameter '%s'",
+                           urj_param_string (&urj_bus_param_list, cmd_params[i]));
+            return NULL;
+        }
+    }
+
+    return bus;
 }
 
 /**
@@ -123,18 +162,18 @@ arm9tdmi_exec_instruction(urj_bus_t *bus, unsigned int c1_inst, unsigned int c1_
     int i;
 
     for (i = 0; i < 32; i++)
-        scan1->in->data[66-i] = (c1_inst >> i) & 1;
-    scan1->in->data[34] = flags;
-    scan1->in->data[33] = 0;
-    scan1->in->data[32] = 0;
+        BP->scan1->in->data[66-i] = (c1_inst >> i) & 1;
+    BP->scan1->in->data[34] = flags;
+    BP->scan1->in->data[33] = 0;
+    BP->scan1->in->data[32] = 0;
     for (i = 0; i < 32; i++)
-        scan1->in->data[i] = (c1_data >> i) & 1;
+        BP->scan1->in->data[i] = (c1_data >> i) & 1;
 #if (ARM9DEBUG)
-    arm9tdmi_debug_in_reg(scan1);
+    arm9tdmi_debug_in_reg(BP->scan1);
 #endif
     urj_tap_chain_shift_data_registers (bus->chain, 1);
 #if (ARM9DEBUG)
-    arm9tdmi_debug_out_reg(scan1);
+    arm9tdmi_debug_out_reg(BP->scan1);
 #endif
 }
 
@@ -146,8 +185,8 @@ arm9tdmi_select_scanchain(urj_bus_t *bus, unsigned int chain)
     urj_part_set_instruction (bus->part, "SCAN_N");
     urj_tap_chain_shift_instructions (bus->chain);
 
-    for (i = 0; i < scann->in->len; i++)
-        scann->in->data[i] = (chain >> i) & 1;
+    for (i = 0; i < BP->scann->in->len; i++)
+        BP->scann->in->data[i] = (chain >> i) & 1;
     urj_tap_chain_shift_data_registers (bus->chain, 0);
 }
 
@@ -157,14 +196,14 @@ arm9tdmi_ice_read(urj_bus_t *bus, unsigned int reg_addr, unsigned int *reg_val)
     int i;
 
     for (i = 0; i < 32; i++)
-        scan2->in->data[i] = 0;
+        BP->scan2->in->data[i] = 0;
     for (i = 0; i < 5; i++)
-        scan2->in->data[i+32] = (reg_addr >> i) & 1;
-    scan2->in->data[37] = 0;
+        BP->scan2->in->data[i+32] = (reg_addr >> i) & 1;
+    BP->scan2->in->data[37] = 0;
     urj_tap_chain_shift_data_registers (bus->chain, 1);
 
     for (i = 0; i < 32; i++)
-        if (scan2->out->data[i])
+        if (BP->scan2->out->data[i])
             *reg_val |= (1 << i);
 }
 
@@ -174,10 +213,10 @@ arm9tdmi_ice_write(urj_bus_t *bus, unsigned int reg_addr, unsigned int reg_val)
     int i;
 
     for (i = 0; i < 32; i++)
-        scan2->in->data[i] = (reg_val >> i) & 1;
+        BP->scan2->in->data[i] = (reg_val >> i) & 1;
     for (i = 0; i < 5; i++)
-        scan2->in->data[i+32] = (reg_addr >> i) & 1;
-    scan2->in->data[37] = 1;
+        BP->scan2->in->data[i+32] = (reg_addr >> i) & 1;
+    BP->scan2->in->data[37] = 1;
     urj_tap_chain_shift_data_registers (bus->chain, 0);
 }
 
@@ -329,7 +368,7 @@ arm9tdmi_read (urj_bus_t *bus, unsigned int addr, unsigned int sz)
     result = 0;
     for (i = 0; i < 32; i++)
     {
-        if (scan1->out->data[i])
+        if (BP->scan1->out->data[i])
             result |= (1 << i);
     }
     arm9tdmi_exec_instruction(bus, c1_inst, c1_data, DEBUG_SPEED);
@@ -337,48 +376,15 @@ arm9tdmi_read (urj_bus_t *bus, unsigned int addr, unsigned int sz)
 }
 
 /**
- * bus->driver->(*initbus)
+ * Stop the core through the EmbeddedICE and leave scan chain 1 selected
+ * for debug-speed instructions.
  *
+ * @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error
  */
 static int
-arm9tdmi_bus_init (urj_bus_t *bus)
+arm9tdmi_halt (urj_bus_t *bus, unsigned int *status)
 {
-    unsigned int i, status, success;
-
-    if (urj_tap_state (bus->chain) != URJ_TAP_STATE_RUN_TEST_IDLE)
-    {
-        /* silently skip initialization if TAP isn't in RUNTEST/IDLE state
-           this is required to avoid interfering with detect when initbus
-           is contained in the part description file
-           URJ_BUS_INIT() will be called latest by URJ_BUS_PREPARE() */
-        return URJ_STATUS_OK;
-    }
-
-    if (scann == NULL)
-        scann = urj_part_find_data_register (bus->part, "SCANN");
-    if (scan1 == NULL)
-        scan1 = urj_part_find_data_register (bus->part, "SCAN1");
-    if (scan2 == NULL)
-        scan2 = urj_part_find_data_register (bus->part, "SCAN2");
-
-    if (!(scann))
-    {
-        urj_error_set (URJ_ERROR_NOTFOUND,
-                       _("SCANN register"));
-        return URJ_STATUS_FAIL;
-    }
-    if (!(scan1))
-    {
-        urj_error_set (URJ_ERROR_NOTFOUND,
-                       _("SCAN1 register"));
-        return URJ_STATUS_FAIL;
-    }
-    if (!(scan2))
-    {
-        urj_error_set (URJ_ERROR_NOTFOUND,
-                       _("SCAN2 register"));
-        return URJ_STATUS_FAIL;
-    }
+    unsigned int i, success;
 
     /*
      * select scan chain 2 -- EmbeddedICE-RT
@@ -395,15 +401,15 @@ arm9tdmi_bus_init (urj_bus_t *bus)
 
     i = 0;
     success = 0;
-    status = 0;
+    *status = 0;
 
     while (i++ < 10) {
         urj_part_set_instruction (bus->part, "INTEST2");
         urj_tap_chain_shift_instructions (bus->chain);
 
-        arm9tdmi_ice_read(bus, ARM9TDMI_ICE_DBGSTAT, &status);
+        arm9tdmi_ice_read(bus, ARM9TDMI_ICE_DBGSTAT, status);
 
-        if (status & 0x01) {
+        if (*status & 0x01) {
             success = 1;
             break;
         }
@@ -416,16 +422,11 @@ arm9tdmi_bus_init (urj_bus_t *bus)
     {
         urj_error_set (URJ_ERROR_TIMEOUT,
                        _("Failed to enter debug mode, ctrl=%s"),
-                       urj_tap_register_get_string (scan2->out));
+                       urj_tap_register_get_string (BP->scan2->out));
         return URJ_STATUS_FAIL;
     }
 
     arm9tdmi_ice_write(bus, ARM9TDMI_ICE_DBGCTL, 0x00);
-    urj_log (URJ_LOG_LEVEL_NORMAL, _("The target is halted in "));
-    if (status & 0x10)
-        urj_log (URJ_LOG_LEVEL_NORMAL, _("THUMB mode.\n"));
-    else
-        urj_log (URJ_LOG_LEVEL_NORMAL, _("ARM mode.\n"));
 
     /* select scan chain 1, and use INTEST instruction */
     arm9tdmi_select_scanchain(bus, 1);
@@ -434,6 +435,63 @@ arm9tdmi_bus_init (urj_bus_t *bus)
     urj_tap_chain_shift_instructions_mode (bus->chain, 0, 1,
                                            URJ_CHAIN_EXITMODE_UPDATE);
 
+    return URJ_STATUS_OK;
+}
+
+/**
+ * bus->driver->(*initbus)
+ *
+ */
+static int
+arm9tdmi_bus_init (urj_bus_t *bus)
+{
+    unsigned int status;
+
+    if (urj_tap_state (bus->chain) != URJ_TAP_STATE_RUN_TEST_IDLE)
+    {
+        /* silently skip initialization if TAP isn't in RUNTEST/IDLE state
+           this is required to avoid interfering with detect when initbus
+           is contained in the part description file
+           URJ_BUS_INIT() will be called latest by URJ_BUS_PREPARE() */
+        return URJ_STATUS_OK;
+    }
+
+    if (BP->scann == NULL)
+        BP->scann = urj_part_find_data_register (bus->part, "SCANN");
+    if (BP->scan1 == NULL)
+        BP->scan1 = urj_part_find_data_register (bus->part, "SCAN1");
+    if (BP->scan2 == NULL)
+        BP->scan2 = urj_part_find_data_register (bus->part, "SCAN2");
+
+    if (!(BP->scann))
+    {
+        urj_error_set (URJ_ERROR_NOTFOUND,
+                       _("SCANN register"));
+        return URJ_STATUS_FAIL;
+    }
+    if (!(BP->scan1))
+    {
+        urj_error_set (URJ_ERROR_NOTFOUND,
+                       _("SCAN1 register"));
+        return URJ_STATUS_FAIL;
+    }
+    if (!(BP->scan2))
+    {
+        urj_error_set (URJ_ERROR_NOTFOUND,
+                       _("SCAN2 register"));
+        return URJ_STATUS_FAIL;
+    }
+
+    if (arm9tdmi_halt (bus, &status) != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+
+    urj_log (URJ_LOG_LEVEL_NORMAL, _("The target is halted in "));
+    if (status & 0x10)
+        urj_log (URJ_LOG_LEVEL_NORMAL, _("THUMB mode.\n"));
+    else
+        urj_log (URJ_LOG_LEVEL_NORMAL, _("ARM mode.\n"));
+
+    BP->stub = 0;
     bus->initialized = 1;
     return URJ_STATUS_OK;
 }
@@ -516,9 +574,9 @@ arm9tdmi_bus_read (urj_bus_t *bus, uint32_t adr)
 static int
 arm9tdmi_bus_read_start (urj_bus_t *bus, uint32_t adr)
 {
-    _data_read = arm9tdmi_read (bus, adr, get_sz (adr));
+    BP->data_read = arm9tdmi_read (bus, adr, get_sz (adr));
     urj_log (URJ_LOG_LEVEL_ALL, "%s:adr=0x%lx, got=0x%lx\n", __func__,
-             (long unsigned) adr, (long unsigned) _data_read);
+             (long unsigned) adr, (long unsigned) BP->data_read);
 
     return URJ_STATUS_OK;
 }
@@ -530,10 +588,10 @@ arm9tdmi_bus_read_start (urj_bus_t *bus, uint32_t adr)
 static uint32_t
 arm9tdmi_bus_read_next (urj_bus_t *bus, uint32_t adr)
 {
-    uint32_t tmp_value = _data_read;
-    _data_read = arm9tdmi_read (bus, adr, get_sz (adr));
+    uint32_t tmp_value = BP->data_read;
+    BP->data_read = arm9tdmi_read (bus, adr, get_sz (adr));
     urj_log (URJ_LOG_LEVEL_ALL, "%s:adr=0x%lx, got=0x%lx\n", __func__,
-             (long unsigned) adr, (long unsigned) _data_read);
+             (long unsigned) adr, (long unsigned) BP->data_read);
     return tmp_value;
 }
 
@@ -544,13 +602,295 @@ arm9tdmi_bus_read_next (urj_bus_t *bus, uint32_t adr)
 static uint32_t
 arm9tdmi_bus_read_end (urj_bus_t *bus)
 {
-    return _data_read;
+    return BP->data_read;
+}
+
+
+/*
+ * Target-resident flash stub, see URJ_BUS_STUB_* in <urjtag/bus_driver.h>
+ *
+ * The stub runs in ARM state at system speed with the mailbox address in
+ * R0. When done it writes R0 to the debug comms channel and spins until
+ * the core is halted again.  R0-R12 and the flags are clobbered.
+ */
+
+#define ARM_LDR(rd,rn,off)      (0xE5900000 | (rn) << 16 | (rd) << 12 | (off))
+#define ARM_STR(rd,rn,off)      (0xE5800000 | (rn) << 16 | (rd) << 12 | (off))
+#define ARM_ADD(rd,rn,imm)      (0xE2800000 | (rn) << 16 | (rd) << 12 | (imm))
+#define ARM_SUBS(rd,rn,imm)     (0xE2500000 | (rn) << 16 | (rd) << 12 | (imm))
+#define ARM_CMP_IMM(rn,imm)     (0xE3500000 | (rn) << 16 | (imm))
+#define ARM_CMN_IMM(rn,imm)     (0xE3700000 | (rn) << 16 | (imm))
+#define ARM_CMP(rn,rm)          (0xE1500000 | (rn) << 16 | (rm))
+#define ARM_TST(rn,rm)          (0xE1100000 | (rn) << 16 | (rm))
+#define ARM_AND(rd,rn,rm)       (0xE0000000 | (rn) << 16 | (rd) << 12 | (rm))
+#define ARM_EOR(cond,rd,rn,rm)  ((uint32_t) (cond) << 28 | 0x00200000 \
+                                 | (rn) << 16 | (rd) << 12 | (rm))
+#define ARM_MOV_IMM(rd,imm)     (0xE3A00000 | (rd) << 12 | (imm))
+#define ARM_LSR1(rd,rm)         (0xE1A000A0 | (rd) << 12 | (rm))
+#define ARM_LSRS1(rd,rm)        (0xE1B000A0 | (rd) << 12 | (rm))
+#define ARM_MOVEQ(rd,rm)        (0x01A00000 | (rd) << 12 | (rm))
+#define ARM_B(cond,off)         ((uint32_t) (cond) << 28 | 0x0A000000 \
+                                 | ((off) & 0xffffff))
+#define ARM_MCR_DCC(rd)         (0xEE010E10 | (rd) << 12)  /* MCR p14,0,Rd,c1,c0 */
+#define ARM_LDMIA_PC(rn)        (0xE8908000 | (rn) << 16)
+
+#define ARM_EQ  0x0
+#define ARM_NE  0x1
+#define ARM_CS  0x2
+#define ARM_AL  0xE
+
+enum
+{
+    L_NEXT, L_CYCLE, L_DATA, L_POLL0, L_POLL, L_STATUS, L_AGAIN, L_OK,
+    L_DONE, L_CRC, L_UNIT, L_BIT, L_LABELS
+};
+
+static uint32_t
+arm9tdmi_stub_ldst (int width, int load, int rd, int rn)
+{
+    if (width == 1)
+        return (load ? 0xE5D00000 : 0xE5C00000) | rn << 16 | rd << 12;   /* LDRB/STRB */
+    if (width == 2)
+        return (load ? 0xE1D000B0 : 0xE1C000B0) | rn << 16 | rd << 12;   /* LDRH/STRH */
+    return (load ? 0xE5900000 : 0xE5800000) | rn << 16 | rd << 12;       /* LDR/STR */
+}
+
+static int
+arm9tdmi_gen_stub (uint32_t *code, int width)
+{
+    int label[L_LABELS] = { 0 };
+    int pass, n = 0;
+
+#define EMIT(insn)      do { uint32_t i_ = (insn); \
+                             code[n++] = i_; } while (0)
+#define LABEL(l)        (label[l] = n)
+#define BRANCH(cond,l)  EMIT (ARM_B (cond, label[l] - n - 2))
+
+    /* The second pass knows where the labels are */
+    for (pass = 0; pass < 2; pass++)
+    {
+        n = 0;
+        EMIT (ARM_LDR (1, 0, URJ_BUS_STUB_MB_DST));
+        EMIT (ARM_LDR (2, 0, URJ_BUS_STUB_MB_SRC));
+        EMIT (ARM_LDR (7, 0, URJ_BUS_STUB_MB_COUNT));
+        EMIT (ARM_LDR (9, 0, URJ_BUS_STUB_MB_WRITE));
+        EMIT (ARM_CMP_IMM (9, URJ_BUS_STUB_CRC));
+        BRANCH (ARM_EQ, L_CRC);
+        LABEL (L_NEXT);
+        EMIT (ARM_ADD (3, 0, URJ_BUS_STUB_MB_CYCLES));
+        EMIT (ARM_LDR (6, 0, URJ_BUS_STUB_MB_NCYCLES));
+
+        /* command cycles */
+        LABEL (L_CYCLE);
+        EMIT (ARM_CMP_IMM (6, 0));
+        BRANCH (ARM_EQ, L_DATA);
+        EMIT (ARM_LDR (4, 3, 0));
+        EMIT (ARM_LDR (5, 3, 4));
+        EMIT (ARM_CMN_IMM (4, 1));
+        EMIT (ARM_MOVEQ (4, 1));                        /* ~0: this unit */
+        EMIT (arm9tdmi_stub_ldst (width, 0, 5, 4));
+        EMIT (ARM_ADD (3, 3, 8));
+        EMIT (ARM_SUBS (6, 6, 1));
+        BRANCH (ARM_AL, L_CYCLE);
+
+        /* data */
+        LABEL (L_DATA);
+        EMIT (ARM_LDR (8, 2, 0));
+        EMIT (ARM_LDR (9, 0, URJ_BUS_STUB_MB_WRITE));
+        EMIT (ARM_CMP_IMM (9, 0));
+        BRANCH (ARM_EQ, L_POLL0);
+        EMIT (arm9tdmi_stub_ldst (width, 0, 8, 1));
+        LABEL (L_POLL0);
+        EMIT (ARM_LDR (10, 0, URJ_BUS_STUB_MB_TIMEOUT));
+
+        /* poll the unit */
+        LABEL (L_POLL);
+        EMIT (arm9tdmi_stub_ldst (width, 1, 11, 1));
+        EMIT (ARM_LDR (12, 0, URJ_BUS_STUB_MB_SMASK));
+        EMIT (ARM_CMP_IMM (12, 0));
+        BRANCH (ARM_NE, L_STATUS);
+        EMIT (ARM_CMP (11, 8));
+        BRANCH (ARM_EQ, L_OK);
+        BRANCH (ARM_AL, L_AGAIN);
+        LABEL (L_STATUS);
+        EMIT (ARM_AND (9, 11, 12));
+        EMIT (ARM_CMP (9, 12));
+        BRANCH (ARM_NE, L_AGAIN);
+        EMIT (ARM_LDR (12, 0, URJ_BUS_STUB_MB_EMASK));
+        EMIT (ARM_TST (11, 12));
+        BRANCH (ARM_EQ, L_OK);
+        EMIT (ARM_STR (7, 0, URJ_BUS_STUB_MB_STATUS));  /* error bits */
+        BRANCH (ARM_AL, L_DONE);
+        LABEL (L_AGAIN);
+        EMIT (ARM_SUBS (10, 10, 1));
+        BRANCH (ARM_NE, L_POLL);
+        EMIT (ARM_STR (7, 0, URJ_BUS_STUB_MB_STATUS));  /* timeout */
+        BRANCH (ARM_AL, L_DONE);
+
+        /* next unit */
+        LABEL (L_OK);
+        EMIT (ARM_ADD (1, 1, width));
+        EMIT (ARM_ADD (2, 2, 4));
+        EMIT (ARM_SUBS (7, 7, 1));
+        BRANCH (ARM_NE, L_NEXT);
+        EMIT (ARM_STR (7, 0, URJ_BUS_STUB_MB_STATUS));
+        LABEL (L_DONE);
+        EMIT (ARM_MCR_DCC (0));
+        EMIT (ARM_B (ARM_AL, -2));                      /* B . */
+
+        /* CRC of the units, R12 = remainder, R8 = polynomial */
+        LABEL (L_CRC);
+        EMIT (ARM_LDR (12, 0, URJ_BUS_STUB_MB_EMASK));
+        EMIT (ARM_LDR (8, 0, URJ_BUS_STUB_MB_SMASK));
+        LABEL (L_UNIT);
+        EMIT (arm9tdmi_stub_ldst (width, 1, 11, 1));
+        EMIT (ARM_MOV_IMM (10, 8 * width));
+        LABEL (L_BIT);
+        EMIT (ARM_EOR (ARM_AL, 9, 12, 11));
+        EMIT (ARM_LSRS1 (9, 9));                        /* C = bit 0 */
+        EMIT (ARM_LSR1 (12, 12));
+        EMIT (ARM_LSR1 (11, 11));
+        EMIT (ARM_EOR (ARM_CS, 12, 12, 8));
+        EMIT (ARM_SUBS (10, 10, 1));
+        BRANCH (ARM_NE, L_BIT);
+        EMIT (ARM_ADD (1, 1, width));
+        EMIT (ARM_SUBS (7, 7, 1));
+        BRANCH (ARM_NE, L_UNIT);
+        EMIT (ARM_STR (12, 0, URJ_BUS_STUB_MB_STATUS));
+        BRANCH (ARM_AL, L_DONE);
+    }
+
+#undef EMIT
+#undef LABEL
+#undef BRANCH
+
+    return n;
+}
+
+/* Read an EmbeddedICE register; the first scan only selects it */
+static unsigned int
+arm9tdmi_ice_get (urj_bus_t *bus, unsigned int reg_addr)
+{
+    unsigned int val = 0;
+
+    arm9tdmi_ice_read (bus, reg_addr, &val);
+    val = 0;
+    arm9tdmi_ice_read (bus, reg_addr, &val);
+
+    return val;
+}
+
+/**
+ * bus->driver->(*stub_area)
+ *
+ */
+static int
+arm9tdmi_bus_stub_area (urj_bus_t *bus, uint32_t *adr)
+{
+    if (!BP->has_workarea)
+        return URJ_STATUS_FAIL;
+
+    *adr = BP->workarea;
+    return URJ_STATUS_OK;
 }
 
+/**
+ * bus->driver->(*stub_run)
+ *
+ */
+static int
+arm9tdmi_bus_stub_run (urj_bus_t *bus, const uint32_t *mailbox, int width)
+{
+    uint32_t code[STUB_WORDS];
+    unsigned int status;
+    long double deadline;
+    int len, done;
+
+    if (!BP->has_workarea)
+    {
+        urj_error_set (URJ_ERROR_INVALID, _("no workarea given"));
+        return URJ_STATUS_FAIL;
+    }
+
+    if (BP->stub != width)
+    {
+        len = arm9tdmi_gen_stub (code, width);
+        BP->stub = 0;
+        if (urj_bus_generic_write_words (bus, BP->workarea + URJ_BUS_STUB_CODE,
+                                         code, len) != URJ_STATUS_OK)
+        {
+            urj_error_set (URJ_ERROR_BUS, _("stub code upload failed"));
+            return URJ_STATUS_FAIL;
+        }
+        BP->stub = width;
+    }
+    if (urj_bus_generic_write_words (bus, BP->workarea + URJ_BUS_STUB_MAILBOX,
+                                     mailbox, URJ_BUS_STUB_MB_WORDS)
+        != URJ_STATUS_OK)
+    {
+        urj_error_set (URJ_ERROR_BUS, _("stub mailbox upload failed"));
+        return URJ_STATUS_FAIL;
+    }
+
+    /* Load R0 with the mailbox address */
+    arm9tdmi_exec_instruction (bus, 0xE59F0000, 0, DEBUG_SPEED); /* LDR R0, [PC] */
+    arm9tdmi_exec_instruction (bus, ARM_NOP, 0, DEBUG_SPEED);
+    arm9tdmi_exec_instruction (bus, ARM_NOP, 0, DEBUG_SPEED);
+    arm9tdmi_exec_instruction (bus, ARM_NOP,
+                               BP->workarea + URJ_BUS_STUB_MAILBOX,
+                               DEBUG_SPEED);
+    arm9tdmi_exec_instruction (bus, ARM_NOP, 0, DEBUG_SPEED);
+
+    /* Load the PC with the stub entry; the data shows up on the 4th scan */
+    arm9tdmi_exec_instruction (bus, ARM_LDMIA_PC (0), 0, DEBUG_SPEED);
+    arm9tdmi_exec_instruction (bus, ARM_NOP, 0, DEBUG_SPEED);
+    arm9tdmi_exec_instruction (bus, ARM_NOP, 0, DEBUG_SPEED);
+    arm9tdmi_exec_instruction (bus, ARM_NOP, BP->workarea + URJ_BUS_STUB_CODE,
+                               DEBUG_SPEED);
+    arm9tdmi_exec_instruction (bus, ARM_NOP, 0, DEBUG_SPEED);
+    arm9tdmi_exec_instruction (bus, ARM_NOP, 0, DEBUG_SPEED);
+    arm9tdmi_exec_instruction (bus, ARM_NOP, 0, DEBUG_SPEED);
+
+    /*
+     * Leave debug state: the branch makes up for the instructions clocked
+     * in since the PC was loaded, the NOP at system speed and RESTART let
+     * the core go.
+     */
+    arm9tdmi_exec_instruction (bus, ARM_B (ARM_AL, 0xfffffc), 0, DEBUG_SPEED);
+    arm9tdmi_exec_instruction (bus, ARM_NOP, 0, SYSTEM_SPEED);
+    urj_tap_chain_flush (bus->chain);
+    urj_part_set_instruction (bus->part, "RESTART");
+    urj_tap_chain_shift_instructions (bus->chain);
+
+    /* Wait for the stub to write to the debug comms channel */
+    arm9tdmi_select_scanchain (bus, 2);
+    urj_part_set_instruction (bus->part, "INTEST2");
+    urj_tap_chain_shift_instructions (bus->chain);
+
+    deadline = urj_lib_frealtime () + STUB_WAIT;
+    do
+    {
+        usleep (1000);
+        done = (arm9tdmi_ice_get (bus, ARM9TDMI_ICE_COMCTL) & 0x02) != 0;
+    }
+    while (!done && urj_lib_frealtime () < deadline);
+
+    if (done)
+        (void) arm9tdmi_ice_get (bus, ARM9TDMI_ICE_COMDATA);
+    else
+        urj_error_set (URJ_ERROR_TIMEOUT, _("flash stub did not return"));
+
+    /* Stop the core again, spinning at the end of the stub or not */
+    if (arm9tdmi_halt (bus, &status) != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+
+    return done ? URJ_STATUS_OK : URJ_STATUS_FAIL;
+}
 
 const urj_bus_driver_t urj_bus_arm9tdmi_bus = {
     "arm9tdmi",
-    N_("ARM9TDMI compatible bus driver"),
+    N_("ARM9TDMI compatible bus driver, parameter:\n"
+       "           [workarea=<RAM address for flash stubs>]"),
     arm9tdmi_bus_new,
     urj_bus_generic_free,
     arm9tdmi_bus_printinfo,
@@ -566,4 +906,8 @@ const urj_bus_driver_t urj_bus_arm9tdmi_bus = {
     urj_bus_generic_no_enable,
     urj_bus_generic_no_disable,
     URJ_BUS_TYPE_PARALLEL,
+    NULL,
+    NULL,
+    arm9tdmi_bus_stub_area,
+    arm9tdmi_bus_stub_run,
 };
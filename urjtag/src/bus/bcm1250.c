@@ -44,6 +44,7 @@ typedef struct
     urj_part_signal_t *io_rw;
     urj_part_signal_t *io_wr_l;
     urj_part_signal_t *io_oe_l;
+    uint32_t addr;              /* EJTAG read: address of the next word */
 } bus_params_t;
 
 #define IO_AD   ((bus_params_t *) bus->params)->io_ad
@@ -51,6 +52,7 @@ typedef struct
 #define IO_RW   ((bus_params_t *) bus->params)->io_rw
 #define IO_WR_L ((bus_params_t *) bus->params)->io_wr_l
 #define IO_OE_L ((bus_params_t *) bus->params)->io_oe_l
+#define ADDR    ((bus_params_t *) bus->params)->addr
 
 /**
  * bus->driver->(*new_bus)
@@ -286,8 +288,7 @@ bcm1250_bus_write (urj_bus_t *bus, uint32_t adr, uint32_t data)
 
 #else /* #ifndef USE_BCM_EJTAG */
 
-static int addr;
-static uint64_t base = 0x1fc00000;
+static const uint64_t base = 0x1fc00000;
 
 static int
 bcm1250_ejtag_do (urj_bus_t *bus, uint64_t ad, uint64_t da, int read,
@@ -466,7 +467,7 @@ bcm1250_ejtag_do (urj_bus_t *bus, uint64_t ad, uint64_t da, int read,
 static void
 bcm1250_bus_read_start (urj_bus_t *bus, uint32_t adr)
 {
-    addr = adr;
+    ADDR = adr;
 }
 
 /**
@@ -490,8 +491,8 @@ static uint32_t
 bcm1250_bus_read_next (urj_bus_t *bus, uint32_t adr)
 {
     uint32_t t;
-    t = bcm1250_bus_read (bus, addr);
-    addr = adr;
+    t = bcm1250_bus_read (bus, ADDR);
+    ADDR = adr;
     return t;
 }
 
@@ -502,7 +503,7 @@ bcm1250_bus_read_next (urj_bus_t *bus, uint32_t adr)
 static uint32_t
 bcm1250_bus_read_end (urj_bus_t *bus)
 {
-    return bcm1250_bus_read (bus, addr);
+    return bcm1250_bus_read (bus, ADDR);
 }
 
 /**
@@ -0,0 +1,631 @@
+/*
+ * $Id$
+ *
+ * Blackfin memory bus driver using the emulation (EMUDAT) interface
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ * Unlike the boundary-scan Blackfin buses, this driver lets the core do
+ * the memory accesses: the core has to be in emulation mode (see
+ * "bfin emulation enter") and blocks of words are streamed through
+ * EMUDAT, see part_mem_read_block_clobber () in src/bfin/bfin.c.
+ *
+ * With a workarea in external memory, the core also runs the flash
+ * programming stub (see src/flash/stub.c).
+ */
+
+#include <sysdep.h>
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include <urjtag/part.h>
+#include <urjtag/bus.h>
+#include <urjtag/chain.h>
+#include <urjtag/bfin.h>
+#include <urjtag/fclock.h>
+
+#include "buses.h"
+#include "generic_bus.h"
+
+typedef struct
+{
+    int n;                      /* index of the Blackfin part in the chain */
+    unsigned int async_width;   /* data width of the asynchronous banks */
+    uint32_t p0, r0;            /* core registers saved by init */
+    uint32_t last_data;         /* pipelined read state */
+    int has_workarea;           /* workarea parameter given */
+    uint32_t workarea;          /* target RAM for the flash stub */
+    int stub;                   /* width of the flash stub loaded, 0 = none */
+} bus_params_t;
+
+#define BP              ((bus_params_t *) bus->params)
+
+#define ASYNC_BASE      UINT32_C (0x20000000)
+#define ASYNC_SIZE      UINT32_C (0x10000000)
+
+#define STUB_HALFWORDS  128
+#define STUB_WAIT       60.0    /* seconds a flash stub may run */
+
+/**
+ * bus->driver->(*new_bus)
+ *
+ */
+static urj_bus_t *
+bfin_emu_bus_new (urj_chain_t *chain, const urj_bus_driver_t *driver,
+                  const urj_param_t *cmd_params[])
+{
+    urj_bus_t *bus;
+    int i;
+
+    if (!part_is_bfin (chain, chain->active_part))
+    {
+        urj_error_set (URJ_ERROR_BFIN, _("part %d is not a Blackfin"),
+                       chain->active_part);
+        return NULL;
+    }
+
+    bus = urj_bus_generic_new (chain, driver, sizeof (bus_params_t));
+    if (bus == NULL)
+        return NULL;
+
+    BP->n = chain->active_part;
+    BP->async_width = 16;
+
+    for (i = 0; cmd_params[i] != NULL; i++)
+    {
+        switch (cmd_params[i]->key)
+        {
+        case URJ_BUS_PARAM_KEY_WIDTH:
+            switch (cmd_params[i]->value.lu)
+            {
+            case 8:
+            case 16:
+            case 32:
+                BP->async_width = cmd_params[i]->value.lu;
+                break;
+            default:
+                urj_bus_generic_free (bus);
+                urj_error_set (URJ_ERROR_SYNTAX, "invalid bus width: %lu",
+                               cmd_params[i]->value.lu);
+                return NULL;
+            }
+            break;
+
+        case URJ_BUS_PARAM_KEY_WORKAREA:
+            if (cmd_params[i]->value.lu & 3)
+            {
+                urj_bus_generic_free (bus);
+                urj_error_set (URJ_ERROR_SYNTAX,
+                               _("workarea 0x%08lx is not word aligned"),
+                               cmd_params[i]->value.lu);
+                return NULL;
+            }
+            BP->has_workarea = 1;
+            BP->workarea = cmd_params[i]->value.lu;
+            break;
+
+        default:
+            urj_bus_generic_free (bus);
+            urj_error_set (URJ_ERROR_SYNTAX, "unrecognised bus parameter '%s'",
+                           urj_param_string (&urj_bus_param_list, cmd_params[i]));
+            return NULL;
+        }
+    }
+
+    return bus;
+}
+
+/**
+ * bus->driver->(*free_bus)
+ *
+ */
+static void
+bfin_emu_bus_free (urj_bus_t *bus)
+{
+    /* Give the core back the registers we have been clobbering */
+    if (bus->initialized)
+    {
+        part_register_set (bus->chain, BP->n, BFIN_REG_P0, BP->p0);
+        part_register_set (bus->chain, BP->n, BFIN_REG_R0, BP->r0);
+    }
+
+    urj_bus_generic_free (bus);
+}
+
+/**
+ * bus->driver->(*printinfo)
+ *
+ */
+static void
+bfin_emu_bus_printinfo (urj_log_level_t ll, urj_bus_t *bus)
+{
+    urj_log (ll, _("Blackfin memory bus driver via EMUDAT (JTAG part No. %d)\n"),
+             BP->n);
+}
+
+/**
+ * bus->driver->(*init)
+ *
+ */
+static int
+bfin_emu_bus_init (urj_bus_t *bus)
+{
+    urj_chain_t *chain = bus->chain;
+
+    part_dbgstat_get (chain, BP->n);
+    if (!part_dbgstat_is_emuready (chain, BP->n))
+    {
+        urj_error_set (URJ_ERROR_BFIN,
+                       _("Run '%s' first"), "bfin emulation enter");
+        return URJ_STATUS_FAIL;
+    }
+
+    BP->p0 = part_register_get (chain, BP->n, BFIN_REG_P0);
+    BP->r0 = part_register_get (chain, BP->n, BFIN_REG_R0);
+    BP->stub = 0;
+
+    bus->initialized = 1;
+    return URJ_STATUS_OK;
+}
+
+/**
+ * bus->driver->(*prepare)
+ *
+ */
+static void
+bfin_emu_bus_prepare (urj_bus_t *bus)
+{
+    if (!bus->initialized)
+        URJ_BUS_INIT (bus);
+}
+
+/**
+ * bus->driver->(*area)
+ *
+ */
+static int
+bfin_emu_bus_area (urj_bus_t *bus, uint32_t adr, urj_bus_area_t *area)
+{
+    if (adr < ASYNC_BASE)
+    {
+        area->description = N_("SDRAM");
+        area->start = UINT32_C (0x00000000);
+        area->length = UINT64_C (0x20000000);
+        area->width = 32;
+    }
+    else if (adr < ASYNC_BASE + ASYNC_SIZE)
+    {
+        area->description = N_("Asynchronous Memory");
+        area->start = ASYNC_BASE;
+        area->length = ASYNC_SIZE;
+        area->width = BP->async_width;
+    }
+    else if (adr < UINT32_C (0xFFC00000))
+    {
+        area->description = N_("Internal Memory");
+        area->start = ASYNC_BASE + ASYNC_SIZE;
+        area->length = UINT64_C (0xFFC00000) - (ASYNC_BASE + ASYNC_SIZE);
+        area->width = 32;
+    }
+    else if (adr < UINT32_C (0xFFE00000))
+    {
+        area->description = N_("System MMRs");
+        area->start = UINT32_C (0xFFC00000);
+        area->length = UINT64_C (0x00200000);
+        area->width = 16;
+    }
+    else
+    {
+        area->description = N_("Core MMRs");
+        area->start = UINT32_C (0xFFE00000);
+        area->length = UINT64_C (0x00200000);
+        area->width = 32;
+    }
+
+    return URJ_STATUS_OK;
+}
+
+static int
+bfin_emu_size (urj_bus_t *bus, uint32_t adr)
+{
+    urj_bus_area_t area;
+
+    bfin_emu_bus_area (bus, adr, &area);
+
+    return area.width / 8;
+}
+
+/**
+ * bus->driver->(*read_block)
+ *
+ */
+static int
+bfin_emu_bus_read_block (urj_bus_t *bus, uint32_t adr, uint32_t *data,
+                         uint32_t count)
+{
+    return part_mem_read_block_clobber (bus->chain, BP->n, adr, data, count,
+                                        bfin_emu_size (bus, adr));
+}
+
+/**
+ * bus->driver->(*write_block)
+ *
+ */
+static int
+bfin_emu_bus_write_block (urj_bus_t *bus, uint32_t adr, const uint32_t *data,
+                          uint32_t count)
+{
+    return part_mem_write_block_clobber (bus->chain, BP->n, adr, data, count,
+                                         bfin_emu_size (bus, adr));
+}
+
+/**
+ * bus->driver->(*read)
+ *
+ */
+static uint32_t
+bfin_emu_bus_read (urj_bus_t *bus, uint32_t adr)
+{
+    uint32_t data = 0;
+
+    bfin_emu_bus_read_block (bus, adr, &data, 1);
+
+    return data;
+}
+
+/**
+ * bus->driver->(*read_start)
+ *
+ */
+static int
+bfin_emu_bus_read_start (urj_bus_t *bus, uint32_t adr)
+{
+    return bfin_emu_bus_read_block (bus, adr, &BP->last_data, 1);
+}
+
+/**
+ * bus->driver->(*read_next)
+ *
+ */
+static uint32_t
+bfin_emu_bus_read_next (urj_bus_t *bus, uint32_t adr)
+{
+    uint32_t data = BP->last_data;
+
+    BP->last_data = bfin_emu_bus_read (bus, adr);
+
+    return data;
+}
+
+/**
+ * bus->driver->(*read_end)
+ *
+ */
+static uint32_t
+bfin_emu_bus_read_end (urj_bus_t *bus)
+{
+    return BP->last_data;
+}
+
+/**
+ * bus->driver->(*write)
+ *
+ */
+static void
+bfin_emu_bus_write (urj_bus_t *bus, uint32_t adr, uint32_t data)
+{
+    bfin_emu_bus_write_block (bus, adr, &data, 1);
+}
+
+/*
+ * Target-resident flash stub, see URJ_BUS_STUB_* in <urjtag/bus_driver.h>
+ *
+ * The stub is entered through RETE with the mailbox address in P0 and
+ * returns to emulation mode with EMUEXCPT.
+ */
+
+#define BFIN_CC_EQ(x,y)         (0x0800 | ((y) & 7) << 3 | ((x) & 7))
+#define BFIN_CC_EQ_0(x)         (0x0c00 | ((x) & 7))
+#define BFIN_IF_CC_JUMP(off)    (0x1800 | ((off) & 0x3ff))
+#define BFIN_IF_NCC_JUMP(off)   (0x1000 | ((off) & 0x3ff))
+#define BFIN_JUMP_S(off)        (0x2000 | ((off) & 0xfff))
+#define BFIN_AND(d,x,y)         (0x5400 | ((d) & 7) << 6 | ((y) & 7) << 3 \
+                                 | ((x) & 7))
+#define BFIN_XOR(d,x,y)         (0x5800 | ((d) & 7) << 6 | ((y) & 7) << 3 \
+                                 | ((x) & 7))
+#define BFIN_CC_BITTST(x,b)     (0x4900 | ((b) & 0x1f) << 3 | ((x) & 7))
+#define BFIN_LSHIFT_R(x,b)      (0x4e00 | ((b) & 0x1f) << 3 | ((x) & 7))
+#define BFIN_DMOV_IMM(d,i)      (0x6000 | ((i) & 0x7f) << 3 | ((d) & 7))
+#define BFIN_DADD_IMM(d,i)      (0x6400 | ((i) & 0x7f) << 3 | ((d) & 7))
+#define BFIN_PADD_IMM(p,i)      (0x6c00 | ((i) & 0x7f) << 3 | ((p) & 7))
+#define BFIN_EMUEXCPT           0x0025
+
+enum
+{
+    L_NEXT, L_CYCLE, L_STORE, L_DATA, L_POLL0, L_POLL, L_STATUS, L_AGAIN,
+    L_FAIL, L_OK, L_CRC, L_UNIT, L_BIT, L_EVEN, L_LABELS
+};
+
+static uint32_t
+bfin_emu_load (int width, enum core_regnum dest, enum core_regnum base)
+{
+    return width == 1 ? gen_load8z (dest, base)
+        : width == 2 ? gen_load16z (dest, base) : gen_load32 (dest, base);
+}
+
+static uint32_t
+bfin_emu_store (int width, enum core_regnum base, enum core_regnum src)
+{
+    return width == 1 ? gen_store8 (base, src)
+        : width == 2 ? gen_store16 (base, src) : gen_store32 (base, src);
+}
+
+static int
+bfin_emu_gen_stub (uint16_t *code, int width)
+{
+    int label[L_LABELS] = { 0 };
+    int pass, n = 0;
+
+#define EMIT(insn)      do { uint32_t i_ = (insn); \
+                             if (i_ > 0xffff) code[n++] = i_ >> 16; \
+                             code[n++] = i_; } while (0)
+#define LABEL(l)        (label[l] = n)
+#define OFF(l)          (label[l] - n)
+
+    /* The second pass knows where the labels are */
+    for (pass = 0; pass < 2; pass++)
+    {
+        n = 0;
+        EMIT (gen_load32_offset (BFIN_REG_R0, BFIN_REG_P0, URJ_BUS_STUB_MB_DST));
+        EMIT (gen_move (BFIN_REG_P1, BFIN_REG_R0));
+        EMIT (gen_load32_offset (BFIN_REG_R0, BFIN_REG_P0, URJ_BUS_STUB_MB_SRC));
+        EMIT (gen_move (BFIN_REG_P2, BFIN_REG_R0));
+        EMIT (gen_load32_offset (BFIN_REG_R7, BFIN_REG_P0, URJ_BUS_STUB_MB_COUNT));
+        EMIT (gen_load32_offset (BFIN_REG_R0, BFIN_REG_P0, URJ_BUS_STUB_MB_WRITE));
+        EMIT (BFIN_DADD_IMM (0, -URJ_BUS_STUB_CRC));
+        EMIT (BFIN_CC_EQ_0 (0));
+        EMIT (BFIN_IF_CC_JUMP (OFF (L_CRC)));
+        LABEL (L_NEXT);
+        EMIT (gen_move (BFIN_REG_P3, BFIN_REG_P0));
+        EMIT (BFIN_PADD_IMM (3, URJ_BUS_STUB_MB_CYCLES));
+        EMIT (gen_load32_offset (BFIN_REG_R6, BFIN_REG_P0, URJ_BUS_STUB_MB_NCYCLES));
+
+        /* command cycles */
+        LABEL (L_CYCLE);
+        EMIT (BFIN_CC_EQ_0 (6));
+        EMIT (BFIN_IF_CC_JUMP (OFF (L_DATA)));
+        EMIT (gen_load32 (BFIN_REG_R0, BFIN_REG_P3));
+        EMIT (gen_load32_offset (BFIN_REG_R1, BFIN_REG_P3, 4));
+        EMIT (gen_move (BFIN_REG_P4, BFIN_REG_R0));
+        EMIT (BFIN_DADD_IMM (0, 1));
+        EMIT (BFIN_CC_EQ_0 (0));
+        EMIT (BFIN_IF_NCC_JUMP (OFF (L_STORE)));
+        EMIT (gen_move (BFIN_REG_P4, BFIN_REG_P1));     /* ~0: this unit */
+        LABEL (L_STORE);
+        EMIT (bfin_emu_store (width, BFIN_REG_P4, BFIN_REG_R1));
+        EMIT (BFIN_PADD_IMM (3, 8));
+        EMIT (BFIN_DADD_IMM (6, -1));
+        EMIT (BFIN_JUMP_S (OFF (L_CYCLE)));
+
+        /* data */
+        LABEL (L_DATA);
+        EMIT (gen_load32 (BFIN_REG_R2, BFIN_REG_P2));
+        EMIT (gen_load32_offset (BFIN_REG_R0, BFIN_REG_P0, URJ_BUS_STUB_MB_WRITE));
+        EMIT (BFIN_CC_EQ_0 (0));
+        EMIT (BFIN_IF_CC_JUMP (OFF (L_POLL0)));
+        EMIT (bfin_emu_store (width, BFIN_REG_P1, BFIN_REG_R2));
+        LABEL (L_POLL0);
+        EMIT (gen_load32_offset (BFIN_REG_R3, BFIN_REG_P0, URJ_BUS_STUB_MB_TIMEOUT));
+
+        /* poll the unit */
+        LABEL (L_POLL);
+        EMIT (bfin_emu_load (width, BFIN_REG_R4, BFIN_REG_P1));
+        EMIT (gen_load32_offset (BFIN_REG_R5, BFIN_REG_P0, URJ_BUS_STUB_MB_SMASK));
+        EMIT (BFIN_CC_EQ_0 (5));
+        EMIT (BFIN_IF_NCC_JUMP (OFF (L_STATUS)));
+        EMIT (BFIN_CC_EQ (4, 2));
+        EMIT (BFIN_IF_CC_JUMP (OFF (L_OK)));
+        EMIT (BFIN_JUMP_S (OFF (L_AGAIN)));
+        LABEL (L_STATUS);
+        EMIT (BFIN_AND (0, 4, 5));
+        EMIT (BFIN_CC_EQ (0, 5));
+        EMIT (BFIN_IF_NCC_JUMP (OFF (L_AGAIN)));
+        EMIT (gen_load32_offset (BFIN_REG_R5, BFIN_REG_P0, URJ_BUS_STUB_MB_EMASK));
+        EMIT (BFIN_AND (0, 4, 5));
+        EMIT (BFIN_CC_EQ_0 (0));
+        EMIT (BFIN_IF_NCC_JUMP (OFF (L_FAIL)));
+        EMIT (BFIN_JUMP_S (OFF (L_OK)));
+        LABEL (L_AGAIN);
+        EMIT (BFIN_DADD_IMM (3, -1));
+        EMIT (BFIN_CC_EQ_0 (3));
+        EMIT (BFIN_IF_NCC_JUMP (OFF (L_POLL)));
+        LABEL (L_FAIL);
+        EMIT (gen_store32_offset (BFIN_REG_P0, URJ_BUS_STUB_MB_STATUS, BFIN_REG_R7));
+        EMIT (INSN_SSYNC);
+        EMIT (BFIN_EMUEXCPT);
+
+        /* next unit */
+        LABEL (L_OK);
+        EMIT (BFIN_PADD_IMM (1, width));
+        EMIT (BFIN_PADD_IMM (2, 4));
+        EMIT (BFIN_DADD_IMM (7, -1));
+        EMIT (BFIN_CC_EQ_0 (7));
+        EMIT (BFIN_IF_NCC_JUMP (OFF (L_NEXT)));
+        EMIT (BFIN_DMOV_IMM (0, 0));
+        EMIT (gen_store32_offset (BFIN_REG_P0, URJ_BUS_STUB_MB_STATUS, BFIN_REG_R0));
+        EMIT (INSN_SSYNC);
+        EMIT (BFIN_EMUEXCPT);
+
+        /* CRC of the units, R6 = remainder, R5 = polynomial */
+        LABEL (L_CRC);
+        EMIT (gen_load32_offset (BFIN_REG_R6, BFIN_REG_P0, URJ_BUS_STUB_MB_EMASK));
+        EMIT (gen_load32_offset (BFIN_REG_R5, BFIN_REG_P0, URJ_BUS_STUB_MB_SMASK));
+        LABEL (L_UNIT);
+        EMIT (bfin_emu_load (width, BFIN_REG_R4, BFIN_REG_P1));
+        EMIT (BFIN_DMOV_IMM (3, 8 * width));
+        LABEL (L_BIT);
+        EMIT (BFIN_XOR (0, 6, 4));
+        EMIT (BFIN_CC_BITTST (0, 0));
+        EMIT (BFIN_LSHIFT_R (6, 1));
+        EMIT (BFIN_LSHIFT_R (4, 1));
+        EMIT (BFIN_IF_NCC_JUMP (OFF (L_EVEN)));
+        EMIT (BFIN_XOR (6, 6, 5));
+        LABEL (L_EVEN);
+        EMIT (BFIN_DADD_IMM (3, -1));
+        EMIT (BFIN_CC_EQ_0 (3));
+        EMIT (BFIN_IF_NCC_JUMP (OFF (L_BIT)));
+        EMIT (BFIN_PADD_IMM (1, width));
+        EMIT (BFIN_DADD_IMM (7, -1));
+        EMIT (BFIN_CC_EQ_0 (7));
+        EMIT (BFIN_IF_NCC_JUMP (OFF (L_UNIT)));
+        EMIT (gen_store32_offset (BFIN_REG_P0, URJ_BUS_STUB_MB_STATUS, BFIN_REG_R6));
+        EMIT (INSN_SSYNC);
+        EMIT (BFIN_EMUEXCPT);
+        EMIT (INSN_NOP);                /* pad to a whole word */
+    }
+
+#undef EMIT
+#undef LABEL
+#undef OFF
+
+    return n & ~1;
+}
+
+/* Registers the stub uses; P0 comes first */
+static const enum core_regnum stub_regs[] = {
+    BFIN_REG_P0, BFIN_REG_P1, BFIN_REG_P2, BFIN_REG_P3, BFIN_REG_P4,
+    BFIN_REG_R0, BFIN_REG_R1, BFIN_REG_R2, BFIN_REG_R3, BFIN_REG_R4,
+    BFIN_REG_R5, BFIN_REG_R6, BFIN_REG_R7, BFIN_REG_ASTAT, BFIN_REG_RETE,
+};
+#define STUB_REGS       ((int) (sizeof stub_regs / sizeof stub_regs[0]))
+
+/**
+ * bus->driver->(*stub_area)
+ *
+ */
+static int
+bfin_emu_bus_stub_area (urj_bus_t *bus, uint32_t *adr)
+{
+    if (!BP->has_workarea)
+        return URJ_STATUS_FAIL;
+
+    *adr = BP->workarea;
+    return URJ_STATUS_OK;
+}
+
+/**
+ * bus->driver->(*stub_run)
+ *
+ */
+static int
+bfin_emu_bus_stub_run (urj_bus_t *bus, const uint32_t *mailbox, int width)
+{
+    urj_chain_t *chain = bus->chain;
+    uint16_t code[STUB_HALFWORDS];
+    uint32_t words[STUB_HALFWORDS / 2], saved[STUB_REGS], adr;
+    long double deadline;
+    int i, len, done;
+
+    if (!BP->has_workarea)
+    {
+        urj_error_set (URJ_ERROR_INVALID, _("no workarea given"));
+        return URJ_STATUS_FAIL;
+    }
+
+    if (BP->stub != width)
+    {
+        len = bfin_emu_gen_stub (code, width);
+        for (i = 0; i < len; i += 2)
+            words[i / 2] = code[i] | ((uint32_t) code[i + 1] << 16);
+        if (part_mem_write_block_clobber (chain, BP->n,
+                                          BP->workarea + URJ_BUS_STUB_CODE,
+                                          words, len / 2, 4) != URJ_STATUS_OK)
+            return URJ_STATUS_FAIL;
+
+        /* Do not run stale code out of the instruction cache */
+        for (adr = 0; adr < 2 * (uint32_t) len; adr += 32)
+        {
+            part_register_set (chain, BP->n, BFIN_REG_P0,
+                               BP->workarea + URJ_BUS_STUB_CODE + adr);
+            part_emuir_set (chain, BP->n, gen_iflush (BFIN_REG_P0),
+                            URJ_CHAIN_EXITMODE_IDLE);
+        }
+        part_emuir_set (chain, BP->n, INSN_CSYNC, URJ_CHAIN_EXITMODE_IDLE);
+        BP->stub = width;
+    }
+
+    if (bfin_emu_bus_write_block (bus, BP->workarea + URJ_BUS_STUB_MAILBOX,
+                                  mailbox, URJ_BUS_STUB_MB_WORDS)
+        != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+
+    for (i = 0; i < STUB_REGS; i++)
+        saved[i] = part_register_get (chain, BP->n, stub_regs[i]);
+
+    part_register_set (chain, BP->n, BFIN_REG_P0,
+                       BP->workarea + URJ_BUS_STUB_MAILBOX);
+    part_register_set (chain, BP->n, BFIN_REG_RETE,
+                       BP->workarea + URJ_BUS_STUB_CODE);
+    part_emulation_return (chain, BP->n);
+
+    deadline = urj_lib_frealtime () + STUB_WAIT;
+    do
+    {
+        usleep (1000);
+        part_dbgstat_get (chain, BP->n);
+        done = part_dbgstat_is_emuready (chain, BP->n);
+    }
+    while (!done && urj_lib_frealtime () < deadline);
+
+    if (!done)
+    {
+        part_emulation_trigger (chain, BP->n);
+        urj_error_set (URJ_ERROR_TIMEOUT, _("flash stub did not return"));
+    }
+
+    for (i = STUB_REGS - 1; i >= 0; i--)
+        part_register_set (chain, BP->n, stub_regs[i], saved[i]);
+
+    return done ? URJ_STATUS_OK : URJ_STATUS_FAIL;
+}
+
+const urj_bus_driver_t urj_bus_bfin_emu_bus = {
+    "bfin_emu",
+    N_("Blackfin memory bus driver via EMUDAT, requires emulation mode:\n"
+       "           [width=8|16|32] (asynchronous memory width, default 16)\n"
+       "           [workarea=<RAM address for flash stubs>]"),
+    bfin_emu_bus_new,
+    bfin_emu_bus_free,
+    bfin_emu_bus_printinfo,
+    bfin_emu_bus_prepare,
+    bfin_emu_bus_area,
+    bfin_emu_bus_read_start,
+    bfin_emu_bus_read_next,
+    bfin_emu_bus_read_end,
+    bfin_emu_bus_read,
+    urj_bus_generic_write_start,
+    bfin_emu_bus_write,
+    bfin_emu_bus_init,
+    urj_bus_generic_no_enable,
+    urj_bus_generic_no_disable,
+    URJ_BUS_TYPE_PARALLEL,
+    bfin_emu_bus_read_block,
+    bfin_emu_bus_write_block,
+    bfin_emu_bus_stub_area,
+    bfin_emu_bus_stub_run,
+};
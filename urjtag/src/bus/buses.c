@@ -40,9 +40,6 @@ const urj_bus_driver_t * const urj_bus_drivers[] = {
     NULL                        /* last must be NULL */
 };
 
-urj_bus_t *urj_bus = NULL;
-urj_buses_t urj_buses = { 0, NULL };
-
 void
 urj_bus_buses_free (void)
 {
@@ -250,6 +247,7 @@ static const urj_param_descr_t bus_param[] =
     { URJ_BUS_PARAM_KEY_SCK,        URJ_PARAM_TYPE_STRING,  "SCK", },
     { URJ_BUS_PARAM_KEY_MOSI,       URJ_PARAM_TYPE_STRING,  "MOSI", },
     { URJ_BUS_PARAM_KEY_MISO,       URJ_PARAM_TYPE_STRING,  "MISO", },
+    { URJ_BUS_PARAM_KEY_WORKAREA,   URJ_PARAM_TYPE_LU,      "WORKAREA", },
 };
 
 const urj_param_list_t urj_bus_param_list =
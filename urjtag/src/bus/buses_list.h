@@ -58,6 +58,9 @@ _URJ_BUS(bf53x)
 _URJ_BUS(bf548_ezkit)
 _URJ_BUS(bf561_ezkit)
 #endif
+#ifdef ENABLE_BUS_BFIN_EMU
+_URJ_BUS(bfin_emu)
+#endif
 #ifdef ENABLE_BUS_BSCOACH
 _URJ_BUS(bscoach)
 #endif
@@ -30,6 +30,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <urjtag/part.h>
 #include <urjtag/bus.h>
@@ -38,6 +39,8 @@
 #include <urjtag/tap_state.h>
 #include <urjtag/tap_register.h>
 #include <urjtag/data_register.h>
+#include <urjtag/part_instruction.h>
+#include <urjtag/fclock.h>
 
 #include "buses.h"
 #include "generic_bus.h"
@@ -46,6 +49,11 @@ typedef struct
 {
     uint32_t impcode;           /* EJTAG Implementation Register */
     uint16_t adr_hi;            /* cached high bits of $3 */
+    int has_workarea;           /* workarea parameter given */
+    uint32_t workarea;          /* target RAM for FASTDATA and flash stubs */
+    int fastdata;               /* FASTDATA transfers usable */
+    int handler;                /* kind of handler in the workarea, 0 = none */
+    int stub;                   /* width of the flash stub loaded, 0 = none */
 } bus_params_t;
 
 #define BP              ((bus_params_t *) bus->params)
@@ -57,6 +65,22 @@ typedef struct
 #define EJTAG_26        2
 #define EJTAG_31        3
 
+/* dmseg addresses */
+#define FASTDATA_AREA   UINT32_C (0xff200000)
+#define PRACC_TEXT      UINT32_C (0xff200200)
+
+/* FASTDATA register: SPrAcc is shifted first, followed by the data */
+#define SPrAcc           0
+
+#define FASTDATA_BATCH   256    /* FASTDATA scans queued per flush */
+#define FASTDATA_MIN     16     /* shorter blocks are not worth the setup */
+#define FASTDATA_RETRIES 100    /* idle scans before giving up */
+
+/* The FASTDATA handler lives behind the flash stub in the workarea */
+#define FASTDATA_HANDLER (URJ_BUS_STUB_MAILBOX - 0x40)
+
+#define STUB_WAIT        60000  /* ms a flash stub may run */
+
 /* EJTAG 3.1 Control Register Bits */
 #define VPED            23      /* R    */
 /* EJTAG 2.6 Control Register Bits */
@@ -117,7 +141,39 @@ static urj_bus_t *
 ejtag_bus_new (urj_chain_t *chain, const urj_bus_driver_t *driver,
                const urj_param_t *cmd_params[])
 {
-    return urj_bus_generic_new (chain, driver, sizeof (bus_params_t));
+    urj_bus_t *bus;
+    int i;
+
+    bus = urj_bus_generic_new (chain, driver, sizeof (bus_params_t));
+    if (bus == NULL)
+        return NULL;
+
+    for (i = 0; cmd_params[i] != NULL; i++)
+    {
+        switch (cmd_params[i]->key)
+        {
+        case URJ_BUS_PARAM_KEY_WORKAREA:
+            if (cmd_params[i]->value.lu & 3)
+            {
+                urj_bus_generic_free (bus);
+                urj_error_set (URJ_ERROR_SYNTAX,
+                               _("workarea 0x%08lx is not word aligned"),
+                               cmd_params[i]->value.lu);
+                return NULL;
+            }
+            BP->has_workarea = 1;
+            BP->workarea = cmd_params[i]->value.lu;
+            break;
+
+        default:
+            urj_bus_generic_free (bus);
+            urj_error_set (URJ_ERROR_SYNTAX, "unrecognised bus parameter '%s'",
+                           urj_param_string (&urj_bus_param_list, cmd_params[i]));
+            return NULL;
+        }
+    }
+
+    return bus;
 }
 
 /**
@@ -150,12 +206,106 @@ reg_value (urj_tap_register_t *reg)
     return retval;
 }
 
-static uint32_t
-ejtag_run_pracc (urj_bus_t *bus, const uint32_t *code, unsigned int len)
+/* Select an EJTAG instruction, skipping the IR scan if it is loaded already */
+static void
+ejtag_select (urj_bus_t *bus, const char *name, int force)
+{
+    urj_part_instruction_t *insn = bus->part->active_instruction;
+
+    if (force || insn == NULL || strcmp (insn->name, name) != 0)
+    {
+        urj_part_set_instruction (bus->part, name);
+        urj_tap_chain_shift_instructions (bus->chain);
+    }
+}
+
+/**
+ * Look for a pending processor access. EJCONTROL, EJADDRESS and EJDATA
+ * are all captured before the first result is picked up, so one poll
+ * costs a single round trip to the cable. On return, EJTAG_DATA is
+ * selected and ejdata->out holds the data of a processor write.
+ *
+ * @return 1 if an access is pending, 0 if not, -1 on reset
+ */
+static int
+ejtag_pracc_poll (urj_bus_t *bus, urj_data_register_t *ejctrl,
+                  urj_data_register_t *ejaddr, urj_data_register_t *ejdata,
+                  uint32_t *addr)
+{
+    urj_chain_t *chain = bus->chain;
+
+    ejtag_select (bus, "EJTAG_CONTROL", 0);
+    ejctrl->in->data[PrAcc] = 1;
+    urj_tap_chain_defer_shift_data_registers_mode (chain, 1, 1,
+                                                   URJ_CHAIN_EXITMODE_IDLE);
+    ejtag_select (bus, "EJTAG_ADDRESS", 0);
+    urj_tap_chain_defer_shift_data_registers_mode (chain, 1, 1,
+                                                   URJ_CHAIN_EXITMODE_IDLE);
+    ejtag_select (bus, "EJTAG_DATA", 0);
+    urj_tap_register_fill (ejdata->in, 0);
+    urj_tap_chain_defer_shift_data_registers_mode (chain, 1, 1,
+                                                   URJ_CHAIN_EXITMODE_IDLE);
+
+    /* The results are picked up in order; the active instruction tells
+       where each of them is stored */
+    urj_part_set_instruction (bus->part, "EJTAG_CONTROL");
+    urj_tap_chain_shift_data_registers_output (chain, URJ_CHAIN_EXITMODE_IDLE);
+    urj_part_set_instruction (bus->part, "EJTAG_ADDRESS");
+    urj_tap_chain_shift_data_registers_output (chain, URJ_CHAIN_EXITMODE_IDLE);
+    urj_part_set_instruction (bus->part, "EJTAG_DATA");
+    urj_tap_chain_shift_data_registers_output (chain, URJ_CHAIN_EXITMODE_IDLE);
+
+    urj_log (URJ_LOG_LEVEL_ALL,  "ctrl=%s\n",
+             urj_tap_register_get_string (ejctrl->out));
+
+    if (ejctrl->out->data[Rocc])
+    {
+        urj_error_set (URJ_ERROR_BUS, _("Reset occurred, ctrl=%s"),
+                       urj_tap_register_get_string (ejctrl->out));
+        bus->initialized = 0;
+        return -1;
+    }
+    if (!ejctrl->out->data[PrAcc])
+        return 0;
+
+    *addr = reg_value (ejaddr->out);
+    if (*addr & 3)
+    {
+        urj_error_set (URJ_ERROR_BUS,
+                       _("PrAcc bad alignment: addr=0x%08lx"),
+                       (long unsigned) *addr);
+        *addr &= ~3;
+    }
+
+    return 1;
+}
+
+/* Let the processor continue after its access has been serviced */
+static void
+ejtag_pracc_finish (urj_bus_t *bus, urj_data_register_t *ejctrl)
+{
+    ejtag_select (bus, "EJTAG_CONTROL", 0);
+
+    ejctrl->in->data[PrAcc] = 0;
+    urj_tap_chain_shift_data_registers (bus->chain, 0);
+}
+
+/**
+ * Feed code to the processor through PrAcc until it branches back to the
+ * start of the dmseg text, or, with stop_at_fastdata, until it reads the
+ * FASTDATA area. Either access is left pending. While the processor runs
+ * code from memory, it is given up to wait ms to come back to dmseg.
+ *
+ * @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error
+ */
+static int
+ejtag_pracc_exec (urj_bus_t *bus, const uint32_t *code, unsigned int len,
+                  int stop_at_fastdata, unsigned int wait, uint32_t *retval)
 {
     urj_data_register_t *ejaddr, *ejdata, *ejctrl;
-    int i, pass;
-    uint32_t addr, data, retval;
+    int i, pass, r;
+    uint32_t addr, data;
+    long double deadline = 0;
 
     ejaddr = urj_part_find_data_register (bus->part, "EJADDRESS");
     ejdata = urj_part_find_data_register (bus->part, "EJDATA");
@@ -164,69 +314,48 @@ ejtag_run_pracc (urj_bus_t *bus, const uint32_t *code, unsigned int len)
     {
         urj_error_set (URJ_ERROR_NOTFOUND,
                        _("EJADDRESS, EJDATA or EJCONTROL register not found"));
-        return 0;
+        return URJ_STATUS_FAIL;
     }
 
-    urj_part_set_instruction (bus->part, "EJTAG_CONTROL");
-    urj_tap_chain_shift_instructions (bus->chain);
+    ejtag_select (bus, "EJTAG_CONTROL", 1);
 
     pass = 0;
-    retval = 0;
 
     for (;;)
     {
-        ejctrl->in->data[PrAcc] = 1;
-        urj_tap_chain_shift_data_registers (bus->chain, 0);
-        urj_tap_chain_shift_data_registers (bus->chain, 1);
-
-        urj_log (URJ_LOG_LEVEL_ALL,  "ctrl=%s\n",
-                 urj_tap_register_get_string (ejctrl->out));
-
-        if (ejctrl->out->data[Rocc])
+        r = ejtag_pracc_poll (bus, ejctrl, ejaddr, ejdata, &addr);
+        if (r < 0)
+            return URJ_STATUS_FAIL;
+        if (r == 0 && wait)
         {
-            urj_error_set (URJ_ERROR_BUS, _("Reset occurred, ctrl=%s"),
-                           urj_tap_register_get_string (ejctrl->out));
-            bus->initialized = 0;
-            break;
+            if (deadline == 0)
+                deadline = urj_lib_frealtime () + wait / 1000.0;
+            if (urj_lib_frealtime () < deadline)
+            {
+                usleep (1000);
+                continue;
+            }
         }
-        if (!ejctrl->out->data[PrAcc])
+        if (r == 0)
         {
             urj_error_set (URJ_ERROR_BUS, _("No processor access, ctrl=%s"),
                            urj_tap_register_get_string (ejctrl->out));
             bus->initialized = 0;
-            break;
-        }
-
-        urj_part_set_instruction (bus->part, "EJTAG_ADDRESS");
-        urj_tap_chain_shift_instructions (bus->chain);
-
-        urj_tap_chain_shift_data_registers (bus->chain, 1);
-        addr = reg_value (ejaddr->out);
-        if (addr & 3)
-        {
-            urj_error_set (URJ_ERROR_BUS,
-                           _("PrAcc bad alignment: addr=0x%08lx"),
-                           (long unsigned) addr);
-            addr &= ~3;
+            return URJ_STATUS_FAIL;
         }
 
-        urj_part_set_instruction (bus->part, "EJTAG_DATA");
-        urj_tap_chain_shift_instructions (bus->chain);
-
-        urj_tap_register_fill (ejdata->in, 0);
-
         if (ejctrl->out->data[PRnW])
         {
-            urj_tap_chain_shift_data_registers (bus->chain, 1);
             data = reg_value (ejdata->out);
             urj_log (URJ_LOG_LEVEL_ALL,
                      _("%s(%d) PrAcc write: addr=0x%08lx data=0x%08lx\n"),
                      __FILE__, __LINE__,
                      (long unsigned) addr, (long unsigned) data);
-            if (addr == UINT32_C (0xff200000))
+            if (addr == FASTDATA_AREA)
             {
                 /* Return value from the target CPU.  */
-                retval = data;
+                if (retval)
+                    *retval = data;
             }
             else
             {
@@ -237,13 +366,15 @@ ejtag_run_pracc (urj_bus_t *bus, const uint32_t *code, unsigned int len)
         }
         else
         {
-            if (addr == UINT32_C (0xff200200) && pass++)
+            if (addr == PRACC_TEXT && pass++)
+                break;
+            if (addr == FASTDATA_AREA && stop_at_fastdata)
                 break;
 
             data = 0;
-            if (addr >= 0xff200200 && addr < 0xff200200 + (len << 2))
+            if (addr >= PRACC_TEXT && addr < PRACC_TEXT + (len << 2))
             {
-                data = code[(addr - 0xff200200) >> 2];
+                data = code[(addr - PRACC_TEXT) >> 2];
 
                 for (i = 0; i < 32; i++)
                     ejdata->in->data[i] = (data >> i) & 1;
@@ -255,12 +386,19 @@ ejtag_run_pracc (urj_bus_t *bus, const uint32_t *code, unsigned int len)
             urj_tap_chain_shift_data_registers (bus->chain, 0);
         }
 
-        urj_part_set_instruction (bus->part, "EJTAG_CONTROL");
-        urj_tap_chain_shift_instructions (bus->chain);
-
-        ejctrl->in->data[PrAcc] = 0;
-        urj_tap_chain_shift_data_registers (bus->chain, 0);
+        ejtag_pracc_finish (bus, ejctrl);
     }
+
+    return URJ_STATUS_OK;
+}
+
+static uint32_t
+ejtag_run_pracc (urj_bus_t *bus, const uint32_t *code, unsigned int len)
+{
+    uint32_t retval = 0;
+
+    ejtag_pracc_exec (bus, code, len, 0, 0, &retval);
+
     return retval;
 }
 
@@ -332,6 +470,25 @@ ejtag_bus_init (urj_bus_t *bus)
              (BP->impcode & (1 << 14)) ? " NoDMA" : " DMA",
              (BP->impcode & (1)) ? " MIPS64" : " MIPS32");
 
+    BP->fastdata = 0;
+    BP->handler = 0;
+    BP->stub = 0;
+    if (EJTAG_VER >= EJTAG_26
+        && urj_part_find_data_register (bus->part, "EJFASTDATA")
+        && urj_part_find_instruction (bus->part, "EJTAG_FASTDATA"))
+    {
+        if (BP->has_workarea)
+        {
+            BP->fastdata = 1;
+            urj_log (URJ_LOG_LEVEL_NORMAL,
+                     _("FASTDATA block transfers, handler at 0x%08lx\n"),
+                     (long unsigned) BP->workarea);
+        }
+        else
+            urj_log (URJ_LOG_LEVEL_NORMAL,
+                     _("FASTDATA supported, use workarea=<RAM address> to enable it\n"));
+    }
+
     if (EJTAG_VER >= EJTAG_25)
     {
         urj_part_set_instruction (bus->part, "EJTAGBOOT");
@@ -759,9 +916,523 @@ ejtag_bus_write (urj_bus_t *bus, uint32_t adr, uint32_t data)
              (long unsigned) adr, (long unsigned) data);
 }
 
+/*
+ * FASTDATA block transfers (EJTAG 2.6 and later)
+ *
+ * A small copy loop is stored in the workarea in target RAM. It reads the
+ * start and end address from the FASTDATA area of dmseg and then moves
+ * one bus word per access between memory and the FASTDATA area. Every
+ * such access is serviced by a single FASTDATA scan, whose SPrAcc bit
+ * tells whether the processor was actually waiting for it. So instead of
+ * polling EJCONTROL before each word, a whole batch of scans is queued
+ * and the SPrAcc bits are checked afterwards.
+ */
+
+static unsigned int
+ejtag_gen_fastdata_handler (uint32_t *code, int step, int write)
+{
+    static const uint32_t load[] = {
+        0x90a20000,             // lbu $2,0($5)
+        0x94a20000,             // lhu $2,0($5)
+        0,
+        0x8ca20000              // lw $2,0($5)
+    };
+    static const uint32_t store[] = {
+        0xa0a20000,             // sb $2,0($5)
+        0xa4a20000,             // sh $2,0($5)
+        0,
+        0xaca20000              // sw $2,0($5)
+    };
+    uint32_t *p = code;
+
+    *p++ = 0x3c04ff20;          // lui $4,0xff20
+    *p++ = 0x3c1fff20;          // lui $31,0xff20
+    *p++ = 0x37ff0200;          // ori $31,$31,0x0200
+    *p++ = 0x8c850000;          // lw $5,0($4)
+    *p++ = 0x8c860000;          // lw $6,0($4)
+    if (write)
+    {
+        *p++ = 0x8c820000;      // loop: lw $2,0($4)
+        *p++ = store[step - 1];
+    }
+    else
+    {
+        *p++ = load[step - 1];  // loop: l[bhw] $2,0($5)
+        *p++ = 0xac820000;      // sw $2,0($4)
+    }
+    *p++ = 0x14c5fffd;          // bne $6,$5,loop
+    *p++ = 0x24a50000 | step;   // addiu $5,$5,step
+    *p++ = 0x03e00008;          // jr $31
+    *p++ = 0x00000000;          // nop
+    return p - code;
+}
+
+/* Queue one FASTDATA scan per word of data */
+static void
+ejtag_fastdata_defer (urj_bus_t *bus, urj_data_register_t *ejfast,
+                      const uint32_t *data, unsigned int count)
+{
+    unsigned int i;
+    int j;
+
+    ejtag_select (bus, "EJTAG_FASTDATA", 0);
+
+    urj_tap_register_fill (ejfast->in, 0);
+    for (i = 0; i < count; i++)
+    {
+        if (data)
+            for (j = 0; j < 32; j++)
+                ejfast->in->data[j + 1] = (data[i] >> j) & 1;
+        urj_tap_chain_defer_shift_data_registers_mode (bus->chain, 1, 1,
+                                                       URJ_CHAIN_EXITMODE_IDLE);
+    }
+}
+
+/* Pick up the result of a queued FASTDATA scan; 0 if nobody was waiting */
+static int
+ejtag_fastdata_output (urj_bus_t *bus, urj_data_register_t *ejfast,
+                       uint32_t *data)
+{
+    int j;
+
+    urj_tap_chain_shift_data_registers_output (bus->chain,
+                                               URJ_CHAIN_EXITMODE_IDLE);
+    if (!ejfast->out->data[SPrAcc])
+        return 0;
+
+    *data = 0;
+    for (j = 0; j < 32; j++)
+        if (ejfast->out->data[j + 1])
+            *data |= UINT32_C (1) << j;
+    return 1;
+}
+
+/* Hand one word to the processor, retrying until it has been taken */
+static int
+ejtag_fastdata_put (urj_bus_t *bus, urj_data_register_t *ejfast,
+                    uint32_t data)
+{
+    uint32_t dummy;
+    int tries;
+
+    for (tries = 0; tries < FASTDATA_RETRIES; tries++)
+    {
+        ejtag_fastdata_defer (bus, ejfast, &data, 1);
+        if (ejtag_fastdata_output (bus, ejfast, &dummy))
+            return URJ_STATUS_OK;
+    }
+
+    urj_error_set (URJ_ERROR_BUS, _("FASTDATA access timed out"));
+    bus->initialized = 0;
+    return URJ_STATUS_FAIL;
+}
+
+static int
+ejtag_fastdata_xfer (urj_bus_t *bus, uint32_t adr, uint32_t *data,
+                     uint32_t count, int write)
+{
+    urj_data_register_t *ejfast, *ejctrl, *ejaddr, *ejdata;
+    uint32_t code[12], start, handler, w, stall;
+    unsigned int len;
+    int step, kind, r, missed;
+    uint32_t done, n, k, accepted;
+    uint32_t redo_lo = count, redo_hi = 0;
+
+    ejfast = urj_part_find_data_register (bus->part, "EJFASTDATA");
+    ejctrl = urj_part_find_data_register (bus->part, "EJCONTROL");
+    ejaddr = urj_part_find_data_register (bus->part, "EJADDRESS");
+    ejdata = urj_part_find_data_register (bus->part, "EJDATA");
+    if (!(ejfast && ejctrl && ejaddr && ejdata))
+    {
+        urj_error_set (URJ_ERROR_NOTFOUND,
+                       _("EJFASTDATA, EJCONTROL, EJADDRESS or EJDATA register not found"));
+        return URJ_STATUS_FAIL;
+    }
+
+    step = 1 << (adr >> 29);
+    start = UINT32_C (0xa0000000) | (adr & UINT32_C (0x1fffffff) & ~(step - 1));
+    handler = UINT32_C (0xa0000000)
+        | ((BP->workarea + FASTDATA_HANDLER) & UINT32_C (0x1fffffff));
+
+    /* Store the copy loop, through the 32-bit area of the bus */
+    kind = (step << 1) | write;
+    if (BP->handler != kind)
+    {
+        len = ejtag_gen_fastdata_handler (code, step, write);
+        for (k = 0; k < len; k++)
+            ejtag_bus_write (bus, UINT32_C (0x40000000)
+                             | ((handler & UINT32_C (0x1fffffff)) + 4 * k),
+                             code[k]);
+        BP->handler = kind;
+    }
+
+    code[0] = 0x3c020000 | (handler >> 16);     // lui $2,handler_hi
+    code[1] = 0x34420000 | (handler & 0xffff);  // ori $2,$2,handler_lo
+    code[2] = 0x00400008;                       // jr $2
+    code[3] = 0x00000000;                       // nop
+    if (ejtag_pracc_exec (bus, code, 4, 1, 0, NULL) != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+
+    if (ejtag_fastdata_put (bus, ejfast, start) != URJ_STATUS_OK
+        || ejtag_fastdata_put (bus, ejfast, start + (count - 1) * step)
+            != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+
+    done = 0;
+    stall = 0;
+    while (done < count)
+    {
+        n = count - done;
+        if (n > FASTDATA_BATCH)
+            n = FASTDATA_BATCH;
+
+        ejtag_fastdata_defer (bus, ejfast, write ? data + done : NULL, n);
+
+        accepted = 0;
+        missed = 0;
+        for (k = 0; k < n; k++)
+        {
+            if (!ejtag_fastdata_output (bus, ejfast, &w))
+            {
+                /* The processor was not ready: when writing, the
+                   following words have been stored one place early. */
+                if (write && !missed && redo_lo > done + accepted)
+                    redo_lo = done + accepted;
+                missed = 1;
+                continue;
+            }
+            if (!write)
+                data[done + accepted] = w;
+            accepted++;
+        }
+        if (write && missed && done + accepted > redo_hi)
+            redo_hi = done + accepted;
+        done += accepted;
+
+        if (accepted)
+            stall = 0;
+        else if (++stall == FASTDATA_RETRIES)
+        {
+            urj_error_set (URJ_ERROR_BUS, _("FASTDATA access timed out"));
+            bus->initialized = 0;
+            return URJ_STATUS_FAIL;
+        }
+    }
+
+    /* Wait for the loop to return to the dmseg text */
+    for (stall = 0; stall < FASTDATA_RETRIES; stall++)
+    {
+        r = ejtag_pracc_poll (bus, ejctrl, ejaddr, ejdata, &w);
+        if (r < 0)
+            return URJ_STATUS_FAIL;
+        if (r > 0)
+            break;
+    }
+    if (stall == FASTDATA_RETRIES || w != PRACC_TEXT
+        || ejctrl->out->data[PRnW])
+    {
+        urj_error_set (URJ_ERROR_BUS,
+                       _("FASTDATA handler did not return, ctrl=%s"),
+                       urj_tap_register_get_string (ejctrl->out));
+        bus->initialized = 0;
+        return URJ_STATUS_FAIL;
+    }
+
+    if (redo_lo < redo_hi)
+    {
+        urj_log (URJ_LOG_LEVEL_DETAIL,
+                 "FASTDATA overrun, rewriting 0x%08lx..0x%08lx\n",
+                 (long unsigned) (adr + redo_lo * step),
+                 (long unsigned) (adr + redo_hi * step - 1));
+        for (k = redo_lo; k < redo_hi; k++)
+            ejtag_bus_write (bus, adr + k * step, data[k]);
+    }
+
+    return URJ_STATUS_OK;
+}
+
+/*
+ * Target-resident flash stub, see URJ_BUS_STUB_* in <urjtag/bus_driver.h>
+ *
+ * The stub is entered with the mailbox address in $4 and returns to dmseg
+ * through $31. It keeps clear of $3, which caches the address high bits
+ * for ejtag_bus_write ().
+ */
+
+#define MIPS_I(op,rs,rt,imm)    (((uint32_t) (op) << 26) | ((rs) << 21) \
+                                 | ((rt) << 16) | ((imm) & 0xffff))
+#define MIPS_R(rs,rt,rd,fn)     (((rs) << 21) | ((rt) << 16) | ((rd) << 11) \
+                                 | (fn))
+
+#define MIPS_BEQ        0x04
+#define MIPS_BNE        0x05
+#define MIPS_ADDIU      0x09
+#define MIPS_ANDI       0x0c
+#define MIPS_LB(w)      ((w) == 1 ? 0x24 : (w) == 2 ? 0x25 : 0x23)     /* lbu lhu lw */
+#define MIPS_SB(w)      ((w) == 1 ? 0x28 : (w) == 2 ? 0x29 : 0x2b)     /* sb sh sw */
+#define MIPS_LW         0x23
+#define MIPS_SW         0x2b
+#define MIPS_ADDU       0x21
+#define MIPS_AND        0x24
+#define MIPS_XOR        0x26
+#define MIPS_SRL1       0x42            /* srl rd, rt, 1 */
+#define MIPS_JR_RA      0x03e00008
+#define MIPS_NOP        0x00000000
+
+#define STUB_WORDS      (FASTDATA_HANDLER / 4)
+
+enum
+{
+    L_NEXT, L_CYCLE, L_STORE, L_DATA, L_POLL0, L_POLL, L_STATUS, L_AGAIN,
+    L_FAIL, L_OK, L_CRC, L_UNIT, L_BIT, L_EVEN,
+    L_LABELS
+};
+
+static unsigned int
+ejtag_gen_stub (uint32_t *code, int width)
+{
+    int label[L_LABELS] = { 0 };
+    int pass, n = 0;
+
+#define EMIT(insn)              do { uint32_t i_ = (insn); \
+                                     code[n++] = i_; } while (0)
+#define LABEL(l)                (label[l] = n)
+#define BRANCH(op,rs,rt,l)      EMIT (MIPS_I (op, rs, rt, label[l] - n - 1)); \
+                                EMIT (MIPS_NOP)
+
+    /* The second pass knows where the labels are */
+    for (pass = 0; pass < 2; pass++)
+    {
+        n = 0;
+        EMIT (MIPS_I (MIPS_LW, 4, 5, URJ_BUS_STUB_MB_DST));
+        EMIT (MIPS_I (MIPS_LW, 4, 6, URJ_BUS_STUB_MB_SRC));
+        EMIT (MIPS_I (MIPS_LW, 4, 7, URJ_BUS_STUB_MB_COUNT));
+        EMIT (MIPS_I (MIPS_LW, 4, 15, URJ_BUS_STUB_MB_WRITE));
+        EMIT (MIPS_I (MIPS_ADDIU, 15, 24, -URJ_BUS_STUB_CRC));
+        BRANCH (MIPS_BEQ, 24, 0, L_CRC);
+        LABEL (L_NEXT);
+        EMIT (MIPS_I (MIPS_ADDIU, 4, 8, URJ_BUS_STUB_MB_CYCLES));
+        EMIT (MIPS_I (MIPS_LW, 4, 9, URJ_BUS_STUB_MB_NCYCLES));
+
+        /* command cycles */
+        LABEL (L_CYCLE);
+        BRANCH (MIPS_BEQ, 9, 0, L_DATA);
+        EMIT (MIPS_I (MIPS_LW, 8, 10, 0));
+        EMIT (MIPS_I (MIPS_LW, 8, 11, 4));
+        EMIT (MIPS_I (MIPS_ADDIU, 10, 15, 1));
+        BRANCH (MIPS_BNE, 15, 0, L_STORE);
+        EMIT (MIPS_R (5, 0, 10, MIPS_ADDU));            /* ~0: this unit */
+        LABEL (L_STORE);
+        EMIT (MIPS_I (MIPS_SB (width), 10, 11, 0));
+        EMIT (MIPS_I (MIPS_ADDIU, 8, 8, 8));
+        EMIT (MIPS_I (MIPS_ADDIU, 9, 9, -1));
+        BRANCH (MIPS_BEQ, 0, 0, L_CYCLE);
+
+        /* data */
+        LABEL (L_DATA);
+        EMIT (MIPS_I (MIPS_LW, 6, 12, 0));
+        EMIT (MIPS_I (MIPS_LW, 4, 15, URJ_BUS_STUB_MB_WRITE));
+        BRANCH (MIPS_BEQ, 15, 0, L_POLL0);
+        EMIT (MIPS_I (MIPS_SB (width), 5, 12, 0));
+        LABEL (L_POLL0);
+        EMIT (MIPS_I (MIPS_LW, 4, 13, URJ_BUS_STUB_MB_TIMEOUT));
+
+        /* poll the unit */
+        LABEL (L_POLL);
+        EMIT (MIPS_I (MIPS_LB (width), 5, 14, 0));
+        EMIT (MIPS_I (MIPS_LW, 4, 15, URJ_BUS_STUB_MB_SMASK));
+        BRANCH (MIPS_BNE, 15, 0, L_STATUS);
+        BRANCH (MIPS_BEQ, 14, 12, L_OK);
+        BRANCH (MIPS_BEQ, 0, 0, L_AGAIN);
+        LABEL (L_STATUS);
+        EMIT (MIPS_R (14, 15, 24, MIPS_AND));
+        BRANCH (MIPS_BNE, 24, 15, L_AGAIN);
+        EMIT (MIPS_I (MIPS_LW, 4, 15, URJ_BUS_STUB_MB_EMASK));
+        EMIT (MIPS_R (14, 15, 24, MIPS_AND));
+        BRANCH (MIPS_BNE, 24, 0, L_FAIL);
+        BRANCH (MIPS_BEQ, 0, 0, L_OK);
+        LABEL (L_AGAIN);
+        EMIT (MIPS_I (MIPS_ADDIU, 13, 13, -1));
+        BRANCH (MIPS_BNE, 13, 0, L_POLL);
+        LABEL (L_FAIL);
+        EMIT (MIPS_I (MIPS_SW, 4, 7, URJ_BUS_STUB_MB_STATUS));
+        EMIT (MIPS_JR_RA);
+        EMIT (MIPS_NOP);
+
+        /* next unit */
+        LABEL (L_OK);
+        EMIT (MIPS_I (MIPS_ADDIU, 5, 5, width));
+        EMIT (MIPS_I (MIPS_ADDIU, 6, 6, 4));
+        EMIT (MIPS_I (MIPS_ADDIU, 7, 7, -1));
+        BRANCH (MIPS_BNE, 7, 0, L_NEXT);
+        EMIT (MIPS_I (MIPS_SW, 4, 0, URJ_BUS_STUB_MB_STATUS));
+        EMIT (MIPS_JR_RA);
+        EMIT (MIPS_NOP);
+
+        /* CRC of the units, $12 = remainder, $15 = polynomial */
+        LABEL (L_CRC);
+        EMIT (MIPS_I (MIPS_LW, 4, 12, URJ_BUS_STUB_MB_EMASK));
+        EMIT (MIPS_I (MIPS_LW, 4, 15, URJ_BUS_STUB_MB_SMASK));
+        LABEL (L_UNIT);
+        EMIT (MIPS_I (MIPS_LB (width), 5, 14, 0));
+        EMIT (MIPS_I (MIPS_ADDIU, 0, 13, 8 * width));
+        LABEL (L_BIT);
+        EMIT (MIPS_R (12, 14, 24, MIPS_XOR));
+        EMIT (MIPS_I (MIPS_ANDI, 24, 24, 1));
+        EMIT (MIPS_R (0, 12, 12, MIPS_SRL1));
+        EMIT (MIPS_R (0, 14, 14, MIPS_SRL1));
+        BRANCH (MIPS_BEQ, 24, 0, L_EVEN);
+        EMIT (MIPS_R (12, 15, 12, MIPS_XOR));
+        LABEL (L_EVEN);
+        EMIT (MIPS_I (MIPS_ADDIU, 13, 13, -1));
+        BRANCH (MIPS_BNE, 13, 0, L_BIT);
+        EMIT (MIPS_I (MIPS_ADDIU, 5, 5, width));
+        EMIT (MIPS_I (MIPS_ADDIU, 7, 7, -1));
+        BRANCH (MIPS_BNE, 7, 0, L_UNIT);
+        EMIT (MIPS_I (MIPS_SW, 4, 12, URJ_BUS_STUB_MB_STATUS));
+        EMIT (MIPS_JR_RA);
+        EMIT (MIPS_NOP);
+    }
+
+#undef EMIT
+#undef LABEL
+#undef BRANCH
+
+    return n;
+}
+
+/* The stub uses uncached kseg1 addresses */
+static uint32_t
+ejtag_kseg1 (uint32_t adr)
+{
+    return UINT32_C (0xa0000000) | (adr & UINT32_C (0x1fffffff));
+}
+
+/**
+ * bus->driver->(*stub_area)
+ *
+ */
+static int
+ejtag_bus_stub_area (urj_bus_t *bus, uint32_t *adr)
+{
+    if (!BP->has_workarea)
+        return URJ_STATUS_FAIL;
+
+    /* through the 32-bit area of the bus */
+    *adr = UINT32_C (0x40000000) | (BP->workarea & UINT32_C (0x1fffffff));
+    return URJ_STATUS_OK;
+}
+
+/**
+ * bus->driver->(*stub_run)
+ *
+ */
+static int
+ejtag_bus_stub_run (urj_bus_t *bus, const uint32_t *mailbox, int width)
+{
+    uint32_t code[STUB_WORDS], mb[URJ_BUS_STUB_MB_WORDS];
+    uint32_t area, entry, box, *cycle;
+    unsigned int i, len;
+
+    if (ejtag_bus_stub_area (bus, &area) != URJ_STATUS_OK)
+    {
+        urj_error_set (URJ_ERROR_INVALID, _("no workarea given"));
+        return URJ_STATUS_FAIL;
+    }
+    entry = ejtag_kseg1 (area + URJ_BUS_STUB_CODE);
+    box = ejtag_kseg1 (area + URJ_BUS_STUB_MAILBOX);
+
+    if (BP->stub != width)
+    {
+        len = ejtag_gen_stub (code, width);
+        BP->stub = 0;
+        if (urj_bus_generic_write_words (bus, area + URJ_BUS_STUB_CODE, code,
+                                         len) != URJ_STATUS_OK)
+        {
+            urj_error_set (URJ_ERROR_BUS, _("stub code upload failed"));
+            return URJ_STATUS_FAIL;
+        }
+        BP->stub = width;
+    }
+
+    memcpy (mb, mailbox, sizeof mb);
+    mb[URJ_BUS_STUB_MB_DST / 4] = ejtag_kseg1 (mb[URJ_BUS_STUB_MB_DST / 4]);
+    mb[URJ_BUS_STUB_MB_SRC / 4] = ejtag_kseg1 (mb[URJ_BUS_STUB_MB_SRC / 4]);
+    cycle = &mb[URJ_BUS_STUB_MB_CYCLES / 4];
+    for (i = 0; i < URJ_BUS_STUB_MAX_CYCLES; i++)
+        if (cycle[2 * i] != ~UINT32_C (0))
+            cycle[2 * i] = ejtag_kseg1 (cycle[2 * i]);
+    if (urj_bus_generic_write_words (bus, area + URJ_BUS_STUB_MAILBOX, mb,
+                                     URJ_BUS_STUB_MB_WORDS) != URJ_STATUS_OK)
+    {
+        urj_error_set (URJ_ERROR_BUS, _("stub mailbox upload failed"));
+        return URJ_STATUS_FAIL;
+    }
+
+    code[0] = 0x3c1fff20;                       // lui $31,0xff20
+    code[1] = 0x37ff0200;                       // ori $31,$31,0x0200
+    code[2] = 0x3c040000 | (box >> 16);         // lui $4,box_hi
+    code[3] = 0x34840000 | (box & 0xffff);      // ori $4,$4,box_lo
+    code[4] = 0x3c020000 | (entry >> 16);       // lui $2,entry_hi
+    code[5] = 0x34420000 | (entry & 0xffff);    // ori $2,$2,entry_lo
+    code[6] = 0x00400008;                       // jr $2
+    code[7] = 0x00000000;                       // nop
+
+    return ejtag_pracc_exec (bus, code, 8, 0, STUB_WAIT, NULL);
+}
+
+/**
+ * bus->driver->(*read_block)
+ *
+ */
+static int
+ejtag_bus_read_block (urj_bus_t *bus, uint32_t adr, uint32_t *data,
+                      uint32_t count)
+{
+    urj_bus_area_t area;
+    uint32_t step, i;
+
+    if (BP->fastdata && count >= FASTDATA_MIN)
+        return ejtag_fastdata_xfer (bus, adr, data, count, 0);
+
+    ejtag_bus_area (bus, adr, &area);
+    step = area.width / 8;
+
+    ejtag_bus_read_start (bus, adr);
+    for (i = 0; i + 1 < count; i++)
+        data[i] = ejtag_bus_read_next (bus, adr + (i + 1) * step);
+    data[i] = ejtag_bus_read_end (bus);
+
+    return URJ_STATUS_OK;
+}
+
+/**
+ * bus->driver->(*write_block)
+ *
+ */
+static int
+ejtag_bus_write_block (urj_bus_t *bus, uint32_t adr, const uint32_t *data,
+                       uint32_t count)
+{
+    urj_bus_area_t area;
+    uint32_t step, i;
+
+    if (BP->fastdata && count >= FASTDATA_MIN)
+        return ejtag_fastdata_xfer (bus, adr, (uint32_t *) data, count, 1);
+
+    ejtag_bus_area (bus, adr, &area);
+    step = area.width / 8;
+
+    for (i = 0; i < count; i++)
+        ejtag_bus_write (bus, adr + i * step, data[i]);
+
+    return URJ_STATUS_OK;
+}
+
 const urj_bus_driver_t urj_bus_ejtag_bus = {
     "ejtag",
-    N_("EJTAG compatible bus driver via PrAcc"),
+    N_("EJTAG compatible bus driver via PrAcc, parameter:\n"
+       "           [workarea=<RAM address for FASTDATA and flash stubs>]"),
     ejtag_bus_new,
     urj_bus_generic_free,
     ejtag_bus_printinfo,
@@ -777,4 +1448,8 @@ const urj_bus_driver_t urj_bus_ejtag_bus = {
     urj_bus_generic_no_enable,
     urj_bus_generic_no_disable,
     URJ_BUS_TYPE_PARALLEL,
+    ejtag_bus_read_block,
+    ejtag_bus_write_block,
+    ejtag_bus_stub_area,
+    ejtag_bus_stub_run,
 };
@@ -51,6 +51,7 @@
 typedef struct
 {
     uint32_t impcode;           /* EJTAG Implementation Register */
+    uint32_t data_read;         /* word read by the last read_start/next */
 } bus_params_t;
 
 #define BP              ((bus_params_t *) bus->params)
@@ -641,7 +642,6 @@ ejtag_dma_bus_read (urj_bus_t *bus, uint32_t adr)
     return data;
 }
 
-static uint32_t _data_read;
 /**
  * bus->driver->(*read_start)
  *
@@ -649,9 +649,9 @@ static uint32_t _data_read;
 static int
 ejtag_dma_bus_read_start (urj_bus_t *bus, uint32_t adr)
 {
-    _data_read = ejtag_dma_read (bus, adr, get_sz (adr));
+    BP->data_read = ejtag_dma_read (bus, adr, get_sz (adr));
     urj_log (URJ_LOG_LEVEL_ALL, "%s:adr=0x%lx, got=0x%lx\n", __func__,
-             (long unsigned) adr, (long unsigned) _data_read);
+             (long unsigned) adr, (long unsigned) BP->data_read);
 
     return URJ_STATUS_OK;
 }
@@ -663,10 +663,10 @@ ejtag_dma_bus_read_start (urj_bus_t *bus, uint32_t adr)
 static uint32_t
 ejtag_dma_bus_read_next (urj_bus_t *bus, uint32_t adr)
 {
-    uint32_t tmp_value = _data_read;
-    _data_read = ejtag_dma_read (bus, adr, get_sz (adr));
+    uint32_t tmp_value = BP->data_read;
+    BP->data_read = ejtag_dma_read (bus, adr, get_sz (adr));
     urj_log (URJ_LOG_LEVEL_ALL, "%s:adr=0x%lx, got=0x%lx\n", __func__,
-             (long unsigned) adr, (long unsigned) _data_read);
+             (long unsigned) adr, (long unsigned) BP->data_read);
     return tmp_value;
 }
 
@@ -677,7 +677,7 @@ ejtag_dma_bus_read_next (urj_bus_t *bus, uint32_t adr)
 static uint32_t
 ejtag_dma_bus_read_end (urj_bus_t *bus)
 {
-    return _data_read;
+    return BP->data_read;
 }
 
 const urj_bus_driver_t urj_bus_ejtag_dma_bus = {
@@ -30,6 +30,7 @@
 #include <urjtag/part.h>
 #include <urjtag/bus.h>
 #include <urjtag/chain.h>
+#include <urjtag/cable.h>
 #include <urjtag/cmd.h>
 #include <urjtag/tap.h>
 #include <urjtag/data_register.h>
@@ -64,6 +65,7 @@ struct block_desc
     uint16_t addr_len;
     uint16_t data_pos;
     uint16_t data_len;
+    int burst;                  /* core implements the burst instructions */
     block_param_t *blocks;
 };
 typedef struct block_desc block_desc_t;
@@ -85,8 +87,8 @@ fjmem_detect_reg_len (urj_chain_t *chain, urj_part_t *part, const char *opcode,
 {
     urj_data_register_t *dr;
     urj_part_instruction_t *i;
+    urj_tap_register_t *ones, *tdo;
     int l, fjmem_reg_len;
-    char *tdo_bit;
 
     /* build register FJMEM_REG with length of 1 bit */
     dr = urj_part_data_register_alloc (FJMEM_REG_NAME, 1);
@@ -137,31 +139,33 @@ fjmem_detect_reg_len (urj_chain_t *chain, urj_part_t *part, const char *opcode,
         return len;
 
     /* now detect the register length of FJMEM_REG:
-       shift 1s through the data register until they appear at TDO
+       shift 1s through the data register and see where they appear at TDO,
+       in one scan that is long enough for the longest register
        NB: We don't shift only through the FJMEM_REG but also through the
        registers of all other parts in the chain. They're set to
        BYPASS hopefully. */
-    fjmem_reg_len = 0;
-    urj_tap_register_fill (dr->in, 1);
-    urj_tap_register_fill (dr->out, 0);
-    tdo_bit = dr->out->data;
-
-    urj_tap_capture_dr (chain);
-    /* read current TDO and then shift once */
-    urj_tap_shift_register (chain, dr->in, dr->out, URJ_CHAIN_EXITMODE_SHIFT);
-    urj_tap_register_get_string (dr->out);
-    while ((tdo_bit[0] == 0) && (fjmem_reg_len < FJMEM_MAX_REG_LEN))
+    ones = urj_tap_register_alloc (FJMEM_MAX_REG_LEN + chain->parts->len);
+    tdo = urj_tap_register_alloc (FJMEM_MAX_REG_LEN + chain->parts->len);
+    if (!ones || !tdo)
     {
-        /* read current TDO and then shift once */
-        urj_tap_shift_register (chain, dr->in, dr->out,
-                                URJ_CHAIN_EXITMODE_SHIFT);
-        tdo_bit = dr->out->data;
-        fjmem_reg_len++;
+        urj_tap_register_free (ones);
+        urj_tap_register_free (tdo);
+        // retain error state
+        return 0;
     }
+    urj_tap_register_fill (ones, 1);
+    urj_tap_register_fill (tdo, 0);
+
+    urj_tap_capture_dr (chain);
+    urj_tap_shift_register (chain, ones, tdo, URJ_CHAIN_EXITMODE_IDLE);
+    for (fjmem_reg_len = 0; fjmem_reg_len < tdo->len; fjmem_reg_len++)
+        if (tdo->data[fjmem_reg_len])
+            break;
+    urj_tap_register_free (ones);
+    urj_tap_register_free (tdo);
+
     /* consider BYPASS register of other parts in the chain */
     fjmem_reg_len -= chain->parts->len - 1;
-    /* shift once more and return to idle state */
-    urj_tap_shift_register (chain, dr->in, NULL, URJ_CHAIN_EXITMODE_IDLE);
     urj_log (URJ_LOG_LEVEL_DEBUG, "FJMEM data register length: %d\n",
              fjmem_reg_len);
 
@@ -211,6 +215,8 @@ fjmem_detect_fields (urj_chain_t *chain, urj_part_t *part, urj_bus_t *bus)
     /* and examine output from field detect */
     urj_log (URJ_LOG_LEVEL_DEBUG, "captured: %s\n",
              urj_tap_register_get_string (dr->out));
+    /* cores with burst mode mark the ack field, older ones leave it 0 */
+    bd->burst = dr->out->data[bd->block_pos - 1];
     /* scan block field */
     idx = bd->block_pos;
     while (dr->out->data[idx] && (idx < dr->out->len))
@@ -233,6 +239,8 @@ fjmem_detect_fields (urj_chain_t *chain, urj_part_t *part, urj_bus_t *bus)
              bd->addr_pos, bd->addr_len);
     urj_log (URJ_LOG_LEVEL_DEBUG, "data  pos: %d, len: %d\n",
              bd->data_pos, bd->data_len);
+    urj_log (URJ_LOG_LEVEL_DEBUG, "burst mode: %s\n",
+             bd->burst ? "yes" : "no");
 
     if ((bd->block_len > 0) && (bd->addr_len > 0) && (bd->data_len > 0))
         return 1;
@@ -249,13 +257,13 @@ fjmem_query_blocks (urj_chain_t *chain, urj_part_t *part, urj_bus_t *bus)
     int failed = 0;
 
     /* the current block number is 0, it has been requested by the previous
-       shift during fjmem_detect_fields */
+       shift during fjmem_detect_fields; each shift returns the answer to the
+       query before it, so all queries go into the cable queue at once */
     max_block_num = (1 << bd->block_len) - 1;
     for (block_num = 0; block_num <= max_block_num; block_num++)
     {
         int next_block_num = block_num + 1;
         int idx;
-        int addr_len, data_len;
 
         /* prepare the next query before shifting the data register */
         for (idx = 0; idx < bd->block_len; idx++)
@@ -263,7 +271,19 @@ fjmem_query_blocks (urj_chain_t *chain, urj_part_t *part, urj_bus_t *bus)
             dr->in->data[bd->block_pos + idx] = next_block_num & 1;
             next_block_num >>= 1;
         }
-        urj_tap_chain_shift_data_registers (chain, 1);
+        urj_tap_chain_defer_shift_data_registers_mode (chain, 1, 1,
+                                                       URJ_CHAIN_EXITMODE_IDLE);
+    }
+
+    for (block_num = 0; block_num <= max_block_num; block_num++)
+    {
+        int addr_len, data_len;
+
+        urj_tap_chain_shift_data_registers_output (chain,
+                                                   URJ_CHAIN_EXITMODE_IDLE);
+        /* the remaining answers still have to be taken from the queue */
+        if (failed)
+            continue;
 
         /* and examine output from block query */
         urj_log (URJ_LOG_LEVEL_DEBUG, "captured: %s\n",
@@ -291,7 +311,7 @@ fjmem_query_blocks (urj_chain_t *chain, urj_part_t *part, urj_bus_t *bus)
                 urj_error_set (URJ_ERROR_OUT_OF_MEMORY, "calloc(%zd,%zd) fails",
                                (size_t) 1, sizeof (urj_bus_t));
                 failed |= 1;
-                break;
+                continue;
             }
 
             bl->next = bd->blocks;
@@ -470,6 +490,9 @@ fjmem_bus_printinfo (urj_log_level_t ll, urj_bus_t *bus)
             break;
     urj_log (ll, _("fjmem FPGA bus driver via USER register (JTAG part No. %d)\n"),
             i);
+    if (BLOCK_DESC.burst)
+        urj_log (ll, _("burst mode, %d bits of data per scan\n"),
+                 BLOCK_DESC.data_len);
 }
 
 /**
@@ -572,21 +595,50 @@ setup_address (urj_bus_t *bus, uint32_t a, block_param_t *block)
     }
 }
 
+/* Word k of a burst goes k data widths up the data field */
 static void
-setup_data (urj_bus_t *bus, uint32_t d, block_param_t *block)
+setup_data (urj_bus_t *bus, int k, uint32_t d, block_param_t *block)
 {
     urj_data_register_t *dr = FJMEM_REG;
     block_desc_t *bd = &(BLOCK_DESC);
+    char *p = dr->in->data + bd->data_pos + k * block->data_width;
     int idx;
 
     /* set data */
     for (idx = 0; idx < block->data_width; idx++)
     {
-        dr->in->data[bd->data_pos + idx] = d & 1;
+        p[idx] = d & 1;
         d >>= 1;
     }
 }
 
+static uint32_t
+get_data (urj_bus_t *bus, int k, block_param_t *block)
+{
+    urj_data_register_t *dr = FJMEM_REG;
+    block_desc_t *bd = &(BLOCK_DESC);
+    const char *p = dr->out->data + bd->data_pos + k * block->data_width;
+    uint32_t d;
+    int idx;
+
+    /* extract data from TDO stream */
+    d = 0;
+    for (idx = 0; idx < block->data_width; idx++)
+        if (p[idx])
+            d |= UINT32_C (1) << idx;
+
+    return d;
+}
+
+/* Words moved per scan of the burst instructions, 0 without burst mode */
+static int
+burst_words (urj_bus_t *bus, block_param_t *block)
+{
+    block_desc_t *bd = &(BLOCK_DESC);
+
+    return bd->burst ? bd->data_len / block->data_width : 0;
+}
+
 /**
  * bus->driver->(*read_start)
  *
@@ -628,12 +680,8 @@ static uint32_t
 fjmem_bus_read_next (urj_bus_t *bus, uint32_t adr)
 {
     urj_chain_t *chain = bus->chain;
-    block_desc_t *bd = &(BLOCK_DESC);
-    urj_data_register_t *dr = FJMEM_REG;
-    uint32_t d;
     urj_bus_area_t area;
     block_param_t *block;
-    int idx;
 
     block_bus_area (bus, adr, &area, &block);
     if (!block)
@@ -646,13 +694,7 @@ fjmem_bus_read_next (urj_bus_t *bus, uint32_t adr)
     setup_address (bus, adr, block);
     urj_tap_chain_shift_data_registers (chain, 1);
 
-    /* extract data from TDO stream */
-    d = 0;
-    for (idx = 0; idx < block->data_width; idx++)
-        if (dr->out->data[bd->data_pos + idx])
-            d |= 1 << idx;
-
-    return d;
+    return get_data (bus, 0, block);
 }
 
 /**
@@ -665,10 +707,8 @@ fjmem_bus_read_end (urj_bus_t *bus)
     urj_chain_t *chain = bus->chain;
     block_desc_t *bd = &(BLOCK_DESC);
     urj_data_register_t *dr = FJMEM_REG;
-    uint32_t d;
     urj_bus_area_t area;
     block_param_t *block;
-    int idx;
 
     block_bus_area (bus, LAST_ADDR, &area, &block);
     if (!block)
@@ -684,13 +724,7 @@ fjmem_bus_read_end (urj_bus_t *bus)
 
     urj_tap_chain_shift_data_registers (chain, 1);
 
-    /* extract data from TDO stream */
-    d = 0;
-    for (idx = 0; idx < block->data_width; idx++)
-        if (dr->out->data[bd->data_pos + idx])
-            d |= 1 << idx;
-
-    return d;
+    return get_data (bus, 0, block);
 }
 
 /**
@@ -714,7 +748,7 @@ fjmem_bus_write (urj_bus_t *bus, uint32_t adr, uint32_t data)
     }
 
     setup_address (bus, adr, block);
-    setup_data (bus, data, block);
+    setup_data (bus, 0, data, block);
 
     /* select write instruction */
     dr->in->data[bd->instr_pos + 0] = 0;
@@ -724,6 +758,143 @@ fjmem_bus_write (urj_bus_t *bus, uint32_t adr, uint32_t data)
     urj_tap_chain_shift_data_registers (chain, 0);
 }
 
+/* Number of words from adr to the end of its block, at most count */
+static uint32_t
+block_words (urj_bus_t *bus, uint32_t adr, uint32_t count,
+             block_param_t *block)
+{
+    uint32_t n = ((block->end - adr) >> block->ashift) + 1;
+
+    return n < count ? n : count;
+}
+
+/**
+ * bus->driver->(*read_block)
+ *
+ */
+static int
+fjmem_bus_read_block (urj_bus_t *bus, uint32_t adr, uint32_t *data,
+                      uint32_t count)
+{
+    urj_chain_t *chain = bus->chain;
+    block_desc_t *bd = &(BLOCK_DESC);
+    urj_data_register_t *dr = FJMEM_REG;
+
+    while (count > 0)
+    {
+        urj_bus_area_t area;
+        block_param_t *block;
+        uint32_t n, i;
+        int per_scan, k;
+
+        block_bus_area (bus, adr, &area, &block);
+        if (!block)
+        {
+            urj_error_set (URJ_ERROR_OUT_OF_BOUNDS, _("Address out of range"));
+            LAST_ADDR = adr;
+            return URJ_STATUS_FAIL;
+        }
+
+        /* whole bursts, the rest of the block word by word */
+        n = block_words (bus, adr, count, block);
+        per_scan = burst_words (bus, block);
+        if (per_scan < 2 || n < per_scan)
+            per_scan = 1;
+        n -= n % per_scan;
+
+        /* select read instruction (001) or burst read instruction (101) */
+        dr->in->data[bd->instr_pos + 0] = 1;
+        dr->in->data[bd->instr_pos + 1] = 0;
+        dr->in->data[bd->instr_pos + 2] = per_scan > 1;
+
+        /* each scan requests the next words and returns those requested by
+           the scan before it, the idle instruction collects the last ones */
+        for (i = 0; i < n; i += per_scan)
+        {
+            setup_address (bus, adr + (i << block->ashift), block);
+            urj_tap_chain_defer_shift_data_registers_mode (chain, 1, 1,
+                                                           URJ_CHAIN_EXITMODE_IDLE);
+        }
+        dr->in->data[bd->instr_pos + 0] = 0;
+        dr->in->data[bd->instr_pos + 1] = 0;
+        dr->in->data[bd->instr_pos + 2] = 0;
+        urj_tap_chain_defer_shift_data_registers_mode (chain, 1, 1,
+                                                       URJ_CHAIN_EXITMODE_IDLE);
+
+        urj_tap_chain_shift_data_registers_output (chain,
+                                                   URJ_CHAIN_EXITMODE_IDLE);
+        for (i = 0; i < n; i += per_scan)
+        {
+            urj_tap_chain_shift_data_registers_output (chain,
+                                                       URJ_CHAIN_EXITMODE_IDLE);
+            for (k = 0; k < per_scan; k++)
+                data[i + k] = get_data (bus, k, block);
+        }
+
+        adr += n << block->ashift;
+        data += n;
+        count -= n;
+    }
+
+    return URJ_STATUS_OK;
+}
+
+/**
+ * bus->driver->(*write_block)
+ *
+ */
+static int
+fjmem_bus_write_block (urj_bus_t *bus, uint32_t adr, const uint32_t *data,
+                       uint32_t count)
+{
+    urj_chain_t *chain = bus->chain;
+    block_desc_t *bd = &(BLOCK_DESC);
+    urj_data_register_t *dr = FJMEM_REG;
+
+    while (count > 0)
+    {
+        urj_bus_area_t area;
+        block_param_t *block;
+        uint32_t n, i;
+        int per_scan, k;
+
+        block_bus_area (bus, adr, &area, &block);
+        if (!block)
+        {
+            urj_error_set (URJ_ERROR_OUT_OF_BOUNDS, _("Address out of range"));
+            return URJ_STATUS_FAIL;
+        }
+
+        n = block_words (bus, adr, count, block);
+        per_scan = burst_words (bus, block);
+        if (per_scan < 2 || n < per_scan)
+            per_scan = 1;
+        n -= n % per_scan;
+
+        /* select write instruction (010) or burst write instruction (011) */
+        dr->in->data[bd->instr_pos + 0] = per_scan > 1;
+        dr->in->data[bd->instr_pos + 1] = 1;
+        dr->in->data[bd->instr_pos + 2] = 0;
+
+        for (i = 0; i < n; i += per_scan)
+        {
+            setup_address (bus, adr + (i << block->ashift), block);
+            for (k = 0; k < per_scan; k++)
+                setup_data (bus, k, data[i + k], block);
+            urj_tap_chain_defer_shift_data_registers_mode (chain, 0, 1,
+                                                           URJ_CHAIN_EXITMODE_IDLE);
+        }
+
+        adr += n << block->ashift;
+        data += n;
+        count -= n;
+    }
+
+    urj_tap_cable_flush (chain->cable, URJ_TAP_CABLE_TO_OUTPUT);
+
+    return URJ_STATUS_OK;
+}
+
 const urj_bus_driver_t urj_bus_fjmem_bus = {
     "fjmem",
     N_("FPGA JTAG memory bus driver via USER register, requires parameters:\n"
@@ -743,4 +914,6 @@ const urj_bus_driver_t urj_bus_fjmem_bus = {
     urj_bus_generic_no_enable,
     urj_bus_generic_no_disable,
     URJ_BUS_TYPE_PARALLEL,
+    fjmem_bus_read_block,
+    fjmem_bus_write_block,
 };
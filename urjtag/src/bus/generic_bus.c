@@ -157,3 +157,25 @@ urj_bus_generic_read (urj_bus_t *bus, uint32_t adr)
     URJ_BUS_READ_START (bus, adr);
     return URJ_BUS_READ_END (bus);
 }
+
+/**
+ * Store words in target memory through the 32-bit area at adr, in one
+ * block transfer if the bus supports it.
+ *
+ * @return URJ_STATUS_OK on success; URJ_STATUS_FAIL if the block transfer
+ *      failed, in which case not all words may have been stored
+ */
+int
+urj_bus_generic_write_words (urj_bus_t *bus, uint32_t adr,
+                             const uint32_t *data, uint32_t count)
+{
+    uint32_t i;
+
+    if (bus->driver->write_block != NULL)
+        return bus->driver->write_block (bus, adr, data, count);
+
+    for (i = 0; i < count; i++)
+        URJ_BUS_WRITE (bus, adr + 4 * i, data[i]);
+
+    return URJ_STATUS_OK;
+}
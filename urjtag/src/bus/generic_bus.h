@@ -42,5 +42,8 @@ int urj_bus_generic_no_disable (urj_bus_t *bus);
 void urj_bus_generic_prepare_extest (urj_bus_t *bus);
 int urj_bus_generic_write_start(urj_bus_t *bus, uint32_t adr);
 uint32_t urj_bus_generic_read (urj_bus_t *bus, uint32_t adr);
+/** @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error */
+int urj_bus_generic_write_words (urj_bus_t *bus, uint32_t adr,
+                                 const uint32_t *data, uint32_t count);
 
 #endif /* URJ_BUS_GENERIC_BUS_H */
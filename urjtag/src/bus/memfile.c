@@ -0,0 +1,801 @@
+/*
+ * $Id$
+ *
+ * Memory image files of readmem and writemem: Intel HEX, Motorola
+ * S-records and ELF, plus mapping of binary images
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ */
+
+#include <sysdep.h>
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <urjtag/log.h>
+#include <urjtag/error.h>
+#include <urjtag/bus.h>
+#include <urjtag/jtag.h>
+
+#include "memfile.h"
+
+/* data bytes per Intel HEX or S-record line */
+#define RECORD_BYTES    16
+/* longest line accepted: 255 data bytes plus framing, in hex */
+#define LINE_MAX_LEN    600
+
+/* ELF constants, see the System V ABI */
+#define EI_NIDENT       16
+#define ELFCLASS32      1
+#define ELFCLASS64      2
+#define ELFDATA2LSB     1
+#define ELFDATA2MSB     2
+#define ET_EXEC         2
+#define PT_LOAD         1
+#define PF_RWX          7
+#define ELF32_EHDR_SIZE 52
+#define ELF32_PHDR_SIZE 32
+#define ELF64_EHDR_SIZE 64
+#define ELF64_PHDR_SIZE 56
+#define ELF32_SHDR_SIZE 40
+#define SHT_PROGBITS    1
+#define SHT_STRTAB      3
+#define SHF_WAX         7
+
+/* section names of the ELF files readmem writes */
+static const char shstrtab[] = "\0.data\0.shstrtab";
+
+static const struct
+{
+    const char *name;
+    urj_bus_memfile_format_t format;
+}
+formats[] = {
+    { "binary", URJ_BUS_MEMFILE_BINARY },
+    { "ihex",   URJ_BUS_MEMFILE_IHEX },
+    { "srec",   URJ_BUS_MEMFILE_SREC },
+    { "elf",    URJ_BUS_MEMFILE_ELF },
+};
+
+int
+urj_bus_memfile_format (const char *name, urj_bus_memfile_format_t *format)
+{
+    size_t i;
+
+    for (i = 0; i < sizeof formats / sizeof formats[0]; i++)
+        if (strcasecmp (name, formats[i].name) == 0)
+        {
+            *format = formats[i].format;
+            return URJ_STATUS_OK;
+        }
+
+    urj_error_set (URJ_ERROR_INVALID,
+                   _("unknown file format '%s' (binary, ihex, srec, elf)"),
+                   name);
+    return URJ_STATUS_FAIL;
+}
+
+/*
+ * Mapping
+ */
+
+int
+urj_bus_memfile_map (FILE *f, uint64_t offset, size_t len, int writable,
+                     urj_bus_memfile_map_t *map)
+{
+#ifdef HAVE_SYS_MMAN_H
+    struct stat st;
+    long page = sysconf (_SC_PAGESIZE);
+    uint64_t base;
+    void *p;
+    int fd;
+
+    if (len == 0 || page <= 0 || fflush (f) != 0)
+        return URJ_STATUS_FAIL;
+
+    fd = fileno (f);
+    if (fd < 0 || fstat (fd, &st) != 0 || !S_ISREG (st.st_mode))
+        return URJ_STATUS_FAIL;
+    if ((uint64_t) st.st_size < offset + len)
+    {
+        if (!writable || ftruncate (fd, offset + len) != 0)
+            return URJ_STATUS_FAIL;
+    }
+
+    base = offset - offset % page;
+    p = mmap (NULL, offset - base + len,
+              writable ? PROT_READ | PROT_WRITE : PROT_READ,
+              writable ? MAP_SHARED : MAP_PRIVATE, fd, base);
+    if (p == MAP_FAILED)
+        return URJ_STATUS_FAIL;
+
+    map->base = p;
+    map->size = offset - base + len;
+    map->data = (uint8_t *) p + (offset - base);
+
+    return URJ_STATUS_OK;
+#else
+    return URJ_STATUS_FAIL;
+#endif
+}
+
+void
+urj_bus_memfile_unmap (urj_bus_memfile_map_t *map)
+{
+#ifdef HAVE_SYS_MMAN_H
+    munmap (map->base, map->size);
+#endif
+    map->base = NULL;
+}
+
+/*
+ * Writing
+ */
+
+static int
+put_line (urj_bus_memfile_out_t *out, const char *line)
+{
+    if (fputs (line, out->f) == EOF)
+    {
+        urj_error_set (URJ_ERROR_FILEIO, "fputs fails");
+        urj_error_state.sys_errno = ferror (out->f);
+        clearerr (out->f);
+        return URJ_STATUS_FAIL;
+    }
+    return URJ_STATUS_OK;
+}
+
+/* One Intel HEX record; the checksum makes all bytes sum up to 0 */
+static int
+put_ihex (urj_bus_memfile_out_t *out, int type, uint32_t addr,
+          const uint8_t *buf, uint32_t len)
+{
+    char line[LINE_MAX_LEN], *p = line;
+    uint8_t sum = len + (addr >> 8) + addr + type;
+    uint32_t i;
+
+    p += sprintf (p, ":%02X%04X%02X", (unsigned) len,
+                  (unsigned) (addr & 0xFFFF), (unsigned) type);
+    for (i = 0; i < len; i++)
+    {
+        p += sprintf (p, "%02X", buf[i]);
+        sum += buf[i];
+    }
+    sprintf (p, "%02X\n", (uint8_t) -sum);
+
+    return put_line (out, line);
+}
+
+/* One S-record; the checksum is the complement of the sum of all bytes */
+static int
+put_srec (urj_bus_memfile_out_t *out, int type, uint32_t addr,
+          const uint8_t *buf, uint32_t len)
+{
+    char line[LINE_MAX_LEN], *p = line;
+    int addr_bytes = type == 0 || type == 1 || type == 9 ? 2
+        : type == 2 || type == 8 ? 3 : 4;
+    uint8_t sum = addr_bytes + len + 1;
+    uint32_t i;
+    int j;
+
+    p += sprintf (p, "S%d%02X", type, (unsigned) (addr_bytes + len + 1));
+    for (j = addr_bytes - 1; j >= 0; j--)
+    {
+        p += sprintf (p, "%02X", (unsigned) ((addr >> (8 * j)) & 0xFF));
+        sum += addr >> (8 * j);
+    }
+    for (i = 0; i < len; i++)
+    {
+        p += sprintf (p, "%02X", buf[i]);
+        sum += buf[i];
+    }
+    sprintf (p, "%02X\n", (uint8_t) ~sum);
+
+    return put_line (out, line);
+}
+
+static void
+set_elf (uint8_t *p, uint64_t v, int bytes, int big)
+{
+    int j;
+
+    for (j = 0; j < bytes; j++, v >>= 8)
+        p[big ? bytes - 1 - j : j] = v & 0xFF;
+}
+
+static int
+put_bytes (urj_bus_memfile_out_t *out, const void *buf, size_t len)
+{
+    if (fwrite (buf, len, 1, out->f) != 1)
+    {
+        urj_error_set (URJ_ERROR_FILEIO, "fwrite fails");
+        urj_error_state.sys_errno = ferror (out->f);
+        clearerr (out->f);
+        return URJ_STATUS_FAIL;
+    }
+    return URJ_STATUS_OK;
+}
+
+/* Where the section headers go: after the data and the name table */
+static uint32_t
+elf_shoff (uint32_t len)
+{
+    return (ELF32_EHDR_SIZE + ELF32_PHDR_SIZE + len + sizeof shstrtab + 3)
+        & ~3;
+}
+
+/* An ELF32 executable with the image as its one loadable segment, the
+ * .data section; the section headers follow the data */
+static int
+put_elf_header (urj_bus_memfile_out_t *out, uint32_t addr, uint32_t len)
+{
+    uint8_t h[ELF32_EHDR_SIZE + ELF32_PHDR_SIZE];
+    uint8_t *ph = h + ELF32_EHDR_SIZE;
+    int big = urj_get_file_endian () == URJ_ENDIAN_BIG;
+
+    memset (h, 0, sizeof h);
+    memcpy (h, "\177ELF", 4);
+    h[4] = ELFCLASS32;
+    h[5] = big ? ELFDATA2MSB : ELFDATA2LSB;
+    h[6] = 1;                                   /* EV_CURRENT */
+    set_elf (h + 16, ET_EXEC, 2, big);          /* e_type */
+    set_elf (h + 20, 1, 4, big);                /* e_version */
+    set_elf (h + 24, addr, 4, big);             /* e_entry */
+    set_elf (h + 28, ELF32_EHDR_SIZE, 4, big);  /* e_phoff */
+    set_elf (h + 32, elf_shoff (len), 4, big);  /* e_shoff */
+    set_elf (h + 40, ELF32_EHDR_SIZE, 2, big);  /* e_ehsize */
+    set_elf (h + 42, ELF32_PHDR_SIZE, 2, big);  /* e_phentsize */
+    set_elf (h + 44, 1, 2, big);                /* e_phnum */
+    set_elf (h + 46, ELF32_SHDR_SIZE, 2, big);  /* e_shentsize */
+    set_elf (h + 48, 3, 2, big);                /* e_shnum */
+    set_elf (h + 50, 2, 2, big);                /* e_shstrndx */
+
+    set_elf (ph + 0, PT_LOAD, 4, big);          /* p_type */
+    set_elf (ph + 4, sizeof h, 4, big);         /* p_offset */
+    set_elf (ph + 8, addr, 4, big);             /* p_vaddr */
+    set_elf (ph + 12, addr, 4, big);            /* p_paddr */
+    set_elf (ph + 16, len, 4, big);             /* p_filesz */
+    set_elf (ph + 20, len, 4, big);             /* p_memsz */
+    set_elf (ph + 24, PF_RWX, 4, big);          /* p_flags */
+    set_elf (ph + 28, 1, 4, big);               /* p_align */
+
+    return put_bytes (out, h, sizeof h);
+}
+
+/* The section name table and the null, .data and .shstrtab headers */
+static int
+put_elf_sections (urj_bus_memfile_out_t *out)
+{
+    uint8_t sh[sizeof shstrtab + 3 + 3 * ELF32_SHDR_SIZE];
+    uint32_t data = ELF32_EHDR_SIZE + ELF32_PHDR_SIZE;
+    uint32_t names = data + out->len;
+    uint32_t pad = elf_shoff (out->len) - names - sizeof shstrtab;
+    uint8_t *p = sh + sizeof shstrtab + pad;
+    int big = urj_get_file_endian () == URJ_ENDIAN_BIG;
+
+    memset (sh, 0, sizeof sh);
+    memcpy (sh, shstrtab, sizeof shstrtab);
+
+    p += ELF32_SHDR_SIZE;
+    set_elf (p + 0, 1, 4, big);                 /* sh_name ".data" */
+    set_elf (p + 4, SHT_PROGBITS, 4, big);      /* sh_type */
+    set_elf (p + 8, SHF_WAX, 4, big);           /* sh_flags */
+    set_elf (p + 12, out->start, 4, big);       /* sh_addr */
+    set_elf (p + 16, data, 4, big);             /* sh_offset */
+    set_elf (p + 20, out->len, 4, big);         /* sh_size */
+    set_elf (p + 32, 1, 4, big);                /* sh_addralign */
+
+    p += ELF32_SHDR_SIZE;
+    set_elf (p + 0, 7, 4, big);                 /* sh_name ".shstrtab" */
+    set_elf (p + 4, SHT_STRTAB, 4, big);
+    set_elf (p + 16, names, 4, big);
+    set_elf (p + 20, sizeof shstrtab, 4, big);
+    set_elf (p + 32, 1, 4, big);
+
+    return put_bytes (out, sh, p + ELF32_SHDR_SIZE - sh);
+}
+
+int
+urj_bus_memfile_begin (urj_bus_memfile_out_t *out, FILE *f,
+                       urj_bus_memfile_format_t format, uint32_t addr,
+                       uint32_t len)
+{
+    uint64_t last = (uint64_t) addr + len - 1;
+
+    out->f = f;
+    out->format = format;
+    out->upper = 0;
+    out->announced = 0;
+    out->start = addr;
+    out->len = len;
+    out->addr_bytes = last <= 0xFFFF ? 2 : last <= 0xFFFFFF ? 3 : 4;
+
+    switch (format)
+    {
+    case URJ_BUS_MEMFILE_SREC:
+        return put_srec (out, 0, 0, (const uint8_t *) "urjtag", 6);
+    case URJ_BUS_MEMFILE_ELF:
+        return put_elf_header (out, addr, len);
+    default:
+        return URJ_STATUS_OK;
+    }
+}
+
+int
+urj_bus_memfile_put (urj_bus_memfile_out_t *out, uint32_t addr,
+                     const uint8_t *buf, uint32_t len)
+{
+    uint32_t n;
+
+    if (out->format == URJ_BUS_MEMFILE_ELF)
+        return put_bytes (out, buf, len);
+
+    for (; len > 0; addr += n, buf += n, len -= n)
+    {
+        n = len > RECORD_BYTES ? RECORD_BYTES : len;
+
+        if (out->format == URJ_BUS_MEMFILE_IHEX)
+        {
+            uint8_t upper[2];
+
+            /* records do not cross a 64 KiB boundary */
+            if (n > 0x10000 - (addr & 0xFFFF))
+                n = 0x10000 - (addr & 0xFFFF);
+            if (!out->announced || out->upper != addr >> 16)
+            {
+                out->upper = addr >> 16;
+                out->announced = 1;
+                upper[0] = out->upper >> 8;
+                upper[1] = out->upper;
+                if (put_ihex (out, 4, 0, upper, 2) != URJ_STATUS_OK)
+                    return URJ_STATUS_FAIL;
+            }
+            if (put_ihex (out, 0, addr, buf, n) != URJ_STATUS_OK)
+                return URJ_STATUS_FAIL;
+        }
+        else if (put_srec (out, out->addr_bytes - 1, addr, buf, n)
+                 != URJ_STATUS_OK)
+            return URJ_STATUS_FAIL;
+    }
+
+    return URJ_STATUS_OK;
+}
+
+int
+urj_bus_memfile_end (urj_bus_memfile_out_t *out)
+{
+    switch (out->format)
+    {
+    case URJ_BUS_MEMFILE_IHEX:
+        return put_ihex (out, 1, 0, NULL, 0);
+    case URJ_BUS_MEMFILE_SREC:
+        /* S9, S8 or S7 for 2, 3 or 4 address bytes */
+        return put_srec (out, 11 - out->addr_bytes, out->start, NULL, 0);
+    case URJ_BUS_MEMFILE_ELF:
+        return put_elf_sections (out);
+    default:
+        return URJ_STATUS_OK;
+    }
+}
+
+/*
+ * Reading
+ */
+
+/* Contiguous data collected from the records of a text file */
+typedef struct
+{
+    uint32_t addr;
+    uint32_t len;
+    uint8_t *buf;
+    urj_bus_memfile_region_t region;
+    void *data;
+} run_t;
+
+static int
+run_flush (run_t *run)
+{
+    int r = URJ_STATUS_OK;
+
+    if (run->len > 0)
+        r = run->region (run->data, run->addr, run->buf, run->len);
+    run->len = 0;
+    return r;
+}
+
+static int
+run_add (run_t *run, uint32_t addr, const uint8_t *buf, uint32_t len)
+{
+    if (run->len > 0 && (addr != run->addr + run->len
+                         || run->len + len > URJ_BUS_MEMFILE_CHUNK))
+        if (run_flush (run) != URJ_STATUS_OK)
+            return URJ_STATUS_FAIL;
+    if (run->len == 0)
+        run->addr = addr;
+    memcpy (run->buf + run->len, buf, len);
+    run->len += len;
+    return URJ_STATUS_OK;
+}
+
+static int
+hex_value (int c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    c = tolower (c);
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+/* Decode the hex pairs of a record; @return the number of bytes or -1 */
+static int
+hex_bytes (const char *s, uint8_t *buf, int max)
+{
+    int n = 0;
+
+    while (*s != '\0' && !isspace ((unsigned char) *s))
+    {
+        int hi = hex_value (s[0]);
+        int lo = hi < 0 ? -1 : hex_value (s[1]);
+
+        if (lo < 0 || n == max)
+            return -1;
+        buf[n++] = hi << 4 | lo;
+        s += 2;
+    }
+    return n;
+}
+
+/* Next non-empty line into line[]; @return 1, 0 at the end, -1 on error */
+static int
+get_line (FILE *f, char *line, int *lineno)
+{
+    size_t l;
+
+    for (;;)
+    {
+        if (fgets (line, LINE_MAX_LEN, f) == NULL)
+        {
+            if (ferror (f))
+            {
+                urj_error_set (URJ_ERROR_FILEIO, "fgets fails");
+                urj_error_state.sys_errno = ferror (f);
+                clearerr (f);
+                return -1;
+            }
+            return 0;
+        }
+        ++*lineno;
+        l = strlen (line);
+        if (l == LINE_MAX_LEN - 1 && line[l - 1] != '\n')
+        {
+            urj_error_set (URJ_ERROR_INVALID, _("line %d: too long"),
+                           *lineno);
+            return -1;
+        }
+        while (l > 0 && isspace ((unsigned char) line[l - 1]))
+            line[--l] = '\0';
+        if (l > 0)
+            return 1;
+    }
+}
+
+static int
+load_ihex (FILE *f, run_t *run)
+{
+    char line[LINE_MAX_LEN];
+    uint8_t b[LINE_MAX_LEN / 2];
+    uint32_t base = 0;
+    int lineno = 0;
+    int r, n, i;
+
+    while ((r = get_line (f, line, &lineno)) > 0)
+    {
+        uint8_t sum = 0;
+
+        n = line[0] == ':' ? hex_bytes (line + 1, b, sizeof b) : -1;
+        if (n < 5 || n != b[0] + 5)
+        {
+            urj_error_set (URJ_ERROR_INVALID,
+                           _("line %d: not an Intel HEX record"), lineno);
+            return URJ_STATUS_FAIL;
+        }
+        for (i = 0; i < n; i++)
+            sum += b[i];
+        if (sum != 0)
+        {
+            urj_error_set (URJ_ERROR_INVALID, _("line %d: bad checksum"),
+                           lineno);
+            return URJ_STATUS_FAIL;
+        }
+
+        switch (b[3])
+        {
+        case 0:                 /* data */
+            if (run_add (run, base + (b[1] << 8 | b[2]), b + 4, b[0])
+                != URJ_STATUS_OK)
+                return URJ_STATUS_FAIL;
+            break;
+        case 1:                 /* end of file */
+            return run_flush (run);
+        case 2:                 /* extended segment address */
+        case 4:                 /* extended linear address */
+            if (b[0] != 2)
+            {
+                urj_error_set (URJ_ERROR_INVALID,
+                               _("line %d: bad address record"), lineno);
+                return URJ_STATUS_FAIL;
+            }
+            base = (uint32_t) (b[4] << 8 | b[5]) << (b[3] == 2 ? 4 : 16);
+            break;
+        case 3:                 /* start addresses */
+        case 5:
+            break;
+        default:
+            urj_error_set (URJ_ERROR_INVALID,
+                           _("line %d: unknown record type %d"), lineno,
+                           b[3]);
+            return URJ_STATUS_FAIL;
+        }
+    }
+
+    return r < 0 ? URJ_STATUS_FAIL : run_flush (run);
+}
+
+static int
+load_srec (FILE *f, run_t *run)
+{
+    char line[LINE_MAX_LEN];
+    uint8_t b[LINE_MAX_LEN / 2];
+    int lineno = 0;
+    int r, n, i, type, addr_bytes;
+
+    while ((r = get_line (f, line, &lineno)) > 0)
+    {
+        uint8_t sum = 0;
+        uint32_t addr = 0;
+
+        type = line[0] == 'S' ? hex_value (line[1]) : -1;
+        n = type >= 0 ? hex_bytes (line + 2, b, sizeof b) : -1;
+        if (n < 1 || n != b[0] + 1)
+        {
+            urj_error_set (URJ_ERROR_INVALID,
+                           _("line %d: not an S-record"), lineno);
+            return URJ_STATUS_FAIL;
+        }
+        for (i = 0; i < n; i++)
+            sum += b[i];
+        if (sum != 0xFF)
+        {
+            urj_error_set (URJ_ERROR_INVALID, _("line %d: bad checksum"),
+                           lineno);
+            return URJ_STATUS_FAIL;
+        }
+
+        switch (type)
+        {
+        case 1:
+        case 2:
+        case 3:                 /* data with 2, 3 or 4 address bytes */
+            addr_bytes = type + 1;
+            if (n < addr_bytes + 2)
+            {
+                urj_error_set (URJ_ERROR_INVALID,
+                               _("line %d: short record"), lineno);
+                return URJ_STATUS_FAIL;
+            }
+            for (i = 0; i < addr_bytes; i++)
+                addr = addr << 8 | b[1 + i];
+            if (run_add (run, addr, b + 1 + addr_bytes,
+                         n - addr_bytes - 2) != URJ_STATUS_OK)
+                return URJ_STATUS_FAIL;
+            break;
+        case 7:
+        case 8:
+        case 9:                 /* termination */
+            return run_flush (run);
+        case 0:                 /* header */
+        case 5:
+        case 6:                 /* record counts */
+            break;
+        default:
+            urj_error_set (URJ_ERROR_INVALID,
+                           _("line %d: unknown record type S%d"), lineno,
+                           type);
+            return URJ_STATUS_FAIL;
+        }
+    }
+
+    return r < 0 ? URJ_STATUS_FAIL : run_flush (run);
+}
+
+static uint64_t
+get_elf (const uint8_t *p, int bytes, int big)
+{
+    uint64_t v = 0;
+    int j;
+
+    for (j = 0; j < bytes; j++)
+        v = v << 8 | p[big ? j : bytes - 1 - j];
+    return v;
+}
+
+static int
+read_at (FILE *f, uint64_t offset, void *buf, size_t len)
+{
+    if (fseek (f, offset, SEEK_SET) != 0 || fread (buf, len, 1, f) != 1)
+    {
+        urj_error_set (URJ_ERROR_INVALID, _("ELF file truncated"));
+        return URJ_STATUS_FAIL;
+    }
+    return URJ_STATUS_OK;
+}
+
+/* Pass the file content of a segment to the region callback, mapped if
+ * possible and in chunks through @buf otherwise */
+static int
+load_segment (FILE *f, uint64_t offset, uint32_t addr, uint32_t len,
+              run_t *run)
+{
+    urj_bus_memfile_map_t map;
+    uint32_t n;
+    int r;
+
+    if (urj_bus_memfile_map (f, offset, len, 0, &map) == URJ_STATUS_OK)
+    {
+        r = run->region (run->data, addr, map.data, len);
+        urj_bus_memfile_unmap (&map);
+        return r;
+    }
+
+    for (; len > 0; offset += n, addr += n, len -= n)
+    {
+        n = len > URJ_BUS_MEMFILE_CHUNK ? URJ_BUS_MEMFILE_CHUNK : len;
+        if (read_at (f, offset, run->buf, n) != URJ_STATUS_OK
+            || run->region (run->data, addr, run->buf, n) != URJ_STATUS_OK)
+            return URJ_STATUS_FAIL;
+    }
+    return URJ_STATUS_OK;
+}
+
+/* The file content of each PT_LOAD segment goes to its physical address */
+static int
+load_elf (FILE *f, run_t *run)
+{
+    uint8_t h[ELF64_EHDR_SIZE], ph[ELF64_PHDR_SIZE];
+    uint64_t phoff, offset, paddr, filesz;
+    int phentsize, phnum, is64, big, i, segments = 0;
+
+    if (read_at (f, 0, h, EI_NIDENT) != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+    if (memcmp (h, "\177ELF", 4) != 0
+        || (h[4] != ELFCLASS32 && h[4] != ELFCLASS64)
+        || (h[5] != ELFDATA2LSB && h[5] != ELFDATA2MSB))
+    {
+        urj_error_set (URJ_ERROR_INVALID, _("not an ELF file"));
+        return URJ_STATUS_FAIL;
+    }
+    is64 = h[4] == ELFCLASS64;
+    big = h[5] == ELFDATA2MSB;
+
+    if (read_at (f, 0, h, is64 ? ELF64_EHDR_SIZE : ELF32_EHDR_SIZE)
+        != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+    phoff = is64 ? get_elf (h + 32, 8, big) : get_elf (h + 28, 4, big);
+    phentsize = get_elf (h + (is64 ? 54 : 42), 2, big);
+    phnum = get_elf (h + (is64 ? 56 : 44), 2, big);
+    if (phnum > 0 && phentsize < (is64 ? ELF64_PHDR_SIZE : ELF32_PHDR_SIZE))
+    {
+        urj_error_set (URJ_ERROR_INVALID, _("bad ELF program header size"));
+        return URJ_STATUS_FAIL;
+    }
+
+    for (i = 0; i < phnum; i++)
+    {
+        if (read_at (f, phoff + (uint64_t) i * phentsize, ph,
+                     is64 ? ELF64_PHDR_SIZE : ELF32_PHDR_SIZE)
+            != URJ_STATUS_OK)
+            return URJ_STATUS_FAIL;
+        if (get_elf (ph, 4, big) != PT_LOAD)
+            continue;
+        if (is64)
+        {
+            offset = get_elf (ph + 8, 8, big);
+            paddr = get_elf (ph + 24, 8, big);
+            filesz = get_elf (ph + 32, 8, big);
+        }
+        else
+        {
+            offset = get_elf (ph + 4, 4, big);
+            paddr = get_elf (ph + 12, 4, big);
+            filesz = get_elf (ph + 16, 4, big);
+        }
+        if (filesz == 0)
+            continue;
+        /* no wrap of paddr + filesz, and a length that fits a uint32_t */
+        if (paddr > UINT64_C (0xFFFFFFFF)
+            || filesz > UINT64_C (0x100000000) - paddr
+            || filesz > UINT64_C (0xFFFFFFFF))
+        {
+            urj_error_set (URJ_ERROR_OUT_OF_BOUNDS,
+                           _("ELF segment at 0x%llX beyond 32 bit addresses"),
+                           (long long unsigned) paddr);
+            return URJ_STATUS_FAIL;
+        }
+
+        urj_log (URJ_LOG_LEVEL_NORMAL,
+                 _("segment: 0x%08lX, 0x%08lX bytes\n"),
+                 (long unsigned) paddr, (long unsigned) filesz);
+        if (load_segment (f, offset, paddr, filesz, run) != URJ_STATUS_OK)
+            return URJ_STATUS_FAIL;
+        segments++;
+    }
+
+    if (segments == 0)
+        urj_warning (_("ELF file has no loadable data\n"));
+
+    return URJ_STATUS_OK;
+}
+
+int
+urj_bus_memfile_load (FILE *f, urj_bus_memfile_format_t format,
+                      urj_bus_memfile_region_t region, void *data)
+{
+    run_t run;
+    int r;
+
+    run.len = 0;
+    run.region = region;
+    run.data = data;
+    run.buf = malloc (URJ_BUS_MEMFILE_CHUNK);
+    if (run.buf == NULL)
+    {
+        urj_error_set (URJ_ERROR_OUT_OF_MEMORY, "malloc(%zd) fails",
+                       (size_t) URJ_BUS_MEMFILE_CHUNK);
+        return URJ_STATUS_FAIL;
+    }
+
+    switch (format)
+    {
+    case URJ_BUS_MEMFILE_IHEX:
+        r = load_ihex (f, &run);
+        break;
+    case URJ_BUS_MEMFILE_SREC:
+        r = load_srec (f, &run);
+        break;
+    case URJ_BUS_MEMFILE_ELF:
+        r = load_elf (f, &run);
+        break;
+    default:
+        urj_error_set (URJ_ERROR_INVALID, _("not an address-carrying format"));
+        r = URJ_STATUS_FAIL;
+        break;
+    }
+
+    free (run.buf);
+    return r;
+}
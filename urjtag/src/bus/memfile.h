@@ -0,0 +1,89 @@
+/*
+ * $Id$
+ *
+ * Memory image files of readmem and writemem
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ */
+
+#ifndef URJ_BUS_MEMFILE_H
+#define URJ_BUS_MEMFILE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include <urjtag/bus.h>
+
+/* bytes moved between file and bus per step of the progress display */
+#define URJ_BUS_MEMFILE_CHUNK   0x10000
+
+/* A range of a file mapped into memory */
+typedef struct
+{
+    void *base;
+    size_t size;
+    uint8_t *data;              /* the requested range within base */
+} urj_bus_memfile_map_t;
+
+/**
+ * Map @len bytes of @f from @offset, growing the file when @writable.
+ * Failing is no error: the caller then falls back to stdio.
+ *
+ * @return URJ_STATUS_OK when mapped; URJ_STATUS_FAIL otherwise
+ */
+int urj_bus_memfile_map (FILE *f, uint64_t offset, size_t len, int writable,
+                         urj_bus_memfile_map_t *map);
+void urj_bus_memfile_unmap (urj_bus_memfile_map_t *map);
+
+/* Writer of the address-carrying formats */
+typedef struct
+{
+    FILE *f;
+    urj_bus_memfile_format_t format;
+    uint32_t upper;             /* ihex: upper address half announced */
+    int announced;
+    int addr_bytes;             /* srec: 2, 3 or 4 */
+    uint32_t start;
+    uint32_t len;
+} urj_bus_memfile_out_t;
+
+/** @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error */
+int urj_bus_memfile_begin (urj_bus_memfile_out_t *out, FILE *f,
+                           urj_bus_memfile_format_t format, uint32_t addr,
+                           uint32_t len);
+/** @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error */
+int urj_bus_memfile_put (urj_bus_memfile_out_t *out, uint32_t addr,
+                         const uint8_t *buf, uint32_t len);
+/** @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error */
+int urj_bus_memfile_end (urj_bus_memfile_out_t *out);
+
+/** Called with each contiguous run of data found in a file */
+typedef int (*urj_bus_memfile_region_t) (void *data, uint32_t addr,
+                                         const uint8_t *buf, uint32_t len);
+
+/**
+ * Parse an Intel HEX, S-record or ELF file and pass its data to @region
+ * in runs of contiguous addresses.
+ *
+ * @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on a malformed file or
+ *      when @region fails
+ */
+int urj_bus_memfile_load (FILE *f, urj_bus_memfile_format_t format,
+                          urj_bus_memfile_region_t region, void *data);
+
+#endif /* URJ_BUS_MEMFILE_H */
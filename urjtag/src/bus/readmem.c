@@ -29,6 +29,7 @@
 #include <sysdep.h>
 
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <urjtag/log.h>
@@ -37,16 +38,297 @@
 #include <urjtag/flash.h>
 #include <urjtag/jtag.h>
 
+#include "memfile.h"
+
+/* words per call of the driver's read_block */
+#define BLOCK_WORDS 1024
+
+/* CRC-32 as in zlib and IEEE 802.3, reflected */
+#define CRC32_POLY  UINT32_C (0xEDB88320)
+/* words per run of a target stub computing it */
+#define CRC_WORDS   (1 << 16)
+
+static void
+unpack_word (uint8_t *buf, uint32_t data, uint32_t step, int big)
+{
+    int j;
+
+    if (big)
+        for (j = step - 1; j >= 0; j--, data >>= 8)
+            buf[j] = data & 0xFF;
+    else
+        for (j = 0; j < step; j++, data >>= 8)
+            buf[j] = data & 0xFF;
+}
+
+/* The byte order is decided once per block, not per byte */
+static void
+unpack_words (uint8_t *buf, const uint32_t *words, uint32_t count,
+              uint32_t step, int big)
+{
+    uint32_t k;
+
+    switch (step << 1 | big)
+    {
+    case 2:
+    case 3:
+        for (k = 0; k < count; k++)
+            buf[k] = words[k];
+        break;
+    case 4:
+        for (k = 0; k < count; k++, buf += 2)
+        {
+            buf[0] = words[k];
+            buf[1] = words[k] >> 8;
+        }
+        break;
+    case 5:
+        for (k = 0; k < count; k++, buf += 2)
+        {
+            buf[0] = words[k] >> 8;
+            buf[1] = words[k];
+        }
+        break;
+    case 8:
+        for (k = 0; k < count; k++, buf += 4)
+        {
+            buf[0] = words[k];
+            buf[1] = words[k] >> 8;
+            buf[2] = words[k] >> 16;
+            buf[3] = words[k] >> 24;
+        }
+        break;
+    case 9:
+        for (k = 0; k < count; k++, buf += 4)
+        {
+            buf[0] = words[k] >> 24;
+            buf[1] = words[k] >> 16;
+            buf[2] = words[k] >> 8;
+            buf[3] = words[k];
+        }
+        break;
+    default:
+        for (k = 0; k < count; k++)
+            unpack_word (buf + k * step, words[k], step, big);
+        break;
+    }
+}
+
 int
-urj_bus_readmem (urj_bus_t *bus, FILE *f, uint32_t addr, uint32_t len)
+urj_bus_read_block (urj_bus_t *bus, uint32_t addr, uint8_t *buf,
+                    uint32_t len)
+{
+    uint32_t step;
+    uint32_t i;
+    urj_bus_area_t area;
+    int big;
+
+    if (!bus)
+    {
+        urj_error_set (URJ_ERROR_NO_BUS_DRIVER, _("Missing bus driver"));
+        return URJ_STATUS_FAIL;
+    }
+
+    URJ_BUS_PREPARE (bus);
+
+    if (URJ_BUS_AREA (bus, addr, &area) != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+
+    step = area.width / 8;
+
+    if (step == 0)
+    {
+        urj_error_set (URJ_ERROR_INVALID,  _("Unknown bus width"));
+        return URJ_STATUS_FAIL;
+    }
+    if ((addr | len) & (step - 1))
+    {
+        urj_error_set (URJ_ERROR_INVALID,
+                       _("address 0x%08lX and length 0x%lX must be multiples of the bus width (%lu bytes)"),
+                       (long unsigned) addr, (long unsigned) len,
+                       (long unsigned) step);
+        return URJ_STATUS_FAIL;
+    }
+    if (len == 0)
+        return URJ_STATUS_OK;
+
+    big = urj_get_file_endian () == URJ_ENDIAN_BIG;
+
+    if (bus->driver->read_block)
+    {
+        uint32_t words[BLOCK_WORDS];
+        uint32_t count;
+
+        for (i = 0; i < len; i += count * step)
+        {
+            count = (len - i) / step;
+            if (count > BLOCK_WORDS)
+                count = BLOCK_WORDS;
+
+            if (bus->driver->read_block (bus, addr + i, words, count)
+                != URJ_STATUS_OK)
+                return URJ_STATUS_FAIL;
+
+            unpack_words (buf + i, words, count, step, big);
+        }
+
+        return URJ_STATUS_OK;
+    }
+
+    if (URJ_BUS_READ_START (bus, addr) != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+
+    for (i = 0; i < len; i += step)
+    {
+        uint32_t data;
+
+        if (i + step < len)
+            data = URJ_BUS_READ_NEXT (bus, addr + i + step);
+        else
+            data = URJ_BUS_READ_END (bus);
+
+        unpack_word (buf + i, data, step, big);
+    }
+
+    return URJ_STATUS_OK;
+}
+
+uint32_t
+urj_bus_crc32_word (uint32_t crc, uint32_t data, uint32_t width)
+{
+    uint32_t i;
+
+    crc = ~crc;
+    for (i = 0; i < 8 * width; i++, data >>= 1)
+        crc = (crc >> 1) ^ (((crc ^ data) & 1) ? CRC32_POLY : 0);
+
+    return ~crc;
+}
+
+/* Let a flash stub on the target sum up the words */
+static int
+crc32_stub (urj_bus_t *bus, uint32_t area, uint32_t addr, uint32_t count,
+            uint32_t step, uint32_t *crc)
+{
+    uint32_t mailbox[URJ_BUS_STUB_MB_WORDS];
+    uint32_t n;
+
+    memset (mailbox, 0, sizeof mailbox);
+    mailbox[URJ_BUS_STUB_MB_WRITE / 4] = URJ_BUS_STUB_CRC;
+    mailbox[URJ_BUS_STUB_MB_SMASK / 4] = CRC32_POLY;
+
+    for (; count > 0; count -= n, addr += n * step)
+    {
+        n = count > CRC_WORDS ? CRC_WORDS : count;
+
+        mailbox[URJ_BUS_STUB_MB_DST / 4] = addr;
+        mailbox[URJ_BUS_STUB_MB_COUNT / 4] = n;
+        mailbox[URJ_BUS_STUB_MB_EMASK / 4] = ~*crc;
+        if (bus->driver->stub_run (bus, mailbox, step) != URJ_STATUS_OK)
+            return URJ_STATUS_FAIL;
+
+        *crc = ~URJ_BUS_READ (bus, area + URJ_BUS_STUB_MAILBOX
+                              + URJ_BUS_STUB_MB_STATUS);
+    }
+
+    return URJ_STATUS_OK;
+}
+
+int
+urj_bus_crc32 (urj_bus_t *bus, uint32_t addr, uint32_t len, uint32_t *crc)
+{
+    uint32_t step;
+    uint32_t i;
+    uint32_t area_adr;
+    urj_bus_area_t area;
+
+    if (!bus)
+    {
+        urj_error_set (URJ_ERROR_NO_BUS_DRIVER, _("Missing bus driver"));
+        return URJ_STATUS_FAIL;
+    }
+
+    URJ_BUS_PREPARE (bus);
+
+    if (URJ_BUS_AREA (bus, addr, &area) != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+
+    step = area.width / 8;
+
+    if (step == 0)
+    {
+        urj_error_set (URJ_ERROR_INVALID,  _("Unknown bus width"));
+        return URJ_STATUS_FAIL;
+    }
+    if ((addr | len) & (step - 1))
+    {
+        urj_error_set (URJ_ERROR_INVALID,
+                       _("address 0x%08lX and length 0x%lX must be multiples of the bus width (%lu bytes)"),
+                       (long unsigned) addr, (long unsigned) len,
+                       (long unsigned) step);
+        return URJ_STATUS_FAIL;
+    }
+    if (len == 0)
+        return URJ_STATUS_OK;
+
+    if (bus->driver->stub_area && bus->driver->stub_run
+        && bus->driver->stub_area (bus, &area_adr) == URJ_STATUS_OK)
+        return crc32_stub (bus, area_adr, addr, len / step, step, crc);
+
+    /* Otherwise read in blocks and reduce here */
+    if (bus->driver->read_block)
+    {
+        uint32_t words[BLOCK_WORDS];
+        uint32_t count, k;
+
+        for (i = 0; i < len; i += count * step)
+        {
+            count = (len - i) / step;
+            if (count > BLOCK_WORDS)
+                count = BLOCK_WORDS;
+
+            if (bus->driver->read_block (bus, addr + i, words, count)
+                != URJ_STATUS_OK)
+                return URJ_STATUS_FAIL;
+
+            for (k = 0; k < count; k++)
+                *crc = urj_bus_crc32_word (*crc, words[k], step);
+        }
+
+        return URJ_STATUS_OK;
+    }
+
+    if (URJ_BUS_READ_START (bus, addr) != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+
+    for (i = 0; i < len; i += step)
+    {
+        uint32_t data;
+
+        if (i + step < len)
+            data = URJ_BUS_READ_NEXT (bus, addr + i + step);
+        else
+            data = URJ_BUS_READ_END (bus);
+
+        *crc = urj_bus_crc32_word (*crc, data, step);
+    }
+
+    return URJ_STATUS_OK;
+}
+
+int
+urj_bus_readmem_format (urj_bus_t *bus, FILE *f, uint32_t addr, uint32_t len,
+                        urj_bus_memfile_format_t format)
 {
     uint32_t step;
     uint64_t a;
-    size_t bc = 0;
-#define BSIZE 4096
-    uint8_t b[BSIZE];
+    uint8_t *b;
     urj_bus_area_t area;
+    urj_bus_memfile_out_t out;
+    urj_bus_memfile_map_t map;
+    off_t pos;
     uint64_t end;
+    int r = URJ_STATUS_OK;
 
     if (!bus)
     {
@@ -66,10 +348,10 @@ urj_bus_readmem (urj_bus_t *bus, FILE *f, uint32_t addr, uint32_t len)
         urj_error_set (URJ_ERROR_INVALID,  _("Unknown bus width"));
         return URJ_STATUS_FAIL;
     }
-    if (BSIZE % step != 0)
+    if (URJ_BUS_MEMFILE_CHUNK % step != 0)
     {
-        urj_error_set (URJ_ERROR_INVALID, "step %lu must divide BSIZE %d",
-                       (long unsigned) step, BSIZE);
+        urj_error_set (URJ_ERROR_INVALID, "step %lu must divide %d",
+                       (long unsigned) step, URJ_BUS_MEMFILE_CHUNK);
         return URJ_STATUS_FAIL;
     }
 
@@ -91,44 +373,82 @@ urj_bus_readmem (urj_bus_t *bus, FILE *f, uint32_t addr, uint32_t len)
     end = a + len;
     urj_log (URJ_LOG_LEVEL_NORMAL, _("reading:\n"));
 
-    if (URJ_BUS_READ_START (bus, addr) != URJ_STATUS_OK)
-        return URJ_STATUS_FAIL;
+    /* A binary image is read straight into the mapped file */
+    pos = format == URJ_BUS_MEMFILE_BINARY ? ftello (f) : -1;
+    if (pos >= 0 && urj_bus_memfile_map (f, pos, len, 1, &map)
+        == URJ_STATUS_OK)
+    {
+        while (a < end && r == URJ_STATUS_OK)
+        {
+            uint32_t bc = (end - a > URJ_BUS_MEMFILE_CHUNK)
+                ? URJ_BUS_MEMFILE_CHUNK : end - a;
 
-    for (a += step; a <= end; a += step)
+            r = urj_bus_read_block (bus, a, map.data + (a - addr), bc);
+            a += bc;
+            urj_log (URJ_LOG_LEVEL_NORMAL, _("addr: 0x%08llX\r"),
+                     (long long unsigned) a);
+        }
+        urj_bus_memfile_unmap (&map);
+        if (r != URJ_STATUS_OK)
+            return URJ_STATUS_FAIL;
+        if (fseeko (f, pos + len, SEEK_SET) != 0)
+        {
+            urj_error_IO_set ("fseek fails");
+            return URJ_STATUS_FAIL;
+        }
+
+        urj_log (URJ_LOG_LEVEL_NORMAL, _("\nDone.\n"));
+        return URJ_STATUS_OK;
+    }
+
+    b = malloc (URJ_BUS_MEMFILE_CHUNK);
+    if (b == NULL)
     {
-        uint32_t data;
-        int j;
+        urj_error_set (URJ_ERROR_OUT_OF_MEMORY, "malloc(%zd) fails",
+                       (size_t) URJ_BUS_MEMFILE_CHUNK);
+        return URJ_STATUS_FAIL;
+    }
 
-        if (a < end)
-            data = URJ_BUS_READ_NEXT (bus, a);
-        else
-            data = URJ_BUS_READ_END (bus);
+    if (format != URJ_BUS_MEMFILE_BINARY)
+        r = urj_bus_memfile_begin (&out, f, format, addr, len);
 
-        for (j = step; j > 0; j--)
-            if (urj_get_file_endian () == URJ_ENDIAN_BIG)
-                b[bc++] = (data >> ((j - 1) * 8)) & 0xFF;
-            else
-            {
-                b[bc++] = data & 0xFF;
-                data >>= 8;
-            }
+    while (a < end && r == URJ_STATUS_OK)
+    {
+        uint32_t bc = (end - a > URJ_BUS_MEMFILE_CHUNK)
+            ? URJ_BUS_MEMFILE_CHUNK : end - a;
 
-        if ((bc >= BSIZE) || (a >= end))
+        r = urj_bus_read_block (bus, a, b, bc);
+        if (r != URJ_STATUS_OK)
+            break;
+
+        if (format != URJ_BUS_MEMFILE_BINARY)
+            r = urj_bus_memfile_put (&out, a, b, bc);
+        else if (fwrite (b, bc, 1, f) != 1)
         {
-            urj_log (URJ_LOG_LEVEL_NORMAL, _("addr: 0x%08llX\r"),
-                     (long long unsigned) a);
-            if (fwrite (b, bc, 1, f) != 1)
-            {
-                urj_error_set (URJ_ERROR_FILEIO, "fwrite fails");
-                urj_error_state.sys_errno = ferror(f);
-                clearerr(f);
-                return URJ_STATUS_FAIL;
-            }
-            bc = 0;
+            urj_error_set (URJ_ERROR_FILEIO, "fwrite fails");
+            urj_error_state.sys_errno = ferror(f);
+            clearerr(f);
+            r = URJ_STATUS_FAIL;
         }
+        a += bc;
+
+        urj_log (URJ_LOG_LEVEL_NORMAL, _("addr: 0x%08llX\r"),
+                 (long long unsigned) a);
     }
 
+    if (r == URJ_STATUS_OK && format != URJ_BUS_MEMFILE_BINARY)
+        r = urj_bus_memfile_end (&out);
+    free (b);
+    if (r != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+
     urj_log (URJ_LOG_LEVEL_NORMAL, _("\nDone.\n"));
 
     return URJ_STATUS_OK;
 }
+
+int
+urj_bus_readmem (urj_bus_t *bus, FILE *f, uint32_t addr, uint32_t len)
+{
+    return urj_bus_readmem_format (bus, f, addr, len, URJ_BUS_MEMFILE_BINARY);
+}
@@ -22,6 +22,7 @@
 #include <sysdep.h>
 
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <urjtag/log.h>
@@ -30,17 +31,219 @@
 #include <urjtag/flash.h>
 #include <urjtag/jtag.h>
 
+#include "memfile.h"
+
+/* words per call of the driver's write_block */
+#define BLOCK_WORDS 1024
+
+static uint32_t
+pack_word (const uint8_t *buf, uint32_t step, int big)
+{
+    uint32_t data = 0;
+    int j;
+
+    if (big)
+        for (j = 0; j < step; j++)
+            data = (data << 8) | buf[j];
+    else
+        for (j = step - 1; j >= 0; j--)
+            data = (data << 8) | buf[j];
+
+    return data;
+}
+
+/* The byte order is decided once per block, not per byte */
+static void
+pack_words (uint32_t *words, const uint8_t *buf, uint32_t count,
+            uint32_t step, int big)
+{
+    uint32_t k;
+
+    switch (step << 1 | big)
+    {
+    case 2:
+    case 3:
+        for (k = 0; k < count; k++)
+            words[k] = buf[k];
+        break;
+    case 4:
+        for (k = 0; k < count; k++, buf += 2)
+            words[k] = buf[0] | buf[1] << 8;
+        break;
+    case 5:
+        for (k = 0; k < count; k++, buf += 2)
+            words[k] = buf[0] << 8 | buf[1];
+        break;
+    case 8:
+        for (k = 0; k < count; k++, buf += 4)
+            words[k] = buf[0] | buf[1] << 8 | buf[2] << 16
+                | (uint32_t) buf[3] << 24;
+        break;
+    case 9:
+        for (k = 0; k < count; k++, buf += 4)
+            words[k] = (uint32_t) buf[0] << 24 | buf[1] << 16 | buf[2] << 8
+                | buf[3];
+        break;
+    default:
+        for (k = 0; k < count; k++)
+            words[k] = pack_word (buf + k * step, step, big);
+        break;
+    }
+}
+
 int
-urj_bus_writemem (urj_bus_t *bus, FILE *f, uint32_t addr, uint32_t len)
+urj_bus_write_block (urj_bus_t *bus, uint32_t addr, const uint8_t *buf,
+                     uint32_t len)
+{
+    uint32_t step;
+    uint32_t i;
+    urj_bus_area_t area;
+    int big;
+
+    if (!bus)
+    {
+        urj_error_set (URJ_ERROR_NO_BUS_DRIVER, _("Missing bus driver"));
+        return URJ_STATUS_FAIL;
+    }
+
+    URJ_BUS_PREPARE (bus);
+
+    if (URJ_BUS_AREA (bus, addr, &area) != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+
+    step = area.width / 8;
+
+    if (step == 0)
+    {
+        urj_error_set (URJ_ERROR_INVALID, _("Unknown bus width"));
+        return URJ_STATUS_FAIL;
+    }
+    if ((addr | len) & (step - 1))
+    {
+        urj_error_set (URJ_ERROR_INVALID,
+                       _("address 0x%08lX and length 0x%lX must be multiples of the bus width (%lu bytes)"),
+                       (long unsigned) addr, (long unsigned) len,
+                       (long unsigned) step);
+        return URJ_STATUS_FAIL;
+    }
+
+    big = urj_get_file_endian () == URJ_ENDIAN_BIG;
+
+    if (bus->driver->write_block)
+    {
+        uint32_t words[BLOCK_WORDS];
+        uint32_t count;
+
+        for (i = 0; i < len; i += count * step)
+        {
+            count = (len - i) / step;
+            if (count > BLOCK_WORDS)
+                count = BLOCK_WORDS;
+
+            pack_words (words, buf + i, count, step, big);
+
+            if (bus->driver->write_block (bus, addr + i, words, count)
+                != URJ_STATUS_OK)
+                return URJ_STATUS_FAIL;
+        }
+
+        return URJ_STATUS_OK;
+    }
+
+    for (i = 0; i < len; i += step)
+        URJ_BUS_WRITE (bus, addr + i, pack_word (buf + i, step, big));
+
+    return URJ_STATUS_OK;
+}
+
+/* Target window of a sparse image */
+typedef struct
+{
+    urj_bus_t *bus;
+    uint32_t step;
+    uint64_t start;
+    uint64_t end;
+    uint64_t written;
+    uint64_t skipped;
+    unsigned long runs;
+} window_t;
+
+/* Write the part of a run of file data that falls into the window */
+static int
+write_region (void *data, uint32_t addr, const uint8_t *buf, uint32_t len)
+{
+    window_t *w = data;
+    uint64_t a = addr;
+    uint64_t end = a + len;
+    uint32_t step = w->step;
+    uint32_t n;
+
+    if (a < w->start)
+    {
+        buf += (w->start < end ? w->start : end) - a;
+        a = w->start;
+    }
+    if (end > w->end)
+        end = w->end;
+    if (a >= end)
+    {
+        w->skipped += len;
+        return URJ_STATUS_OK;
+    }
+    w->skipped += len - (end - a);
+    w->runs++;
+
+    while (a < end)
+    {
+        uint32_t off = a & (step - 1);
+
+        if (off != 0 || end - a < step)
+        {
+            /* a word partly covered keeps its other bytes */
+            uint8_t word[4];
+
+            n = step - off;
+            if (n > end - a)
+                n = end - a;
+            if (urj_bus_read_block (w->bus, a - off, word, step)
+                != URJ_STATUS_OK)
+                return URJ_STATUS_FAIL;
+            memcpy (word + off, buf, n);
+            if (urj_bus_write_block (w->bus, a - off, word, step)
+                != URJ_STATUS_OK)
+                return URJ_STATUS_FAIL;
+        }
+        else
+        {
+            n = (end - a) & ~(step - 1);
+            if (n > URJ_BUS_MEMFILE_CHUNK)
+                n = URJ_BUS_MEMFILE_CHUNK;
+            if (urj_bus_write_block (w->bus, a, buf, n) != URJ_STATUS_OK)
+                return URJ_STATUS_FAIL;
+        }
+        a += n;
+        buf += n;
+        w->written += n;
+
+        urj_log (URJ_LOG_LEVEL_NORMAL, _("addr: 0x%08llX\r"),
+                 (long long unsigned) a);
+    }
+
+    return URJ_STATUS_OK;
+}
+
+int
+urj_bus_writemem_format (urj_bus_t *bus, FILE *f, uint32_t addr,
+                         uint32_t len, urj_bus_memfile_format_t format)
 {
     uint32_t step;
     uint64_t a;
-    size_t bc = 0;
-    int bidx = 0;
-#define BSIZE 4096
-    uint8_t b[BSIZE];
+    uint8_t *b;
     urj_bus_area_t area;
+    urj_bus_memfile_map_t map;
+    off_t pos;
     uint64_t end;
+    int r = URJ_STATUS_OK;
 
     if (!bus)
     {
@@ -60,13 +263,39 @@ urj_bus_writemem (urj_bus_t *bus, FILE *f, uint32_t addr, uint32_t len)
         urj_error_set (URJ_ERROR_INVALID, _("Unknown bus width"));
         return URJ_STATUS_FAIL;
     }
-    if (BSIZE % step != 0)
+    if (URJ_BUS_MEMFILE_CHUNK % step != 0)
     {
-        urj_error_set (URJ_ERROR_INVALID, "step %lu must divide BSIZE %d",
-                       (long unsigned) step, BSIZE);
+        urj_error_set (URJ_ERROR_INVALID, "step %lu must divide %d",
+                       (long unsigned) step, URJ_BUS_MEMFILE_CHUNK);
         return URJ_STATUS_FAIL;
     }
 
+    if (format != URJ_BUS_MEMFILE_BINARY)
+    {
+        window_t w;
+
+        w.bus = bus;
+        w.step = step;
+        w.start = addr;
+        w.end = (uint64_t) addr + len;
+        w.written = w.skipped = 0;
+        w.runs = 0;
+
+        urj_log (URJ_LOG_LEVEL_NORMAL, _("window: 0x%08lX..0x%08llX\n"),
+                 (long unsigned) addr, (long long unsigned) w.end - 1);
+        urj_log (URJ_LOG_LEVEL_NORMAL, _("writing:\n"));
+        if (urj_bus_memfile_load (f, format, write_region, &w)
+            != URJ_STATUS_OK)
+            return URJ_STATUS_FAIL;
+
+        urj_log (URJ_LOG_LEVEL_NORMAL,
+                 _("\n%llu bytes in %lu runs written, %llu bytes outside the window skipped\n"),
+                 (long long unsigned) w.written, w.runs,
+                 (long long unsigned) w.skipped);
+        urj_log (URJ_LOG_LEVEL_NORMAL, _("Done.\n"));
+        return URJ_STATUS_OK;
+    }
+
     addr = addr & (~(step - 1));
     len = (len + step - 1) & (~(step - 1));
 
@@ -85,62 +314,96 @@ urj_bus_writemem (urj_bus_t *bus, FILE *f, uint32_t addr, uint32_t len)
     end = a + len;
     urj_log (URJ_LOG_LEVEL_NORMAL, _("writing:\n"));
 
-    for (; a < end; a += step)
+    /* A file holding the whole image is written from its mapping */
+    pos = ftello (f);
+    if (pos >= 0 && urj_bus_memfile_map (f, pos, len, 0, &map)
+        == URJ_STATUS_OK)
     {
-        uint32_t data;
-        int j;
-
-        /* Read one block of data */
-        if (bc == 0)
+        while (a < end && r == URJ_STATUS_OK)
         {
+            uint32_t bc = (end - a > URJ_BUS_MEMFILE_CHUNK)
+                ? URJ_BUS_MEMFILE_CHUNK : end - a;
+
             urj_log (URJ_LOG_LEVEL_NORMAL, _("addr: 0x%08llX\r"),
                      (long long unsigned) a);
-            bc = fread (b, 1, BSIZE, f);
-            if (bc != BSIZE)
+            r = urj_bus_write_block (bus, a, map.data + (a - addr), bc);
+            a += bc;
+        }
+        urj_bus_memfile_unmap (&map);
+        if (r != URJ_STATUS_OK)
+            return URJ_STATUS_FAIL;
+        if (fseeko (f, pos + len, SEEK_SET) != 0)
+        {
+            urj_error_IO_set ("fseek fails");
+            return URJ_STATUS_FAIL;
+        }
+
+        urj_log (URJ_LOG_LEVEL_NORMAL, _("\nDone.\n"));
+        return URJ_STATUS_OK;
+    }
+
+    b = malloc (URJ_BUS_MEMFILE_CHUNK);
+    if (b == NULL)
+    {
+        urj_error_set (URJ_ERROR_OUT_OF_MEMORY, "malloc(%zd) fails",
+                       (size_t) URJ_BUS_MEMFILE_CHUNK);
+        return URJ_STATUS_FAIL;
+    }
+
+    while (a < end)
+    {
+        size_t want = (end - a > URJ_BUS_MEMFILE_CHUNK)
+            ? URJ_BUS_MEMFILE_CHUNK : end - a;
+        size_t bc;
+
+        /* Read one block of data */
+        urj_log (URJ_LOG_LEVEL_NORMAL, _("addr: 0x%08llX\r"),
+                 (long long unsigned) a);
+        bc = fread (b, 1, want, f);
+        if (bc != want)
+        {
+            urj_log (URJ_LOG_LEVEL_NORMAL, _("Short read: bc=0x%zX\n"), bc);
+            if (bc < step)
             {
-                urj_log (URJ_LOG_LEVEL_NORMAL, _("Short read: bc=0x%zX\n"), bc);
-                if (bc < step)
+                // Not even enough for one step. Something is wrong. Check
+                // the file state and bail out.
+                if (feof (f))
+                    urj_error_set (URJ_ERROR_FILEIO,
+                        _("Unexpected end of file; Addr: 0x%08llX\n"),
+                        (long long unsigned) a);
+                else
                 {
-                    // Not even enough for one step. Something is wrong. Check
-                    // the file state and bail out.
-                    if (feof (f))
-                        urj_error_set (URJ_ERROR_FILEIO,
-                            _("Unexpected end of file; Addr: 0x%08llX\n"),
-                            (long long unsigned) a);
-                    else
-                    {
-                        urj_error_set (URJ_ERROR_FILEIO, "fread fails");
-                        urj_error_state.sys_errno = ferror(f);
-                        clearerr(f);
-                    }
-
-                    return URJ_STATUS_FAIL;
+                    urj_error_set (URJ_ERROR_FILEIO, "fread fails");
+                    urj_error_state.sys_errno = ferror(f);
+                    clearerr(f);
                 }
-                /* else, process what we have read, then return to fread() to
-                 * meet the error condition (again) */
+
+                free (b);
+                return URJ_STATUS_FAIL;
             }
-            bidx = 0;
+            /* else, pad the last word, write what we have read, then
+             * return to fread() to meet the error condition (again) */
+            while (bc % step)
+                b[bc++] = 0;
         }
 
-        /* Write a word at a time */
-        data = 0;
-        for (j = step; j > 0 && bc > 0; j--)
+        if (urj_bus_write_block (bus, a, b, bc) != URJ_STATUS_OK)
         {
-            if (urj_get_file_endian () == URJ_ENDIAN_BIG)
-            {
-                /* first shift doesn't matter: data = 0 */
-                data <<= 8;
-                data |= b[bidx++];
-            }
-            else
-                data |= (b[bidx++] << ((step - j) * 8));
-            bc--;
+            free (b);
+            return URJ_STATUS_FAIL;
         }
-
-        URJ_BUS_WRITE (bus, a, data);
+        a += bc;
     }
+    free (b);
 
     urj_log (URJ_LOG_LEVEL_NORMAL, _("\nDone.\n"));
 
     return URJ_STATUS_OK;
 }
+
+int
+urj_bus_writemem (urj_bus_t *bus, FILE *f, uint32_t addr, uint32_t len)
+{
+    return urj_bus_writemem_format (bus, f, addr, len,
+                                    URJ_BUS_MEMFILE_BINARY);
+}
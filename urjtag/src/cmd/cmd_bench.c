@@ -0,0 +1,685 @@
+/*
+ * $Id$
+ *
+ * JTAG throughput and latency benchmark
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ */
+
+#include <sysdep.h>
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <urjtag/error.h>
+#include <urjtag/log.h>
+#include <urjtag/chain.h>
+#include <urjtag/part.h>
+#include <urjtag/part_instruction.h>
+#include <urjtag/data_register.h>
+#include <urjtag/tap.h>
+#include <urjtag/tap_register.h>
+#include <urjtag/bus.h>
+#include <urjtag/flash.h>
+#include <urjtag/fclock.h>
+#ifdef ENABLE_SVF
+#include <urjtag/svf.h>
+#endif
+#ifdef ENABLE_STAPL
+#include <urjtag/stapl.h>
+#endif
+#ifdef ENABLE_JIM
+#include <urjtag/jim.h>
+#endif
+
+#include <urjtag/cmd.h>
+
+#include "cmd.h"
+
+#define BENCH_DEFAULT_COUNT     10
+#define BENCH_DEFAULT_LEN       0x1000
+
+/* DR scan lengths of the "scan" workload */
+static const int bench_scan_lens[] = { 32, 1024, 32768 };
+
+typedef struct
+{
+    char name[32];
+    unsigned long ops;
+    unsigned long long bits;
+    long double start;
+    long double total;
+    long double min;
+    long double max;
+#ifdef ENABLE_JIM
+    double model_usecs;
+#endif
+} bench_result_t;
+
+typedef struct
+{
+    urj_chain_t *chain;
+    unsigned long count;
+    unsigned long len;
+    char *action;
+    urj_log_level_t log_level;
+} bench_t;
+
+static void
+bench_begin (bench_t *b, bench_result_t *r, const char *name)
+{
+    memset (r, 0, sizeof *r);
+    snprintf (r->name, sizeof r->name, "%s", name);
+#ifdef ENABLE_JIM
+    {
+        urj_jim_cable_model_t m;
+
+        if (urj_tap_cable_jim_model (b->chain->cable, &m) == URJ_STATUS_OK)
+            r->model_usecs = -m.usecs;
+        else
+            urj_error_reset ();
+    }
+#endif
+}
+
+static void
+bench_op_start (bench_result_t *r)
+{
+    r->start = urj_lib_frealtime ();
+}
+
+static void
+bench_op_end (bench_result_t *r, unsigned long long bits)
+{
+    long double dt = urj_lib_frealtime () - r->start;
+
+    if (r->ops == 0 || dt < r->min)
+        r->min = dt;
+    if (dt > r->max)
+        r->max = dt;
+    r->total += dt;
+    r->bits += bits;
+    r->ops++;
+}
+
+static void
+bench_report (bench_t *b, bench_result_t *r)
+{
+    urj_log_level_t quiet = urj_log_state.level;
+    double total = r->total;
+
+    urj_log_state.level = b->log_level;
+
+    urj_log (URJ_LOG_LEVEL_NORMAL,
+             _("%-16s %6lu ops %12llu bits %10.6f s"),
+             r->name, r->ops, r->bits, total);
+    if (r->bits != 0 && total > 0)
+        urj_log (URJ_LOG_LEVEL_NORMAL, _(" %10.1f kbit/s"),
+                 r->bits / total / 1000.0);
+    if (r->ops != 0)
+        urj_log (URJ_LOG_LEVEL_NORMAL,
+                 _("  latency min/avg/max %.3f/%.3f/%.3f ms"),
+                 (double) r->min * 1E3, total * 1E3 / r->ops,
+                 (double) r->max * 1E3);
+#ifdef ENABLE_JIM
+    {
+        urj_jim_cable_model_t m;
+
+        if (urj_tap_cable_jim_model (b->chain->cable, &m) == URJ_STATUS_OK)
+            urj_log (URJ_LOG_LEVEL_NORMAL, _("  modelled %.6f s"),
+                     (r->model_usecs + m.usecs) / 1E6);
+        else
+            urj_error_reset ();
+    }
+#endif
+    urj_log (URJ_LOG_LEVEL_NORMAL, "\n");
+    urj_log_state.level = quiet;
+}
+
+static int
+bench_need_parts (urj_chain_t *chain)
+{
+    if (chain->parts == NULL || chain->parts->len == 0)
+    {
+        urj_error_set (URJ_ERROR_ILLEGAL_STATE, _("Run \"detect\" first"));
+        return URJ_STATUS_FAIL;
+    }
+
+    return URJ_STATUS_OK;
+}
+
+static int
+bench_need_bus (void)
+{
+    if (!urj_bus)
+    {
+        urj_error_set (URJ_ERROR_ILLEGAL_STATE, _("Bus driver missing"));
+        return URJ_STATUS_FAIL;
+    }
+
+    return URJ_STATUS_OK;
+}
+
+/*
+ * Raw scans: all parts to BYPASS by shifting all-ones into IR, then DR scans
+ * of several lengths with output.  Each bypassed part delays the pattern by
+ * one bit, which is checked so a broken shift path is not reported as fast.
+ */
+static int
+bench_scan (bench_t *b)
+{
+    urj_chain_t *chain = b->chain;
+    urj_parts_t *ps;
+    urj_tap_register_t *ir, *in, *out;
+    bench_result_t r;
+    int irlen = 0;
+    int i, j, n;
+    unsigned long k;
+    unsigned long errors = 0;
+    char name[32];
+
+    if (bench_need_parts (chain) != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+    ps = chain->parts;
+    for (i = 0; i < ps->len; i++)
+        irlen += ps->parts[i]->instruction_length;
+
+    ir = urj_tap_register_alloc (irlen);
+    if (ir == NULL)
+        return URJ_STATUS_FAIL;
+    urj_tap_register_fill (ir, 1);
+
+    bench_begin (b, &r, "scan ir");
+    for (k = 0; k < b->count; k++)
+    {
+        bench_op_start (&r);
+        urj_tap_capture_ir (chain);
+        urj_tap_shift_register (chain, ir, NULL, URJ_CHAIN_EXITMODE_IDLE);
+        bench_op_end (&r, irlen);
+    }
+    bench_report (b, &r);
+    urj_tap_register_free (ir);
+
+    for (j = 0; j < sizeof bench_scan_lens / sizeof bench_scan_lens[0]; j++)
+    {
+        n = bench_scan_lens[j];
+        in = urj_tap_register_alloc (n);
+        out = urj_tap_register_alloc (n);
+        if (in == NULL || out == NULL)
+        {
+            urj_tap_register_free (in);
+            urj_tap_register_free (out);
+            return URJ_STATUS_FAIL;
+        }
+        for (i = 0; i < n; i++)
+            in->data[i] = ((i * 7) ^ (i >> 3)) & 1;
+
+        snprintf (name, sizeof name, "scan dr %d", n);
+        bench_begin (b, &r, name);
+        for (k = 0; k < b->count; k++)
+        {
+            bench_op_start (&r);
+            urj_tap_capture_dr (chain);
+            urj_tap_shift_register (chain, in, out, URJ_CHAIN_EXITMODE_IDLE);
+            bench_op_end (&r, n);
+
+            for (i = ps->len; i < n; i++)
+                if (out->data[i] != in->data[i - ps->len])
+                {
+                    errors++;
+                    break;
+                }
+        }
+        bench_report (b, &r);
+        urj_tap_register_free (in);
+        urj_tap_register_free (out);
+    }
+
+    /* put the parts back into the instructions the chain thinks they have */
+    urj_tap_chain_shift_instructions (chain);
+
+    if (errors != 0)
+    {
+        urj_error_set (URJ_ERROR_INVALID,
+                       _("%lu DR scans did not return the bypassed pattern"),
+                       errors);
+        return URJ_STATUS_FAIL;
+    }
+
+    return URJ_STATUS_OK;
+}
+
+static int
+bench_detect (bench_t *b)
+{
+    bench_result_t r;
+    unsigned long k;
+    int ret = URJ_STATUS_OK;
+
+    bench_begin (b, &r, "detect");
+    for (k = 0; k < b->count && ret == URJ_STATUS_OK; k++)
+    {
+        bench_op_start (&r);
+        ret = urj_tap_detect (b->chain, 0);
+        bench_op_end (&r, 0);
+    }
+    bench_report (b, &r);
+
+    return ret;
+}
+
+/* BSR SAMPLE loop on every part that has a SAMPLE instruction */
+static int
+bench_sample (bench_t *b)
+{
+    urj_chain_t *chain = b->chain;
+    urj_parts_t *ps;
+    urj_part_instruction_t **saved;
+    bench_result_t r;
+    unsigned long long bits = 0;
+    unsigned long k;
+    int i, found = 0;
+
+    if (bench_need_parts (chain) != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+    ps = chain->parts;
+
+    saved = malloc (ps->len * sizeof *saved);
+    if (saved == NULL)
+    {
+        urj_error_set (URJ_ERROR_OUT_OF_MEMORY, "malloc(%zd) fails",
+                       ps->len * sizeof *saved);
+        return URJ_STATUS_FAIL;
+    }
+
+    for (i = 0; i < ps->len; i++)
+    {
+        urj_part_t *p = ps->parts[i];
+        urj_part_instruction_t *inst;
+
+        saved[i] = p->active_instruction;
+        inst = urj_part_find_instruction (p, "SAMPLE/PRELOAD");
+        if (inst == NULL)
+            inst = urj_part_find_instruction (p, "SAMPLE");
+        if (inst == NULL)
+            continue;
+        p->active_instruction = inst;
+        found++;
+    }
+
+    for (i = 0; i < ps->len; i++)
+        if (ps->parts[i]->active_instruction != NULL
+            && ps->parts[i]->active_instruction->data_register != NULL)
+            bits += ps->parts[i]->active_instruction->data_register->in->len;
+
+    if (found == 0)
+    {
+        free (saved);
+        urj_error_set (URJ_ERROR_NOTFOUND,
+                       _("no part has a SAMPLE instruction"));
+        return URJ_STATUS_FAIL;
+    }
+
+    urj_tap_chain_shift_instructions (chain);
+
+    bench_begin (b, &r, "sample");
+    for (k = 0; k < b->count; k++)
+    {
+        bench_op_start (&r);
+        urj_tap_chain_shift_data_registers (chain, 1);
+        bench_op_end (&r, bits);
+    }
+    bench_report (b, &r);
+
+    for (i = 0; i < ps->len; i++)
+        ps->parts[i]->active_instruction = saved[i];
+    free (saved);
+    urj_tap_chain_shift_instructions (chain);
+
+    return URJ_STATUS_OK;
+}
+
+static FILE *
+bench_pattern_file (unsigned long len)
+{
+    FILE *f = tmpfile ();
+    unsigned long i;
+
+    if (f == NULL)
+    {
+        urj_error_IO_set (_("Unable to create temporary file"));
+        return NULL;
+    }
+    for (i = 0; i < len; i++)
+        fputc ((i * 0x9D + (i >> 8)) & 0xFF, f);
+
+    return f;
+}
+
+static int
+bench_readmem (bench_t *b, uint32_t adr)
+{
+    bench_result_t r;
+    unsigned long k;
+    int ret = URJ_STATUS_OK;
+    FILE *f;
+
+    if (bench_need_bus () != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+
+    f = tmpfile ();
+    if (f == NULL)
+    {
+        urj_error_IO_set (_("Unable to create temporary file"));
+        return URJ_STATUS_FAIL;
+    }
+
+    bench_begin (b, &r, "readmem");
+    for (k = 0; k < b->count && ret == URJ_STATUS_OK; k++)
+    {
+        rewind (f);
+        bench_op_start (&r);
+        ret = urj_bus_readmem (urj_bus, f, adr, b->len);
+        bench_op_end (&r, 8ULL * b->len);
+    }
+    bench_report (b, &r);
+    fclose (f);
+
+    return ret;
+}
+
+static int
+bench_writemem (bench_t *b, uint32_t adr)
+{
+    bench_result_t r;
+    unsigned long k;
+    int ret = URJ_STATUS_OK;
+    FILE *f;
+
+    if (bench_need_bus () != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+
+    f = bench_pattern_file (b->len);
+    if (f == NULL)
+        return URJ_STATUS_FAIL;
+
+    bench_begin (b, &r, "writemem");
+    for (k = 0; k < b->count && ret == URJ_STATUS_OK; k++)
+    {
+        rewind (f);
+        bench_op_start (&r);
+        ret = urj_bus_writemem (urj_bus, f, adr, b->len);
+        bench_op_end (&r, 8ULL * b->len);
+    }
+    bench_report (b, &r);
+    fclose (f);
+
+    return ret;
+}
+
+static int
+bench_flashmem (bench_t *b, uint32_t adr)
+{
+    bench_result_t r;
+    unsigned long k;
+    int ret = URJ_STATUS_OK;
+    FILE *f;
+
+    if (bench_need_bus () != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+
+    f = bench_pattern_file (b->len);
+    if (f == NULL)
+        return URJ_STATUS_FAIL;
+
+    bench_begin (b, &r, "flashmem");
+    for (k = 0; k < b->count && ret == URJ_STATUS_OK; k++)
+    {
+        rewind (f);
+        bench_op_start (&r);
+        ret = urj_flashmem (urj_bus, f, adr, 0);
+        bench_op_end (&r, 8ULL * b->len);
+    }
+    bench_report (b, &r);
+    fclose (f);
+
+    return ret;
+}
+
+#ifdef ENABLE_SVF
+static int
+bench_svf (bench_t *b, const char *filename)
+{
+    bench_result_t r;
+    unsigned long k;
+    int ret = URJ_STATUS_OK;
+    FILE *f;
+
+    f = fopen (filename, FOPEN_R);
+    if (f == NULL)
+    {
+        urj_error_IO_set (_("Unable to open file `%s'"), filename);
+        return URJ_STATUS_FAIL;
+    }
+
+    bench_begin (b, &r, "svf");
+    for (k = 0; k < b->count && ret == URJ_STATUS_OK; k++)
+    {
+        rewind (f);
+        bench_op_start (&r);
+        ret = urj_svf_run (b->chain, f, 0, 0);
+        bench_op_end (&r, 0);
+    }
+    bench_report (b, &r);
+    fclose (f);
+
+    return ret;
+}
+#endif
+
+#ifdef ENABLE_STAPL
+static int
+bench_stapl (bench_t *b, char *filename)
+{
+    bench_result_t r;
+    unsigned long k;
+    int ret = URJ_STATUS_OK;
+    char action[64];
+
+    if (b->action == NULL)
+    {
+        urj_error_set (URJ_ERROR_SYNTAX, _("stapl needs action=NAME"));
+        return URJ_STATUS_FAIL;
+    }
+    snprintf (action, sizeof action, "-a%s", b->action);
+
+    bench_begin (b, &r, "stapl");
+    for (k = 0; k < b->count && ret == URJ_STATUS_OK; k++)
+    {
+        bench_op_start (&r);
+        ret = urj_stapl_run (b->chain, filename, action);
+        bench_op_end (&r, 0);
+    }
+    bench_report (b, &r);
+
+    return ret;
+}
+#endif
+
+static int
+bench_run_one (bench_t *b, char *workload)
+{
+    char *value = strchr (workload, '=');
+    long unsigned adr = 0;
+
+    if (value != NULL)
+        *value++ = '\0';
+
+    if (strcasecmp (workload, "scan") == 0)
+        return bench_scan (b);
+    if (strcasecmp (workload, "detect") == 0)
+        return bench_detect (b);
+    if (strcasecmp (workload, "sample") == 0)
+        return bench_sample (b);
+
+#ifdef ENABLE_SVF
+    if (strcasecmp (workload, "svf") == 0 && value != NULL)
+        return bench_svf (b, value);
+#endif
+#ifdef ENABLE_STAPL
+    if (strcasecmp (workload, "stapl") == 0 && value != NULL)
+        return bench_stapl (b, value);
+#endif
+
+    if (value == NULL)
+    {
+        urj_error_set (URJ_ERROR_SYNTAX, _("unknown workload '%s'"),
+                       workload);
+        return URJ_STATUS_FAIL;
+    }
+    if (urj_cmd_get_number (value, &adr) != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+
+    if (strcasecmp (workload, "readmem") == 0)
+        return bench_readmem (b, adr);
+    if (strcasecmp (workload, "writemem") == 0)
+        return bench_writemem (b, adr);
+    if (strcasecmp (workload, "flashmem") == 0)
+        return bench_flashmem (b, adr);
+
+    urj_error_set (URJ_ERROR_SYNTAX, _("unknown workload '%s'"), workload);
+    return URJ_STATUS_FAIL;
+}
+
+static int
+cmd_bench_run (urj_chain_t *chain, char *params[])
+{
+    bench_t b;
+    char *workloads[32];
+    int nworkloads = 0;
+    int i, r = URJ_STATUS_OK;
+
+    if (urj_cmd_test_cable (chain) != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+
+    b.chain = chain;
+    b.count = BENCH_DEFAULT_COUNT;
+    b.len = BENCH_DEFAULT_LEN;
+    b.action = NULL;
+    b.log_level = urj_log_state.level;
+
+    for (i = 1; params[i] != NULL; i++)
+    {
+        if (strncasecmp (params[i], "count=", 6) == 0)
+        {
+            if (urj_cmd_get_number (params[i] + 6, &b.count) != URJ_STATUS_OK)
+                return URJ_STATUS_FAIL;
+        }
+        else if (strncasecmp (params[i], "len=", 4) == 0)
+        {
+            if (urj_cmd_get_number (params[i] + 4, &b.len) != URJ_STATUS_OK)
+                return URJ_STATUS_FAIL;
+        }
+        else if (strncasecmp (params[i], "action=", 7) == 0)
+            b.action = params[i] + 7;
+        else if (nworkloads < sizeof workloads / sizeof workloads[0])
+            workloads[nworkloads++] = params[i];
+        else
+        {
+            urj_error_set (URJ_ERROR_SYNTAX, _("too many workloads"));
+            return URJ_STATUS_FAIL;
+        }
+    }
+
+    if (b.count == 0)
+    {
+        urj_error_set (URJ_ERROR_SYNTAX, _("count must be at least 1"));
+        return URJ_STATUS_FAIL;
+    }
+
+    /* the workload commands are chatty; keep only warnings and the report */
+    if (urj_log_state.level < URJ_LOG_LEVEL_WARNING)
+        urj_log_state.level = URJ_LOG_LEVEL_WARNING;
+
+    if (nworkloads == 0)
+    {
+        r = bench_scan (&b);
+        if (r == URJ_STATUS_OK)
+            r = bench_sample (&b);
+        if (r == URJ_STATUS_OK && urj_bus)
+            r = bench_readmem (&b, 0);
+    }
+    for (i = 0; i < nworkloads && r == URJ_STATUS_OK; i++)
+        r = bench_run_one (&b, workloads[i]);
+
+    urj_log_state.level = b.log_level;
+
+    return r;
+}
+
+static void
+cmd_bench_help (void)
+{
+    urj_log (URJ_LOG_LEVEL_NORMAL,
+             _("Usage: %s [count=N] [len=LEN] [action=NAME] [WORKLOAD...]\n"
+               "Run JTAG workloads and report throughput and latency.\n"
+               "\n"
+               "count=N         repetitions of each workload (default %d)\n"
+               "len=LEN         bytes per memory workload (default %d)\n"
+               "action=NAME     STAPL action to execute\n"
+               "\n"
+               "WORKLOAD is one of:\n"
+               "scan            IR scan to BYPASS and DR scans of %d, %d and %d bits\n"
+               "detect          chain detection (drops the current bus)\n"
+               "sample          SAMPLE/PRELOAD boundary scan loop\n"
+               "readmem=ADDR    bus reads of LEN bytes at ADDR\n"
+               "writemem=ADDR   bus writes of LEN bytes at ADDR\n"
+               "flashmem=ADDR   flash programming of LEN bytes at ADDR\n"
+               "svf=FILE        SVF playback\n"
+               "stapl=FILE      STAPL playback of action NAME\n"
+               "\n"
+               "Without WORKLOAD, runs scan, sample and readmem=0 if a bus\n"
+               "is selected.\n"),
+             "bench", BENCH_DEFAULT_COUNT, BENCH_DEFAULT_LEN,
+             bench_scan_lens[0], bench_scan_lens[1], bench_scan_lens[2]);
+}
+
+static void
+cmd_bench_complete (urj_chain_t *chain, char ***matches, size_t *match_cnt,
+                    char * const *tokens, const char *text, size_t text_len,
+                    size_t token_point)
+{
+    static const char * const words[] = {
+        "count=", "len=", "action=", "scan", "detect", "sample", "readmem=",
+        "writemem=", "flashmem=", "svf=", "stapl=",
+    };
+    size_t i;
+
+    for (i = 0; i < sizeof words / sizeof words[0]; i++)
+        urj_completion_mayben_add_match (matches, match_cnt, text, text_len,
+                                         words[i]);
+}
+
+const urj_cmd_t urj_cmd_bench = {
+    "bench",
+    N_("measure JTAG throughput and latency"),
+    cmd_bench_help,
+    cmd_bench_run,
+    cmd_bench_complete,
+};
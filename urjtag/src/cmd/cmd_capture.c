@@ -0,0 +1,505 @@
+/*
+ * $Id$
+ *
+ * Continuous boundary-scan sampling to a VCD file
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ */
+
+#include <sysdep.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <urjtag/error.h>
+#include <urjtag/log.h>
+#include <urjtag/chain.h>
+#include <urjtag/cable.h>
+#include <urjtag/part.h>
+#include <urjtag/tap_register.h>
+#include <urjtag/data_register.h>
+#include <urjtag/bssignal.h>
+#include <urjtag/bsbit.h>
+#include <urjtag/fclock.h>
+
+#include <urjtag/cmd.h>
+
+#include "cmd.h"
+
+#define CAPTURE_DEFAULT_COUNT   1000
+#define CAPTURE_DEFAULT_DEPTH   16
+#define CAPTURE_DEFAULT_RING    4096
+
+/* one pin change; time in ns since the first sample */
+typedef struct
+{
+    uint64_t time;
+    unsigned int sig;
+    char val;
+}
+capture_event_t;
+
+typedef struct
+{
+    FILE *f;
+    urj_chain_t *chain;
+    urj_part_t *part;
+    urj_data_register_t *bsr;
+    int nsigs;
+    urj_part_signal_t **sigs;
+    char *last;                 /* last value per signal */
+
+    capture_event_t *ring;      /* changes not yet written */
+    size_t ring_size;
+    size_t head;                /* oldest event */
+    size_t used;
+    uint64_t written_time;      /* time of the last '#' line */
+    int time_written;
+
+    uint32_t frequency;         /* TCK in Hz; 0: use the wall clock */
+    uint64_t *tck;              /* TCK count at each sample in flight */
+    unsigned long depth;
+    uint64_t tck0;
+    long double start;
+
+    unsigned long samples;
+    unsigned long changes;
+}
+capture_t;
+
+/* VCD identifiers are strings over the printable ASCII characters */
+static void
+capture_vcd_id (unsigned int n, char *id)
+{
+    do
+    {
+        *id++ = '!' + n % 94;
+        n /= 94;
+    }
+    while (n != 0);
+    *id = '\0';
+}
+
+static void
+capture_drain (capture_t *c)
+{
+    char id[8];
+
+    while (c->used > 0)
+    {
+        const capture_event_t *e = &c->ring[c->head];
+
+        if (!c->time_written || e->time != c->written_time)
+        {
+            fprintf (c->f, "#%llu\n", (unsigned long long) e->time);
+            c->written_time = e->time;
+            c->time_written = 1;
+        }
+        capture_vcd_id (e->sig, id);
+        fprintf (c->f, "%c%s\n", e->val ? '1' : '0', id);
+
+        c->head = (c->head + 1) % c->ring_size;
+        c->used--;
+    }
+}
+
+static void
+capture_event (capture_t *c, uint64_t time, int sig, char val)
+{
+    capture_event_t *e;
+
+    if (c->used == c->ring_size)
+        capture_drain (c);
+
+    e = &c->ring[(c->head + c->used) % c->ring_size];
+    e->time = time;
+    e->sig = sig;
+    e->val = val;
+    c->used++;
+    c->changes++;
+}
+
+static void
+capture_header (capture_t *c)
+{
+    time_t now = time (NULL);
+    char id[8];
+    int i;
+
+    fprintf (c->f, "$date\n  %s$end\n", ctime (&now));
+    fprintf (c->f, "$version\n  UrJTAG %s boundary-scan capture\n$end\n",
+             VERSION);
+    fprintf (c->f, "$comment\n  time base: %s\n$end\n",
+             c->frequency ? "TCK" : "wall clock");
+    fprintf (c->f, "$timescale 1 ns $end\n");
+    fprintf (c->f, "$scope module %s $end\n",
+             c->part->part_name[0] ? c->part->part_name : "part");
+    for (i = 0; i < c->nsigs; i++)
+    {
+        capture_vcd_id (i, id);
+        fprintf (c->f, "$var wire 1 %s %s $end\n", id, c->sigs[i]->name);
+    }
+    fprintf (c->f, "$upscope $end\n$enddefinitions $end\n");
+}
+
+/* timestamp of a sample picked up from the cable */
+static uint64_t
+capture_time (capture_t *c, unsigned long sample)
+{
+    if (c->frequency != 0)
+        return (uint64_t) ((c->tck[sample % c->depth] - c->tck0) * 1e9L
+                           / c->frequency);
+
+    return (uint64_t) ((urj_lib_frealtime () - c->start) * 1e9L);
+}
+
+static void
+capture_sample (capture_t *c, unsigned long sample)
+{
+    const char *data = c->bsr->out->data;
+    uint64_t t = capture_time (c, sample);
+    int i;
+
+    if (sample == 0)
+    {
+        fprintf (c->f, "#0\n$dumpvars\n");
+        for (i = 0; i < c->nsigs; i++)
+        {
+            char id[8];
+
+            c->last[i] = data[c->sigs[i]->input->bit];
+            capture_vcd_id (i, id);
+            fprintf (c->f, "%c%s\n", c->last[i] ? '1' : '0', id);
+        }
+        fprintf (c->f, "$end\n");
+        c->written_time = 0;
+        c->time_written = 1;
+        return;
+    }
+
+    for (i = 0; i < c->nsigs; i++)
+    {
+        char v = data[c->sigs[i]->input->bit];
+
+        if (v != c->last[i])
+        {
+            c->last[i] = v;
+            capture_event (c, t, i, v);
+        }
+    }
+}
+
+/* queue one SAMPLE scan and remember the TCK count it ends at */
+static int
+capture_defer (capture_t *c, unsigned long sample)
+{
+    if (urj_tap_chain_defer_shift_data_registers_mode (c->chain, 1, 1,
+                                                       URJ_CHAIN_EXITMODE_IDLE)
+        != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+    c->tck[sample % c->depth] = c->chain->cable->stats.bits;
+
+    return URJ_STATUS_OK;
+}
+
+static int
+capture_run (capture_t *c, unsigned long count, unsigned long seconds)
+{
+    unsigned long queued = 0, done = 0;
+
+    c->start = urj_lib_frealtime ();
+    c->tck0 = c->chain->cable->stats.bits;
+
+    /* keep up to depth scans in the cable queue: while one result is
+     * converted the following scans are already on their way */
+    while (queued < count && queued < c->depth)
+        if (capture_defer (c, queued++) != URJ_STATUS_OK)
+            return URJ_STATUS_FAIL;
+
+    while (done < queued)
+    {
+        urj_tap_chain_shift_data_registers_output (c->chain,
+                                                   URJ_CHAIN_EXITMODE_IDLE);
+        capture_sample (c, done);
+        done++;
+
+        if (seconds != 0 && urj_lib_frealtime () - c->start >= seconds)
+            count = queued;
+        if (queued < count)
+            if (capture_defer (c, queued++) != URJ_STATUS_OK)
+                return URJ_STATUS_FAIL;
+    }
+
+    c->samples = done;
+    capture_drain (c);
+    /* close the trace at the time of the last sample */
+    if (done > 1)
+    {
+        uint64_t t = capture_time (c, done - 1);
+
+        if (t > c->written_time)
+            fprintf (c->f, "#%llu\n", (unsigned long long) t);
+    }
+
+    return URJ_STATUS_OK;
+}
+
+static int
+capture_signals (capture_t *c, char *names[], int n)
+{
+    urj_part_signal_t *s;
+    int i;
+
+    if (n == 0)
+    {
+        for (s = c->part->signals; s; s = s->next)
+            if (s->input != NULL)
+                n++;
+    }
+
+    c->sigs = calloc (n, sizeof *c->sigs);
+    c->last = calloc (n, 1);
+    if (c->sigs == NULL || c->last == NULL)
+    {
+        urj_error_set (URJ_ERROR_OUT_OF_MEMORY, "calloc(%d signals) fails",
+                       n);
+        return URJ_STATUS_FAIL;
+    }
+
+    if (names[0] == NULL)
+    {
+        for (s = c->part->signals; s; s = s->next)
+            if (s->input != NULL)
+                c->sigs[c->nsigs++] = s;
+    }
+    else
+        for (i = 0; i < n; i++)
+        {
+            s = urj_part_find_signal (c->part, names[i]);
+            if (s == NULL)
+            {
+                urj_error_set (URJ_ERROR_NOTFOUND, _("signal '%s' not found"),
+                               names[i]);
+                return URJ_STATUS_FAIL;
+            }
+            if (s->input == NULL)
+            {
+                urj_error_set (URJ_ERROR_INVALID,
+                               _("signal '%s' is not an input"), names[i]);
+                return URJ_STATUS_FAIL;
+            }
+            c->sigs[c->nsigs++] = s;
+        }
+
+    if (c->nsigs == 0)
+    {
+        urj_error_set (URJ_ERROR_NOTFOUND, _("no input signals to capture"));
+        return URJ_STATUS_FAIL;
+    }
+
+    return URJ_STATUS_OK;
+}
+
+static int
+cmd_capture_run (urj_chain_t *chain, char *params[])
+{
+    capture_t c;
+    char *names[64];
+    int nnames = 0;
+    long unsigned count = CAPTURE_DEFAULT_COUNT, seconds = 0;
+    long unsigned depth = CAPTURE_DEFAULT_DEPTH, ring = CAPTURE_DEFAULT_RING;
+    const char *filename = NULL;
+    long double secs;
+    int i, r;
+
+    if (urj_cmd_params (params) < 2)
+    {
+        urj_error_set (URJ_ERROR_SYNTAX,
+                       "%s: #parameters should be >= %d, not %d",
+                       params[0], 2, urj_cmd_params (params));
+        return URJ_STATUS_FAIL;
+    }
+
+    for (i = 1; params[i] != NULL; i++)
+    {
+        if (strncasecmp (params[i], "count=", 6) == 0)
+        {
+            if (urj_cmd_get_number (params[i] + 6, &count) != URJ_STATUS_OK)
+                return URJ_STATUS_FAIL;
+        }
+        else if (strncasecmp (params[i], "seconds=", 8) == 0)
+        {
+            if (urj_cmd_get_number (params[i] + 8, &seconds) != URJ_STATUS_OK)
+                return URJ_STATUS_FAIL;
+        }
+        else if (strncasecmp (params[i], "depth=", 6) == 0)
+        {
+            if (urj_cmd_get_number (params[i] + 6, &depth) != URJ_STATUS_OK)
+                return URJ_STATUS_FAIL;
+        }
+        else if (strncasecmp (params[i], "ring=", 5) == 0)
+        {
+            if (urj_cmd_get_number (params[i] + 5, &ring) != URJ_STATUS_OK)
+                return URJ_STATUS_FAIL;
+        }
+        else if (filename == NULL)
+            filename = params[i];
+        else if (nnames < ARRAY_SIZE (names) - 1)
+            names[nnames++] = params[i];
+        else
+        {
+            urj_error_set (URJ_ERROR_SYNTAX, _("too many signals"));
+            return URJ_STATUS_FAIL;
+        }
+    }
+    names[nnames] = NULL;
+
+    if (filename == NULL || count == 0 || depth == 0 || ring == 0)
+    {
+        urj_error_set (URJ_ERROR_SYNTAX,
+                       _("%s: need FILE, and count, depth and ring >= 1"),
+                       params[0]);
+        return URJ_STATUS_FAIL;
+    }
+    /* with a time limit the count only caps the number of samples */
+    if (seconds != 0 && count == CAPTURE_DEFAULT_COUNT)
+        count = ~0UL;
+
+    if (urj_cmd_test_cable (chain) != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+
+    memset (&c, 0, sizeof c);
+    c.chain = chain;
+    c.part = urj_tap_chain_active_part (chain);
+    if (c.part == NULL)
+        return URJ_STATUS_FAIL;
+
+    c.bsr = urj_part_find_data_register (c.part, "BSR");
+    if (c.bsr == NULL)
+    {
+        urj_error_set (URJ_ERROR_NOTFOUND,
+                       _("Boundary Scan Register (BSR) not found"));
+        return URJ_STATUS_FAIL;
+    }
+
+    if (urj_part_find_instruction (c.part, "SAMPLE"))
+        urj_part_set_instruction (c.part, "SAMPLE");
+    else if (urj_part_find_instruction (c.part, "SAMPLE/PRELOAD"))
+        urj_part_set_instruction (c.part, "SAMPLE/PRELOAD");
+    else
+    {
+        urj_error_set (URJ_ERROR_UNSUPPORTED, _("Part can't SAMPLE"));
+        return URJ_STATUS_FAIL;
+    }
+
+    r = URJ_STATUS_FAIL;
+    c.depth = depth;
+    c.ring_size = ring;
+    c.frequency = urj_tap_cable_get_frequency (chain->cable);
+    c.tck = calloc (depth, sizeof *c.tck);
+    c.ring = calloc (ring, sizeof *c.ring);
+    if (c.tck == NULL || c.ring == NULL)
+    {
+        urj_error_set (URJ_ERROR_OUT_OF_MEMORY, "calloc fails");
+        goto done;
+    }
+
+    if (capture_signals (&c, names, nnames) != URJ_STATUS_OK)
+        goto done;
+
+    c.f = fopen (filename, FOPEN_W);
+    if (c.f == NULL)
+    {
+        urj_error_IO_set (_("Unable to create file `%s'"), filename);
+        goto done;
+    }
+
+    if (urj_tap_chain_shift_instructions (chain) != URJ_STATUS_OK)
+        goto done;
+
+    capture_header (&c);
+    r = capture_run (&c, count, seconds);
+    secs = urj_lib_frealtime () - c.start;
+
+    if (fclose (c.f) != 0 && r == URJ_STATUS_OK)
+    {
+        urj_error_IO_set (_("Error writing file `%s'"), filename);
+        r = URJ_STATUS_FAIL;
+    }
+    c.f = NULL;
+
+    if (r == URJ_STATUS_OK)
+        urj_log (URJ_LOG_LEVEL_NORMAL,
+                 _("%lu samples of %d signals in %.3f s (%.1f samples/s), "
+                   "%lu changes\n"),
+                 c.samples, c.nsigs, (double) secs,
+                 secs > 0 ? c.samples / (double) secs : 0.0, c.changes);
+
+  done:
+    if (c.f != NULL)
+        fclose (c.f);
+    free (c.tck);
+    free (c.ring);
+    free (c.sigs);
+    free (c.last);
+
+    return r;
+}
+
+static void
+cmd_capture_help (void)
+{
+    urj_log (URJ_LOG_LEVEL_NORMAL,
+             _("Usage: %s FILE [count=N] [seconds=S] [depth=D] [ring=R] "
+               "[SIGNAL...]\n"
+               "Sample the BSR of the active part continuously and write the\n"
+               "changes of the input signals to a VCD file.\n"
+               "\n"
+               "FILE       VCD output file\n"
+               "count=N    number of samples (default %d)\n"
+               "seconds=S  stop after S seconds\n"
+               "depth=D    scans kept in flight in the cable queue "
+               "(default %d)\n"
+               "ring=R     changes buffered before writing (default %d)\n"
+               "SIGNAL     signals to record (default: all inputs)\n"
+               "\n"
+               "Time stamps are derived from the TCK count when the cable\n"
+               "frequency is known, from the wall clock otherwise.\n"),
+             "capture", CAPTURE_DEFAULT_COUNT, CAPTURE_DEFAULT_DEPTH,
+             CAPTURE_DEFAULT_RING);
+}
+
+static void
+cmd_capture_complete (urj_chain_t *chain, char ***matches, size_t *match_cnt,
+                      char * const *tokens, const char *text, size_t text_len,
+                      size_t token_point)
+{
+    if (token_point == 1)
+        urj_completion_mayben_add_file (matches, match_cnt, text, text_len,
+                                        false);
+}
+
+const urj_cmd_t urj_cmd_capture = {
+    "capture",
+    N_("sample the BSR continuously into a VCD file"),
+    cmd_capture_help,
+    cmd_capture_run,
+    cmd_capture_complete,
+};
@@ -0,0 +1,222 @@
+/*
+ * $Id$
+ *
+ * Gang programming: one job on several cables in parallel
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ */
+
+#include <sysdep.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <urjtag/error.h>
+#include <urjtag/log.h>
+#include <urjtag/chain.h>
+#include <urjtag/cable.h>
+#include <urjtag/part.h>
+#include <urjtag/fclock.h>
+#include <urjtag/gang.h>
+
+#include <urjtag/cmd.h>
+
+#include "cmd.h"
+
+/* targets of the gang command, kept between invocations */
+static urj_gang_t *gang;
+
+static void
+gang_list (void)
+{
+    int i;
+
+    if (gang == NULL || gang->count == 0)
+    {
+        urj_log (URJ_LOG_LEVEL_NORMAL, _("No gang targets\n"));
+        return;
+    }
+
+    for (i = 0; i < gang->count; i++)
+    {
+        urj_chain_t *chain = gang->targets.chains[i];
+
+        urj_log (URJ_LOG_LEVEL_NORMAL, _("  [%d] cable %s, %d part(s)\n"), i,
+                 chain->cable->driver->name,
+                 chain->parts ? chain->parts->len : 0);
+    }
+}
+
+static void
+gang_report (double wall)
+{
+    double sum = 0.0;
+    int i, passed = 0;
+
+    for (i = 0; i < gang->count; i++)
+    {
+        const urj_gang_result_t *res = &gang->results[i];
+
+        sum += res->secs;
+        if (res->status == URJ_STATUS_OK)
+        {
+            passed++;
+            urj_log (URJ_LOG_LEVEL_NORMAL, _("  [%d] PASS %10.3f s\n"), i,
+                     res->secs);
+        }
+        else
+            urj_log (URJ_LOG_LEVEL_NORMAL, _("  [%d] FAIL %10.3f s  %s\n"), i,
+                     res->secs, res->error[0] ? res->error : _("failed"));
+    }
+
+    urj_log (URJ_LOG_LEVEL_NORMAL,
+             _("%d of %d targets passed in %.3f s (%.3f s of work, %.2fx)\n"),
+             passed, gang->count, wall, sum, wall > 0.0 ? sum / wall : 0.0);
+}
+
+static int
+cmd_gang_run (urj_chain_t *chain, char *params[])
+{
+    int paramc = urj_cmd_params (params);
+    long double start;
+    int r;
+
+    if (paramc < 2)
+    {
+        urj_error_set (URJ_ERROR_SYNTAX,
+                       "%s: #parameters should be >= %d, not %d",
+                       params[0], 2, paramc);
+        return URJ_STATUS_FAIL;
+    }
+
+    if (strcasecmp (params[1], "add") == 0)
+    {
+        if (paramc < 3)
+        {
+            urj_error_set (URJ_ERROR_SYNTAX,
+                           "%s: #parameters should be >= %d, not %d",
+                           params[0], 3, paramc);
+            return URJ_STATUS_FAIL;
+        }
+        if (gang == NULL && (gang = urj_gang_alloc ()) == NULL)
+            return URJ_STATUS_FAIL;
+
+        return urj_gang_add (gang, params[2], &params[3]);
+    }
+
+    if (strcasecmp (params[1], "list") == 0)
+    {
+        gang_list ();
+        return URJ_STATUS_OK;
+    }
+
+    if (strcasecmp (params[1], "free") == 0)
+    {
+        /* a job of the gang would free the threads it runs in */
+        if (gang != NULL && gang->running)
+        {
+            urj_error_set (URJ_ERROR_ILLEGAL_STATE,
+                           _("%s: can not free the gang while it runs"),
+                           params[0]);
+            return URJ_STATUS_FAIL;
+        }
+        urj_gang_free (gang);
+        gang = NULL;
+        return URJ_STATUS_OK;
+    }
+
+    if (strcasecmp (params[1], "run") == 0)
+    {
+        if (paramc < 3)
+        {
+            urj_error_set (URJ_ERROR_SYNTAX,
+                           "%s: #parameters should be >= %d, not %d",
+                           params[0], 3, paramc);
+            return URJ_STATUS_FAIL;
+        }
+        if (gang == NULL || gang->count == 0)
+        {
+            urj_error_set (URJ_ERROR_NO_CHAIN,
+                           _("%s: no targets, use '%s add' first"),
+                           params[0], params[0]);
+            return URJ_STATUS_FAIL;
+        }
+        if (gang->running)
+        {
+            urj_error_set (URJ_ERROR_ILLEGAL_STATE,
+                           _("%s: can not run the gang from one of its jobs"),
+                           params[0]);
+            return URJ_STATUS_FAIL;
+        }
+
+        start = urj_lib_frealtime ();
+        r = urj_gang_run (gang, &params[2]);
+        gang_report (urj_lib_frealtime () - start);
+
+        return r;
+    }
+
+    urj_error_set (URJ_ERROR_SYNTAX, "%s: unknown parameter '%s'",
+                   params[0], params[1]);
+    return URJ_STATUS_FAIL;
+}
+
+static void
+cmd_gang_help (void)
+{
+    urj_log (URJ_LOG_LEVEL_NORMAL,
+             _("Usage: %s add DRIVER [DRIVER_OPTS]\n"
+               "Usage: %s run COMMAND [ARGS...]\n"
+               "Usage: %s list|free\n"
+               "Run the same job on several cables in parallel.\n"
+               "\n"
+               "add   connect another target cable, as with 'cable'\n"
+               "run   run COMMAND on every target at the same time, one\n"
+               "      thread per target, and report pass/fail and time\n"
+               "list  show the targets\n"
+               "free  disconnect all targets\n"
+               "\n"
+               "Each target has its own chain, bus and flash state.  Use\n"
+               "'%s run include FILE' to run a whole job script, e.g.\n"
+               "detect, initbus and flashmem, on every target.  Log lines\n"
+               "of a target are prefixed with its number.\n"),
+             "gang", "gang", "gang", "gang");
+}
+
+static void
+cmd_gang_complete (urj_chain_t *chain, char ***matches, size_t *match_cnt,
+                   char * const *tokens, const char *text, size_t text_len,
+                   size_t token_point)
+{
+    static const char * const subcmds[] = { "add", "run", "list", "free" };
+    size_t i;
+
+    if (token_point != 1)
+        return;
+
+    for (i = 0; i < ARRAY_SIZE (subcmds); i++)
+        urj_completion_mayben_add_match (matches, match_cnt, text, text_len,
+                                         subcmds[i]);
+}
+
+const urj_cmd_t urj_cmd_gang = {
+    "gang",
+    N_("run one job on several cables in parallel"),
+    cmd_gang_help,
+    cmd_gang_run,
+    cmd_gang_complete,
+};
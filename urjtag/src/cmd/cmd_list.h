@@ -40,6 +40,9 @@
 #ifndef ENABLE_SVF
 #define URJ_CMD_SKIP_svf
 #endif
+#ifndef ENABLE_XSVF
+#define URJ_CMD_SKIP_xsvf
+#endif
 
 #include "generated_cmd_list.h"
 
@@ -41,14 +41,15 @@ cmd_readmem_run (urj_chain_t *chain, char *params[])
 {
     long unsigned adr;
     long unsigned len;
+    urj_bus_memfile_format_t format = URJ_BUS_MEMFILE_BINARY;
     int r;
     FILE *f;
 
-    if (urj_cmd_params (params) != 4)
+    if (urj_cmd_params (params) < 4 || urj_cmd_params (params) > 5)
     {
         urj_error_set (URJ_ERROR_SYNTAX,
-                       "%s: #parameters should be %d, not %d",
-                       params[0], 4, urj_cmd_params (params));
+                       "%s: #parameters should be %d or %d, not %d",
+                       params[0], 4, 5, urj_cmd_params (params));
         return URJ_STATUS_FAIL;
     }
 
@@ -61,14 +62,19 @@ cmd_readmem_run (urj_chain_t *chain, char *params[])
     if (urj_cmd_get_number (params[1], &adr) != URJ_STATUS_OK
         || urj_cmd_get_number (params[2], &len) != URJ_STATUS_OK)
         return URJ_STATUS_FAIL;
+    if (params[4] != NULL
+        && urj_bus_memfile_format (params[4], &format) != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
 
-    f = fopen (params[3], FOPEN_W);
+    /* a binary image is mapped, which needs read access too */
+    f = fopen (params[3],
+               format == URJ_BUS_MEMFILE_BINARY ? FOPEN_RW : FOPEN_W);
     if (!f)
     {
         urj_error_IO_set (_("Unable to create file `%s'"), params[3]);
         return URJ_STATUS_FAIL;
     }
-    r = urj_bus_readmem (urj_bus, f, adr, len);
+    r = urj_bus_readmem_format (urj_bus, f, adr, len, format);
     fclose (f);
 
     return r;
@@ -78,14 +84,16 @@ static void
 cmd_readmem_help (void)
 {
     urj_log (URJ_LOG_LEVEL_NORMAL,
-             _("Usage: %s ADDR LEN FILENAME\n"
+             _("Usage: %s ADDR LEN FILENAME [FORMAT]\n"
                "Copy device memory content starting with ADDR to FILENAME file.\n"
                "\n"
                "ADDR       start address of the copied memory area\n"
                "LEN        copied memory length\n"
                "FILENAME   name of the output file\n"
+               "FORMAT     binary (default), ihex, srec or elf\n"
                "\n"
-               "ADDR and LEN could be in decimal or hexadecimal (prefixed with 0x) form.\n"),
+               "ADDR and LEN could be in decimal or hexadecimal (prefixed with 0x) form.\n"
+               "The ihex, srec and elf files record ADDR with the data.\n"),
              "readmem");
 }
 
@@ -106,6 +114,17 @@ cmd_readmem_complete (urj_chain_t *chain, char ***matches, size_t *match_cnt,
         urj_completion_mayben_add_file (matches, match_cnt, text,
                                         text_len, false);
         break;
+
+    case 4: /* format */
+        urj_completion_mayben_add_match (matches, match_cnt, text, text_len,
+                                         "binary");
+        urj_completion_mayben_add_match (matches, match_cnt, text, text_len,
+                                         "ihex");
+        urj_completion_mayben_add_match (matches, match_cnt, text, text_len,
+                                         "srec");
+        urj_completion_mayben_add_match (matches, match_cnt, text, text_len,
+                                         "elf");
+        break;
     }
 }
 
@@ -0,0 +1,202 @@
+/*
+ * $Id$
+ *
+ * Cable queue statistics
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ */
+
+#include <sysdep.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <urjtag/error.h>
+#include <urjtag/log.h>
+#include <urjtag/chain.h>
+#include <urjtag/cable.h>
+
+#include <urjtag/cmd.h>
+
+#include "cmd.h"
+
+static const char * const stats_actions[URJ_CABLE_STATS_ACTIONS] = {
+    [URJ_TAP_CABLE_CLOCK] = "clock",
+    [URJ_TAP_CABLE_CLOCK_COMPACT] = "clock_compact",
+    [URJ_TAP_CABLE_GET_TDO] = "get_tdo",
+    [URJ_TAP_CABLE_TRANSFER] = "transfer",
+    [URJ_TAP_CABLE_SET_SIGNAL] = "set_signal",
+    [URJ_TAP_CABLE_GET_SIGNAL] = "get_signal",
+    [URJ_TAP_CABLE_CLOCK_TMS] = "clock_tms",
+};
+
+static const char * const stats_amounts[URJ_CABLE_STATS_FLUSH_AMOUNTS] = {
+    [URJ_TAP_CABLE_OPTIONALLY] = "optionally",
+    [URJ_TAP_CABLE_TO_OUTPUT] = "to_output",
+    [URJ_TAP_CABLE_COMPLETELY] = "completely",
+};
+
+static void
+stats_print (const urj_cable_t *cable)
+{
+    const urj_cable_stats_t *st = &cable->stats;
+    int a, h, last;
+
+    urj_log (URJ_LOG_LEVEL_NORMAL, _("Cable %s\n"), cable->driver->name);
+    urj_log (URJ_LOG_LEVEL_NORMAL, _("  TCK cycles:   %llu\n"), st->bits);
+
+    urj_log (URJ_LOG_LEVEL_NORMAL, _("  %-14s %10s %10s\n"),
+             _("operation"), _("queued"), _("direct"));
+    for (a = 0; a < URJ_CABLE_STATS_ACTIONS; a++)
+        if (st->items[a] != 0 || st->direct[a] != 0)
+            urj_log (URJ_LOG_LEVEL_NORMAL, "  %-14s %10lu %10lu\n",
+                     stats_actions[a], st->items[a], st->direct[a]);
+    urj_log (URJ_LOG_LEVEL_NORMAL, _("  queue high-water mark: %d items\n"),
+             st->high_water);
+
+    urj_log (URJ_LOG_LEVEL_NORMAL, _("  round trips:  %lu\n"),
+             st->round_trips);
+    urj_log (URJ_LOG_LEVEL_NORMAL, _("  bytes out:    %llu\n"), st->bytes_out);
+    urj_log (URJ_LOG_LEVEL_NORMAL, _("  bytes in:     %llu\n"), st->bytes_in);
+
+    urj_log (URJ_LOG_LEVEL_NORMAL, _("  %-14s %10s %12s\n"),
+             _("flush"), _("count"), _("seconds"));
+    for (a = 0; a < URJ_CABLE_STATS_FLUSH_AMOUNTS; a++)
+        urj_log (URJ_LOG_LEVEL_NORMAL, "  %-14s %10lu %12.6f\n",
+                 stats_amounts[a], st->flushes[a], st->flush_secs[a]);
+    if (!cable->stats_timing)
+        urj_log (URJ_LOG_LEVEL_NORMAL,
+                 _("  flushes are not timed, see 'stats timing on'\n"));
+
+    /* histogram rows up to the last non-empty bucket */
+    last = -1;
+    for (h = 0; h < URJ_CABLE_STATS_BUCKETS; h++)
+        for (a = 0; a < URJ_CABLE_STATS_FLUSH_AMOUNTS; a++)
+            if (st->latency[a][h] != 0)
+                last = h;
+    if (last < 0)
+        return;
+
+    urj_log (URJ_LOG_LEVEL_NORMAL, "  %-14s %10s %10s %10s\n",
+             _("flush latency"), stats_amounts[0], stats_amounts[1],
+             stats_amounts[2]);
+    for (h = 0; h <= last; h++)
+    {
+        if (h == URJ_CABLE_STATS_BUCKETS - 1)
+            urj_log (URJ_LOG_LEVEL_NORMAL, "  >= %8lu us", 1UL << (h - 1));
+        else
+            urj_log (URJ_LOG_LEVEL_NORMAL, "  <  %8lu us", 1UL << h);
+        for (a = 0; a < URJ_CABLE_STATS_FLUSH_AMOUNTS; a++)
+            urj_log (URJ_LOG_LEVEL_NORMAL, " %10lu", st->latency[a][h]);
+        urj_log (URJ_LOG_LEVEL_NORMAL, "\n");
+    }
+}
+
+static int
+cmd_stats_run (urj_chain_t *chain, char *params[])
+{
+    int paramc = urj_cmd_params (params);
+
+    if (paramc > 3)
+    {
+        urj_error_set (URJ_ERROR_SYNTAX,
+                       "%s: #parameters should be <= %d, not %d",
+                       params[0], 3, paramc);
+        return URJ_STATUS_FAIL;
+    }
+
+    if (urj_cmd_test_cable (chain) != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+
+    if (paramc == 1)
+    {
+        stats_print (chain->cable);
+        return URJ_STATUS_OK;
+    }
+
+    if (paramc == 2 && strcasecmp (params[1], "reset") == 0)
+    {
+        urj_tap_cable_stats_reset (chain->cable);
+        return URJ_STATUS_OK;
+    }
+
+    if (paramc == 3 && strcasecmp (params[1], "timing") == 0)
+    {
+        if (strcasecmp (params[2], "on") == 0)
+            chain->cable->stats_timing = 1;
+        else if (strcasecmp (params[2], "off") == 0)
+            chain->cable->stats_timing = 0;
+        else
+        {
+            urj_error_set (URJ_ERROR_SYNTAX, "%s: unknown parameter '%s'",
+                           params[0], params[2]);
+            return URJ_STATUS_FAIL;
+        }
+        return URJ_STATUS_OK;
+    }
+
+    urj_error_set (URJ_ERROR_SYNTAX, "%s: unknown parameter '%s'",
+                   params[0], params[1]);
+    return URJ_STATUS_FAIL;
+}
+
+static void
+cmd_stats_help (void)
+{
+    urj_log (URJ_LOG_LEVEL_NORMAL,
+             _("Usage: %s [reset]\n"
+               "Usage: %s timing on|off\n"
+               "Show or reset the statistics of the current cable.\n"
+               "\n"
+               "The counters cover TCK cycles, queued and direct cable\n"
+               "operations, the queue high-water mark, USB/parport round\n"
+               "trips and bytes, and flushes of the queue by amount.\n"
+               "\n"
+               "With timing on, every flush of a non-empty queue also reads\n"
+               "the clock twice to build a histogram of flush durations.\n"
+               "Timing is off by default.\n"),
+             "stats", "stats");
+}
+
+static void
+cmd_stats_complete (urj_chain_t *chain, char ***matches, size_t *match_cnt,
+                    char * const *tokens, const char *text, size_t text_len,
+                    size_t token_point)
+{
+    if (token_point == 1)
+    {
+        urj_completion_mayben_add_match (matches, match_cnt, text, text_len,
+                                         "reset");
+        urj_completion_mayben_add_match (matches, match_cnt, text, text_len,
+                                         "timing");
+    }
+    else if (token_point == 2 && strcasecmp (tokens[1], "timing") == 0)
+    {
+        urj_completion_mayben_add_match (matches, match_cnt, text, text_len,
+                                         "on");
+        urj_completion_mayben_add_match (matches, match_cnt, text, text_len,
+                                         "off");
+    }
+}
+
+const urj_cmd_t urj_cmd_stats = {
+    "stats",
+    N_("show or reset cable queue statistics"),
+    cmd_stats_help,
+    cmd_stats_run,
+    cmd_stats_complete,
+};
@@ -0,0 +1,204 @@
+/*
+ * $Id$
+ *
+ * Recording and replay of cable traces
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ */
+
+#include <sysdep.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <urjtag/error.h>
+#include <urjtag/log.h>
+#include <urjtag/chain.h>
+#include <urjtag/cable.h>
+#include <urjtag/trace.h>
+
+#include <urjtag/cmd.h>
+
+#include "cmd.h"
+
+static int
+cmd_trace_replay (urj_chain_t *chain, const char *filename)
+{
+    urj_tap_trace_report_t report;
+
+    if (urj_tap_trace_replay (chain->cable, filename,
+                              &report) != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+
+    urj_log (URJ_LOG_LEVEL_NORMAL,
+             _("%lu records, %llu TCK cycles, %lu mismatches\n"),
+             report.records, report.bits, report.mismatches);
+    urj_log (URJ_LOG_LEVEL_NORMAL,
+             _("recorded %.6f s, replayed %.6f s\n"),
+             report.recorded_secs, report.replayed_secs);
+
+    if (report.mismatches != 0)
+    {
+        urj_error_set (URJ_ERROR_INVALID,
+                       _("trace replay differs, first at record %lu"),
+                       report.first_mismatch);
+        return URJ_STATUS_FAIL;
+    }
+
+    return URJ_STATUS_OK;
+}
+
+static int
+cmd_trace_export (char *params[])
+{
+    urj_tap_trace_export_report_t report;
+    urj_tap_trace_format_t format = URJ_TAP_TRACE_SVF;
+    const char *ext = strrchr (params[3], '.');
+    int flags = 0;
+    int i;
+
+    if (ext != NULL && strcasecmp (ext, ".xsvf") == 0)
+        format = URJ_TAP_TRACE_XSVF;
+
+    for (i = 4; params[i] != NULL; i++)
+    {
+        if (strcasecmp (params[i], "svf") == 0)
+            format = URJ_TAP_TRACE_SVF;
+        else if (strcasecmp (params[i], "xsvf") == 0)
+            format = URJ_TAP_TRACE_XSVF;
+        else if (strcasecmp (params[i], "tdo") == 0)
+            flags |= URJ_TAP_TRACE_EXPORT_TDO;
+        else if (strcasecmp (params[i], "nopoll") == 0)
+            flags |= URJ_TAP_TRACE_EXPORT_NOPOLL;
+        else
+        {
+            urj_error_set (URJ_ERROR_SYNTAX,
+                           "%s: unknown parameter '%s'", params[0],
+                           params[i]);
+            return URJ_STATUS_FAIL;
+        }
+    }
+
+    if (urj_tap_trace_export (params[2], params[3], format, flags,
+                              &report) != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+
+    urj_log (URJ_LOG_LEVEL_NORMAL,
+             _("%lu records, %lu scans, %lu polling loops (%lu passes left out)\n"),
+             report.records, report.scans, report.polls, report.dropped);
+
+    return URJ_STATUS_OK;
+}
+
+static int
+cmd_trace_run (urj_chain_t *chain, char *params[])
+{
+    int paramc = urj_cmd_params (params);
+
+    /* a conversion needs no cable */
+    if (paramc >= 4 && paramc <= 7 && strcasecmp (params[1], "export") == 0)
+        return cmd_trace_export (params);
+
+    if (paramc < 2 || paramc > 3)
+    {
+        urj_error_set (URJ_ERROR_SYNTAX,
+                       "%s: #parameters should be %d or %d, not %d",
+                       params[0], 2, 3, paramc);
+        return URJ_STATUS_FAIL;
+    }
+
+    if (urj_cmd_test_cable (chain) != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+
+    if (paramc == 2 && strcasecmp (params[1], "stop") == 0)
+        return urj_tap_trace_stop (chain->cable);
+
+    if (paramc == 3 && strcasecmp (params[1], "record") == 0)
+        return urj_tap_trace_start (chain->cable, params[2]);
+
+    if (paramc == 3 && strcasecmp (params[1], "replay") == 0)
+        return cmd_trace_replay (chain, params[2]);
+
+    urj_error_set (URJ_ERROR_SYNTAX,
+                   "%s: unknown parameter '%s'", params[0], params[1]);
+    return URJ_STATUS_FAIL;
+}
+
+static void
+cmd_trace_help (void)
+{
+    urj_log (URJ_LOG_LEVEL_NORMAL,
+             _("Usage: %s record FILENAME\n"
+               "Usage: %s stop\n"
+               "Usage: %s replay FILENAME\n"
+               "Usage: %s export FILENAME OUTFILE [svf|xsvf] [tdo] [nopoll]\n"
+               "Record cable operations to a binary trace, replay one or\n"
+               "convert one to SVF or XSVF.\n"
+               "\n"
+               "'record' writes every clock, get_tdo, transfer and signal\n"
+               "operation on the current cable, with its TDI and the TDO the\n"
+               "cable returned, to FILENAME until 'stop'.\n"
+               "\n"
+               "'replay' issues the operations of FILENAME on the current\n"
+               "cable, compares the results with the recorded ones and reports\n"
+               "mismatches and timing. The replay bypasses the TAP state\n"
+               "tracking of the chain; run 'reset' afterwards.\n"
+               "\n"
+               "'export' follows the TAP state through the recorded clocks and\n"
+               "writes the scans, state changes and waits of FILENAME as an SVF\n"
+               "file, or an XSVF file if OUTFILE ends in .xsvf or 'xsvf' is\n"
+               "given. The recording must begin with 'reset'. With 'tdo' the\n"
+               "TDO the cable returned is checked. Polling loops, scans\n"
+               "reading the same TDO until it changed, become one pass, a\n"
+               "wait as long as the loop took and the final pass; 'nopoll'\n"
+               "keeps every pass.\n"),
+             "trace", "trace", "trace", "trace");
+}
+
+static void
+cmd_trace_complete (urj_chain_t *chain, char ***matches, size_t *match_cnt,
+                    char * const *tokens, const char *text, size_t text_len,
+                    size_t token_point)
+{
+    switch (token_point)
+    {
+    case 1:
+        urj_completion_mayben_add_match (matches, match_cnt, text, text_len,
+                                         "record");
+        urj_completion_mayben_add_match (matches, match_cnt, text, text_len,
+                                         "stop");
+        urj_completion_mayben_add_match (matches, match_cnt, text, text_len,
+                                         "replay");
+        urj_completion_mayben_add_match (matches, match_cnt, text, text_len,
+                                         "export");
+        break;
+
+    case 2:
+    case 3:
+        urj_completion_mayben_add_file (matches, match_cnt, text,
+                                        text_len, false);
+        break;
+    }
+}
+
+const urj_cmd_t urj_cmd_trace = {
+    "trace",
+    N_("record, replay or export a binary trace of cable operations"),
+    cmd_trace_help,
+    cmd_trace_run,
+    cmd_trace_complete,
+};
@@ -39,14 +39,15 @@ cmd_writemem_run (urj_chain_t *chain, char *params[])
 {
     long unsigned adr;
     long unsigned len;
+    urj_bus_memfile_format_t format = URJ_BUS_MEMFILE_BINARY;
     FILE *f;
     int r;
 
-    if (urj_cmd_params (params) != 4)
+    if (urj_cmd_params (params) < 4 || urj_cmd_params (params) > 5)
     {
         urj_error_set (URJ_ERROR_SYNTAX,
-                       "%s: #parameters should be %d, not %d",
-                       params[0], 4, urj_cmd_params (params));
+                       "%s: #parameters should be %d or %d, not %d",
+                       params[0], 4, 5, urj_cmd_params (params));
         return URJ_STATUS_FAIL;
     }
 
@@ -59,6 +60,9 @@ cmd_writemem_run (urj_chain_t *chain, char *params[])
     if (urj_cmd_get_number (params[1], &adr) != URJ_STATUS_OK
         || urj_cmd_get_number (params[2], &len) != URJ_STATUS_OK)
         return URJ_STATUS_FAIL;
+    if (params[4] != NULL
+        && urj_bus_memfile_format (params[4], &format) != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
 
     f = fopen (params[3], FOPEN_R);
     if (!f)
@@ -66,7 +70,7 @@ cmd_writemem_run (urj_chain_t *chain, char *params[])
         urj_error_IO_set (_("Unable to open file `%s'"), params[3]);
         return URJ_STATUS_FAIL;
     }
-    r = urj_bus_writemem (urj_bus, f, adr, len);
+    r = urj_bus_writemem_format (urj_bus, f, adr, len, format);
     fclose (f);
 
     return r;
@@ -87,6 +91,17 @@ cmd_writemem_complete (urj_chain_t *chain, char ***matches, size_t *match_cnt,
         urj_completion_mayben_add_file (matches, match_cnt, text,
                                         text_len, false);
         break;
+
+    case 4: /* format */
+        urj_completion_mayben_add_match (matches, match_cnt, text, text_len,
+                                         "binary");
+        urj_completion_mayben_add_match (matches, match_cnt, text, text_len,
+                                         "ihex");
+        urj_completion_mayben_add_match (matches, match_cnt, text, text_len,
+                                         "srec");
+        urj_completion_mayben_add_match (matches, match_cnt, text, text_len,
+                                         "elf");
+        break;
     }
 }
 
@@ -94,14 +109,17 @@ static void
 cmd_writemem_help (void)
 {
     urj_log (URJ_LOG_LEVEL_NORMAL,
-             _("Usage: %s ADDR LEN FILENAME\n"
+             _("Usage: %s ADDR LEN FILENAME [FORMAT]\n"
                "Write to device memory starting at ADDR the FILENAME file.\n"
                "\n"
                "ADDR       start address of the written memory area\n"
                "LEN        written memory length\n"
                "FILENAME   name of the input file\n"
+               "FORMAT     binary (default), ihex, srec or elf\n"
                "\n"
                "ADDR and LEN could be in decimal or hexadecimal (prefixed with 0x) form.\n"
+               "The ihex, srec and elf files carry their own addresses; only the\n"
+               "data within ADDR..ADDR+LEN-1 is written, other memory is untouched.\n"
                "NOTE: This is NOT useful for FLASH programming!\n"),
              "writemem");
 }
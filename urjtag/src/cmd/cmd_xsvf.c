@@ -0,0 +1,124 @@
+/*
+ * $Id$
+ *
+ * Play an XSVF file
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ */
+
+#include <sysdep.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <urjtag/error.h>
+#include <urjtag/log.h>
+
+#include <urjtag/xsvf.h>
+#include <urjtag/cmd.h>
+
+#include "cmd.h"
+
+static int
+cmd_xsvf_run (urj_chain_t *chain, char *params[])
+{
+    FILE *XSVF_FILE;
+    int num_params, i;
+    int print_progress = 0;
+    urj_log_level_t old_log_level = urj_log_state.level;
+    int result;
+
+    num_params = urj_cmd_params (params);
+    if (num_params < 2)
+    {
+        urj_error_set (URJ_ERROR_SYNTAX,
+                       "%s: #parameters should be >= %d, not %d",
+                       params[0], 2, num_params);
+        return URJ_STATUS_FAIL;
+    }
+
+    for (i = 2; i < num_params; i++)
+    {
+        if (strcasecmp (params[i], "progress") == 0)
+            print_progress = 1;
+        else
+        {
+            urj_error_set (URJ_ERROR_SYNTAX, "%s: unknown command '%s'",
+                           params[0], params[i]);
+            return URJ_STATUS_FAIL;
+        }
+    }
+
+    if (urj_cmd_test_cable (chain) != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+
+    if ((XSVF_FILE = fopen (params[1], FOPEN_R)) == NULL)
+    {
+        urj_error_IO_set ("%s: cannot open file '%s'", params[0], params[1]);
+        return URJ_STATUS_FAIL;
+    }
+
+    if (print_progress)
+        urj_log_state.level = URJ_LOG_LEVEL_DETAIL;
+
+    result = urj_xsvf_run (chain, XSVF_FILE);
+
+    urj_log_state.level = old_log_level;
+    fclose (XSVF_FILE);
+
+    return result;
+}
+
+static void
+cmd_xsvf_complete (urj_chain_t *chain, char ***matches, size_t *match_cnt,
+                   char * const *tokens, const char *text, size_t text_len,
+                   size_t token_point)
+{
+    switch (token_point)
+    {
+    case 1:
+        urj_completion_mayben_add_file (matches, match_cnt, text,
+                                        text_len, false);
+        break;
+
+    default:
+        urj_completion_mayben_add_match (matches, match_cnt, text, text_len,
+                                         "progress");
+        break;
+    }
+}
+
+static void
+cmd_xsvf_help (void)
+{
+    urj_log (URJ_LOG_LEVEL_NORMAL,
+             _("Usage: %s FILE [progress]\n"
+               "Play the Xilinx XSVF file FILE on the whole chain.\n"
+               "progress : Show comments, the position in FILE and a summary.\n"
+               "\n"
+               "The file is played as is, without 'detect'.  A TDO mismatch\n"
+               "that persists through the XREPEAT retries stops the player.\n"),
+             "xsvf");
+}
+
+const urj_cmd_t urj_cmd_xsvf = {
+    "xsvf",
+    N_("play an XSVF file"),
+    cmd_xsvf_help,
+    cmd_xsvf_run,
+    cmd_xsvf_complete,
+};
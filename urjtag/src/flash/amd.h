@@ -38,7 +38,7 @@
 #include <urjtag/flash.h>
 
 int urj_flash_amd_detect (urj_bus_t *bus, uint32_t adr,
-                          urj_flash_cfi_array_t **urj_flash_cfi_array);
+                          urj_flash_cfi_array_t **cfi_array);
 
 extern const urj_flash_driver_t urj_flash_amd_32_flash_driver;
 extern const urj_flash_driver_t urj_flash_amd_16_flash_driver;
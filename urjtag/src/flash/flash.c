@@ -51,8 +51,12 @@
 #include "intel.h"
 #include "amd.h"
 #include "spi_flash.h"
+#include "stub.h"
 
 const urj_flash_driver_t * const urj_flash_flash_drivers[] = {
+    &urj_flash_stub_32_flash_driver,    /* before the drivers it calls */
+    &urj_flash_stub_16_flash_driver,
+    &urj_flash_stub_8_flash_driver,
     &urj_flash_amd_32_flash_driver,
     &urj_flash_amd_16_flash_driver,
     &urj_flash_amd_8_flash_driver,
@@ -296,8 +300,161 @@ find_block (urj_flash_cfi_query_structure_t *cfi, int adr, int bus_width,
     return -1;
 }
 
-int
-urj_flashmem (urj_bus_t *bus, FILE *f, uint32_t addr, int noverify)
+#define BSIZE (1 << 12)
+
+/*
+ * Compare the next len bytes of f, or what is left of it, with the flash
+ * from *adr on.  *adr is advanced past the words that compared equal.
+ */
+static int
+verify_words (urj_bus_t *bus, FILE *f, uint32_t *adr, uint32_t len)
+{
+    while (len > 0 && !feof (f))
+    {
+        uint32_t data, readed;
+        uint8_t b[BSIZE];
+        int bc = 0, bn = 0, btr = len < BSIZE ? len : BSIZE;
+
+        // @@@@ RFHH check error state?
+        bn = fread (b, 1, btr, f);
+        if (bn <= 0)
+            break;
+        len -= bn;
+
+        /* start consecutive read */
+        URJ_BUS_READ_START (bus, *adr);
+
+        for (bc = 0; bc < bn; bc += flash_driver->bus_width)
+        {
+            int j;
+            uint32_t next_adr = *adr + flash_driver->bus_width;
+
+            if ((*adr & 0xFF) == 0)
+            {
+                urj_log (URJ_LOG_LEVEL_NORMAL, _("addr: 0x%08lX"),
+                         (long unsigned) *adr);
+                urj_log (URJ_LOG_LEVEL_NORMAL, "\r");
+            }
+
+            data = 0;
+            for (j = 0; j < flash_driver->bus_width; j++)
+                if (urj_get_file_endian () == URJ_ENDIAN_BIG)
+                    data = (data << 8) | b[bc + j];
+                else
+                    data |= b[bc + j] << (j * 8);
+
+            readed = URJ_BUS_READ_NEXT (bus, next_adr);
+            if (data != readed)
+            {
+                /* end consecutive read */
+                (void) URJ_BUS_READ_END (bus);
+
+                urj_error_set (URJ_ERROR_FLASH_PROGRAM,
+                               _("addr: 0x%08lX\n verify error:\nread: 0x%08lX\nexpected: 0x%08lX\n"),
+                                 (long unsigned) *adr, (long unsigned) readed,
+                                 (long unsigned) data);
+                return URJ_STATUS_FAIL;
+            }
+            *adr = next_adr;
+        }
+
+        /* end consecutive read
+           this wastes one read access but saves us from determining the for-loop
+           finish condition twice within the loop */
+        (void) URJ_BUS_READ_END (bus);
+    }
+
+    return URJ_STATUS_OK;
+}
+
+/*
+ * Compare a CRC-32 per erase block instead of every word; the flash side
+ * is summed up by the target or at least without a round trip per word.
+ * Only a block that does not match is read back word by word, to report
+ * where it differs.
+ */
+static int
+verify_crc (urj_bus_t *bus, FILE *f, uint32_t addr)
+{
+    urj_flash_cfi_query_structure_t *cfi = &urj_flash_cfi_array->cfi_chips[0]->cfi;
+    int bus_width = urj_flash_cfi_array->bus_width;
+    int chip_width = urj_flash_cfi_array->cfi_chips[0]->width;
+    int width = flash_driver->bus_width;
+    int big = urj_get_file_endian () == URJ_ENDIAN_BIG;
+    uint32_t adr = addr;
+
+    urj_log (URJ_LOG_LEVEL_NORMAL, _("verify (CRC-32 per block):\n"));
+    while (!feof (f))
+    {
+        uint8_t b[BSIZE];
+        uint32_t data, crc = 0, flash_crc = 0, len = 0;
+        long pos = ftell (f);
+        int bc, bn, j, btr = BSIZE;
+        int block_no = find_block (cfi, adr - urj_flash_cfi_array->address,
+                                   bus_width, chip_width, &btr);
+
+        if (block_no < 0)
+        {
+            urj_error_set (URJ_ERROR_FLASH_PROGRAM,
+                           _("addr: 0x%08lX is outside of the flash"),
+                           (long unsigned) adr);
+            return URJ_STATUS_FAIL;
+        }
+
+        /* the part of the image that went into this block */
+        while (btr > 0)
+        {
+            memset (b, 0, sizeof b);
+            bn = fread (b, 1, btr < BSIZE ? btr : BSIZE, f);
+            if (bn <= 0)
+                break;
+            for (bc = 0; bc < bn; bc += width)
+            {
+                data = 0;
+                for (j = 0; j < width; j++)
+                    if (big)
+                        data = (data << 8) | b[bc + j];
+                    else
+                        data |= b[bc + j] << (j * 8);
+
+                crc = urj_bus_crc32_word (crc, data, width);
+                len += width;
+            }
+            btr -= bn;
+        }
+        if (len == 0)
+            break;
+
+        urj_log (URJ_LOG_LEVEL_NORMAL, _("addr: 0x%08lX"), (long unsigned) adr);
+        urj_log (URJ_LOG_LEVEL_NORMAL, "\r");
+        if (urj_bus_crc32 (bus, adr, len, &flash_crc) != URJ_STATUS_OK)
+            return URJ_STATUS_FAIL;
+
+        if (flash_crc != crc)
+        {
+            urj_log (URJ_LOG_LEVEL_NORMAL,
+                     _("\nblock %d: CRC 0x%08lX, expected 0x%08lX\n"),
+                     block_no, (long unsigned) flash_crc, (long unsigned) crc);
+            fseek (f, pos, SEEK_SET);
+            if (verify_words (bus, f, &adr, len) != URJ_STATUS_OK)
+                return URJ_STATUS_FAIL;
+
+            urj_error_set (URJ_ERROR_FLASH_PROGRAM,
+                           _("block %d: CRC mismatch, but the words read back equal"),
+                           block_no);
+            return URJ_STATUS_FAIL;
+        }
+        adr += len;
+    }
+
+    urj_log (URJ_LOG_LEVEL_NORMAL, _("addr: 0x%08lX\nDone.\n"),
+             (long unsigned) adr - width);
+
+    return URJ_STATUS_OK;
+}
+
+static int
+flashmem (urj_bus_t *bus, FILE *f, uint32_t addr, int noverify, int crc)
 {
     uint32_t adr;
     urj_flash_cfi_query_structure_t *cfi;
@@ -306,7 +463,6 @@ urj_flashmem (urj_bus_t *bus, FILE *f, uint32_t addr, int noverify)
     int neb;
     int bus_width;
     int chip_width;
-#define BSIZE (1 << 12)
     uint32_t write_buffer[BSIZE];
     int write_buffer_count;
     uint32_t write_buffer_adr;
@@ -416,65 +572,31 @@ urj_flashmem (urj_bus_t *bus, FILE *f, uint32_t addr, int noverify)
     }
 
     fseek (f, 0, SEEK_SET);
+    if (crc)
+        return verify_crc (bus, f, addr);
+
     urj_log (URJ_LOG_LEVEL_NORMAL, _("verify:\n"));
     adr = addr;
-    while (!feof (f))
-    {
-        uint32_t data, readed;
-        uint8_t b[BSIZE];
-        int bc = 0, bn = 0, btr = BSIZE;
-
-        // @@@@ RFHH check error state?
-        bn = fread (b, 1, btr, f);
-
-        /* start consecutive read */
-        URJ_BUS_READ_START (bus, adr);
-
-        for (bc = 0; bc < bn; bc += flash_driver->bus_width)
-        {
-            int j;
-            uint32_t next_adr = adr + flash_driver->bus_width;
-
-            if ((adr & 0xFF) == 0)
-            {
-                urj_log (URJ_LOG_LEVEL_NORMAL, _("addr: 0x%08lX"),
-                         (long unsigned) adr);
-                urj_log (URJ_LOG_LEVEL_NORMAL, "\r");
-            }
-
-            data = 0;
-            for (j = 0; j < flash_driver->bus_width; j++)
-                if (urj_get_file_endian () == URJ_ENDIAN_BIG)
-                    data = (data << 8) | b[bc + j];
-                else
-                    data |= b[bc + j] << (j * 8);
-
-            readed = URJ_BUS_READ_NEXT (bus, next_adr);
-            if (data != readed)
-            {
-                /* end consecutive read */
-                (void) URJ_BUS_READ_END (bus);
-
-                urj_error_set (URJ_ERROR_FLASH_PROGRAM,
-                               _("addr: 0x%08lX\n verify error:\nread: 0x%08lX\nexpected: 0x%08lX\n"),
-                                 (long unsigned) adr, (long unsigned) readed,
-                                 (long unsigned) data);
-                return URJ_STATUS_FAIL;
-            }
-            adr = next_adr;
-        }
-
-        /* end consecutive read
-           this wastes one read access but saves us from determining the for-loop
-           finish condition twice within the loop */
-        (void) URJ_BUS_READ_END (bus);
-    }
+    if (verify_words (bus, f, &adr, UINT32_MAX) != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
     urj_log (URJ_LOG_LEVEL_NORMAL, _("addr: 0x%08lX\nDone.\n"),
              (long unsigned) adr - flash_driver->bus_width);
 
     return URJ_STATUS_OK;
 }
 
+int
+urj_flashmem (urj_bus_t *bus, FILE *f, uint32_t addr, int noverify)
+{
+    return flashmem (bus, f, addr, noverify, 0);
+}
+
+int
+urj_flashmem_crc (urj_bus_t *bus, FILE *f, uint32_t addr)
+{
+    return flashmem (bus, f, addr, 0, 1);
+}
+
 int
 urj_flasherase (urj_bus_t *bus, uint32_t addr, uint32_t number)
 {
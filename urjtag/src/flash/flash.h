@@ -52,6 +52,8 @@ struct URJ_FLASH_CFI_ARRAY
     urj_flash_cfi_chip_t **cfi_chips;
 };
 
-extern urj_flash_cfi_array_t *urj_flash_cfi_array;
+/* Flash array of the calling thread's context, see context.h */
+urj_flash_cfi_array_t **urj_context_flash_cfi_array (void);
+#define urj_flash_cfi_array (*urj_context_flash_cfi_array ())
 
 #endif /* URJ_FLASH_H */
@@ -99,10 +99,10 @@ struct amd_flash_info
 
 
 int urj_flash_jedec_detect (urj_bus_t *bus, uint32_t adr,
-                            urj_flash_cfi_array_t **urj_flash_cfi_array);
+                            urj_flash_cfi_array_t **cfi_array);
 #ifdef JEDEC_EXP
 int urj_flash_jedec_exp_detect (urj_bus_t *bus, uint32_t adr,
-                                urj_flash_cfi_array_t **urj_flash_cfi_array);
+                                urj_flash_cfi_array_t **cfi_array);
 #endif
 
 #endif /* ndef URJ_FLASH_JEDEC_H */
@@ -0,0 +1,479 @@
+/*
+ * $Id$
+ *
+ * Flash programming through a target-resident stub
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ * Busses that can execute code on the target (see stub_area/stub_run in
+ * <urjtag/bus_driver.h>) get their AMD and Intel flash erased and
+ * programmed by a small stub in target RAM.  The host only downloads the
+ * data and the command cycles; the stub writes them and polls the flash
+ * status at CPU speed, so a whole buffer costs a few scans instead of
+ * several bus cycles per word.  Identification, locking and read array
+ * mode are left to the regular AMD and Intel drivers.
+ *
+ */
+
+#include <sysdep.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#include <urjtag/error.h>
+#include <urjtag/log.h>
+#include <urjtag/flash.h>
+#include <urjtag/bus.h>
+#include <urjtag/bus_driver.h>
+
+#include "flash.h"
+#include "cfi.h"
+#include "amd.h"
+#include "intel.h"
+#include "stub.h"
+#include "../bus/generic_bus.h"
+
+/* units per stub run */
+#define STUB_UNITS      ((URJ_BUS_STUB_SIZE - URJ_BUS_STUB_BUFFER) / 4)
+
+/* status polls per unit */
+#define PROGRAM_TIMEOUT (1 << 20)
+#define ERASE_TIMEOUT   (1 << 28)
+
+#define AMD_CMD_ERASE_SETUP     0x80
+#define AMD_CMD_SECTOR_ERASE    0x30
+#define AMD_CMD_PROGRAM         0xA0
+
+#define INTEL_SR_PROGRAM_ERRORS (CFI_INTEL_SR_PROGRAM_ERROR \
+                                 | CFI_INTEL_SR_VPEN_ERROR \
+                                 | CFI_INTEL_SR_BLOCK_LOCKED)
+#define INTEL_SR_ERASE_ERRORS   (CFI_INTEL_SR_ERASE_ERROR \
+                                 | INTEL_SR_PROGRAM_ERRORS)
+
+typedef struct
+{
+    urj_flash_cfi_array_t *cfi_array;
+    uint32_t area;
+    uint32_t mailbox[URJ_BUS_STUB_MB_WORDS];
+}
+stub_job_t;
+
+#define MB(job,off)     ((job)->mailbox[(off) / 4])
+
+static int
+stub_is_amd (const urj_flash_driver_t *driver)
+{
+    return driver == &urj_flash_amd_32_flash_driver
+        || driver == &urj_flash_amd_16_flash_driver
+        || driver == &urj_flash_amd_8_flash_driver;
+}
+
+static int
+stub_is_intel (const urj_flash_driver_t *driver)
+{
+    return driver == &urj_flash_intel_32_flash_driver
+        || driver == &urj_flash_intel_16_flash_driver
+        || driver == &urj_flash_intel_8_flash_driver;
+}
+
+/* The driver that would handle the flash without the stub */
+static const urj_flash_driver_t *
+stub_base_driver (urj_flash_cfi_array_t *cfi_array)
+{
+    const urj_flash_driver_t *driver;
+    int i;
+
+    for (i = 0; urj_flash_flash_drivers[i] != NULL; i++)
+    {
+        driver = urj_flash_flash_drivers[i];
+        if (driver == &urj_flash_stub_32_flash_driver
+            || driver == &urj_flash_stub_16_flash_driver
+            || driver == &urj_flash_stub_8_flash_driver)
+            continue;
+        if (driver->autodetect (cfi_array))
+            return driver;
+    }
+
+    return NULL;
+}
+
+/* see amd_flash_address_shift() */
+static int
+stub_amd_address_shift (urj_flash_cfi_array_t *cfi_array)
+{
+    if (cfi_array->bus_width == 4)
+        return 2;
+
+    switch (cfi_array->cfi_chips[0]->cfi.device_geometry.device_interface)
+    {
+    case CFI_INTERFACE_X8_X16:
+    case CFI_INTERFACE_X16:
+        return 1;
+
+    case CFI_INTERFACE_X16_X32:
+    case CFI_INTERFACE_X32:
+        return 2;
+
+    default:
+        break;
+    }
+
+    if (cfi_array->bus_width == 2)
+        return 1;
+
+    return 0;
+}
+
+static uint32_t
+stub_mask (urj_flash_cfi_array_t *cfi_array)
+{
+    if (cfi_array->bus_width >= 4)
+        return UINT32_C (0xffffffff);
+
+    return (UINT32_C (1) << (8 * cfi_array->bus_width)) - 1;
+}
+
+/* A command or status value for every chip on the bus, as the drivers do */
+static uint32_t
+stub_cmd (urj_flash_cfi_array_t *cfi_array, uint32_t cmd)
+{
+    return ((cmd << 16) | cmd) & stub_mask (cfi_array);
+}
+
+/** @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error */
+static int
+stub_job_init (stub_job_t *job, urj_flash_cfi_array_t *cfi_array,
+               int write, uint32_t smask, uint32_t emask, uint32_t timeout)
+{
+    urj_bus_t *bus = cfi_array->bus;
+
+    if (bus->driver->stub_area == NULL
+        || bus->driver->stub_area (bus, &job->area) != URJ_STATUS_OK)
+    {
+        urj_error_set (URJ_ERROR_UNSUPPORTED, _("bus has no stub workarea"));
+        return URJ_STATUS_FAIL;
+    }
+
+    job->cfi_array = cfi_array;
+    memset (job->mailbox, 0, sizeof job->mailbox);
+    MB (job, URJ_BUS_STUB_MB_WRITE) = write;
+    MB (job, URJ_BUS_STUB_MB_SMASK) = smask;
+    MB (job, URJ_BUS_STUB_MB_EMASK) = emask;
+    MB (job, URJ_BUS_STUB_MB_TIMEOUT) = timeout;
+
+    return URJ_STATUS_OK;
+}
+
+/* Add a command cycle; an address of ~0 stands for the current unit */
+static void
+stub_job_cycle (stub_job_t *job, uint32_t adr, uint32_t data)
+{
+    uint32_t n = MB (job, URJ_BUS_STUB_MB_NCYCLES);
+
+    MB (job, URJ_BUS_STUB_MB_CYCLES + 8 * n) = adr;
+    MB (job, URJ_BUS_STUB_MB_CYCLES + 8 * n + 4) = data;
+    MB (job, URJ_BUS_STUB_MB_NCYCLES) = n + 1;
+}
+
+/** @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error */
+static int
+stub_job_run (stub_job_t *job, uint32_t adr, const uint32_t *src, int count,
+              urj_error_t err)
+{
+    urj_flash_cfi_array_t *cfi_array = job->cfi_array;
+    urj_bus_t *bus = cfi_array->bus;
+    uint32_t status;
+    int n;
+
+    while (count > 0)
+    {
+        n = count < STUB_UNITS ? count : STUB_UNITS;
+
+        if (urj_bus_generic_write_words (bus, job->area + URJ_BUS_STUB_BUFFER,
+                                         src, n) != URJ_STATUS_OK)
+        {
+            urj_error_set (err, _("flash stub buffer upload failed at 0x%08lX"),
+                           (long unsigned) adr);
+            return URJ_STATUS_FAIL;
+        }
+        MB (job, URJ_BUS_STUB_MB_DST) = adr;
+        MB (job, URJ_BUS_STUB_MB_SRC) = job->area + URJ_BUS_STUB_BUFFER;
+        MB (job, URJ_BUS_STUB_MB_COUNT) = n;
+
+        if (bus->driver->stub_run (bus, job->mailbox, cfi_array->bus_width)
+            != URJ_STATUS_OK)
+            return URJ_STATUS_FAIL;
+
+        status = URJ_BUS_READ (bus, job->area + URJ_BUS_STUB_MAILBOX
+                               + URJ_BUS_STUB_MB_STATUS);
+        if (status != 0)
+        {
+            adr += (n - status) * cfi_array->bus_width;
+            urj_error_set (err, _("flash stub failed at 0x%08lX"),
+                           (long unsigned) adr);
+            return URJ_STATUS_FAIL;
+        }
+
+        adr += n * cfi_array->bus_width;
+        src += n;
+        count -= n;
+    }
+
+    return URJ_STATUS_OK;
+}
+
+static int
+stub_flash_autodetect (urj_flash_cfi_array_t *cfi_array,
+                       unsigned int bus_width)
+{
+    const urj_flash_driver_t *driver;
+    urj_bus_t *bus = cfi_array->bus;
+    uint32_t area;
+
+    if (cfi_array->bus_width != bus_width)
+        return 0;
+    if (bus->driver->stub_area == NULL
+        || bus->driver->stub_area (bus, &area) != URJ_STATUS_OK)
+        return 0;
+
+    driver = stub_base_driver (cfi_array);
+    if (driver == NULL || driver->bus_width != bus_width)
+        return 0;
+
+    return stub_is_amd (driver) || stub_is_intel (driver);
+}
+
+static int
+stub_flash_autodetect32 (urj_flash_cfi_array_t *cfi_array)
+{
+    return stub_flash_autodetect (cfi_array, 4);
+}
+
+static int
+stub_flash_autodetect16 (urj_flash_cfi_array_t *cfi_array)
+{
+    return stub_flash_autodetect (cfi_array, 2);
+}
+
+static int
+stub_flash_autodetect8 (urj_flash_cfi_array_t *cfi_array)
+{
+    return stub_flash_autodetect (cfi_array, 1);
+}
+
+static void
+stub_flash_print_info (urj_log_level_t ll, urj_flash_cfi_array_t *cfi_array)
+{
+    const urj_flash_driver_t *driver = stub_base_driver (cfi_array);
+    uint32_t area;
+
+    cfi_array->bus->driver->stub_area (cfi_array->bus, &area);
+    urj_log (ll, _("Programmed by target stub at 0x%08lX\n"),
+             (long unsigned) area);
+    if (driver != NULL)
+        driver->print_info (ll, cfi_array);
+}
+
+static int
+stub_flash_erase_block (urj_flash_cfi_array_t *cfi_array, uint32_t adr)
+{
+    const urj_flash_driver_t *driver = stub_base_driver (cfi_array);
+    urj_bus_t *bus = cfi_array->bus;
+    uint32_t erased = stub_mask (cfi_array);
+    stub_job_t job;
+    int r;
+
+    if (driver == NULL)
+    {
+        urj_error_set (URJ_ERROR_NOTFOUND, _("no flash driver found"));
+        return URJ_STATUS_FAIL;
+    }
+
+    if (stub_is_amd (driver))
+    {
+        int o = stub_amd_address_shift (cfi_array);
+
+        /* wait until the sector reads back erased */
+        if (stub_job_init (&job, cfi_array, 0, 0, 0, ERASE_TIMEOUT)
+            != URJ_STATUS_OK)
+            return URJ_STATUS_FAIL;
+        stub_job_cycle (&job, cfi_array->address + (0x0555 << o),
+                        stub_cmd (cfi_array, 0xAA));
+        stub_job_cycle (&job, cfi_array->address + (0x02aa << o),
+                        stub_cmd (cfi_array, 0x55));
+        stub_job_cycle (&job, cfi_array->address + (0x0555 << o),
+                        stub_cmd (cfi_array, AMD_CMD_ERASE_SETUP));
+        stub_job_cycle (&job, cfi_array->address + (0x0555 << o),
+                        stub_cmd (cfi_array, 0xAA));
+        stub_job_cycle (&job, cfi_array->address + (0x02aa << o),
+                        stub_cmd (cfi_array, 0x55));
+        stub_job_cycle (&job, ~UINT32_C (0),
+                        stub_cmd (cfi_array, AMD_CMD_SECTOR_ERASE));
+    }
+    else
+    {
+        URJ_BUS_WRITE (bus, adr,
+                       stub_cmd (cfi_array,
+                                 CFI_INTEL_CMD_CLEAR_STATUS_REGISTER));
+        if (stub_job_init (&job, cfi_array, 0,
+                           stub_cmd (cfi_array, CFI_INTEL_SR_READY),
+                           stub_cmd (cfi_array, INTEL_SR_ERASE_ERRORS),
+                           ERASE_TIMEOUT) != URJ_STATUS_OK)
+            return URJ_STATUS_FAIL;
+        stub_job_cycle (&job, ~UINT32_C (0),
+                        stub_cmd (cfi_array, CFI_INTEL_CMD_BLOCK_ERASE));
+        stub_job_cycle (&job, ~UINT32_C (0),
+                        stub_cmd (cfi_array, CFI_INTEL_CMD_CONFIRM));
+    }
+
+    r = stub_job_run (&job, adr, &erased, 1, URJ_ERROR_FLASH_ERASE);
+    driver->readarray (cfi_array);
+
+    return r;
+}
+
+static int
+stub_flash_lock_block (urj_flash_cfi_array_t *cfi_array, uint32_t adr)
+{
+    const urj_flash_driver_t *driver = stub_base_driver (cfi_array);
+
+    if (driver == NULL)
+    {
+        urj_error_set (URJ_ERROR_NOTFOUND, _("no flash driver found"));
+        return URJ_STATUS_FAIL;
+    }
+
+    return driver->lock_block (cfi_array, adr);
+}
+
+static int
+stub_flash_unlock_block (urj_flash_cfi_array_t *cfi_array, uint32_t adr)
+{
+    const urj_flash_driver_t *driver = stub_base_driver (cfi_array);
+
+    if (driver == NULL)
+    {
+        urj_error_set (URJ_ERROR_NOTFOUND, _("no flash driver found"));
+        return URJ_STATUS_FAIL;
+    }
+
+    return driver->unlock_block (cfi_array, adr);
+}
+
+static int
+stub_flash_program (urj_flash_cfi_array_t *cfi_array, uint32_t adr,
+                    uint32_t *buffer, int count)
+{
+    const urj_flash_driver_t *driver = stub_base_driver (cfi_array);
+    urj_bus_t *bus = cfi_array->bus;
+    stub_job_t job;
+
+    if (driver == NULL)
+    {
+        urj_error_set (URJ_ERROR_NOTFOUND, _("no flash driver found"));
+        return URJ_STATUS_FAIL;
+    }
+
+    if (stub_is_amd (driver))
+    {
+        int o = stub_amd_address_shift (cfi_array);
+
+        /* data polling: done when the unit reads back the data */
+        if (stub_job_init (&job, cfi_array, 1, 0, 0, PROGRAM_TIMEOUT)
+            != URJ_STATUS_OK)
+            return URJ_STATUS_FAIL;
+        stub_job_cycle (&job, cfi_array->address + (0x0555 << o),
+                        stub_cmd (cfi_array, 0xAA));
+        stub_job_cycle (&job, cfi_array->address + (0x02aa << o),
+                        stub_cmd (cfi_array, 0x55));
+        stub_job_cycle (&job, cfi_array->address + (0x0555 << o),
+                        stub_cmd (cfi_array, AMD_CMD_PROGRAM));
+
+        return stub_job_run (&job, adr, buffer, count,
+                             URJ_ERROR_FLASH_PROGRAM);
+    }
+
+    URJ_BUS_WRITE (bus, adr,
+                   stub_cmd (cfi_array, CFI_INTEL_CMD_CLEAR_STATUS_REGISTER));
+    if (stub_job_init (&job, cfi_array, 1,
+                       stub_cmd (cfi_array, CFI_INTEL_SR_READY),
+                       stub_cmd (cfi_array, INTEL_SR_PROGRAM_ERRORS),
+                       PROGRAM_TIMEOUT) != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+    stub_job_cycle (&job, ~UINT32_C (0),
+                    stub_cmd (cfi_array, CFI_INTEL_CMD_PROGRAM1));
+    if (stub_job_run (&job, adr, buffer, count, URJ_ERROR_FLASH_PROGRAM)
+        != URJ_STATUS_OK)
+    {
+        driver->readarray (cfi_array);
+        return URJ_STATUS_FAIL;
+    }
+
+    /* The status register only tells about errors, compare the data too */
+    driver->readarray (cfi_array);
+    if (stub_job_init (&job, cfi_array, 0, 0, 0, 1) != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+
+    return stub_job_run (&job, adr, buffer, count, URJ_ERROR_FLASH_PROGRAM);
+}
+
+static void
+stub_flash_readarray (urj_flash_cfi_array_t *cfi_array)
+{
+    const urj_flash_driver_t *driver = stub_base_driver (cfi_array);
+
+    if (driver != NULL)
+        driver->readarray (cfi_array);
+}
+
+const urj_flash_driver_t urj_flash_stub_32_flash_driver = {
+    N_("Target stub"),
+    N_("AMD/Intel command sets programmed by a target-resident stub, 32 bit"),
+    4,                          /* buswidth */
+    stub_flash_autodetect32,
+    stub_flash_print_info,
+    stub_flash_erase_block,
+    stub_flash_lock_block,
+    stub_flash_unlock_block,
+    stub_flash_program,
+    stub_flash_readarray,
+};
+
+const urj_flash_driver_t urj_flash_stub_16_flash_driver = {
+    N_("Target stub"),
+    N_("AMD/Intel command sets programmed by a target-resident stub, 16 bit"),
+    2,                          /* buswidth */
+    stub_flash_autodetect16,
+    stub_flash_print_info,
+    stub_flash_erase_block,
+    stub_flash_lock_block,
+    stub_flash_unlock_block,
+    stub_flash_program,
+    stub_flash_readarray,
+};
+
+const urj_flash_driver_t urj_flash_stub_8_flash_driver = {
+    N_("Target stub"),
+    N_("AMD/Intel command sets programmed by a target-resident stub, 8 bit"),
+    1,                          /* buswidth */
+    stub_flash_autodetect8,
+    stub_flash_print_info,
+    stub_flash_erase_block,
+    stub_flash_lock_block,
+    stub_flash_unlock_block,
+    stub_flash_program,
+    stub_flash_readarray,
+};
@@ -0,0 +1,33 @@
+/*
+ * $Id$
+ *
+ * Flash programming through a target-resident stub
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ */
+
+#ifndef URJ_SRC_STUB_H
+#define URJ_SRC_STUB_H
+
+#include <urjtag/types.h>
+#include <urjtag/flash.h>
+
+extern const urj_flash_driver_t urj_flash_stub_32_flash_driver;
+extern const urj_flash_driver_t urj_flash_stub_16_flash_driver;
+extern const urj_flash_driver_t urj_flash_stub_8_flash_driver;
+
+#endif /* URJ_SRC_STUB_H */
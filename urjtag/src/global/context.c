@@ -0,0 +1,152 @@
+/*
+ * $Id$
+ *
+ * Per-thread library state
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ */
+
+#include <sysdep.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <urjtag/log.h>
+#include <urjtag/error.h>
+#include <urjtag/bus.h>
+#include <urjtag/flash.h>
+#include <urjtag/context.h>
+
+#include "../flash/flash.h"
+
+struct URJ_CONTEXT
+{
+    urj_bus_t *bus;
+    urj_buses_t buses;
+    urj_flash_cfi_array_t *flash_cfi_array;
+    urj_log_state_t log_state;
+    urj_error_state_t error_state;
+};
+
+static int
+stderr_vprintf(const char *fmt, va_list ap)
+{
+    return vfprintf (stderr, fmt, ap);
+}
+
+static int
+stdout_vprintf(const char *fmt, va_list ap)
+{
+    int r = vfprintf (stdout, fmt, ap);
+
+    fflush (stdout);
+
+    return r;
+}
+
+static urj_context_t default_context =
+    {
+        .log_state =
+            {
+                .level = URJ_LOG_LEVEL_NORMAL,
+                .out_vprintf = stdout_vprintf,
+                .err_vprintf = stderr_vprintf,
+            },
+    };
+
+/* NULL means default_context */
+static URJ_THREAD_LOCAL urj_context_t *current_context;
+
+urj_context_t *
+urj_context_current (void)
+{
+    return current_context != NULL ? current_context : &default_context;
+}
+
+urj_context_t *
+urj_context_use (urj_context_t *ctx)
+{
+    urj_context_t *prev = urj_context_current ();
+
+    current_context = ctx;
+
+    return prev;
+}
+
+urj_context_t *
+urj_context_alloc (void)
+{
+    urj_context_t *ctx = calloc (1, sizeof *ctx);
+
+    if (ctx == NULL)
+    {
+        urj_error_set (URJ_ERROR_OUT_OF_MEMORY, "calloc(%zd,%zd) fails",
+                       (size_t) 1, sizeof *ctx);
+        return NULL;
+    }
+    ctx->log_state = urj_log_state;
+
+    return ctx;
+}
+
+void
+urj_context_free (urj_context_t *ctx)
+{
+    urj_context_t *prev;
+
+    if (ctx == NULL || ctx == &default_context)
+        return;
+
+    /* the cleanup functions work on the current context */
+    prev = urj_context_use (ctx);
+    urj_bus_buses_free ();
+    urj_flash_cleanup ();
+    urj_context_use (prev == ctx ? NULL : prev);
+
+    free (ctx);
+}
+
+urj_bus_t **
+urj_context_bus (void)
+{
+    return &urj_context_current ()->bus;
+}
+
+urj_buses_t *
+urj_context_buses (void)
+{
+    return &urj_context_current ()->buses;
+}
+
+urj_flash_cfi_array_t **
+urj_context_flash_cfi_array (void)
+{
+    return &urj_context_current ()->flash_cfi_array;
+}
+
+urj_log_state_t *
+urj_context_log_state (void)
+{
+    return &urj_context_current ()->log_state;
+}
+
+urj_error_state_t *
+urj_context_error_state (void)
+{
+    return &urj_context_current ()->error_state;
+}
@@ -9,6 +9,7 @@
 #include <urjtag/jtag.h>
 
 static const char *jtag_argv0;
+static const char *jtag_data_dir_set;
 
 void
 urj_set_argv0(const char *argv0)
@@ -16,6 +17,12 @@ urj_set_argv0(const char *argv0)
     jtag_argv0 = argv0;
 }
 
+void
+urj_set_data_dir (const char *dir)
+{
+    jtag_data_dir_set = dir;
+}
+
 #ifdef JTAG_RELOCATABLE
 
 #include <stdlib.h>
@@ -27,6 +34,8 @@ static char *jtag_data_dir = NULL;
 const char *
 urj_get_data_dir (void)
 {
+    if (jtag_data_dir_set)
+        return jtag_data_dir_set;
     if (jtag_data_dir)
         return jtag_data_dir;
 
@@ -43,6 +52,8 @@ urj_get_data_dir (void)
 const char *
 urj_get_data_dir (void)
 {
+    if (jtag_data_dir_set)
+        return jtag_data_dir_set;
     return JTAG_DATA_DIR;
 }
 
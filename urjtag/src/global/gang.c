@@ -0,0 +1,369 @@
+/*
+ * $Id$
+ *
+ * Gang programming: one job on several cables in parallel
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ */
+
+#include <sysdep.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#include <urjtag/error.h>
+#include <urjtag/log.h>
+#include <urjtag/chain.h>
+#include <urjtag/cmd.h>
+#include <urjtag/fclock.h>
+#include <urjtag/context.h>
+#include <urjtag/gang.h>
+
+typedef struct
+{
+    urj_chain_t *chain;
+    urj_context_t *ctx;
+    int index;
+    char **params;              /* private copy, commands may modify it */
+    urj_gang_result_t *result;
+}
+gang_job_t;
+
+/* target number of the calling thread, prefixed to its log lines */
+static URJ_THREAD_LOCAL int gang_index;
+static URJ_THREAD_LOCAL int gang_bol = 1;
+
+static int
+gang_vprintf (FILE *f, const char *fmt, va_list ap)
+{
+    char buf[1024], out[1024 + 256];
+    size_t o = 0;
+    const char *p;
+    int r;
+
+    r = vsnprintf (buf, sizeof buf, fmt, ap);
+
+    /* assemble the whole piece first: one fputs per call keeps the
+     * lines of different targets apart */
+    for (p = buf; *p != '\0' && o < sizeof out - 16; p++)
+    {
+        if (gang_bol)
+            o += snprintf (out + o, sizeof out - o, "[%d] ", gang_index);
+        out[o++] = *p;
+        gang_bol = (*p == '\n' || *p == '\r');
+    }
+    out[o] = '\0';
+
+    fputs (out, f);
+    fflush (f);
+
+    return r;
+}
+
+static int
+gang_out_vprintf (const char *fmt, va_list ap)
+{
+    return gang_vprintf (stdout, fmt, ap);
+}
+
+static int
+gang_err_vprintf (const char *fmt, va_list ap)
+{
+    return gang_vprintf (stderr, fmt, ap);
+}
+
+urj_gang_t *
+urj_gang_alloc (void)
+{
+    urj_gang_t *gang = calloc (1, sizeof *gang);
+
+    if (gang == NULL)
+    {
+        urj_error_set (URJ_ERROR_OUT_OF_MEMORY, "calloc(%zd,%zd) fails",
+                       (size_t) 1, sizeof *gang);
+        return NULL;
+    }
+
+    return gang;
+}
+
+void
+urj_gang_free (urj_gang_t *gang)
+{
+    urj_context_t *prev;
+    int i;
+
+    if (gang == NULL)
+        return;
+
+    for (i = 0; i < gang->count; i++)
+    {
+        /* the cable and bus cleanup logs to, and works on, the target */
+        prev = urj_context_use (gang->contexts[i]);
+        gang_index = i;
+        urj_tap_chain_free (gang->targets.chains[i]);
+        urj_context_use (prev);
+        urj_context_free (gang->contexts[i]);
+    }
+
+    free (gang->targets.chains);
+    free (gang->contexts);
+    free (gang->results);
+    free (gang);
+}
+
+int
+urj_gang_add (urj_gang_t *gang, const char *drivername, char *params[])
+{
+    urj_chain_t *chain;
+    urj_context_t *ctx, *prev;
+    void *p;
+    int n = gang->count + 1;
+    int r;
+
+    if (gang->running)
+    {
+        urj_error_set (URJ_ERROR_ILLEGAL_STATE,
+                       _("can not add gang targets while the gang runs"));
+        return URJ_STATUS_FAIL;
+    }
+
+    if (n > gang->targets.size)
+    {
+        p = realloc (gang->targets.chains, n * sizeof *gang->targets.chains);
+        if (p == NULL)
+            goto oom;
+        gang->targets.chains = p;
+        p = realloc (gang->contexts, n * sizeof *gang->contexts);
+        if (p == NULL)
+            goto oom;
+        gang->contexts = p;
+        p = realloc (gang->results, n * sizeof *gang->results);
+        if (p == NULL)
+            goto oom;
+        gang->results = p;
+        gang->targets.size = n;
+    }
+
+    chain = urj_tap_chain_alloc ();
+    if (chain == NULL)
+        return URJ_STATUS_FAIL;
+    ctx = urj_context_alloc ();
+    if (ctx == NULL)
+    {
+        urj_tap_chain_free (chain);
+        return URJ_STATUS_FAIL;
+    }
+
+    prev = urj_context_use (ctx);
+    gang_index = gang->count;
+    urj_log_state.out_vprintf = gang_out_vprintf;
+    urj_log_state.err_vprintf = gang_err_vprintf;
+    r = urj_tap_chain_connect (chain, drivername, params);
+    if (r != URJ_STATUS_OK)
+    {
+        /* hand the error over to the caller's context */
+        urj_error_state_t err = urj_error_state;
+
+        urj_tap_chain_free (chain);
+        urj_context_use (prev);
+        urj_context_free (ctx);
+        urj_error_state = err;
+        return URJ_STATUS_FAIL;
+    }
+    urj_context_use (prev);
+
+    gang->targets.chains[gang->count] = chain;
+    gang->contexts[gang->count] = ctx;
+    memset (&gang->results[gang->count], 0, sizeof *gang->results);
+    gang->count++;
+
+    return URJ_STATUS_OK;
+
+  oom:
+    urj_error_set (URJ_ERROR_OUT_OF_MEMORY, "realloc(%d targets) fails", n);
+    return URJ_STATUS_FAIL;
+}
+
+static void *
+gang_worker (void *arg)
+{
+    gang_job_t *job = arg;
+    urj_gang_result_t *res = job->result;
+    urj_context_t *prev;
+    long double start;
+
+    prev = urj_context_use (job->ctx);
+    gang_index = job->index;
+    gang_bol = 1;
+    urj_error_reset ();
+
+    start = urj_lib_frealtime ();
+    res->status = urj_cmd_run (job->chain, job->params);
+    res->secs = urj_lib_frealtime () - start;
+
+    res->error[0] = '\0';
+    if (res->status != URJ_STATUS_OK)
+    {
+        if (urj_error_get () != URJ_ERROR_OK)
+            snprintf (res->error, sizeof res->error, "%s",
+                      urj_error_describe ());
+        urj_error_reset ();
+    }
+
+    urj_context_use (prev);
+
+    return NULL;
+}
+
+static void
+gang_free_params (char **params)
+{
+    int i;
+
+    for (i = 0; params[i] != NULL; i++)
+        free (params[i]);
+    free (params);
+}
+
+static char **
+gang_copy_params (char *params[])
+{
+    int i, n = urj_cmd_params (params);
+    char **copy = calloc (n + 1, sizeof *copy);
+
+    if (copy == NULL)
+        return NULL;
+
+    for (i = 0; i < n; i++)
+        if ((copy[i] = strdup (params[i])) == NULL)
+        {
+            gang_free_params (copy);
+            return NULL;
+        }
+
+    return copy;
+}
+
+int
+urj_gang_run (urj_gang_t *gang, char *params[])
+{
+    gang_job_t *jobs;
+#ifdef HAVE_PTHREAD_H
+    pthread_t *threads;
+    int *started;
+#endif
+    int i, failed, r = URJ_STATUS_OK;
+
+    if (gang->count == 0)
+    {
+        urj_error_set (URJ_ERROR_NO_CHAIN, _("no gang targets"));
+        return URJ_STATUS_FAIL;
+    }
+    if (gang->running)
+    {
+        urj_error_set (URJ_ERROR_ILLEGAL_STATE, _("the gang is running"));
+        return URJ_STATUS_FAIL;
+    }
+
+    jobs = calloc (gang->count, sizeof *jobs);
+    if (jobs == NULL)
+    {
+        urj_error_set (URJ_ERROR_OUT_OF_MEMORY, "calloc(%d,%zd) fails",
+                       gang->count, sizeof *jobs);
+        return URJ_STATUS_FAIL;
+    }
+
+    for (i = 0; i < gang->count; i++)
+    {
+        jobs[i].chain = gang->targets.chains[i];
+        jobs[i].ctx = gang->contexts[i];
+        jobs[i].index = i;
+        jobs[i].result = &gang->results[i];
+        jobs[i].params = gang_copy_params (params);
+        if (jobs[i].params == NULL)
+        {
+            urj_error_set (URJ_ERROR_OUT_OF_MEMORY, "strdup fails");
+            r = URJ_STATUS_FAIL;
+            goto done;
+        }
+    }
+
+    /* set before the threads start, cleared after they have all ended */
+    gang->running = 1;
+
+#ifdef HAVE_PTHREAD_H
+    threads = calloc (gang->count, sizeof *threads);
+    started = calloc (gang->count, sizeof *started);
+    if (threads == NULL || started == NULL)
+    {
+        free (threads);
+        free (started);
+        urj_error_set (URJ_ERROR_OUT_OF_MEMORY, "calloc(%d threads) fails",
+                       gang->count);
+        gang->running = 0;
+        r = URJ_STATUS_FAIL;
+        goto done;
+    }
+
+    for (i = 0; i < gang->count; i++)
+        started[i] = pthread_create (&threads[i], NULL, gang_worker,
+                                     &jobs[i]) == 0;
+    for (i = 0; i < gang->count; i++)
+    {
+        if (started[i])
+            pthread_join (threads[i], NULL);
+        else
+            /* out of threads: still do the job, just not in parallel */
+            gang_worker (&jobs[i]);
+    }
+
+    free (threads);
+    free (started);
+#else
+    /* no thread support: run the targets one after the other */
+    for (i = 0; i < gang->count; i++)
+        gang_worker (&jobs[i]);
+#endif
+
+    gang->running = 0;
+
+    failed = 0;
+    for (i = 0; i < gang->count; i++)
+        if (gang->results[i].status != URJ_STATUS_OK)
+            failed++;
+    if (failed != 0)
+    {
+        urj_error_set (URJ_ERROR_ILLEGAL_STATE,
+                       _("job failed on %d of %d targets"),
+                       failed, gang->count);
+        r = URJ_STATUS_FAIL;
+    }
+
+  done:
+    for (i = 0; i < gang->count; i++)
+        if (jobs[i].params != NULL)
+            gang_free_params (jobs[i].params);
+    free (jobs);
+
+    return r;
+}
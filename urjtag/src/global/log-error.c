@@ -32,34 +32,6 @@
 #include <urjtag/error.h>
 #include <urjtag/jtag.h>
 
-urj_error_state_t urj_error_state;
-
-static int stderr_vprintf (const char *fmt, va_list ap);
-static int stdout_vprintf (const char *fmt, va_list ap);
-
-urj_log_state_t urj_log_state =
-    {
-        .level = URJ_LOG_LEVEL_NORMAL,
-        .out_vprintf = stdout_vprintf,
-        .err_vprintf = stderr_vprintf,
-    };
-
-static int
-stderr_vprintf(const char *fmt, va_list ap)
-{
-    return vfprintf (stderr, fmt, ap);
-}
-
-static int
-stdout_vprintf(const char *fmt, va_list ap)
-{
-    int r = vfprintf (stdout, fmt, ap);
-
-    fflush (stdout);
-
-    return r;
-}
-
 static int
 log_printf (int (*p) (const char *, va_list), const char *fmt, ...)
 {
@@ -211,7 +183,7 @@ urj_error_string (urj_error_t err)
 const char *
 urj_error_describe (void)
 {
-    static char msg[URJ_ERROR_MSG_LEN + 1024 + 256 + 20];
+    static URJ_THREAD_LOCAL char msg[URJ_ERROR_MSG_LEN + 1024 + 256 + 20];
 
     if (urj_error_state.errnum == URJ_ERROR_IO)
     {
@@ -0,0 +1,178 @@
+#!/bin/sh
+#
+# $Id$
+#
+# Regression checks against the jim cable, run by "make check".
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+# 02111-1307, USA.
+#
+# Usage: check.sh JTAG CHECK_CHAIN DATADIR
+#
+# Every check_* function below runs in a scratch directory of its own and
+# calls fail with a message for each thing that went wrong, or skip if it
+# can not run in this build.  jtag reads no ~/.jtag/rc and takes the part
+# database from DATADIR, the data directory of the source tree, so nothing
+# has to be installed.
+
+usage="usage: check.sh JTAG CHECK_CHAIN DATADIR"
+JTAG=${1:?$usage}
+CHECK_CHAIN=${2:?$usage}
+DATADIR=${3:?$usage}
+case $JTAG in
+    /*) ;;
+    *) JTAG=`pwd`/$JTAG ;;
+esac
+case $CHECK_CHAIN in
+    /*) ;;
+    *) CHECK_CHAIN=`pwd`/$CHECK_CHAIN ;;
+esac
+case $DATADIR in
+    /*) ;;
+    *) DATADIR=`pwd`/$DATADIR ;;
+esac
+
+jtag ()
+{
+    "$JTAG" --norc --datadir="$DATADIR" "$@"
+}
+
+fail ()
+{
+    echo "FAIL: $check: $*" >&2
+    failed=1
+}
+
+# the check does not apply to this build
+skip ()
+{
+    echo "SKIP: $check: $*" >&2
+    exit 77
+}
+
+# true if jtag was built with the command $1
+has_command ()
+{
+    echo "help $1" > has_command.jtag
+    ! jtag has_command.jtag 2>&1 | grep "unknown command" > /dev/null
+}
+
+# N identical scans that capture no TDO are N writes, not a polling loop,
+# and must all reach the exported SVF and XSVF; identical reads of the same
+# TDO still fold into first pass, wait and last pass.
+check_trace_export_writes ()
+{
+    has_command svf || skip "no SVF player"
+
+    i=0
+    : > writes.svf
+    : > reads.svf
+    while [ $i -lt 6 ]; do
+        echo "SDR 32 TDI (12345678);" >> writes.svf
+        echo "SDR 32 TDI (00000000) TDO (87654321) MASK (FFFFFFFF);" >> reads.svf
+        i=`expr $i + 1`
+    done
+    # some_cpu is not in the part database of the source tree
+    cat > run.jtag <<EOF
+cable jim
+detect
+instruction length 2
+register BR 1
+instruction BYPASS 11 BR
+trace record run.trc
+reset
+svf writes.svf
+svf reads.svf
+trace stop
+trace export run.trc out.svf tdo
+trace export run.trc out.xsvf tdo
+EOF
+    jtag run.jtag > run.log 2>&1
+
+    n=`grep -c '^SDR 32 TDI (12345678);' out.svf`
+    [ "$n" = 6 ] || fail "$n of 6 write-only SDRs exported"
+    n=`grep -c '^SDR 32 TDI (00000000)' out.svf`
+    [ "$n" = 2 ] || fail "read loop exported as $n SDRs, expected 2"
+    n=`grep -c '1 polling loops (4 passes left out)' run.log`
+    [ "$n" = 2 ] || fail "SVF and XSVF export did not both drop 4 reads"
+}
+
+# Captured DR scans of a chain with several parts, queued with IR scans of
+# other lengths in between, must each be picked up in full (check_chain.c).
+check_chain_interleaved_scans ()
+{
+    "$CHECK_CHAIN" > run.log 2>&1 || fail "`tail -n 3 run.log | tr '\n' ' '`"
+}
+
+# A gang job must not free, extend or rerun the gang it runs in.
+check_gang_nested ()
+{
+    cat > run.jtag <<EOF
+gang add jim
+gang add jim
+gang run gang free
+gang run gang add jim
+gang run gang run detect
+gang run detect
+EOF
+    jtag run.jtag > run.log 2>&1
+
+    n=`grep -c 'FAIL .*illegal state' run.log`
+    [ "$n" = 6 ] || fail "$n of 6 nested gang commands refused"
+    grep '2 of 2 targets passed' run.log > /dev/null \
+        || fail "gang no longer runs after the refused commands"
+}
+
+# Memory read out as Intel HEX, S-record and ELF must write back the same
+# bytes at the same address, through the 32 bit block of the fjmem core.
+check_memfile_round_trip ()
+{
+    head -c 4096 /dev/urandom > data.bin
+    head -c 4096 /dev/zero > zero.bin
+    {
+        echo "cable jim chain=fjmem"
+        echo "detect"
+        echo "initbus fjmem opcode=000010"
+        for format in ihex srec elf; do
+            echo "writemem 0x900000 0x1000 data.bin"
+            echo "readmem 0x900000 0x1000 out.$format $format"
+            echo "writemem 0x900000 0x1000 zero.bin"
+            echo "writemem 0x900000 0x1000 out.$format $format"
+            echo "readmem 0x900000 0x1000 back.$format"
+        done
+    } > run.jtag
+    jtag run.jtag > run.log 2>&1
+
+    for format in ihex srec elf; do
+        [ -s out.$format ] || fail "nothing read out as $format"
+        cmp data.bin back.$format > /dev/null 2>&1 \
+            || fail "$format did not write back what it read"
+    done
+}
+
+status=0
+scratch=`mktemp -d "${TMPDIR:-/tmp}/urjtag-check.XXXXXX"` || exit 1
+for check in check_trace_export_writes check_chain_interleaved_scans \
+             check_gang_nested check_memfile_round_trip; do
+    mkdir "$scratch/$check"
+    (cd "$scratch/$check" && failed=0 && $check && exit $failed)
+    case $? in
+        0) echo "PASS: $check" ;;
+        77) echo "SKIP: $check" ;;
+        *) echo "FAIL: $check"; status=1 ;;
+    esac
+done
+rm -rf "$scratch"
+exit $status
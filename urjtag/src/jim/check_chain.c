@@ -0,0 +1,158 @@
+/*
+ * $Id$
+ *
+ * Deferred scans of a chain with several parts, run by src/jim/check.sh
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ * The jim chain has two generic TAPs with instruction registers of 4 and
+ * 6 bits. Data register scans of 64 and 13 bits are queued with
+ * instruction scans of 10 bits in between, the way ejtag.c polls, and
+ * only then picked up. Each result must reach the parts in full.
+ */
+
+#include <sysdep.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <urjtag/chain.h>
+#include <urjtag/part.h>
+#include <urjtag/part_instruction.h>
+#include <urjtag/data_register.h>
+#include <urjtag/tap.h>
+#include <urjtag/tap_register.h>
+#include <urjtag/error.h>
+
+#define IDCODE0 0x10000001
+#define IDCODE1 0x20000003
+
+static int failed;
+
+static void
+check (int ok, const char *what)
+{
+    if (!ok)
+    {
+        fprintf (stderr, "FAIL: %s\n", what);
+        failed = 1;
+    }
+}
+
+static urj_tap_register_t *
+dr_out (urj_part_t *part)
+{
+    return part->active_instruction->data_register->out;
+}
+
+/** @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error */
+static int
+add_part (urj_chain_t *chain, int ir_len, const char *idcode,
+          const char *sample)
+{
+    urj_part_t *part;
+
+    if (urj_tap_manual_add (chain, ir_len) < 0)
+        return URJ_STATUS_FAIL;
+    part = chain->parts->parts[chain->parts->len - 1];
+
+    if (urj_part_data_register_define (part, "DIR", 32) != URJ_STATUS_OK
+        || urj_part_instruction_define (part, "IDCODE", idcode, "DIR") == NULL)
+        return URJ_STATUS_FAIL;
+    if (sample != NULL
+        && (urj_part_data_register_define (part, "BSR", 12) != URJ_STATUS_OK
+            || urj_part_instruction_define (part, "SAMPLE", sample,
+                                            "BSR") == NULL))
+        return URJ_STATUS_FAIL;
+
+    return URJ_STATUS_OK;
+}
+
+/** @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error */
+static int
+select_ir (urj_chain_t *chain, const char *i0, const char *i1)
+{
+    urj_part_set_instruction (chain->parts->parts[0], i0);
+    urj_part_set_instruction (chain->parts->parts[1], i1);
+    return urj_tap_chain_shift_instructions (chain);
+}
+
+int
+main (void)
+{
+    char chain_param[] = "chain=0x10000001:4:12,0x20000003:6";
+    char *params[] = { chain_param, NULL };
+    urj_chain_t *chain;
+    urj_part_t *p0, *p1;
+
+    chain = urj_tap_chain_alloc ();
+    if (chain == NULL
+        || urj_tap_chain_connect (chain, "jim", params) != URJ_STATUS_OK
+        || add_part (chain, 4, "0001", "0010") != URJ_STATUS_OK
+        || add_part (chain, 6, "000001", NULL) != URJ_STATUS_OK)
+    {
+        fprintf (stderr, "FAIL: %s\n", urj_error_describe ());
+        return 1;
+    }
+    p0 = chain->parts->parts[0];
+    p1 = chain->parts->parts[1];
+    urj_tap_reset (chain);
+
+    /* queue two captured DR scans of different lengths, each after an
+       uncaptured IR scan of a third length */
+    if (select_ir (chain, "IDCODE", "IDCODE") != URJ_STATUS_OK
+        || urj_tap_chain_defer_shift_data_registers_mode (chain, 1, 1,
+                URJ_CHAIN_EXITMODE_IDLE) != URJ_STATUS_OK
+        || select_ir (chain, "SAMPLE", "BYPASS") != URJ_STATUS_OK
+        || urj_tap_chain_defer_shift_data_registers_mode (chain, 1, 1,
+                URJ_CHAIN_EXITMODE_IDLE) != URJ_STATUS_OK)
+    {
+        fprintf (stderr, "FAIL: %s\n", urj_error_describe ());
+        return 1;
+    }
+
+    /* the active instructions tell where each result goes */
+    urj_part_set_instruction (p0, "IDCODE");
+    urj_part_set_instruction (p1, "IDCODE");
+    urj_tap_chain_shift_data_registers_output (chain, URJ_CHAIN_EXITMODE_IDLE);
+    check (urj_tap_register_get_value (dr_out (p0)) == IDCODE0,
+           "IDCODE of part 0 from the first queued DR scan");
+    check (urj_tap_register_get_value (dr_out (p1)) == IDCODE1,
+           "IDCODE of part 1 from the first queued DR scan");
+
+    urj_part_set_instruction (p0, "SAMPLE");
+    urj_part_set_instruction (p1, "BYPASS");
+    dr_out (p1)->data[0] = 1;
+    urj_tap_chain_shift_data_registers_output (chain, URJ_CHAIN_EXITMODE_IDLE);
+    check (dr_out (p1)->data[0] == 0,
+           "BYPASS of part 1 from the second queued DR scan");
+
+    /* a captured IR scan afterwards reads 0...01 from both parts */
+    if (urj_tap_chain_shift_instructions_mode (chain, 1, 1,
+                URJ_CHAIN_EXITMODE_IDLE) != URJ_STATUS_OK)
+    {
+        fprintf (stderr, "FAIL: %s\n", urj_error_describe ());
+        return 1;
+    }
+    check (urj_tap_register_get_value (p0->active_instruction->out) == 1,
+           "IR capture of part 0");
+    check (urj_tap_register_get_value (p1->active_instruction->out) == 1,
+           "IR capture of part 1");
+
+    urj_tap_chain_free (chain);
+
+    return failed;
+}
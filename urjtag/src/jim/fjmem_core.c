@@ -0,0 +1,450 @@
+/*
+ * $Id$
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * An FPGA running the fjmem_core design of extra/fjmem behind USER1 of a
+ * Spartan 3 style TAP. Capture and update of the fjmem register follow the
+ * shift and dout processes of fjmem_core.vhd bit for bit; memory accesses
+ * complete within the update. With a burst size, the core also implements
+ * the burst instructions described in extra/fjmem/README.
+ */
+
+#include <sysdep.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <urjtag/types.h>
+#include <urjtag/log.h>
+#include <urjtag/error.h>
+#include <urjtag/jim.h>
+
+/* TAP of an XC3S200, so that "detect" finds the part in the database */
+#define FJMEM_IDCODE        0x01414093
+#define FJMEM_IR_LEN        6
+#define FJMEM_BSR_LEN       599
+
+#define FJMEM_IR_EXTEST     0x00
+#define FJMEM_IR_SAMPLE     0x01
+#define FJMEM_IR_USER1      0x02
+#define FJMEM_IR_IDCODE     0x09
+
+#define FJMEM_DR_BYPASS     0
+#define FJMEM_DR_IDCODE     1
+#define FJMEM_DR_BSR        2
+#define FJMEM_DR_FJMEM      3
+
+/* fjmem_pack: instruction, ack, block, address and data fields */
+#define INSTR_POS           0
+#define INSTR_WIDTH         3
+#define ACK_POS             3
+#define BLOCK_POS           4
+#define BLOCK_WIDTH         2
+#define ADDR_POS            (BLOCK_POS + BLOCK_WIDTH)
+#define ADDR_WIDTH          22
+#define DATA_POS            (ADDR_POS + ADDR_WIDTH)
+#define MAX_DATA_WIDTH      32
+
+#define INSTR_IDLE          0x0
+#define INSTR_READ          0x1
+#define INSTR_WRITE         0x2
+#define INSTR_BURST_WRITE   0x3
+#define INSTR_BURST_READ    0x5
+#define INSTR_QUERY         0x6
+#define INSTR_DETECT        0x7
+
+/* fjmem_config_pack: the blocks, laid out in device memory the way the
+ * fjmem bus driver places them in its address space */
+static const struct
+{
+    int addr_width;
+    int data_width;
+    uint32_t offset;
+}
+fjmem_blocks[] = {
+    {22, 16, 0x00000000},       /* block #0, 8 MByte */
+    {20, 8, 0x00800000},        /* block #1, 1 MByte */
+    {18, 32, 0x00900000},       /* block #2, 1 MByte */
+};
+
+#define NUM_BLOCKS  (sizeof fjmem_blocks / sizeof fjmem_blocks[0])
+
+typedef struct
+{
+    int burst;                  /* words per burst, 0 without burst mode */
+    int data_width;             /* bits in the data field */
+    /* the registers of the dout and din processes */
+    uint32_t instr_q, block_q, addr_q;
+    uint32_t *dout_q, *din_q;
+    int ack_q;
+}
+fjmem_state_t;
+
+static uint32_t
+fjmem_get (const urj_jim_shift_reg_t *sr, int pos, int len)
+{
+    uint32_t v = 0;
+    int i;
+
+    for (i = len - 1; i >= 0; i--)
+        v = (v << 1) | ((sr->reg[(pos + i) / 32] >> ((pos + i) % 32)) & 1);
+
+    return v;
+}
+
+static void
+fjmem_set (urj_jim_shift_reg_t *sr, int pos, int len, uint32_t v)
+{
+    int i;
+
+    for (i = 0; i < len; i++, v >>= 1)
+    {
+        uint32_t m = 1u << ((pos + i) % 32);
+
+        if (v & 1)
+            sr->reg[(pos + i) / 32] |= m;
+        else
+            sr->reg[(pos + i) / 32] &= ~m;
+    }
+}
+
+/* Copy the data field of the shift register into a word vector, or back */
+static void
+fjmem_get_data (const urj_jim_shift_reg_t *sr, uint32_t *v, int width)
+{
+    int i;
+
+    memset (v, 0, (width + 31) / 32 * sizeof *v);
+    for (i = 0; i < width; i++)
+        if ((sr->reg[(DATA_POS + i) / 32] >> ((DATA_POS + i) % 32)) & 1)
+            v[i / 32] |= 1u << (i % 32);
+}
+
+static void
+fjmem_set_data (urj_jim_shift_reg_t *sr, const uint32_t *v, int width)
+{
+    int i;
+
+    for (i = 0; i < width; i++)
+        fjmem_set (sr, DATA_POS + i, 1, (v[i / 32] >> (i % 32)) & 1);
+}
+
+/* Word k of width bits in a data vector, as packed by burst transfers */
+static uint32_t
+fjmem_slot (const uint32_t *v, int k, int width)
+{
+    return (uint32_t) ((((uint64_t) v[(k * width) / 32 + 1] << 32)
+                        | v[(k * width) / 32]) >> ((k * width) % 32))
+        & (uint32_t) ((UINT64_C (1) << width) - 1);
+}
+
+static void
+fjmem_set_slot (uint32_t *v, int k, int width, uint32_t d)
+{
+    int i;
+
+    for (i = 0; i < width; i++, d >>= 1)
+    {
+        int b = k * width + i;
+
+        if (d & 1)
+            v[b / 32] |= 1u << (b % 32);
+        else
+            v[b / 32] &= ~(1u << (b % 32));
+    }
+}
+
+/* One access on the memory interface; addresses wrap within the block */
+static uint32_t
+fjmem_access (int blk, uint32_t addr, int write, uint32_t d,
+              uint8_t *shmem, size_t shmem_size)
+{
+    int bytes = fjmem_blocks[blk].data_width / 8;
+    size_t at;
+    int i;
+
+    addr &= (1u << fjmem_blocks[blk].addr_width) - 1;
+    at = fjmem_blocks[blk].offset + (size_t) addr * bytes;
+    if (at + bytes > shmem_size)
+        return 0;
+
+    if (write)
+    {
+        for (i = 0; i < bytes; i++, d >>= 8)
+            shmem[at + i] = d & 0xFF;
+        return 0;
+    }
+
+    for (d = 0, i = bytes - 1; i >= 0; i--)
+        d = (d << 8) | shmem[at + i];
+    return d;
+}
+
+/* The capture branch of process shift */
+static void
+fjmem_capture (urj_jim_device_t *dev)
+{
+    fjmem_state_t *fs = dev->state;
+    urj_jim_shift_reg_t *sr = &dev->sreg[FJMEM_DR_FJMEM];
+    uint32_t blk = fjmem_get (sr, BLOCK_POS, BLOCK_WIDTH);
+    int i;
+
+    switch (fs->instr_q)
+    {
+    case INSTR_READ:
+    case INSTR_BURST_READ:
+        fjmem_set (sr, ACK_POS, 1, fs->ack_q);
+        fjmem_set_data (sr, fs->din_q, fs->data_width);
+        break;
+
+    case INSTR_WRITE:
+    case INSTR_BURST_WRITE:
+        break;
+
+    case INSTR_IDLE:
+        memset (sr->reg, 0, (sr->len + 31) / 32 * sizeof *sr->reg);
+        break;
+
+    case INSTR_DETECT:
+        memset (sr->reg, 0, (sr->len + 31) / 32 * sizeof *sr->reg);
+        /* a burst capable core marks the ack field */
+        fjmem_set (sr, ACK_POS, 1, fs->burst != 0);
+        fjmem_set (sr, BLOCK_POS, BLOCK_WIDTH, ~0u);
+        for (i = 0; i < fs->data_width; i++)
+            fjmem_set (sr, DATA_POS + i, 1, 1);
+        break;
+
+    case INSTR_QUERY:
+        memset (sr->reg, 0, (sr->len + 31) / 32 * sizeof *sr->reg);
+        if (blk < NUM_BLOCKS)
+        {
+            for (i = 0; i < fjmem_blocks[blk].addr_width; i++)
+                fjmem_set (sr, ADDR_POS + i, 1, 1);
+            for (i = 0; i < fjmem_blocks[blk].data_width; i++)
+                fjmem_set (sr, DATA_POS + i, 1, 1);
+        }
+        break;
+
+    default:
+        /* don't care in the HDL, the register is left as shifted */
+        break;
+    }
+
+    fjmem_set (sr, INSTR_POS, INSTR_WIDTH, fs->instr_q);
+}
+
+/* Process dout, followed by the access it strobes on the memory side */
+static void
+fjmem_update (urj_jim_device_t *dev, uint8_t *shmem, size_t shmem_size)
+{
+    fjmem_state_t *fs = dev->state;
+    urj_jim_shift_reg_t *sr = &dev->sreg[FJMEM_DR_FJMEM];
+    int n, k, width;
+
+    fs->instr_q = fjmem_get (sr, INSTR_POS, INSTR_WIDTH);
+    fs->block_q = fjmem_get (sr, BLOCK_POS, BLOCK_WIDTH);
+    fs->addr_q = fjmem_get (sr, ADDR_POS, ADDR_WIDTH);
+    fjmem_get_data (sr, fs->dout_q, fs->data_width);
+
+    if (fs->block_q >= NUM_BLOCKS)
+        return;
+    width = fjmem_blocks[fs->block_q].data_width;
+
+    switch (fs->instr_q)
+    {
+    case INSTR_READ:
+        memset (fs->din_q, 0, (fs->data_width + 31) / 32 * sizeof *fs->din_q);
+        fs->din_q[0] = fjmem_access (fs->block_q, fs->addr_q, 0, 0,
+                                     shmem, shmem_size);
+        fs->ack_q = 1;
+        break;
+
+    case INSTR_WRITE:
+        fjmem_access (fs->block_q, fs->addr_q, 1,
+                      fjmem_slot (fs->dout_q, 0, width), shmem, shmem_size);
+        break;
+
+    case INSTR_BURST_READ:
+        if (fs->burst == 0)
+            break;
+        n = fs->data_width / width;
+        memset (fs->din_q, 0, (fs->data_width + 31) / 32 * sizeof *fs->din_q);
+        for (k = 0; k < n; k++)
+            fjmem_set_slot (fs->din_q, k, width,
+                            fjmem_access (fs->block_q, fs->addr_q + k, 0, 0,
+                                          shmem, shmem_size));
+        fs->ack_q = 1;
+        break;
+
+    case INSTR_BURST_WRITE:
+        if (fs->burst == 0)
+            break;
+        n = fs->data_width / width;
+        for (k = 0; k < n; k++)
+            fjmem_access (fs->block_q, fs->addr_q + k, 1,
+                          fjmem_slot (fs->dout_q, k, width), shmem,
+                          shmem_size);
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void
+fjmem_reset (urj_jim_device_t *dev)
+{
+    fjmem_state_t *fs = dev->state;
+    urj_jim_shift_reg_t *sr = &dev->sreg[FJMEM_DR_FJMEM];
+
+    dev->sreg[0].reg[0] = FJMEM_IR_IDCODE;
+    dev->sreg[FJMEM_DR_IDCODE].reg[0] = FJMEM_IDCODE;
+    dev->current_dr = FJMEM_DR_IDCODE;
+
+    memset (sr->reg, 0, (sr->len + 31) / 32 * sizeof *sr->reg);
+    fs->instr_q = INSTR_IDLE;
+    fs->block_q = 0;
+    fs->addr_q = 0;
+    memset (fs->dout_q, 0, (fs->data_width + 31) / 32 * sizeof *fs->dout_q);
+}
+
+static void
+fjmem_tck_rise (urj_jim_device_t *dev, int tms, int tdi,
+                uint8_t *shmem, size_t shmem_size)
+{
+    switch (dev->tap_state)
+    {
+    case URJ_JIM_RESET:
+        fjmem_reset (dev);
+        break;
+
+    case URJ_JIM_CAPTURE_DR:
+        if (dev->current_dr == FJMEM_DR_IDCODE)
+            dev->sreg[FJMEM_DR_IDCODE].reg[0] = FJMEM_IDCODE;
+        else if (dev->current_dr == FJMEM_DR_FJMEM)
+            fjmem_capture (dev);
+        break;
+
+    case URJ_JIM_UPDATE_DR:
+        if (dev->current_dr == FJMEM_DR_FJMEM)
+            fjmem_update (dev, shmem, shmem_size);
+        break;
+
+    case URJ_JIM_CAPTURE_IR:
+        dev->sreg[0].reg[0] = 0x01;
+        break;
+
+    case URJ_JIM_UPDATE_IR:
+        switch (dev->sreg[0].reg[0])
+        {
+        case FJMEM_IR_EXTEST:
+        case FJMEM_IR_SAMPLE:
+            dev->current_dr = FJMEM_DR_BSR;
+            break;
+        case FJMEM_IR_USER1:
+            dev->current_dr = FJMEM_DR_FJMEM;
+            break;
+        case FJMEM_IR_IDCODE:
+            dev->current_dr = FJMEM_DR_IDCODE;
+            break;
+        default:
+            dev->current_dr = FJMEM_DR_BYPASS;
+            break;
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void
+fjmem_free (urj_jim_device_t *dev)
+{
+    fjmem_state_t *fs = dev->state;
+
+    if (fs == NULL)
+        return;
+
+    free (fs->dout_q);
+    free (fs->din_q);
+    free (fs);
+}
+
+urj_jim_device_t *
+urj_jim_fjmem (int burst)
+{
+    urj_jim_device_t *dev;
+    fjmem_state_t *fs;
+    int data_width = MAX_DATA_WIDTH * (burst > 0 ? burst : 1);
+    /* one spare word so that fjmem_slot may read past the last slot */
+    size_t words = (data_width + 31) / 32 + 1;
+    int reg_size[4] = { FJMEM_IR_LEN, 32, FJMEM_BSR_LEN, 0 };
+
+    if (burst < 0 || burst > 63)
+    {
+        urj_error_set (URJ_ERROR_INVALID,
+                       "fjmem burst of %d words out of range (0..63)", burst);
+        return NULL;
+    }
+    reg_size[FJMEM_DR_FJMEM] = DATA_POS + data_width;
+
+    fs = calloc (1, sizeof (fjmem_state_t));
+    if (fs == NULL)
+    {
+        urj_error_set (URJ_ERROR_OUT_OF_MEMORY, "calloc(%zd) fails",
+                       sizeof (fjmem_state_t));
+        return NULL;
+    }
+    fs->burst = burst;
+    fs->data_width = data_width;
+    fs->dout_q = calloc (words, sizeof (uint32_t));
+    fs->din_q = calloc (words, sizeof (uint32_t));
+    if (fs->dout_q == NULL || fs->din_q == NULL)
+    {
+        urj_error_set (URJ_ERROR_OUT_OF_MEMORY, "calloc(%zd,%zd) fails",
+                       words, sizeof (uint32_t));
+        free (fs->dout_q);
+        free (fs->din_q);
+        free (fs);
+        return NULL;
+    }
+
+    dev = urj_jim_alloc_device (4, reg_size);
+    if (dev == NULL)
+    {
+        free (fs->dout_q);
+        free (fs->din_q);
+        free (fs);
+        // retain error state
+        return NULL;
+    }
+
+    dev->state = fs;
+    dev->tck_rise = fjmem_tck_rise;
+    dev->passive_shift = 1;
+    dev->dev_free = fjmem_free;
+
+    urj_log (URJ_LOG_LEVEL_NORMAL,
+             "jim: fjmem core, %d bit register, burst %d words\n",
+             reg_size[FJMEM_DR_FJMEM], burst);
+
+    return dev;
+}
@@ -0,0 +1,404 @@
+/*
+ * $Id$
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Generic 1149.1 devices for the simulated chain: a TAP with IR, IDCODE and
+ * boundary scan register of arbitrary length and no core behind it. The
+ * geometry and opcodes come either from the command line or from a BSDL
+ * file, read by the BSDL module into a part of its own.
+ */
+
+#include <sysdep.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <urjtag/types.h>
+#include <urjtag/log.h>
+#include <urjtag/error.h>
+#include <urjtag/chain.h>
+#include <urjtag/part.h>
+#include <urjtag/part_instruction.h>
+#include <urjtag/data_register.h>
+#include <urjtag/tap_register.h>
+#include <urjtag/bsdl.h>
+#include <urjtag/bsdl_mode.h>
+#include <urjtag/jim.h>
+
+#define GENERIC_DR_BYPASS       0
+#define GENERIC_DR_IDCODE       1
+#define GENERIC_DR_BSR          2
+
+typedef struct
+{
+    char *bits;                 /* MSB first, ir_len characters */
+    int dr;
+}
+generic_opcode_t;
+
+typedef struct
+{
+    uint32_t idcode;            /* 0 if the device has no IDCODE register */
+    char *capture;              /* INSTRUCTION_CAPTURE, MSB first */
+    int num_opcodes;
+    generic_opcode_t *opcodes;
+}
+generic_state_t;
+
+static void
+generic_set_ir (urj_jim_device_t *dev, const char *bits)
+{
+    urj_jim_shift_reg_t *ir = &dev->sreg[0];
+    int i;
+
+    for (i = 0; i < ir->len; i++)
+    {
+        uint32_t m = 1u << (i % 32);
+
+        if (bits[ir->len - 1 - i] == '1')
+            ir->reg[i / 32] |= m;
+        else
+            ir->reg[i / 32] &= ~m;
+    }
+}
+
+static int
+generic_match_ir (urj_jim_device_t *dev, const char *bits)
+{
+    urj_jim_shift_reg_t *ir = &dev->sreg[0];
+    int i;
+
+    for (i = 0; i < ir->len; i++)
+    {
+        int b = (ir->reg[i / 32] >> (i % 32)) & 1;
+        char c = bits[ir->len - 1 - i];
+
+        if (c != 'X' && c != 'x' && c - '0' != b)
+            return 0;
+    }
+
+    return 1;
+}
+
+static void
+generic_reset (urj_jim_device_t *dev)
+{
+    generic_state_t *gs = dev->state;
+    int i;
+
+    dev->current_dr = GENERIC_DR_BYPASS;
+    if (gs->idcode == 0)
+        return;
+
+    for (i = 0; i < gs->num_opcodes; i++)
+        if (gs->opcodes[i].dr == GENERIC_DR_IDCODE)
+        {
+            generic_set_ir (dev, gs->opcodes[i].bits);
+            break;
+        }
+    dev->sreg[1].reg[0] = gs->idcode;
+    dev->current_dr = GENERIC_DR_IDCODE;
+}
+
+static void
+generic_tck_rise (urj_jim_device_t *dev, int tms, int tdi,
+                  uint8_t *shmem, size_t shmem_size)
+{
+    generic_state_t *gs = dev->state;
+    int i;
+
+    switch (dev->tap_state)
+    {
+    case URJ_JIM_RESET:
+        generic_reset (dev);
+        break;
+
+    case URJ_JIM_CAPTURE_DR:
+        if (dev->current_dr == GENERIC_DR_IDCODE)
+            dev->sreg[1].reg[0] = gs->idcode;
+        break;
+
+    case URJ_JIM_CAPTURE_IR:
+        generic_set_ir (dev, gs->capture);
+        break;
+
+    case URJ_JIM_UPDATE_IR:
+        /* Anything not listed selects BYPASS */
+        dev->current_dr = GENERIC_DR_BYPASS;
+        for (i = 0; i < gs->num_opcodes; i++)
+            if (generic_match_ir (dev, gs->opcodes[i].bits))
+            {
+                dev->current_dr = gs->opcodes[i].dr;
+                break;
+            }
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void
+generic_free (urj_jim_device_t *dev)
+{
+    generic_state_t *gs = dev->state;
+    int i;
+
+    if (gs == NULL)
+        return;
+
+    for (i = 0; i < gs->num_opcodes; i++)
+        free (gs->opcodes[i].bits);
+    free (gs->opcodes);
+    free (gs->capture);
+    free (gs);
+}
+
+static int
+generic_add_opcode (generic_state_t *gs, const char *bits, int len, int dr)
+{
+    generic_opcode_t *op;
+
+    op = realloc (gs->opcodes, (gs->num_opcodes + 1) * sizeof *op);
+    if (op == NULL)
+    {
+        urj_error_set (URJ_ERROR_OUT_OF_MEMORY, "realloc(%s,%zd) fails",
+                       "gs->opcodes", (gs->num_opcodes + 1) * sizeof *op);
+        return URJ_STATUS_FAIL;
+    }
+    gs->opcodes = op;
+
+    op = &gs->opcodes[gs->num_opcodes];
+    op->bits = malloc (len + 1);
+    if (op->bits == NULL)
+    {
+        urj_error_set (URJ_ERROR_OUT_OF_MEMORY, "malloc(%d) fails", len + 1);
+        return URJ_STATUS_FAIL;
+    }
+    memcpy (op->bits, bits, len);
+    op->bits[len] = '\0';
+    op->dr = dr;
+    gs->num_opcodes++;
+
+    return URJ_STATUS_OK;
+}
+
+/* Allocates the device with the state attached but no opcodes yet */
+static urj_jim_device_t *
+generic_alloc (uint32_t idcode, int ir_len, int bsr_len)
+{
+    urj_jim_device_t *dev;
+    generic_state_t *gs;
+    const int reg_size[3] = { ir_len, 32, bsr_len };
+
+    if (ir_len < 2 || bsr_len < 1)
+    {
+        urj_error_set (URJ_ERROR_INVALID,
+                       "IR length %d or BSR length %d out of range",
+                       ir_len, bsr_len);
+        return NULL;
+    }
+
+    gs = calloc (1, sizeof (generic_state_t));
+    if (gs == NULL)
+    {
+        urj_error_set (URJ_ERROR_OUT_OF_MEMORY, "calloc(%zd) fails",
+                       sizeof (generic_state_t));
+        return NULL;
+    }
+
+    /* IEEE 1149.1 requires the two LSBs of the captured IR to be 01 */
+    gs->capture = malloc (ir_len + 1);
+    if (gs->capture == NULL)
+    {
+        urj_error_set (URJ_ERROR_OUT_OF_MEMORY, "malloc(%d) fails",
+                       ir_len + 1);
+        free (gs);
+        return NULL;
+    }
+    memset (gs->capture, '0', ir_len);
+    gs->capture[ir_len - 1] = '1';
+    gs->capture[ir_len] = '\0';
+    gs->idcode = idcode;
+
+    dev = urj_jim_alloc_device (3, reg_size);
+    if (dev == NULL)
+    {
+        free (gs->capture);
+        free (gs);
+        // retain error state
+        return NULL;
+    }
+
+    dev->state = gs;
+    dev->tck_rise = generic_tck_rise;
+    dev->passive_shift = 1;
+    dev->dev_free = generic_free;
+
+    return dev;
+}
+
+urj_jim_device_t *
+urj_jim_generic_device (uint32_t idcode, int ir_len, int bsr_len)
+{
+    urj_jim_device_t *dev;
+    generic_state_t *gs;
+    char *bits;
+    int i, r = URJ_STATUS_OK;
+
+    dev = generic_alloc (idcode, ir_len, bsr_len);
+    if (dev == NULL)
+        return NULL;
+    gs = dev->state;
+
+    bits = malloc (ir_len);
+    if (bits == NULL)
+    {
+        urj_error_set (URJ_ERROR_OUT_OF_MEMORY, "malloc(%d) fails", ir_len);
+        urj_jim_free_device (dev);
+        return NULL;
+    }
+
+    /* Same opcodes as some_cpu, extended to ir_len bits: EXTEST 0...00,
+     * IDCODE 0...01, SAMPLE 0...10, everything else BYPASS */
+    memset (bits, '0', ir_len);
+    r |= generic_add_opcode (gs, bits, ir_len, GENERIC_DR_BSR);
+    bits[ir_len - 1] = '1';
+    if (idcode != 0)
+        r |= generic_add_opcode (gs, bits, ir_len, GENERIC_DR_IDCODE);
+    bits[ir_len - 1] = '0';
+    bits[ir_len - 2] = '1';
+    r |= generic_add_opcode (gs, bits, ir_len, GENERIC_DR_BSR);
+    free (bits);
+
+    if (r != URJ_STATUS_OK)
+    {
+        urj_jim_free_device (dev);
+        // retain error state
+        return NULL;
+    }
+
+    for (i = 0; i < gs->num_opcodes; i++)
+        urj_log (URJ_LOG_LEVEL_DETAIL, "jim: opcode %s -> DR %d\n",
+                 gs->opcodes[i].bits, gs->opcodes[i].dr);
+
+    return dev;
+}
+
+#ifdef ENABLE_BSDL
+
+/* DIR and BSR are modelled, every other data register as a bypass */
+static int
+bsdl_instruction_dr (const urj_part_instruction_t *in)
+{
+    if (in->data_register == NULL)
+        return GENERIC_DR_BYPASS;
+    if (strcasecmp (in->data_register->name, "DIR") == 0)
+        return GENERIC_DR_IDCODE;
+    if (strcasecmp (in->data_register->name, "BSR") == 0)
+        return GENERIC_DR_BSR;
+    return GENERIC_DR_BYPASS;
+}
+
+urj_jim_device_t *
+urj_jim_bsdl_device (const char *filename)
+{
+    urj_jim_device_t *dev = NULL;
+    urj_chain_t *chain;
+    urj_part_t *part;
+    urj_part_instruction_t *in;
+    urj_data_register_t *bsr;
+    uint32_t idcode;
+    int ir_len, bsr_len;
+
+    /* Let src/bsdl fill in a part of its own, on a chain that has no cable */
+    chain = urj_tap_chain_alloc ();
+    if (chain == NULL)
+        return NULL;
+    chain->parts = urj_part_parts_alloc ();
+    part = urj_part_alloc (NULL);
+    if (chain->parts == NULL || part == NULL
+        || urj_part_parts_add_part (chain->parts, part) != URJ_STATUS_OK)
+    {
+        if (part != NULL)
+            urj_part_free (part);
+        goto done;
+    }
+
+    if (urj_bsdl_read_file (chain, filename, URJ_BSDL_MODE_INCLUDE2,
+                            NULL) < 0)
+    {
+        if (urj_error_get () == URJ_ERROR_OK)
+            urj_error_set (URJ_ERROR_BSDL_BSDL, "%s: not a valid BSDL file",
+                           filename);
+        goto done;
+    }
+
+    ir_len = part->instruction_length;
+    bsr = urj_part_find_data_register (part, "BSR");
+    bsr_len = (bsr != NULL && bsr->in->len > 0) ? bsr->in->len : 1;
+    idcode = (part->id != NULL) ? urj_tap_register_get_value (part->id) : 0;
+    if (ir_len <= 0 || part->instructions == NULL)
+    {
+        urj_error_set (URJ_ERROR_BSDL_BSDL,
+                       "%s: INSTRUCTION_LENGTH or INSTRUCTION_OPCODE missing",
+                       filename);
+        goto done;
+    }
+
+    dev = generic_alloc (idcode, ir_len, bsr_len);
+    if (dev == NULL)
+        goto done;
+
+    for (in = part->instructions; in != NULL; in = in->next)
+    {
+        const char *bits = urj_tap_register_get_string (in->value);
+
+        if (bits == NULL
+            || generic_add_opcode (dev->state, bits, ir_len,
+                                   bsdl_instruction_dr (in)) != URJ_STATUS_OK)
+        {
+            urj_jim_free_device (dev);
+            dev = NULL;
+            goto done;
+        }
+    }
+
+    urj_log (URJ_LOG_LEVEL_NORMAL,
+             "jim: %s: IDCODE %08lX, IR %d, BSR %d bits\n", filename,
+             (unsigned long) idcode, ir_len, bsr_len);
+
+ done:
+    urj_tap_chain_free (chain);
+
+    return dev;
+}
+
+#else /* ENABLE_BSDL */
+
+urj_jim_device_t *
+urj_jim_bsdl_device (const char *filename)
+{
+    urj_error_set (URJ_ERROR_UNSUPPORTED,
+                   "%s: BSDL files need a build with BSDL support", filename);
+    return NULL;
+}
+
+#endif /* ENABLE_BSDL */
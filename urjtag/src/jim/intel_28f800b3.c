@@ -29,6 +29,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <sys/time.h>
 #include <time.h>
 
@@ -54,11 +55,12 @@ typedef enum
     ERASE_SUSP_TO_READ_STATUS = 12,
     ERASE_SUSP_TO_READ_ARRAY = 13,
     ERASE_SUSP_TO_READ_ID = 14,
-    ERASE_COMPLETE = 15
+    ERASE_COMPLETE = 15,
+    READ_CFI = 16
 }
 intel_f28xxxb3_op_state_t;
 
-static const char *intel_28fxxx_opstate_name[16] = {
+static const char *intel_28fxxx_opstate_name[17] = {
     "READ_ARRAY",
     "READ_STATUS",
     "READ_ID",
@@ -74,9 +76,36 @@ static const char *intel_28fxxx_opstate_name[16] = {
     "ERASE_SUSP_TO_READ_STATUS",
     "ERASE_SUSP_TO_READ_ARRAY",
     "ERASE_SUSP_TO_READ_ID",
-    "ERASE_COMPLETE"
+    "ERASE_COMPLETE",
+    "READ_CFI"
 };
 
+/* CFI query table of the x16 B3 parts, from word offset 0x10 on */
+static const uint8_t intel_28fxxxb3_cfi[] = {
+    'Q', 'R', 'Y',
+    0x03, 0x00,                 /* primary command set: Intel/Sharp */
+    0x35, 0x00,                 /* primary extended table */
+    0x00, 0x00, 0x00, 0x00,     /* no alternate command set */
+    0x27, 0x36, 0xB4, 0xC6,     /* Vcc 2.7-3.6 V, Vpp 11.4-12.6 V */
+    0x05, 0x00, 0x0A, 0x00,     /* typ. word program 32 us, erase 1 s */
+    0x04, 0x00, 0x03, 0x00,     /* max. 16 and 8 times typical */
+    0x00,                       /* device size, filled in at init */
+    0x01, 0x00,                 /* x16 interface */
+    0x00, 0x00,                 /* no write buffer */
+    0x02,                       /* two erase block regions */
+    0x00, 0x00, 0x00, 0x00,     /* filled in at init */
+    0x00, 0x00, 0x00, 0x00,
+    'P', 'R', 'I', '1', '0'
+};
+
+#define CFI_DEVICE_SIZE         (0x27 - 0x10)
+#define CFI_REGIONS             (0x2D - 0x10)
+
+/* 8 parameter blocks of 4 KWords at the boot end, main blocks of 32 KWords
+ * elsewhere */
+#define B3_PARAM_BLOCK_WORDS    0x1000
+#define B3_MAIN_BLOCK_WORDS     0x8000
+
 typedef enum
 {
     TOP = 0,
@@ -103,6 +132,8 @@ typedef struct
     uint8_t status, status_buffer;
     intel_f28xxxb3_op_state_t opstate;
     b3_boot_type_t boot_type;
+    uint32_t size;              /* words */
+    uint8_t cfi[sizeof intel_28fxxxb3_cfi];
     struct timeval prog_start_time;
 }
 intel_f28xxxb3_state_t;
@@ -111,6 +142,9 @@ static int
 urj_jim_intel_28fxxxb3_init (urj_jim_bus_device_t *d, uint16_t id,
                              b3_boot_type_t bt)
 {
+    uint32_t blocks[2], words[2];
+    int i;
+
     d->state = malloc (sizeof (intel_f28xxxb3_state_t));
     if (d->state == NULL)
     {
@@ -126,6 +160,28 @@ urj_jim_intel_28fxxxb3_init (urj_jim_bus_device_t *d, uint16_t id,
     is->status = 0x00;
     is->status_buffer = 0x00;
     is->control_buffer = 0x00000000;
+    is->size = d->size;
+
+    memcpy (is->cfi, intel_28fxxxb3_cfi, sizeof is->cfi);
+    for (i = 0; (1u << i) < 2 * is->size; i++)
+        ;
+    is->cfi[CFI_DEVICE_SIZE] = i;
+
+    /* erase block regions in address order */
+    blocks[0] = 8;
+    words[0] = B3_PARAM_BLOCK_WORDS;
+    blocks[1] = (is->size - 8 * B3_PARAM_BLOCK_WORDS) / B3_MAIN_BLOCK_WORDS;
+    words[1] = B3_MAIN_BLOCK_WORDS;
+    for (i = 0; i < 2; i++)
+    {
+        int j = (bt == BOTTOM) ? i : 1 - i;
+        uint8_t *region = &is->cfi[CFI_REGIONS + 4 * i];
+
+        region[0] = (blocks[j] - 1) & 0xFF;
+        region[1] = (blocks[j] - 1) >> 8;
+        region[2] = (2 * words[j] / 256) & 0xFF;
+        region[3] = (2 * words[j] / 256) >> 8;
+    }
 
     return URJ_STATUS_OK;
 }
@@ -161,9 +217,18 @@ urj_jim_intel_28fxxxb3_capture (urj_jim_bus_device_t *d,
         case ERASE_CONTINUE:
         case PROG_SUSP_TO_READ_STATUS:
         case ERASE_SUSP_TO_READ_STATUS:
+        case PROG_COMPLETE:
+        case ERASE_COMPLETE:
+        case ERASE_ERROR:
             data = is->status_buffer;
             break;
 
+        case READ_CFI:
+            if (address >= 0x10
+                && address - 0x10 < sizeof is->cfi)
+                data = is->cfi[address - 0x10];
+            break;
+
         case READ_ID:
         case PROG_SUSP_TO_READ_ID:
         case ERASE_SUSP_TO_READ_ID:
@@ -176,8 +241,12 @@ urj_jim_intel_28fxxxb3_capture (urj_jim_bus_device_t *d,
         case READ_ARRAY:
         case PROG_SUSP_TO_READ_ARRAY:
         case ERASE_SUSP_TO_READ_ARRAY:
-            data = shmem[(address << 1)] << 8;
-            data |= shmem[(address << 1)] + 1;
+            /* the array lives in shmem, which memsize may make smaller */
+            if (((size_t) address << 1) + 2 <= shmem_size)
+            {
+                data = shmem[(address << 1)];
+                data |= shmem[(address << 1) + 1] << 8;
+            }
             break;
 
         default:
@@ -210,7 +279,7 @@ urj_jim_intel_28fxxxb3_update (urj_jim_bus_device_t *d,
     {
         intel_f28xxxb3_state_t *is = d->state;
         if ((((is->control_buffer & 1) == 0) && ((control & 1) == 1))   /* OE rise */
-            || (((is->control_buffer & 4) == 0) && ((control & 4) == 1)))       /* CS rise */
+            || (((is->control_buffer & 4) == 0) && ((control & 4) == 4)))       /* CS rise */
         {
             if (is->opstate == PROG_CONTINUE || is->opstate == ERASE_CONTINUE)
             {
@@ -234,17 +303,40 @@ urj_jim_intel_28fxxxb3_update (urj_jim_bus_device_t *d,
                 {
                     if (dusecs > 40)
                     {
-                        shmem[(is->address_buffer << 1)] &=
-                            ((data >> 8) & 0xFF);
-                        shmem[(is->address_buffer << 1) + 1] &= (data & 0xFF);
+                        size_t at = (size_t) is->address_buffer << 1;
+
+                        if (at + 2 <= shmem_size)
+                        {
+                            shmem[at] &= (is->data_buffer & 0xFF);
+                            shmem[at + 1] &= ((is->data_buffer >> 8) & 0xFF);
+                        }
                         is->status |= I28F_WSM_READY;
+                        is->opstate = PROG_COMPLETE;
                     }
                 }
                 else if (is->opstate == ERASE_CONTINUE)
                 {
                     if (dusecs > 600E3)
                     {
+                        uint32_t a = is->address_buffer, words;
+                        size_t at, bytes;
+
+                        if ((is->boot_type == BOTTOM
+                             && a < 8 * B3_PARAM_BLOCK_WORDS)
+                            || (is->boot_type == TOP
+                                && a >= is->size - 8 * B3_PARAM_BLOCK_WORDS))
+                            words = B3_PARAM_BLOCK_WORDS;
+                        else
+                            words = B3_MAIN_BLOCK_WORDS;
+                        a &= ~(words - 1);
+                        at = (size_t) a << 1;
+                        bytes = (size_t) words << 1;
+                        if (at < shmem_size)
+                            memset (&shmem[at], 0xFF,
+                                    at + bytes <= shmem_size
+                                    ? bytes : shmem_size - at);
                         is->status |= I28F_WSM_READY;
+                        is->opstate = ERASE_COMPLETE;
                     }
                 }
             }
@@ -273,6 +365,7 @@ urj_jim_intel_28fxxxb3_update (urj_jim_bus_device_t *d,
             case READ_STATUS:
             case READ_ARRAY:
             case READ_ID:
+            case READ_CFI:
                 switch (dl)
                 {
                 case 0x10:
@@ -288,6 +381,9 @@ urj_jim_intel_28fxxxb3_update (urj_jim_bus_device_t *d,
                 case 0x90:
                     is->opstate = READ_ID;
                     break;
+                case 0x98:
+                    is->opstate = READ_CFI;
+                    break;
                 default:
                     is->opstate = READ_ARRAY;
                     break;
@@ -295,19 +391,12 @@ urj_jim_intel_28fxxxb3_update (urj_jim_bus_device_t *d,
                 break;
 
             case PROG_SETUP:
-                if (dl != 0x10 && dl != 0x40)
-                {
-                    is->status |= I28F_PROG_ERROR | I28F_ERASE_ERROR;
-                    is->opstate = READ_STATUS;
-                }
-                else
-                {
-                    is->status &= ~I28F_WSM_READY;
-                    is->data_buffer = data;
-                    is->address_buffer = address;
-                    is->opstate = PROG_CONTINUE;
-                    gettimeofday (&(is->prog_start_time), NULL);
-                }
+                /* the second cycle carries the data to program */
+                is->status &= ~I28F_WSM_READY;
+                is->data_buffer = data;
+                is->address_buffer = address;
+                is->opstate = PROG_CONTINUE;
+                gettimeofday (&(is->prog_start_time), NULL);
                 break;
 
             case PROG_CONTINUE:
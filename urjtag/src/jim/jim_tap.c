@@ -22,10 +22,18 @@
  * THE SOFTWARE.
  */
 
+#include <sysdep.h>
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
 
 #include <urjtag/log.h>
 #include <urjtag/error.h>
@@ -222,6 +230,133 @@ urj_jim_tck_fall (urj_jim_state_t *s)
     }
 }
 
+static int
+urj_jim_sreg_bit (const urj_jim_shift_reg_t *sr, int i)
+{
+    return (sr->reg[i / 32] >> (i % 32)) & 1;
+}
+
+/* Runs n clocks with TMS=0 through one device sitting in a SHIFT state.
+ * On entry buf[] holds the bits presented at the device's TDI, on return
+ * it holds the bits seen at its TDO before each clock.  The caller leaves
+ * room for the longest register in front of buf[]. */
+static void
+urj_jim_shift_device (urj_jim_device_t *dev, char *buf, int n)
+{
+    urj_jim_shift_reg_t *sr;
+    char *line;
+    int i, len;
+
+    if (dev->tap_state == URJ_JIM_SHIFT_IR)
+        sr = &dev->sreg[0];
+    else if (dev->current_dr != 0)
+        sr = &dev->sreg[dev->current_dr];
+    else
+        sr = NULL;              /* BYPASS */
+
+    /* Register contents followed by the incoming bits form one delay
+     * line; the register keeps the last len bits of it after n clocks */
+    len = (sr == NULL) ? 1 : sr->len;
+    line = buf - len;
+
+    if (sr == NULL)
+        line[0] = dev->tdo;
+    else
+    {
+        for (i = 0; i < len; i++)
+            line[i] = urj_jim_sreg_bit (sr, i);
+        for (i = 0; i < (len + 31) / 32; i++)
+            sr->reg[i] = 0;
+        for (i = 0; i < len; i++)
+            if (line[n + i])
+                sr->reg[i / 32] |= 1u << (i % 32);
+    }
+
+    /* TDO shows the bit below the register, starting with the one latched
+     * on the last falling edge */
+    line[0] = dev->tdo;
+    dev->tdo = dev->tdo_buffer = line[n];
+    memmove (buf, line, n);
+}
+
+static void
+urj_jim_shift_chain (urj_jim_device_t *dev, char *buf, int n)
+{
+    if (dev->prev != NULL)
+        urj_jim_shift_chain (dev->prev, buf, n);
+    urj_jim_shift_device (dev, buf, n);
+}
+
+/* @return the longest register any device shifts in its current state, or
+ * -1 if some device is outside SHIFT_DR/SHIFT_IR or wants to see every
+ * clock */
+static int
+urj_jim_shift_headroom (urj_jim_state_t *s)
+{
+    urj_jim_device_t *dev;
+    int max = 1;
+
+    for (dev = s->last_device_in_chain; dev; dev = dev->prev)
+    {
+        int len = 1;
+
+        if (dev->tap_state != URJ_JIM_SHIFT_DR
+            && dev->tap_state != URJ_JIM_SHIFT_IR)
+            return -1;
+        if (!dev->passive_shift
+            && (dev->tck_rise != NULL || dev->tck_fall != NULL))
+            return -1;
+
+        if (dev->tap_state == URJ_JIM_SHIFT_IR)
+            len = dev->sreg[0].len;
+        else if (dev->current_dr != 0)
+            len = dev->sreg[dev->current_dr].len;
+        if (len > max)
+            max = len;
+    }
+
+    return max;
+}
+
+int
+urj_jim_shift (urj_jim_state_t *s, int len, const char *in, char *out)
+{
+    char *buf = NULL;
+    int i, room;
+
+    if (len <= 0)
+        return 0;
+
+    room = urj_jim_shift_headroom (s);
+    if (room > 0)
+        buf = malloc (room + len);
+
+    if (buf == NULL)
+    {
+        /* State transitions or clock-level device models: one TCK at a
+         * time */
+        for (i = 0; i < len; i++)
+        {
+            if (out)
+                out[i] = urj_jim_get_tdo (s);
+            urj_jim_tck_rise (s, 0, in[i]);
+            urj_jim_tck_fall (s);
+        }
+        return len;
+    }
+
+    for (i = 0; i < len; i++)
+        buf[room + i] = in[i] ? 1 : 0;
+
+    urj_jim_shift_chain (s->last_device_in_chain, buf + room, len);
+
+    if (out)
+        memcpy (out, buf + room, len);
+    free (buf);
+
+    return len;
+}
+
 urj_jim_device_t *
 urj_jim_alloc_device (int num_sregs, const int reg_size[])
 {
@@ -268,6 +403,7 @@ urj_jim_alloc_device (int num_sregs, const int reg_size[])
     dev->current_dr = 0;
     dev->tck_rise = NULL;
     dev->tck_fall = NULL;
+    dev->passive_shift = 0;
     dev->dev_free = NULL;
     dev->tap_state = URJ_JIM_RESET;
     dev->tdo = dev->tdo_buffer = 1;
@@ -275,8 +411,182 @@ urj_jim_alloc_device (int num_sregs, const int reg_size[])
     return dev;
 }
 
+/* Builds one device from a chain entry: "some_cpu", "fjmem[:WORDS]",
+ * IDCODE:IR[:BSR] or the name of a BSDL file */
+static urj_jim_device_t *
+urj_jim_chain_entry (const char *spec)
+{
+    unsigned long idcode;
+    long ir_len, bsr_len = 1;
+    char *end;
+
+    if (strcmp (spec, "some_cpu") == 0)
+        return urj_jim_some_cpu ();
+
+    if (strncmp (spec, "fjmem", 5) == 0
+        && (spec[5] == '\0' || spec[5] == ':'))
+    {
+        long burst = 0;
+
+        if (spec[5] == ':')
+        {
+            burst = strtol (spec + 6, &end, 0);
+            if (end == spec + 6 || *end != '\0' || burst < 1)
+            {
+                urj_error_set (URJ_ERROR_SYNTAX,
+                               "chain entry '%s': expected fjmem[:WORDS]",
+                               spec);
+                return NULL;
+            }
+        }
+        return urj_jim_fjmem (burst);
+    }
+
+    idcode = strtoul (spec, &end, 0);
+    if (end != spec && *end == ':')
+    {
+        ir_len = strtol (end + 1, &end, 0);
+        if (*end == ':')
+            bsr_len = strtol (end + 1, &end, 0);
+        if (*end != '\0')
+        {
+            urj_error_set (URJ_ERROR_SYNTAX,
+                           "chain entry '%s': expected IDCODE:IR[:BSR]",
+                           spec);
+            return NULL;
+        }
+        return urj_jim_generic_device (idcode, ir_len, bsr_len);
+    }
+
+    return urj_jim_bsdl_device (spec);
+}
+
+/* Appends the devices listed in 'chain' (comma separated, optionally as
+ * N*entry) behind *link; the first entry is closest to TDO */
+static int
+urj_jim_build_chain (urj_jim_device_t **link, const char *chain)
+{
+    char *list, *entry, *next;
+    int r = URJ_STATUS_OK;
+
+    list = strdup (chain);
+    if (list == NULL)
+    {
+        urj_error_set (URJ_ERROR_OUT_OF_MEMORY, "strdup(%s) fails", chain);
+        return URJ_STATUS_FAIL;
+    }
+
+    for (entry = list; entry != NULL && r == URJ_STATUS_OK; entry = next)
+    {
+        unsigned long n = 1;
+        char *end;
+
+        next = strchr (entry, ',');
+        if (next != NULL)
+            *next++ = '\0';
+
+        n = strtoul (entry, &end, 10);
+        if (end != entry && *end == '*')
+            entry = end + 1;
+        else
+            n = 1;
+
+        for (; n > 0; n--)
+        {
+            urj_jim_device_t *dev = urj_jim_chain_entry (entry);
+
+            if (dev == NULL)
+            {
+                r = URJ_STATUS_FAIL;
+                break;
+            }
+            dev->prev = NULL;
+            *link = dev;
+            link = &dev->prev;
+        }
+    }
+
+    free (list);
+    return r;
+}
+
+static int
+urj_jim_map_memory (urj_jim_state_t *s, const char *memfile)
+{
+#ifdef HAVE_SYS_MMAN_H
+    struct stat st;
+    void *p;
+    int fd;
+
+    fd = open (memfile, O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+    {
+        urj_error_IO_set ("Cannot open '%s'", memfile);
+        return URJ_STATUS_FAIL;
+    }
+
+    /* A fresh file reads like erased flash */
+    if (fstat (fd, &st) == 0 && (size_t) st.st_size < s->shmem_size)
+    {
+        uint8_t erased[4096];
+        off_t pos;
+
+        memset (erased, 0xFF, sizeof erased);
+        for (pos = st.st_size; pos < (off_t) s->shmem_size;
+             pos += sizeof erased)
+        {
+            size_t n = s->shmem_size - pos;
+
+            if (n > sizeof erased)
+                n = sizeof erased;
+            if (pwrite (fd, erased, n, pos) != (ssize_t) n)
+            {
+                urj_error_IO_set ("Cannot extend '%s'", memfile);
+                close (fd);
+                return URJ_STATUS_FAIL;
+            }
+        }
+    }
+
+    p = mmap (NULL, s->shmem_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close (fd);
+    if (p == MAP_FAILED)
+    {
+        urj_error_IO_set ("Cannot mmap '%s'", memfile);
+        return URJ_STATUS_FAIL;
+    }
+
+    s->shmem = p;
+    s->shmem_mapped = 1;
+    urj_log (URJ_LOG_LEVEL_NORMAL,
+             "Mapped %zd bytes of '%s' for device memory simulation.\n",
+             s->shmem_size, memfile);
+
+    return URJ_STATUS_OK;
+#else
+    urj_error_set (URJ_ERROR_UNSUPPORTED,
+                   "File backed device memory needs mmap()");
+    return URJ_STATUS_FAIL;
+#endif
+}
+
+void
+urj_jim_free_device (urj_jim_device_t *dev)
+{
+    int i;
+
+    if (dev->dev_free != NULL)
+        dev->dev_free (dev);
+    for (i = 0; i < dev->num_sregs; i++)
+    {
+        free (dev->sreg[i].reg);
+    }
+    free (dev->sreg);
+    free (dev);
+}
+
 urj_jim_state_t *
-urj_jim_init (void)
+urj_jim_init (const char *chain, const char *memfile, size_t memsize)
 {
     urj_jim_state_t *s;
 
@@ -288,38 +598,55 @@ urj_jim_init (void)
         return NULL;
     }
 
-    s->shmem_size = (1 << 20) * 16;     /* 16 MByte */
-    s->shmem = malloc (s->shmem_size);
+    s->trst = 0;
+    s->last_device_in_chain = NULL;
+    s->shmem_mapped = 0;
+    s->shmem_size = (memsize != 0) ? memsize : (1 << 20) * 16;  /* 16 MByte */
 
-    if (s->shmem != NULL)
+    if (memfile != NULL)
     {
-        memset (s->shmem, 0xFF, s->shmem_size);
-        urj_log (URJ_LOG_LEVEL_NORMAL,
-                 "Allocated %zd bytes for device memory simulation.\n",
-                s->shmem_size);
+        if (urj_jim_map_memory (s, memfile) != URJ_STATUS_OK)
+        {
+            free (s);
+            // retain error state
+            return NULL;
+        }
     }
     else
     {
-        free (s);
-        urj_error_set (URJ_ERROR_OUT_OF_MEMORY, "malloc(%zd) fails",
-                       sizeof (s->shmem_size));
-        return NULL;
-    }
+        s->shmem = malloc (s->shmem_size);
 
-    s->trst = 0;
-    s->last_device_in_chain = urj_jim_some_cpu ();
+        if (s->shmem != NULL)
+        {
+            memset (s->shmem, 0xFF, s->shmem_size);
+            urj_log (URJ_LOG_LEVEL_NORMAL,
+                     "Allocated %zd bytes for device memory simulation.\n",
+                     s->shmem_size);
+        }
+        else
+        {
+            urj_error_set (URJ_ERROR_OUT_OF_MEMORY, "malloc(%zd) fails",
+                           s->shmem_size);
+            free (s);
+            return NULL;
+        }
+    }
 
-    if (s->last_device_in_chain != NULL)
+    if (urj_jim_build_chain (&s->last_device_in_chain,
+                             chain != NULL ? chain : "some_cpu")
+        != URJ_STATUS_OK)
     {
-        s->last_device_in_chain->prev = NULL;
+        // retain error state
+        urj_jim_free (s);
+        return NULL;
     }
-    else
+    if (s->last_device_in_chain == NULL)
     {
-        free (s->shmem);
-        free (s);
-        // retain error state
+        urj_error_set (URJ_ERROR_INVALID, "empty chain");
+        urj_jim_free (s);
         return NULL;
     }
+
     return s;
 }
 
@@ -333,20 +660,16 @@ urj_jim_free (urj_jim_state_t *s)
 
     for (dev = s->last_device_in_chain; dev; dev = pre)
     {
-        int i;
-
-        if (dev->dev_free != NULL)
-            dev->dev_free (dev);
-        for (i = 0; i < dev->num_sregs; i++)
-        {
-            free (dev->sreg[i].reg);
-        }
-        free (dev->sreg);
         pre = dev->prev;
-        free (dev);
+        urj_jim_free_device (dev);
     }
 
     s->last_device_in_chain = NULL;
-    free (s->shmem);
+#ifdef HAVE_SYS_MMAN_H
+    if (s->shmem_mapped)
+        munmap (s->shmem, s->shmem_size);
+    else
+#endif
+        free (s->shmem);
     free (s);
 }
@@ -33,6 +33,7 @@
 #include <urjtag/bitmask.h>
 
 extern urj_jim_bus_device_t urj_jim_intel_28f800b3b;
+extern urj_jim_bus_device_t urj_jim_sram;
 
 static urj_jim_attached_part_t some_cpu_attached[] = {
     /* 1. Address offset: base offset [bytes]
@@ -40,7 +41,10 @@ static urj_jim_attached_part_t some_cpu_attached[] = {
      * 3. Data shift: Distance between D0 of device and CPU e.g. 0, 8, 16 or 24 bits
      * 4. Part: Pointer to part structure */
 
-    {0x00000000, 1, 0, &urj_jim_intel_28f800b3b},
+    {0x00000000, 0, 0, &urj_jim_intel_28f800b3b},
+    /* 16 bit words, so with A(0) as the word address LSB (see
+     * README.jim) this appears at byte address 0x01000000 */
+    {0x00800000, 0, 0, &urj_jim_sram},
 
     {0xFFFFFFFF, 0, 0, NULL}    /* Always end list with part == NULL */
 };
@@ -223,6 +227,7 @@ urj_jim_some_cpu (void)
             int i;
             dev->tck_rise = urj_jim_some_cpu_tck_rise;
             dev->tck_fall = urj_jim_some_cpu_tck_fall;
+            dev->passive_shift = 1;
             dev->dev_free = urj_jim_some_cpu_free;
             memcpy (dev->state, some_cpu_attached,
                     sizeof (some_cpu_attached));
@@ -0,0 +1,116 @@
+/*
+ * $Id$
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This code simulates a plain 16 bit wide static RAM. It is attached to
+ * some_cpu above the flash and stores its contents in the simulator's
+ * shared memory, right after the area used by the flash.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <urjtag/types.h>
+#include <urjtag/log.h>
+#include <urjtag/error.h>
+#include <urjtag/jim.h>
+
+/* The flash keeps its array in the first MByte of shmem */
+#define SRAM_SHMEM_OFFSET       (1 << 20)
+
+typedef struct
+{
+    uint32_t control_buffer;
+}
+sram_state_t;
+
+static int
+urj_jim_sram_init (urj_jim_bus_device_t *d)
+{
+    sram_state_t *ss;
+
+    ss = malloc (sizeof (sram_state_t));
+    if (ss == NULL)
+    {
+        urj_error_set (URJ_ERROR_OUT_OF_MEMORY, "malloc(%zd) fails",
+                       sizeof (sram_state_t));
+        return URJ_STATUS_FAIL;
+    }
+
+    ss->control_buffer = 0;
+    d->state = ss;
+
+    return URJ_STATUS_OK;
+}
+
+static void
+urj_jim_sram_free (urj_jim_bus_device_t *d)
+{
+    free (d->state);
+}
+
+static uint32_t
+urj_jim_sram_capture (urj_jim_bus_device_t *d,
+                      uint32_t address, uint32_t control,
+                      uint8_t *shmem, size_t shmem_size)
+{
+    size_t offset = SRAM_SHMEM_OFFSET + ((size_t) address << 1);
+    uint32_t data = 0;
+
+    if ((control & 7) == 5 && offset + 2 <= shmem_size)     /* OE and CS: READ */
+    {
+        data = shmem[offset] | (shmem[offset + 1] << 8);
+        urj_log (URJ_LOG_LEVEL_DETAIL, "sram: read %04X from %08X\n",
+                 data, address);
+    }
+
+    return data;
+}
+
+static void
+urj_jim_sram_update (urj_jim_bus_device_t *d,
+                     uint32_t address, uint32_t data, uint32_t control,
+                     uint8_t *shmem, size_t shmem_size)
+{
+    sram_state_t *ss = d->state;
+    size_t offset = SRAM_SHMEM_OFFSET + ((size_t) address << 1);
+
+    /* WE rise, CS active: WRITE */
+    if ((control & 7) == 6 && (ss->control_buffer & 2) != 2
+        && offset + 2 <= shmem_size)
+    {
+        urj_log (URJ_LOG_LEVEL_DETAIL, "sram: write %04X to %08X\n",
+                 data & 0xFFFF, address);
+        shmem[offset] = data & 0xFF;
+        shmem[offset + 1] = (data >> 8) & 0xFF;
+    }
+
+    ss->control_buffer = control;
+}
+
+urj_jim_bus_device_t urj_jim_sram = {
+    2,                          /* width [bytes] */
+    0x7FFFFFFF,                 /* size [words]; bounded by shmem_size */
+    NULL,                       /* state */
+    urj_jim_sram_init,          /* init() */
+    urj_jim_sram_capture,       /* access() */
+    urj_jim_sram_update,        /* access() */
+    urj_jim_sram_free           /* free() */
+};
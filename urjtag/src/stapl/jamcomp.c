@@ -75,8 +75,8 @@ urj_jam_read_packed (char *buffer, int32_t length, short bits)
 /****************************************************************************/
 {
     short result = -1;
-    static int32_t index = 0L;
-    static short bits_avail = 0;
+    static URJ_THREAD_LOCAL int32_t index = 0L;
+    static URJ_THREAD_LOCAL short bits_avail = 0;
     short shift = 0;
 
     /* If buffer is NULL then initialize. */
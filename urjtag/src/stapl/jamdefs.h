@@ -13,6 +13,8 @@
 #ifndef INC_JAMDEFS_H
 #define INC_JAMDEFS_H
 
+#include <sysdep.h>
+
 #include <stdint.h>
 #include <stddef.h>
 #include <stdlib.h>
@@ -158,16 +160,16 @@ typedef enum
 /*                                                                          */
 /****************************************************************************/
 
-extern char *urj_jam_workspace;
+extern URJ_THREAD_LOCAL char *urj_jam_workspace;
 
-extern int32_t urj_jam_workspace_size;
+extern URJ_THREAD_LOCAL int32_t urj_jam_workspace_size;
 
-extern char *urj_jam_program;
+extern URJ_THREAD_LOCAL char *urj_jam_program;
 
-extern int32_t urj_jam_program_size;
+extern URJ_THREAD_LOCAL int32_t urj_jam_program_size;
 
-extern char **urj_jam_init_list;
+extern URJ_THREAD_LOCAL char **urj_jam_init_list;
 
-extern JAME_PHASE_TYPE urj_jam_phase;
+extern URJ_THREAD_LOCAL JAME_PHASE_TYPE urj_jam_phase;
 
 #endif /* INC_JAMDEFS_H */
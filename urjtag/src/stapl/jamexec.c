@@ -38,56 +38,56 @@
 /****************************************************************************/
 
 /* pointer to memory buffer for variable, symbol and stack storage */
-char *urj_jam_workspace = NULL;
+URJ_THREAD_LOCAL char *urj_jam_workspace = NULL;
 
 /* size of available memory buffer */
-int32_t urj_jam_workspace_size = 0L;
+URJ_THREAD_LOCAL int32_t urj_jam_workspace_size = 0L;
 
 /* pointer to Jam program text */
-char *urj_jam_program = NULL;
+URJ_THREAD_LOCAL char *urj_jam_program = NULL;
 
 /* size of program buffer */
-int32_t urj_jam_program_size = 0L;
+URJ_THREAD_LOCAL int32_t urj_jam_program_size = 0L;
 
 /* current position in input stream */
-int32_t urj_jam_current_file_position = 0L;
+URJ_THREAD_LOCAL int32_t urj_jam_current_file_position = 0L;
 
 /* position in input stream of the beginning of the current statement */
-int32_t urj_jam_current_statement_position = 0L;
+URJ_THREAD_LOCAL int32_t urj_jam_current_statement_position = 0L;
 
 /* position of the beginning of the next statement (the one after the */
 /* current statement, but not necessarily the next one to be executed) */
-int32_t urj_jam_next_statement_position = 0L;
+URJ_THREAD_LOCAL int32_t urj_jam_next_statement_position = 0L;
 
 /* name of desired action (Jam 2.0 only) */
-char *urj_jam_action = NULL;
+URJ_THREAD_LOCAL char *urj_jam_action = NULL;
 
 /* pointer to initialization list */
-char **urj_jam_init_list = NULL;
+URJ_THREAD_LOCAL char **urj_jam_init_list = NULL;
 
 /* buffer for constant literal boolean array data */
 #define JAMC_MAX_LITERAL_ARRAYS 4
-int32_t urj_jam_literal_array_buffer[JAMC_MAX_LITERAL_ARRAYS];
+URJ_THREAD_LOCAL int32_t urj_jam_literal_array_buffer[JAMC_MAX_LITERAL_ARRAYS];
 
 /* buffer for constant literal ACA array data */
-int32_t *urj_jam_literal_aca_buffer[JAMC_MAX_LITERAL_ARRAYS];
+URJ_THREAD_LOCAL int32_t *urj_jam_literal_aca_buffer[JAMC_MAX_LITERAL_ARRAYS];
 
 /* number of vector signals */
-int urj_jam_vector_signal_count = 0;
+URJ_THREAD_LOCAL int urj_jam_vector_signal_count = 0;
 
 /* version of Jam language used:  0 = unknown */
-int urj_jam_version = 0;
+URJ_THREAD_LOCAL int urj_jam_version = 0;
 
 /* phase of Jam execution */
-JAME_PHASE_TYPE urj_jam_phase = JAM_UNKNOWN_PHASE;
+URJ_THREAD_LOCAL JAME_PHASE_TYPE urj_jam_phase = JAM_UNKNOWN_PHASE;
 
 /* current procedure or data block */
-JAMS_SYMBOL_RECORD *urj_jam_current_block = NULL;
+URJ_THREAD_LOCAL JAMS_SYMBOL_RECORD *urj_jam_current_block = NULL;
 
 /* this global flag indicates that we are processing the items in */
 /* the "uses" list for a procedure, executing the data blocks if */
 /* they have not yet been initialized, but not calling any procedures */
-BOOL urj_jam_checking_uses_list = false;
+URJ_THREAD_LOCAL BOOL urj_jam_checking_uses_list = false;
 
 /* function prototypes for forward reference */
 int urj_jam_get_statement (char *statement_buffer, char *label_buffer);
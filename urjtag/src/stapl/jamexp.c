@@ -126,15 +126,15 @@ struct
     {"FLOOR", 5, FLOOR_TOK}
 };
 
-char urj_jam_ch = '\0';             /* next character from input file */
-int urj_jam_strptr = 0;
-int urj_jam_token = 0;
-char urj_jam_token_buffer[MAX_BUFFER_LENGTH];
-int urj_jam_token_buffer_index;
-char urj_jam_parse_string[MAX_BUFFER_LENGTH];
-int32_t urj_jam_parse_value = 0;
-int urj_jam_expression_type = 0;
-JAMS_SYMBOL_RECORD *urj_jam_array_symbol_rec = NULL;
+URJ_THREAD_LOCAL char urj_jam_ch = '\0';             /* next character from input file */
+URJ_THREAD_LOCAL int urj_jam_strptr = 0;
+URJ_THREAD_LOCAL int urj_jam_token = 0;
+URJ_THREAD_LOCAL char urj_jam_token_buffer[MAX_BUFFER_LENGTH];
+URJ_THREAD_LOCAL int urj_jam_token_buffer_index;
+URJ_THREAD_LOCAL char urj_jam_parse_string[MAX_BUFFER_LENGTH];
+URJ_THREAD_LOCAL int32_t urj_jam_parse_value = 0;
+URJ_THREAD_LOCAL int urj_jam_expression_type = 0;
+URJ_THREAD_LOCAL JAMS_SYMBOL_RECORD *urj_jam_array_symbol_rec = NULL;
 
 #define YYMAXDEPTH 300          /* This fixes a stack depth problem on  */
                         /* all platforms.                       */
@@ -193,11 +193,11 @@ typedef struct EXP_STACK
 
 #define YYSTYPE EXPN_STACK      /* must be a #define for yacc */
 
-YYSTYPE urj_jam_null_expression = { 0, 0, 0, 0, 0 };
+URJ_THREAD_LOCAL YYSTYPE urj_jam_null_expression = { 0, 0, 0, 0, 0 };
 
-JAM_RETURN_TYPE urj_jam_return_code = JAMC_SUCCESS;
+URJ_THREAD_LOCAL JAM_RETURN_TYPE urj_jam_return_code = JAMC_SUCCESS;
 
-JAME_EXPRESSION_TYPE urj_jam_expr_type = JAM_ILLEGAL_EXPR_TYPE;
+URJ_THREAD_LOCAL JAME_EXPRESSION_TYPE urj_jam_expr_type = JAM_ILLEGAL_EXPR_TYPE;
 
 #define NULL_EXP urj_jam_null_expression    /* .. for 1 operand operators */
 
@@ -234,7 +234,7 @@ int urj_jam_yylex (void);
 #ifndef YYSTYPE
 #define YYSTYPE int
 #endif
-YYSTYPE urj_jam_yylval, urj_jam_yyval;
+URJ_THREAD_LOCAL YYSTYPE urj_jam_yylval, urj_jam_yyval;
 #define YYERRCODE 256
 
 /* # line 333 "jamexp.y" */
@@ -1529,10 +1529,10 @@ static const int jam_yydef[] = {
 #define YYACCEPT return(0)
 #define YYABORT return(1)
 
-static YYSTYPE jam_yyv[YYMAXDEPTH];
-static int token = -1;                 /* input token */
-static int errct = 0;                  /* error count */
-static int errfl = 0;                  /* error flag */
+static URJ_THREAD_LOCAL YYSTYPE jam_yyv[YYMAXDEPTH];
+static URJ_THREAD_LOCAL int token = -1;                 /* input token */
+static URJ_THREAD_LOCAL int errct = 0;                  /* error count */
+static URJ_THREAD_LOCAL int errfl = 0;                  /* error flag */
 
 int
 urj_jam_yyparse (void)
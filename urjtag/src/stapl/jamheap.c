@@ -26,11 +26,11 @@
 /*                                                                          */
 /****************************************************************************/
 
-JAMS_HEAP_RECORD *urj_jam_heap = NULL;
+URJ_THREAD_LOCAL JAMS_HEAP_RECORD *urj_jam_heap = NULL;
 
-void *urj_jam_heap_top = NULL;
+URJ_THREAD_LOCAL void *urj_jam_heap_top = NULL;
 
-int32_t urj_jam_heap_records = 0L;
+URJ_THREAD_LOCAL int32_t urj_jam_heap_records = 0L;
 
 /****************************************************************************/
 /*                                                                          */
@@ -61,9 +61,9 @@ typedef struct JAMS_HEAP_STRUCT
 /*                                                                          */
 /****************************************************************************/
 
-extern JAMS_HEAP_RECORD *urj_jam_heap;
+extern URJ_THREAD_LOCAL JAMS_HEAP_RECORD *urj_jam_heap;
 
-extern void *urj_jam_heap_top;
+extern URJ_THREAD_LOCAL void *urj_jam_heap_top;
 
 /****************************************************************************/
 /*                                                                          */
@@ -25,29 +25,29 @@
 /*
 *   Global variable to store the current JTAG state
 */
-JAME_JTAG_STATE urj_jam_jtag_state = JAM_ILLEGAL_JTAG_STATE;
+URJ_THREAD_LOCAL JAME_JTAG_STATE urj_jam_jtag_state = JAM_ILLEGAL_JTAG_STATE;
 
 /*
 *   Store current stop-state for DR and IR scan commands
 */
-JAME_JTAG_STATE urj_jam_drstop_state = IDLE;
-JAME_JTAG_STATE urj_jam_irstop_state = IDLE;
+URJ_THREAD_LOCAL JAME_JTAG_STATE urj_jam_drstop_state = IDLE;
+URJ_THREAD_LOCAL JAME_JTAG_STATE urj_jam_irstop_state = IDLE;
 
 /*
 *   Store current padding values
 */
-int urj_jam_dr_preamble = 0;
-int urj_jam_dr_postamble = 0;
-int urj_jam_ir_preamble = 0;
-int urj_jam_ir_postamble = 0;
-int urj_jam_dr_length = 0;
-int urj_jam_ir_length = 0;
-int32_t *urj_jam_dr_preamble_data = NULL;
-int32_t *urj_jam_dr_postamble_data = NULL;
-int32_t *urj_jam_ir_preamble_data = NULL;
-int32_t *urj_jam_ir_postamble_data = NULL;
-char *urj_jam_dr_buffer = NULL;
-char *urj_jam_ir_buffer = NULL;
+URJ_THREAD_LOCAL int urj_jam_dr_preamble = 0;
+URJ_THREAD_LOCAL int urj_jam_dr_postamble = 0;
+URJ_THREAD_LOCAL int urj_jam_ir_preamble = 0;
+URJ_THREAD_LOCAL int urj_jam_ir_postamble = 0;
+URJ_THREAD_LOCAL int urj_jam_dr_length = 0;
+URJ_THREAD_LOCAL int urj_jam_ir_length = 0;
+URJ_THREAD_LOCAL int32_t *urj_jam_dr_preamble_data = NULL;
+URJ_THREAD_LOCAL int32_t *urj_jam_dr_postamble_data = NULL;
+URJ_THREAD_LOCAL int32_t *urj_jam_ir_preamble_data = NULL;
+URJ_THREAD_LOCAL int32_t *urj_jam_ir_postamble_data = NULL;
+URJ_THREAD_LOCAL char *urj_jam_dr_buffer = NULL;
+URJ_THREAD_LOCAL char *urj_jam_ir_buffer = NULL;
 
 /*
 *   Table of JTAG state names
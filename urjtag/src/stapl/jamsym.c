@@ -28,9 +28,9 @@
 /*                                                                          */
 /****************************************************************************/
 
-JAMS_SYMBOL_RECORD **urj_jam_symbol_table = NULL;
+URJ_THREAD_LOCAL JAMS_SYMBOL_RECORD **urj_jam_symbol_table = NULL;
 
-void *urj_jam_symbol_bottom = NULL;
+URJ_THREAD_LOCAL void *urj_jam_symbol_bottom = NULL;
 
 int urj_jam_init_symbol_table (void);
 void urj_jam_free_symbol_table (void);
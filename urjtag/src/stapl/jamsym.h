@@ -54,15 +54,15 @@ typedef struct JAMS_SYMBOL_STRUCT
 /*                                                                          */
 /****************************************************************************/
 
-extern JAMS_SYMBOL_RECORD **urj_jam_symbol_table;
+extern URJ_THREAD_LOCAL JAMS_SYMBOL_RECORD **urj_jam_symbol_table;
 
-extern void *urj_jam_symbol_bottom;
+extern URJ_THREAD_LOCAL void *urj_jam_symbol_bottom;
 
-extern JAMS_SYMBOL_RECORD *urj_jam_current_block;
+extern URJ_THREAD_LOCAL JAMS_SYMBOL_RECORD *urj_jam_current_block;
 
-extern int urj_jam_version;
+extern URJ_THREAD_LOCAL int urj_jam_version;
 
-extern BOOL urj_jam_checking_uses_list;
+extern URJ_THREAD_LOCAL BOOL urj_jam_checking_uses_list;
 
 /****************************************************************************/
 /*                                                                          */
@@ -22,6 +22,8 @@
  *
  */
 
+#include <sysdep.h>
+
 #include <stdbool.h>
 #include <stdlib.h>
 #include <sys/stat.h>
@@ -36,13 +38,13 @@
 *   Global variables
 ***********************************************************************/
 /* UrJTAG */
-static urj_cable_t *current_cable;
-static urj_chain_t *current_chain;
+static URJ_THREAD_LOCAL urj_cable_t *current_cable;
+static URJ_THREAD_LOCAL urj_chain_t *current_chain;
 
 /* file buffer for JAM input file */
-static char *file_buffer = NULL;
-static int32_t file_pointer = 0L;
-static int32_t file_length = 0L;
+static URJ_THREAD_LOCAL char *file_buffer = NULL;
+static URJ_THREAD_LOCAL int32_t file_pointer = 0L;
+static URJ_THREAD_LOCAL int32_t file_length = 0L;
 
 int urj_jam_getc (void);
 int urj_jam_seek (int32_t offset);
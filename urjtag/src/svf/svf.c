@@ -33,16 +33,14 @@
 #include <string.h>
 #include <ctype.h>
 #include <math.h>
-#include <signal.h>
 #include <unistd.h>
 #include <sys/types.h>
-#ifndef SA_ONESHOT
-#define SA_ONESHOT SA_RESETHAND
-#endif
+#include <sys/stat.h>
 
 #include <urjtag/error.h>
 #include <urjtag/cable.h>
 #include <urjtag/part.h>
+#include <urjtag/tap.h>
 #include <urjtag/tap_state.h>
 #include <urjtag/tap_register.h>
 #include <urjtag/part_instruction.h>
@@ -71,25 +69,15 @@
 int urj_svf_parse (urj_svf_parser_priv_t *priv_data, urj_chain_t *chain);
 
 
-/*
- * urj_svf_force_reset_state()
- *
- * Puts TAP controller into reset state by clocking 5 times with TMS = 1.
- */
-static void
-urj_svf_force_reset_state (urj_chain_t *chain)
-{
-    urj_tap_chain_clock (chain, 1, 0, 5);
-    urj_tap_state_reset (chain);
-}
-
-
 /*
  * urj_svf_goto_state(state)
  *
  * Moves from any TAP state to the specified state.
  * The state traversal is done according to the SVF specification.
  *   See STATE of the Serial Vector Format Specification
+ * The path comes from the table of urj_tap_state_path() and is queued as
+ * one TMS sequence; an unknown current state is left through
+ * Test-Logic-Reset.
  *
  * Encoding of state is according to the jtag suite's defines.
  *
@@ -99,125 +87,11 @@ urj_svf_force_reset_state (urj_chain_t *chain)
 static void
 urj_svf_goto_state (urj_chain_t *chain, int new_state)
 {
-    int current_state;
-
-    current_state = urj_tap_state (chain);
-
     /* handle unknown state */
     if (new_state == URJ_TAP_STATE_UNKNOWN_STATE)
         new_state = URJ_TAP_STATE_TEST_LOGIC_RESET;
 
-    /* abort if new_state already reached */
-    if (current_state == new_state)
-        return;
-
-    switch (current_state)
-    {
-    case URJ_TAP_STATE_TEST_LOGIC_RESET:
-        CHAIN_CLOCK (chain, 0, 0, 1);
-        break;
-
-    case URJ_TAP_STATE_RUN_TEST_IDLE:
-        CHAIN_CLOCK (chain, 1, 0, 1);
-        break;
-
-    case URJ_TAP_STATE_SELECT_DR_SCAN:
-    case URJ_TAP_STATE_SELECT_IR_SCAN:
-        if (new_state == URJ_TAP_STATE_TEST_LOGIC_RESET ||
-            new_state == URJ_TAP_STATE_RUN_TEST_IDLE ||
-            (current_state & URJ_TAP_STATE_DR && new_state & URJ_TAP_STATE_IR)
-            || (current_state & URJ_TAP_STATE_IR
-                && new_state & URJ_TAP_STATE_DR))
-            /* progress in select-idle/reset loop */
-            CHAIN_CLOCK (chain, 1, 0, 1);
-        else
-            /* enter DR/IR branch */
-            CHAIN_CLOCK (chain, 0, 0, 1);
-        break;
-
-    case URJ_TAP_STATE_CAPTURE_DR:
-        if (new_state == URJ_TAP_STATE_SHIFT_DR)
-            /* enter URJ_TAP_STATE_SHIFT_DR state */
-            CHAIN_CLOCK (chain, 0, 0, 1);
-        else
-            /* bypass URJ_TAP_STATE_SHIFT_DR */
-            CHAIN_CLOCK (chain, 1, 0, 1);
-        break;
-
-    case URJ_TAP_STATE_CAPTURE_IR:
-        if (new_state == URJ_TAP_STATE_SHIFT_IR)
-            /* enter URJ_TAP_STATE_SHIFT_IR state */
-            CHAIN_CLOCK (chain, 0, 0, 1);
-        else
-            /* bypass URJ_TAP_STATE_SHIFT_IR */
-            CHAIN_CLOCK (chain, 1, 0, 1);
-        break;
-
-    case URJ_TAP_STATE_SHIFT_DR:
-    case URJ_TAP_STATE_SHIFT_IR:
-        /* progress to URJ_TAP_STATE_EXIT1_DR/IR */
-        CHAIN_CLOCK (chain, 1, 0, 1);
-        break;
-
-    case URJ_TAP_STATE_EXIT1_DR:
-        if (new_state == URJ_TAP_STATE_PAUSE_DR)
-            /* enter URJ_TAP_STATE_PAUSE_DR state */
-            CHAIN_CLOCK (chain, 0, 0, 1);
-        else
-            /* bypass URJ_TAP_STATE_PAUSE_DR */
-            CHAIN_CLOCK (chain, 1, 0, 1);
-        break;
-
-    case URJ_TAP_STATE_EXIT1_IR:
-        if (new_state == URJ_TAP_STATE_PAUSE_IR)
-            /* enter URJ_TAP_STATE_PAUSE_IR state */
-            CHAIN_CLOCK (chain, 0, 0, 1);
-        else
-            /* bypass URJ_TAP_STATE_PAUSE_IR */
-            CHAIN_CLOCK (chain, 1, 0, 1);
-        break;
-
-    case URJ_TAP_STATE_PAUSE_DR:
-    case URJ_TAP_STATE_PAUSE_IR:
-        /* progress to URJ_TAP_STATE_EXIT2_DR/IR */
-        CHAIN_CLOCK (chain, 1, 0, 1);
-        break;
-
-    case URJ_TAP_STATE_EXIT2_DR:
-        if (new_state == URJ_TAP_STATE_SHIFT_DR)
-            /* enter URJ_TAP_STATE_SHIFT_DR state */
-            CHAIN_CLOCK (chain, 0, 0, 1);
-        else
-            /* progress to URJ_TAP_STATE_UPDATE_DR */
-            CHAIN_CLOCK (chain, 1, 0, 1);
-        break;
-
-    case URJ_TAP_STATE_EXIT2_IR:
-        if (new_state == URJ_TAP_STATE_SHIFT_IR)
-            /* enter URJ_TAP_STATE_SHIFT_IR state */
-            CHAIN_CLOCK (chain, 0, 0, 1);
-        else
-            /* progress to URJ_TAP_STATE_UPDATE_IR */
-            CHAIN_CLOCK (chain, 1, 0, 1);
-        break;
-
-    case URJ_TAP_STATE_UPDATE_DR:
-    case URJ_TAP_STATE_UPDATE_IR:
-        if (new_state == URJ_TAP_STATE_RUN_TEST_IDLE)
-            /* enter URJ_TAP_STATE_RUN_TEST_IDLE */
-            CHAIN_CLOCK (chain, 0, 0, 1);
-        else
-            /* progress to Select_DR/IR */
-            CHAIN_CLOCK (chain, 1, 0, 1);
-        break;
-
-    default:
-        urj_svf_force_reset_state (chain);
-        break;
-    }
-
-    /* continue state changes */
-    urj_svf_goto_state (chain, new_state);
+    urj_tap_chain_defer_goto_state (chain, new_state);
 }
 
 
@@ -395,6 +269,26 @@ urj_svf_build_bit_string (char *hex_string, int len)
 }
 
 
+/*
+ * urj_svf_hex_bit(hex_string, hex_len, bit)
+ *
+ * Returns bit number bit (0 = LSB) of the hexadecimal string hex_string,
+ * which has hex_len nibbles. Missing nibbles are 0, as with
+ * urj_svf_build_bit_string().
+ */
+static int
+urj_svf_hex_bit (const char *hex_string, size_t hex_len, int bit)
+{
+    size_t nibble = bit / 4;
+
+    if (nibble >= hex_len)
+        return 0;
+
+    return (urj_svf_hex2dec (hex_string[hex_len - 1 - nibble]) >> (bit % 4))
+           & 1;
+}
+
+
 /*
  * urj_svf_copy_hex_to_register(hex_string, reg)
  *
@@ -411,53 +305,38 @@ urj_svf_build_bit_string (char *hex_string, int len)
 static int
 urj_svf_copy_hex_to_register (char *hex_string, urj_tap_register_t *reg)
 {
-    char *bit_string;
-
-    if (!(bit_string = urj_svf_build_bit_string (hex_string, reg->len)))
-        return URJ_STATUS_FAIL;
-
-    urj_tap_register_init (reg, bit_string);
+    size_t hex_len = strlen (hex_string);
+    int i;
 
-    /* free memory as we do not need the intermediate bit_string anymore */
-    free (bit_string);
+    for (i = 0; i < reg->len; i++)
+        reg->data[i] = urj_svf_hex_bit (hex_string, hex_len, i);
 
     return URJ_STATUS_OK;
 }
 
 
 /*
- * urj_svf_compare_tdo(tdo, mask, reg)
- *
- * Compares the captured device output in tap register reg with the expected
- * hex_string tdo (specified in SVF command SDR/SDI.
+ * urj_svf_compare_bits(tdo_bit, mask_bit, reg)
  *
- * Comparison honours the "care" bits in mask ('1') while matching the contents
- * of reg with tdo.
+ * Like urj_svf_compare_tdo(), with tdo and mask given as bit strings of
+ * reg->len bits each.
  *
  * Parameter:
- *   tdo  : reference hex string
- *   mask : hex string for masking tdo
- *   reg  : hex string to be compared vs. tdo
+ *   tdo_bit  : reference bit string
+ *   mask_bit : bit string for masking tdo_bit
+ *   reg      : register to be compared vs. tdo_bit
  *
  * Return value:
  *   URJ_STATUS_OK   : tdo matches reg at all positions where mask is '1'
  *   URJ_STATUS_FAIL : tdo and reg do not match or error occurred
  */
 static int
-urj_svf_compare_tdo (urj_svf_parser_priv_t *priv, char *tdo, char *mask,
-                     urj_tap_register_t *reg, YYLTYPE *loc)
+urj_svf_compare_bits (urj_svf_parser_priv_t *priv, const char *tdo_bit,
+                      const char *mask_bit, urj_tap_register_t *reg,
+                      YYLTYPE *loc)
 {
-    char *tdo_bit, *mask_bit;
     int pos, mismatch, result = URJ_STATUS_OK;
 
-    if (!(tdo_bit = urj_svf_build_bit_string (tdo, reg->len)))
-        return URJ_STATUS_FAIL;
-    if (!(mask_bit = urj_svf_build_bit_string (mask, reg->len)))
-    {
-        free (tdo_bit);
-        return URJ_STATUS_FAIL;
-    }
-
     /* retrieve string representation */
     urj_tap_register_get_string (reg);
 
@@ -487,6 +366,55 @@ urj_svf_compare_tdo (urj_svf_parser_priv_t *priv, char *tdo, char *mask,
             result = URJ_STATUS_FAIL;
     }
 
+    return result;
+}
+
+
+/*
+ * urj_svf_compare_tdo(tdo, mask, reg)
+ *
+ * Compares the captured device output in tap register reg with the expected
+ * hex_string tdo (specified in SVF command SDR/SDI.
+ *
+ * Comparison honours the "care" bits in mask ('1') while matching the contents
+ * of reg with tdo.
+ *
+ * Parameter:
+ *   tdo  : reference hex string
+ *   mask : hex string for masking tdo
+ *   reg  : hex string to be compared vs. tdo
+ *
+ * Return value:
+ *   URJ_STATUS_OK   : tdo matches reg at all positions where mask is '1'
+ *   URJ_STATUS_FAIL : tdo and reg do not match or error occurred
+ */
+static int
+urj_svf_compare_tdo (urj_svf_parser_priv_t *priv, char *tdo, char *mask,
+                     urj_tap_register_t *reg, YYLTYPE *loc)
+{
+    size_t tdo_len = strlen (tdo);
+    size_t mask_len = strlen (mask);
+    char *tdo_bit, *mask_bit;
+    int i, result;
+
+    /* the common case is a match, which needs no bit strings */
+    for (i = 0; i < reg->len; i++)
+        if (urj_svf_hex_bit (mask, mask_len, i)
+            && urj_svf_hex_bit (tdo, tdo_len, i) != reg->data[i])
+            break;
+    if (i == reg->len)
+        return URJ_STATUS_OK;
+
+    if (!(tdo_bit = urj_svf_build_bit_string (tdo, reg->len)))
+        return URJ_STATUS_FAIL;
+    if (!(mask_bit = urj_svf_build_bit_string (mask, reg->len)))
+    {
+        free (tdo_bit);
+        return URJ_STATUS_FAIL;
+    }
+
+    result = urj_svf_compare_bits (priv, tdo_bit, mask_bit, reg, loc);
+
     free (mask_bit);
     free (tdo_bit);
 
@@ -497,66 +425,64 @@ urj_svf_compare_tdo (urj_svf_parser_priv_t *priv, char *tdo, char *mask,
 /*
  * urj_svf_remember_param(rem, new)
  *
- * Assigns the contents of the string new to the string rem.
- * By doing so, the responsability to free the memory occupied by new
- * is transferred to the code that handles *rem.
- * Nothing happens when new is NULL. In this case the current value of
- * rem has to be "remembered".
+ * Makes the hex string in new the "remembered" value rem by swapping the
+ * two buffers. The previous value of rem goes to new, whose buffer is
+ * reused for the next hex string the parser reads, so remembering neither
+ * copies nor allocates.
  *
  * Parameter:
- *   rem : hex string pointer pointing to the "remembered" string
- *   new : hex string that has to be rememberd
- *         memory of the string is free'd
+ *   rem : buffer holding the "remembered" string
+ *   new : buffer holding the hex string that has to be remembered
  */
 static void
-urj_svf_remember_param (char **rem, char *new)
+urj_svf_remember_param (struct hexa_frag *rem, struct hexa_frag *new)
 {
-    if (new)
-    {
-        if (*rem)
-            free (*rem);
+    struct hexa_frag tmp = *rem;
 
-        *rem = new;
-    }
+    *rem = *new;
+    *new = tmp;
 }
 
 
 /*
  * urj_svf_all_care(string, number)
  *
- * Allocates a hex string of given length (number gives number of bits)
- * and sets it to all 'F'.
- * The allocated memory of the string has to be free'd by the caller.
+ * Sets the hex string in buffer string to all 'F' for the given number of
+ * bits, growing the buffer if needed.
  *
  * Parameter:
- *   string : is updated with the pointer to the allocated hex string
+ *   string : buffer to be updated
  *   number : number of required bits
  *
  * Return value:
  *   URJ_STATUS_OK, URJ_STATUS_FAIL
  */
 static int
-urj_svf_all_care (char **string, double number)
+urj_svf_all_care (struct hexa_frag *string, double number)
 {
-    char *ptr;
-    int num;
+    size_t num;
 
-    num = (int) number;
+    num = (size_t) number;
     num = num % 4 == 0 ? num / 4 : num / 4 + 1;
 
-    /* build string with all cares */
-    if (!(ptr = calloc (num + 1, sizeof (char))))
+    if (string->buflen < num + 1)
     {
-        urj_error_set (URJ_ERROR_OUT_OF_MEMORY, _("calloc(%zd,%zd) fails"),
-                       (size_t) (num + 1), sizeof (char));
-        return URJ_STATUS_FAIL;
+        char *ptr = realloc (string->buf, num + 1);
+
+        if (ptr == NULL)
+        {
+            urj_error_set (URJ_ERROR_OUT_OF_MEMORY, _("realloc(%zd) fails"),
+                           num + 1);
+            return URJ_STATUS_FAIL;
+        }
+        string->buf = ptr;
+        string->buflen = num + 1;
     }
-    memset (ptr, 'F', num);
-    ptr[num] = '\0';
 
-    urj_svf_remember_param (string, ptr);
-    /* responsability for free'ing ptr is now at the code that
-       operates on *string */
+    /* build string with all cares */
+    memset (string->buf, 'F', num);
+    string->buf[num] = '\0';
+    string->strlen = num;
 
     return URJ_STATUS_OK;
 }
@@ -602,14 +528,98 @@ urj_svf_frequency (urj_chain_t *chain, double freq)
 }
 
 
+/*
+ * urj_svf_free_pad(pad)
+ *
+ * Releases the bit strings of a header or trailer and sets its length to 0.
+ */
+static void
+urj_svf_free_pad (urj_svf_pad_t *pad)
+{
+    free (pad->tdi_bits);
+    free (pad->tdo_bits);
+    free (pad->mask_bits);
+    pad->tdi_bits = pad->tdo_bits = pad->mask_bits = NULL;
+    pad->len = 0;
+}
+
+
+/*
+ * urj_svf_set_pad(pad, params, cmd)
+ *
+ * Common part of HIR, HDR, TIR and TDR. The hex strings are converted to
+ * bit strings here, once, so that SIR and SDR only have to join them with
+ * their own data.
+ * TDI and MASK are remembered as long as the length does not change, TDO
+ * applies to the following SIR/SDR commands until the next HXR/TXR.
+ *
+ * Parameter:
+ *   pad    : header or trailer to update
+ *   params : paramter set for TXR, HXR and SXR
+ *   cmd    : command name for messages
+ *
+ * Return value:
+ *   URJ_STATUS_OK, URJ_STATUS_FAIL
+ */
+static int
+urj_svf_set_pad (urj_svf_pad_t *pad, struct ths_params *params,
+                 const char *cmd)
+{
+    int len = (int) params->number;
+
+    if (len != pad->len)
+        urj_svf_free_pad (pad);
+    pad->len = len;
+    if (len == 0)
+        return URJ_STATUS_OK;
+
+    if (params->tdi)
+    {
+        free (pad->tdi_bits);
+        if (!(pad->tdi_bits = urj_svf_build_bit_string (params->tdi, len)))
+            return URJ_STATUS_FAIL;
+    }
+    else if (!pad->tdi_bits)
+    {
+        urj_error_set (URJ_ERROR_SYNTAX,
+                       _("Error %s: first %s command after length change must have a TDI value"),
+                       "svf", cmd);
+        return URJ_STATUS_FAIL;
+    }
+
+    free (pad->tdo_bits);
+    pad->tdo_bits = NULL;
+    if (params->tdo)
+        if (!(pad->tdo_bits = urj_svf_build_bit_string (params->tdo, len)))
+            return URJ_STATUS_FAIL;
+
+    if (params->mask)
+    {
+        free (pad->mask_bits);
+        if (!(pad->mask_bits = urj_svf_build_bit_string (params->mask, len)))
+            return URJ_STATUS_FAIL;
+    }
+    else if (!pad->mask_bits)
+    {
+        /* all care */
+        if (!(pad->mask_bits = calloc (len + 1, sizeof (char))))
+        {
+            urj_error_set (URJ_ERROR_OUT_OF_MEMORY, "calloc(%zd,%zd) fails",
+                           (size_t) (len + 1), sizeof (char));
+            return URJ_STATUS_FAIL;
+        }
+        memset (pad->mask_bits, '1', len);
+    }
+
+    return URJ_STATUS_OK;
+}
+
+
 /* ***************************************************************************
  * urj_svf_hxr(ir_dr, params)
  *
  * Handles HIR, HDR.
  *
- * Note:
- * Functionality not implemented.
- *
  * Parameter:
  *   ir_dr  : selects HIR or HDR
  *   params : paramter set for TXR, HXR and SXR
@@ -618,25 +628,15 @@ urj_svf_frequency (urj_chain_t *chain, double freq)
  *   URJ_STATUS_OK, URJ_STATUS_FAIL
  * ***************************************************************************/
 int
-urj_svf_hxr (enum generic_irdr_coding ir_dr, struct ths_params *params)
+urj_svf_hxr (urj_svf_parser_priv_t *priv, enum generic_irdr_coding ir_dr,
+             struct ths_params *params)
 {
-    if (params->number != 0.0)
-        urj_warning ( _("command %s not implemented\n"),
-                     ir_dr == generic_ir ? "HIR" : "HDR");
+    priv->scan[ir_dr].dirty = 1;
 
-    return URJ_STATUS_OK;
+    return urj_svf_set_pad (&priv->header[ir_dr], params,
+                            ir_dr == generic_ir ? "HIR" : "HDR");
 }
 
-#ifdef HAVE_SIGACTION_SA_ONESHOT
-static int max_time_reached;
-static void
-sigalrm_handler (int signal)
-{
-    max_time_reached = 1;
-}
-#endif
-
-
 /* ***************************************************************************
  * urj_svf_runtest(params)
  *
@@ -652,7 +652,7 @@ int
 urj_svf_runtest (urj_chain_t *chain, urj_svf_parser_priv_t *priv,
                  struct runtest *params)
 {
-    uint32_t run_count, frequency;
+    uint32_t frequency;
 
     /* check for restrictions */
     if (params->run_count > 0 && params->run_clk != TCK)
@@ -689,98 +689,21 @@ urj_svf_runtest (urj_chain_t *chain, urj_svf_parser_priv_t *priv,
     if (params->end_state != 0)
         priv->runtest_end_state = urj_svf_map_state (params->end_state);
 
-    /* compute run_count */
-    run_count = params->run_count;
-    if (params->min_time > 0.0)
-    {
-        frequency =
-            priv->ref_freq >
-            0 ? priv->ref_freq : urj_tap_cable_get_frequency (chain->cable);
-        if (frequency > 0)
-        {
-            uint32_t min_time_run_count = ceil (params->min_time * frequency);
-            if (min_time_run_count > run_count)
-            {
-                run_count = min_time_run_count;
-            }
-        }
-        else
-        {
-            urj_error_set (URJ_ERROR_OUT_OF_BOUNDS,
-                           _("Error %s: Maximum cable clock frequency required for RUNTEST"),
-                           "svf");
-            urj_log (URJ_LOG_LEVEL_ERROR,
-                     _("  Set the cable frequency with 'FREQUENCY <Hz>'.\n"));
-            return URJ_STATUS_FAIL;
-        }
-    }
+    frequency =
+        priv->ref_freq >
+        0 ? priv->ref_freq : urj_tap_cable_get_frequency (chain->cable);
 
     urj_svf_goto_state (chain, priv->runtest_run_state);
 
-#ifndef HAVE_SIGACTION_SA_ONESHOT
-    if (params->max_time > 0.0)
-    {
-        double maxt = urj_lib_frealtime () + params->max_time;
-
-        while (run_count-- > 0 && urj_lib_frealtime () < maxt)
-        {
-            urj_tap_chain_clock (chain, 0, 0, 1);
-        }
-    }
-    else
-        CHAIN_CLOCK (chain, 0, 0, run_count);
-
-    urj_svf_goto_state (chain, priv->runtest_end_state);
-
-#else
-    /* set up the timer for max_time */
-    if (params->max_time > 0.0)
-    {
-        struct sigaction sa;
-        unsigned max_time;
-
-        sa.sa_handler = sigalrm_handler;
-        sa.sa_flags = SA_ONESHOT;
-        sigemptyset (&sa.sa_mask);
-        if (sigaction (SIGALRM, &sa, NULL) != 0)
-        {
-            perror ("sigaction");
-            exit (EXIT_FAILURE);
-        }
-
-        max_time = floor (params->max_time / 1000000);
-        if (max_time == 0)
-        {
-            max_time = 1;
-        }
-        ualarm (max_time, 0);
-    }
-
-    if (params->max_time > 0.0)
-        while (run_count-- > 0 && !max_time_reached)
-        {
-            urj_tap_chain_clock (chain, 0, 0, 1);
-        }
-    else
-        CHAIN_CLOCK (chain, 0, 0, run_count);
+    /* all cycles as deferred clocks: the cable sends them in bulk, there
+       is no flush per cycle; with the clock rate unknown the TCK count
+       goes out first, then the host takes care of the time */
+    if (urj_tap_chain_defer_wait (chain, frequency, params->run_count,
+                                  params->min_time) != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
 
     urj_svf_goto_state (chain, priv->runtest_end_state);
 
-    /* stop the timer */
-    if (params->max_time > 0.0)
-    {
-        struct sigaction sa;
-        sa.sa_handler = SIG_IGN;
-        sa.sa_flags = 0;
-        sigemptyset (&sa.sa_mask);
-        if (sigaction (SIGALRM, &sa, NULL) != 0)
-        {
-            perror ("sigaction");
-            exit (EXIT_FAILURE);
-        }
-    }
-#endif
-
     return URJ_STATUS_OK;
 }
 
@@ -818,6 +741,129 @@ urj_svf_state (urj_chain_t *chain, urj_svf_parser_priv_t *priv,
 }
 
 
+/*
+ * urj_svf_sxr_padded(ir_dr, sxr_params)
+ *
+ * SIR/SDR with header and/or trailer: the file describes the whole chain,
+ * so header, data and trailer are shifted as one raw scan, header bits
+ * first. The padding bits are copied into the scan register only when
+ * an HXR/TXR command changed them or the scan length changed.
+ *
+ * Parameter:
+ *   ir_dr      : selects SIR or SDR
+ *   sxr_params : remembered SIR/SDR parameters, TDI checked by caller
+ *
+ * Return value:
+ *   URJ_STATUS_OK, URJ_STATUS_FAIL
+ */
+static int
+urj_svf_sxr_padded (urj_chain_t *chain, urj_svf_parser_priv_t *priv,
+                    enum generic_irdr_coding ir_dr, urj_svf_sxr_t *sxr_params,
+                    YYLTYPE *loc)
+{
+    const urj_svf_pad_t *h = &priv->header[ir_dr];
+    const urj_svf_pad_t *t = &priv->trailer[ir_dr];
+    urj_svf_scan_t *scan = &priv->scan[ir_dr];
+    int n = (int) sxr_params->params.number;
+    int len = h->len + n + t->len;
+    const char *hex;
+    size_t hex_len;
+    int i, check, result;
+
+    if (!scan->in || scan->in->len != len)
+    {
+        urj_tap_register_free (scan->in);
+        urj_tap_register_free (scan->out);
+        free (scan->tdo_bits);
+        free (scan->mask_bits);
+        scan->out = NULL;
+        scan->tdo_bits = scan->mask_bits = NULL;
+        if (!(scan->in = urj_tap_register_alloc (len)))
+            return URJ_STATUS_FAIL;
+        if (!(scan->out = urj_tap_register_alloc (len)))
+            return URJ_STATUS_FAIL;
+        scan->tdo_bits = calloc (len + 1, sizeof (char));
+        scan->mask_bits = calloc (len + 1, sizeof (char));
+        if (!scan->tdo_bits || !scan->mask_bits)
+        {
+            urj_error_set (URJ_ERROR_OUT_OF_MEMORY, "calloc(%zd,%zd) fails",
+                           (size_t) (len + 1), sizeof (char));
+            return URJ_STATUS_FAIL;
+        }
+        scan->dirty = 1;
+    }
+
+    if (scan->dirty)
+    {
+        for (i = 0; i < h->len; i++)
+            scan->in->data[i] = h->tdi_bits[h->len - 1 - i] == '1';
+        for (i = 0; i < t->len; i++)
+            scan->in->data[h->len + n + i] =
+                t->tdi_bits[t->len - 1 - i] == '1';
+        scan->dirty = 0;
+    }
+
+    hex = sxr_params->params.tdi;
+    hex_len = strlen (hex);
+    for (i = 0; i < n; i++)
+        scan->in->data[h->len + i] = urj_svf_hex_bit (hex, hex_len, i);
+
+    check = sxr_params->params.tdo || h->tdo_bits || t->tdo_bits;
+
+    urj_svf_goto_state (chain, ir_dr == generic_ir ? URJ_TAP_STATE_SHIFT_IR
+                                                   : URJ_TAP_STATE_SHIFT_DR);
+    urj_tap_defer_shift_register (chain, scan->in, check ? scan->out : NULL,
+                                  URJ_CHAIN_EXITMODE_EXIT1);
+    if (check)
+        urj_tap_shift_register_output (chain, scan->in, scan->out,
+                                       URJ_CHAIN_EXITMODE_EXIT1);
+    urj_svf_goto_state (chain, ir_dr == generic_ir ? priv->endir
+                                                   : priv->enddr);
+
+    if (!check)
+        return URJ_STATUS_OK;
+
+    /* expected value and mask of the whole scan, MSB first: trailer, data,
+       header; parts without TDO are don't care */
+    memset (scan->tdo_bits, '0', len);
+    memset (scan->mask_bits, '0', len);
+
+    if (t->tdo_bits)
+    {
+        memcpy (scan->tdo_bits, t->tdo_bits, t->len);
+        memcpy (scan->mask_bits, t->mask_bits, t->len);
+    }
+    if (sxr_params->params.tdo)
+    {
+        char *tdo_bit = scan->tdo_bits + t->len + n - 1;
+        char *mask_bit = scan->mask_bits + t->len + n - 1;
+        const char *mask = sxr_params->params.mask;
+        size_t mask_len = strlen (mask);
+
+        hex = sxr_params->params.tdo;
+        hex_len = strlen (hex);
+        for (i = 0; i < n; i++)
+        {
+            tdo_bit[-i] = urj_svf_hex_bit (hex, hex_len, i) ? '1' : '0';
+            mask_bit[-i] = urj_svf_hex_bit (mask, mask_len, i) ? '1' : '0';
+        }
+    }
+    if (h->tdo_bits)
+    {
+        memcpy (scan->tdo_bits + t->len + n, h->tdo_bits, h->len);
+        memcpy (scan->mask_bits + t->len + n, h->mask_bits, h->len);
+    }
+
+    result = urj_svf_compare_bits (priv, scan->tdo_bits, scan->mask_bits,
+                                   scan->out, loc);
+
+    if (result != URJ_STATUS_OK)
+        priv->mismatch_occurred = 1;
+
+    return result;
+}
+
+
 /* ***************************************************************************
  * urj_svf_sxr(ir_dr, params)
  *
@@ -841,14 +887,19 @@ urj_svf_sxr (urj_chain_t *chain, urj_svf_parser_priv_t *priv,
     sxr_params = (ir_dr == generic_ir) ?
                      &(priv->sir_params) : &(priv->sdr_params);
 
-    /* remember parameters */
-    urj_svf_remember_param (&sxr_params->params.tdi, params->tdi);
+    /* remember parameters, params points into priv->parser_params */
+    if (params->tdi)
+        urj_svf_remember_param (&sxr_params->tdi, &priv->parser_params.tdi);
 
     sxr_params->params.tdo = params->tdo;       /* tdo is not "remembered" */
 
-    urj_svf_remember_param (&sxr_params->params.mask, params->mask);
+    if (params->mask)
+        urj_svf_remember_param (&sxr_params->mask,
+                                &priv->parser_params.mask);
 
-    urj_svf_remember_param (&sxr_params->params.smask, params->smask);
+    if (params->smask)
+        urj_svf_remember_param (&sxr_params->smask,
+                                &priv->parser_params.smask);
 
 
     /* handle length change for MASK and SMASK */
@@ -858,16 +909,19 @@ urj_svf_sxr (urj_chain_t *chain, urj_svf_parser_priv_t *priv,
         sxr_params->no_tdo = 1;
 
         if (!params->mask)
-            if (urj_svf_all_care (&sxr_params->params.mask, params->number)
+            if (urj_svf_all_care (&sxr_params->mask, params->number)
                 != URJ_STATUS_OK)
                 result = URJ_STATUS_FAIL;
         if (!params->smask)
-            if (urj_svf_all_care (&sxr_params->params.smask, params->number)
+            if (urj_svf_all_care (&sxr_params->smask, params->number)
                 != URJ_STATUS_OK)
                 result = URJ_STATUS_FAIL;
     }
 
     sxr_params->params.number = params->number;
+    sxr_params->params.tdi = sxr_params->tdi.buf;
+    sxr_params->params.mask = sxr_params->mask.buf;
+    sxr_params->params.smask = sxr_params->smask.buf;
 
     /* check consistency */
     if (sxr_params->no_tdi)
@@ -882,15 +936,14 @@ urj_svf_sxr (urj_chain_t *chain, urj_svf_parser_priv_t *priv,
         sxr_params->no_tdi = 0;
     }
 
-    /* take over responsability for free'ing parameter strings */
-    params->tdi = NULL;
-    params->mask = NULL;
-    params->smask = NULL;
-
     /* result of consistency check */
     if (result != URJ_STATUS_OK)
         return URJ_STATUS_FAIL;
 
+    /* with header or trailer the scan covers the whole chain */
+    if (priv->header[ir_dr].len != 0 || priv->trailer[ir_dr].len != 0)
+        return urj_svf_sxr_padded (chain, priv, ir_dr, sxr_params, loc);
+
 
     /*
      * handle tap registers
@@ -1064,9 +1117,6 @@ urj_svf_trst (urj_chain_t *chain, urj_svf_parser_priv_t *priv, int trst_mode)
  *
  * Handles TIR, TDR.
  *
- * Note:
- * Functionality not implemented.
- *
  * Parameter:
  *   ir_dr  : selects TIR or TDR
  *   params : paramter set for TXR, HXR and SXR
@@ -1075,13 +1125,13 @@ urj_svf_trst (urj_chain_t *chain, urj_svf_parser_priv_t *priv, int trst_mode)
  *   URJ_STATUS_OK, URJ_STATUS_FAIL
  * ***************************************************************************/
 int
-urj_svf_txr (enum generic_irdr_coding ir_dr, struct ths_params *params)
+urj_svf_txr (urj_svf_parser_priv_t *priv, enum generic_irdr_coding ir_dr,
+             struct ths_params *params)
 {
-    if (params->number != 0.0)
-        urj_warning (_("command %s not implemented\n"),
-                     ir_dr == generic_ir ? "TIR" : "TDR");
+    priv->scan[ir_dr].dirty = 1;
 
-    return URJ_STATUS_OK;
+    return urj_svf_set_pad (&priv->trailer[ir_dr], params,
+                            ir_dr == generic_ir ? "TIR" : "TDR");
 }
 
 
@@ -1109,11 +1159,13 @@ urj_svf_run (urj_chain_t *chain, FILE *SVF_FILE, int stop_on_mismatch,
              uint32_t ref_freq)
 {
     const urj_svf_sxr_t sxr_default = { {0.0, NULL, NULL, NULL, NULL},
+    {NULL, 0, 0}, {NULL, 0, 0}, {NULL, 0, 0},
     1, 1
     };
     urj_svf_parser_priv_t priv;
-    int c = ~EOF;
-    int num_lines;
+    struct stat st;
+    long file_size;
+    int i;
     uint32_t old_frequency;
 
     if (chain == NULL || chain->cable == NULL)
@@ -1121,20 +1173,11 @@ urj_svf_run (urj_chain_t *chain, FILE *SVF_FILE, int stop_on_mismatch,
 
     old_frequency = urj_tap_cable_get_frequency (chain->cable);
 
-    /* get number of lines in svf file so we can give user some feedback on long
-       files or slow cables */
-    rewind (SVF_FILE);
-    num_lines = 0;
-    while (EOF != c)
-    {
-        c = fgetc (SVF_FILE);
-        if ('\n' == c)
-            num_lines++;
-    }
-    rewind (SVF_FILE);
-    if (0 == num_lines)
-        /* avoid those annoying divide/0 crashes */
-        num_lines++;
+    /* the file size lets the scanner report progress by file offset
+       without reading the file twice; pipes simply show no percentage */
+    file_size = 0;
+    if (fstat (fileno (SVF_FILE), &st) == 0 && S_ISREG (st.st_mode))
+        file_size = st.st_size;
 
     /* initialize
        - part
@@ -1215,6 +1258,9 @@ urj_svf_run (urj_chain_t *chain, FILE *SVF_FILE, int stop_on_mismatch,
     priv.svf_stop_on_mismatch = stop_on_mismatch;
 
     priv.sir_params = priv.sdr_params = sxr_default;
+    memset (priv.header, 0, sizeof priv.header);
+    memset (priv.trailer, 0, sizeof priv.trailer);
+    memset (priv.scan, 0, sizeof priv.scan);
 
     priv.endir = priv.enddr = URJ_TAP_STATE_RUN_TEST_IDLE;
 
@@ -1234,7 +1280,7 @@ urj_svf_run (urj_chain_t *chain, FILE *SVF_FILE, int stop_on_mismatch,
     /* select SIR instruction */
     urj_part_set_instruction (priv.part, "SIR");
 
-    if (urj_svf_bison_init (&priv, SVF_FILE, num_lines))
+    if (urj_svf_bison_init (&priv, SVF_FILE, file_size))
     {
         urj_svf_parse (&priv, chain);
         urj_svf_bison_deinit (&priv);
@@ -1249,19 +1295,23 @@ urj_svf_run (urj_chain_t *chain, FILE *SVF_FILE, int stop_on_mismatch,
 
     /* clean up */
     /* SIR */
-    if (priv.sir_params.params.tdi)
-        free (priv.sir_params.params.tdi);
-    if (priv.sir_params.params.mask)
-        free (priv.sir_params.params.mask);
-    if (priv.sir_params.params.smask)
-        free (priv.sir_params.params.smask);
+    free (priv.sir_params.tdi.buf);
+    free (priv.sir_params.mask.buf);
+    free (priv.sir_params.smask.buf);
     /* SDR */
-    if (priv.sdr_params.params.tdi)
-        free (priv.sdr_params.params.tdi);
-    if (priv.sdr_params.params.mask)
-        free (priv.sdr_params.params.mask);
-    if (priv.sdr_params.params.smask)
-        free (priv.sdr_params.params.smask);
+    free (priv.sdr_params.tdi.buf);
+    free (priv.sdr_params.mask.buf);
+    free (priv.sdr_params.smask.buf);
+    /* headers, trailers and joined scans */
+    for (i = 0; i < 2; i++)
+    {
+        urj_svf_free_pad (&priv.header[i]);
+        urj_svf_free_pad (&priv.trailer[i]);
+        urj_tap_register_free (priv.scan[i].in);
+        urj_tap_register_free (priv.scan[i].out);
+        free (priv.scan[i].tdo_bits);
+        free (priv.scan[i].mask_bits);
+    }
 
     /* restore previous frequency setting, required by SVF spec */
     if (old_frequency != urj_tap_cable_get_frequency (chain->cable))
@@ -37,6 +37,7 @@ enum generic_irdr_coding
 };
 
 
+/* growable hex string, kept and reused from command to command */
 struct hexa_frag
 {
     char   *buf;
@@ -83,15 +84,42 @@ struct runtest
 
 typedef struct
 {
-    struct ths_params params;
+    struct ths_params params;   /* tdi, mask and smask point into the below */
+    struct hexa_frag tdi;
+    struct hexa_frag mask;
+    struct hexa_frag smask;
     int no_tdi;
     int no_tdo;
 } urj_svf_sxr_t;
 
 
+/* header or trailer of SIR/SDR scans, set by HIR/HDR/TIR/TDR */
+typedef struct
+{
+    int len;
+    char *tdi_bits;             /* bit strings of len bits, MSB first */
+    char *tdo_bits;             /* NULL: no check */
+    char *mask_bits;
+} urj_svf_pad_t;
+
+/* whole SIR/SDR scan: header, data and trailer joined */
+typedef struct
+{
+    urj_tap_register_t *in;
+    urj_tap_register_t *out;
+    char *tdo_bits;             /* expected value and mask, MSB first */
+    char *mask_bits;
+    int dirty;                  /* padding bits in 'in' need refresh */
+} urj_svf_scan_t;
+
+
 struct svf_parser_params
 {
-    struct ths_params ths_params;
+    struct ths_params ths_params;   /* hex strings point into the below */
+    struct hexa_frag tdi;
+    struct hexa_frag tdo;
+    struct hexa_frag mask;
+    struct hexa_frag smask;
     struct path_states path_states;
     struct runtest runtest;
 };
@@ -108,6 +136,9 @@ struct parser_priv
     urj_data_register_t *dr;
     urj_svf_sxr_t sir_params;
     urj_svf_sxr_t sdr_params;
+    urj_svf_pad_t header[2];    /* indexed by enum generic_irdr_coding */
+    urj_svf_pad_t trailer[2];
+    urj_svf_scan_t scan[2];
     int endir;
     int enddr;
     int runtest_run_state;
@@ -124,24 +155,29 @@ typedef struct parser_priv urj_svf_parser_priv_t;
 
 struct scanner_extra
 {
-    int num_lines;
+    FILE *f;
+    long file_size;             /* 0 if unknown, e.g. for a pipe */
+    int last_percent;
     int planb;
     char decimal_point;
+    struct hexa_frag hex;       /* hex number being scanned */
 };
 typedef struct scanner_extra urj_svf_scanner_extra_t;
 
 struct YYLTYPE;
 
-void *urj_svf_flex_init (FILE *, int);
+void *urj_svf_flex_init (FILE *, long);
 void urj_svf_flex_deinit (void *);
+char *urj_svf_flex_take_hex (void *, struct hexa_frag *);
 
-int urj_svf_bison_init (urj_svf_parser_priv_t *, FILE *, int);
+int urj_svf_bison_init (urj_svf_parser_priv_t *, FILE *, long);
 void urj_svf_bison_deinit (urj_svf_parser_priv_t *);
 
 void urj_svf_endxr (urj_svf_parser_priv_t *, enum generic_irdr_coding,
                     int);
 void urj_svf_frequency (urj_chain_t *, double);
-int urj_svf_hxr (enum generic_irdr_coding, struct ths_params *);
+int urj_svf_hxr (urj_svf_parser_priv_t *, enum generic_irdr_coding,
+                 struct ths_params *);
 int urj_svf_runtest (urj_chain_t *, urj_svf_parser_priv_t *,
                      struct runtest *);
 int urj_svf_state (urj_chain_t *, urj_svf_parser_priv_t *,
@@ -150,4 +186,5 @@ int urj_svf_sxr (urj_chain_t *, urj_svf_parser_priv_t *,
                  enum generic_irdr_coding, struct ths_params *,
                  struct YYLTYPE *);
 int urj_svf_trst (urj_chain_t *, urj_svf_parser_priv_t *, int);
-int urj_svf_txr (enum generic_irdr_coding, struct ths_params *);
+int urj_svf_txr (urj_svf_parser_priv_t *, enum generic_irdr_coding,
+                 struct ths_params *);
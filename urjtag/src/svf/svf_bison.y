@@ -54,7 +54,7 @@ int yylex (YYSTYPE *, YYLTYPE *, void *);
 
 void yyerror(YYLTYPE *, urj_svf_parser_priv_t *priv_data, urj_chain_t *, const char *);
 
-static void urj_svf_free_ths_params(struct ths_params *);
+static void urj_svf_reset_ths_params(struct ths_params *);
 %}
 
 %union {
@@ -62,7 +62,6 @@ static void urj_svf_free_ths_params(struct ths_params *);
   double dvalue;
   char  *cvalue;
   int    ivalue;
-  struct hexa_frag hexa_frag;
   struct tdval tdval;
   struct tcval *tcval;
 }
@@ -84,11 +83,9 @@ static void urj_svf_free_ths_params(struct ths_params *);
 %token SVF_EOF 0    /* SVF_EOF must match bison's token YYEOF */
 
 %type <dvalue> NUMBER
-%type <cvalue> HEXA_NUM_FRAGMENT
 %type <tdval>  runtest_clk_count
 %type <token>  runtest_run_state_opt
 %type <token>  runtest_end_state_opt
-%type <hexa_frag> hexa_num_sequence
 
 %%
 
@@ -130,19 +127,31 @@ svf_statement
     | HDR NUMBER ths_param_list ';'
       {
         struct ths_params *p = &(priv_data->parser_params.ths_params);
+        int result;
 
         p->number = $2;
-        urj_svf_hxr(generic_dr, p);
-        urj_svf_free_ths_params(p);
+        result = urj_svf_hxr(priv_data, generic_dr, p);
+        urj_svf_reset_ths_params(p);
+
+        if (result != URJ_STATUS_OK) {
+          yyerror(&@$, priv_data, chain, "HDR");
+          YYERROR;
+        }
       }
 
     | HIR NUMBER ths_param_list ';'
       {
         struct ths_params *p = &(priv_data->parser_params.ths_params);
+        int result;
 
         p->number = $2;
-        urj_svf_hxr(generic_ir, p);
-        urj_svf_free_ths_params(p);
+        result = urj_svf_hxr(priv_data, generic_ir, p);
+        urj_svf_reset_ths_params(p);
+
+        if (result != URJ_STATUS_OK) {
+          yyerror(&@$, priv_data, chain, "HIR");
+          YYERROR;
+        }
       }
 
     | PIOMAP '(' direction IDENTIFIER piomap_rec ')' ';'
@@ -197,7 +206,7 @@ svf_statement
 
         p->number = $2;
         result = urj_svf_sxr(chain, priv_data, generic_dr, p, &@$);
-        urj_svf_free_ths_params(p);
+        urj_svf_reset_ths_params(p);
 
         if (result != URJ_STATUS_OK) {
           yyerror(&@$, priv_data, chain, "SDR");
@@ -212,7 +221,7 @@ svf_statement
 
         p->number = $2;
         result = urj_svf_sxr(chain, priv_data, generic_ir, p, &@$);
-        urj_svf_free_ths_params(p);
+        urj_svf_reset_ths_params(p);
 
         if (result != URJ_STATUS_OK) {
           yyerror(&@$, priv_data, chain, "SIR");
@@ -234,8 +243,8 @@ svf_statement
         int result;
 
         p->number = $2;
-        result = urj_svf_txr(generic_dr, p);
-        urj_svf_free_ths_params(p);
+        result = urj_svf_txr(priv_data, generic_dr, p);
+        urj_svf_reset_ths_params(p);
 
         if (result != URJ_STATUS_OK) {
           yyerror(&@$, priv_data, chain, "TDR");
@@ -249,8 +258,8 @@ svf_statement
         int result;
 
         p->number = $2;
-        result = urj_svf_txr(generic_ir, p);
-        urj_svf_free_ths_params(p);
+        result = urj_svf_txr(priv_data, generic_ir, p);
+        urj_svf_reset_ths_params(p);
 
         if (result != URJ_STATUS_OK) {
           yyerror(&@$, priv_data, chain, "TIR");
@@ -276,50 +285,49 @@ ths_param_list
 ths_opt_param
             : TDI   '(' hexa_num_sequence ')'
               {
-                priv_data->parser_params.ths_params.tdi = $3.buf;
+                if (!(priv_data->parser_params.ths_params.tdi =
+                      urj_svf_flex_take_hex(priv_data->scanner,
+                                            &priv_data->parser_params.tdi))) {
+                  yyerror(&@$, priv_data, chain, "TDI");
+                  YYERROR;
+                }
               }
 
             | TDO   '(' hexa_num_sequence ')'
               {
-                priv_data->parser_params.ths_params.tdo = $3.buf;
+                if (!(priv_data->parser_params.ths_params.tdo =
+                      urj_svf_flex_take_hex(priv_data->scanner,
+                                            &priv_data->parser_params.tdo))) {
+                  yyerror(&@$, priv_data, chain, "TDO");
+                  YYERROR;
+                }
               }
 
             | MASK  '(' hexa_num_sequence ')'
               {
-                priv_data->parser_params.ths_params.mask = $3.buf;
+                if (!(priv_data->parser_params.ths_params.mask =
+                      urj_svf_flex_take_hex(priv_data->scanner,
+                                            &priv_data->parser_params.mask))) {
+                  yyerror(&@$, priv_data, chain, "MASK");
+                  YYERROR;
+                }
               }
 
             | SMASK '(' hexa_num_sequence ')'
               {
-                priv_data->parser_params.ths_params.smask = $3.buf;
+                if (!(priv_data->parser_params.ths_params.smask =
+                      urj_svf_flex_take_hex(priv_data->scanner,
+                                            &priv_data->parser_params.smask))) {
+                  yyerror(&@$, priv_data, chain, "SMASK");
+                  YYERROR;
+                }
               }
 ;
 
+/* the fragments are collected by the scanner, see urj_svf_flex_take_hex() */
 hexa_num_sequence
            : HEXA_NUM_FRAGMENT
-             {
-                 $$.buf    = $1;
-                 $$.strlen = strlen ($1);
-                 $$.buflen = $$.strlen + 1;
-             }
            | hexa_num_sequence HEXA_NUM_FRAGMENT
-             {
-#define REALLOC_STEP (1 << 16)
-                 size_t frag_len = strlen ($2);
-                 size_t req_len = $1.strlen + frag_len;
-                 if ($1.buflen <= req_len) {
-                     size_t newlen = req_len - $1.buflen < REALLOC_STEP ?
-                         $1.buflen + REALLOC_STEP : req_len + 1;
-                     $1.buf = (char *)realloc ($1.buf, newlen);
-                     $1.buflen = newlen;
-                 }
-                 if ($1.buf != NULL) {
-                     memcpy ($1.buf + $1.strlen, $2, frag_len + 1);
-                     $1.strlen += frag_len;
-                 }
-                 free ($2);
-                 $$ = $1;
-             }
 ;
 
 stable_state
@@ -452,47 +460,25 @@ yyerror (YYLTYPE *locp, urj_svf_parser_priv_t *priv_data, urj_chain_t *chain,
 }
 
 
+/* the hex strings stay in their buffers for the next command */
 static void
-urj_svf_free_ths_params (struct ths_params *params)
+urj_svf_reset_ths_params (struct ths_params *params)
 {
     params->number = 0.0;
-
-    if (params->tdi)
-    {
-        free (params->tdi);
-        params->tdi = NULL;
-    }
-    if (params->tdo)
-    {
-        free (params->tdo);
-        params->tdo = NULL;
-    }
-    if (params->mask)
-    {
-        free (params->mask);
-        params->mask = NULL;
-    }
-    if (params->smask)
-    {
-        free (params->smask);
-        params->smask = NULL;
-    }
+    params->tdi = NULL;
+    params->tdo = NULL;
+    params->mask = NULL;
+    params->smask = NULL;
 }
 
 
 int
-urj_svf_bison_init (urj_svf_parser_priv_t *priv_data, FILE *f, int num_lines)
+urj_svf_bison_init (urj_svf_parser_priv_t *priv_data, FILE *f, long file_size)
 {
-    const struct svf_parser_params params = {
-        {0.0, NULL, NULL, NULL, NULL},
-        {{}, 0},
-        {0, 0.0, 0, 0, 0, 0}
-    };
-
-    priv_data->parser_params = params;
+    memset (&priv_data->parser_params, 0, sizeof priv_data->parser_params);
 
     if ((priv_data->scanner =
-         urj_svf_flex_init (f, num_lines)) == NULL)
+         urj_svf_flex_init (f, file_size)) == NULL)
         return 0;
     else
         return 1;
@@ -502,5 +488,11 @@ urj_svf_bison_init (urj_svf_parser_priv_t *priv_data, FILE *f, int num_lines)
 void
 urj_svf_bison_deinit (urj_svf_parser_priv_t *priv_data)
 {
+    struct svf_parser_params *p = &priv_data->parser_params;
+
+    free (p->tdi.buf);
+    free (p->tdo.buf);
+    free (p->mask.buf);
+    free (p->smask.buf);
     urj_svf_flex_deinit (priv_data->scanner);
 }
@@ -42,6 +42,7 @@
 #include <urjtag/chain.h>
 #include <urjtag/tap.h>
 #include <urjtag/cable.h>
+#include <urjtag/fclock.h>
 
 #include "cable.h"
 
@@ -74,6 +75,7 @@ urj_tap_cable_init (urj_cable_t *cable)
 {
     cable->delay = 0;
     cable->frequency = 0;
+    urj_tap_cable_stats_reset (cable);
 
     cable->todo.max_items = 128;
     cable->todo.num_items = 0;
@@ -105,16 +107,46 @@ urj_tap_cable_init (urj_cable_t *cable)
     return cable->driver->init (cable);
 }
 
+void
+urj_tap_cable_stats_reset (urj_cable_t *cable)
+{
+    memset (&cable->stats, 0, sizeof cable->stats);
+}
+
 void
 urj_tap_cable_flush (urj_cable_t *cable, urj_cable_flush_amount_t how_much)
 {
+    long double start;
+    unsigned long usecs;
+    int bucket;
+
+    if (cable->todo.num_items != 0)
+        cable->stats.flushes[how_much]++;
+
+    /* reading the clock is not free, only do it when asked to */
+    if (!cable->stats_timing || cable->todo.num_items == 0)
+    {
+        cable->driver->flush (cable, how_much);
+        return;
+    }
+
+    start = urj_lib_frealtime ();
     cable->driver->flush (cable, how_much);
+    usecs = (urj_lib_frealtime () - start) * 1E6;
+
+    for (bucket = 0; bucket < URJ_CABLE_STATS_BUCKETS - 1; bucket++)
+        if (usecs < (1UL << bucket))
+            break;
+    cable->stats.latency[how_much][bucket]++;
+    cable->stats.flush_secs[how_much] += usecs / 1E6;
 }
 
 void
 urj_tap_cable_done (urj_cable_t *cable)
 {
     urj_tap_cable_flush (cable, URJ_TAP_CABLE_COMPLETELY);
+    if (cable->trace != NULL)
+        urj_tap_trace_stop (cable);
     if (cable->todo.data != NULL)
     {
         free (cable->todo.data);
@@ -236,6 +268,8 @@ urj_tap_cable_add_queue_item (urj_cable_t *cable, urj_cable_queue_info_t *q)
         j = 0;
     q->next_free = j;
     q->num_items++;
+    if (q == &cable->todo && q->num_items > cable->stats.high_water)
+        cable->stats.high_water = q->num_items;
 
     // urj_log (URJ_LOG_LEVEL_DEBUG, "add_queue_item to %p: %d\n", q, i);
     return i;
@@ -298,7 +332,11 @@ void
 urj_tap_cable_clock (urj_cable_t *cable, int tms, int tdi, int n)
 {
     urj_tap_cable_flush (cable, URJ_TAP_CABLE_COMPLETELY);
+    cable->stats.direct[URJ_TAP_CABLE_CLOCK]++;
+    cable->stats.bits += n;
     cable->driver->clock (cable, tms, tdi, n);
+    if (cable->trace != NULL)
+        urj_tap_trace_record (cable, URJ_TAP_TRACE_CLOCK, tms, tdi, n);
 }
 
 int
@@ -311,6 +349,38 @@ urj_tap_cable_defer_clock (urj_cable_t *cable, int tms, int tdi, int n)
     cable->todo.data[i].arg.clock.tms = tms;
     cable->todo.data[i].arg.clock.tdi = tdi;
     cable->todo.data[i].arg.clock.n = n;
+    cable->stats.items[URJ_TAP_CABLE_CLOCK]++;
+    cable->stats.bits += n;
+    if (cable->trace != NULL)
+        urj_tap_trace_record (cable, URJ_TAP_TRACE_DEFER_CLOCK, tms, tdi, n);
+    urj_tap_cable_flush (cable, URJ_TAP_CABLE_OPTIONALLY);
+    return URJ_STATUS_OK;                   /* success */
+}
+
+int
+urj_tap_cable_defer_clock_tms (urj_cable_t *cable, uint32_t tms, int tdi,
+                               int n)
+{
+    int i;
+
+    if (n < 1 || n > 31)
+    {
+        urj_error_set (URJ_ERROR_INVALID, "TMS sequence of %d clocks", n);
+        return URJ_STATUS_FAIL;
+    }
+
+    i = urj_tap_cable_add_queue_item (cable, &cable->todo);
+    if (i < 0)
+        return URJ_STATUS_FAIL;               /* report failure */
+    cable->todo.data[i].action = URJ_TAP_CABLE_CLOCK_TMS;
+    cable->todo.data[i].arg.clock.tms = tms;
+    cable->todo.data[i].arg.clock.tdi = tdi;
+    cable->todo.data[i].arg.clock.n = n;
+    cable->stats.items[URJ_TAP_CABLE_CLOCK_TMS]++;
+    cable->stats.bits += n;
+    if (cable->trace != NULL)
+        urj_tap_trace_record (cable, URJ_TAP_TRACE_DEFER_CLOCK_TMS, tms, tdi,
+                              n);
     urj_tap_cable_flush (cable, URJ_TAP_CABLE_OPTIONALLY);
     return URJ_STATUS_OK;                   /* success */
 }
@@ -318,12 +388,18 @@ urj_tap_cable_defer_clock (urj_cable_t *cable, int tms, int tdi, int n)
 int
 urj_tap_cable_get_tdo (urj_cable_t *cable)
 {
+    int tdo;
+
     urj_tap_cable_flush (cable, URJ_TAP_CABLE_COMPLETELY);
-    return cable->driver->get_tdo (cable);
+    cable->stats.direct[URJ_TAP_CABLE_GET_TDO]++;
+    tdo = cable->driver->get_tdo (cable);
+    if (cable->trace != NULL)
+        urj_tap_trace_record (cable, URJ_TAP_TRACE_GET_TDO, tdo, 0, 0);
+    return tdo;
 }
 
-int
-urj_tap_cable_get_tdo_late (urj_cable_t *cable)
+static int
+urj_tap_cable_get_tdo_done (urj_cable_t *cable)
 {
     int i;
     urj_tap_cable_flush (cable, URJ_TAP_CABLE_TO_OUTPUT);
@@ -345,6 +421,16 @@ urj_tap_cable_get_tdo_late (urj_cable_t *cable)
     return cable->driver->get_tdo (cable);
 }
 
+int
+urj_tap_cable_get_tdo_late (urj_cable_t *cable)
+{
+    int tdo = urj_tap_cable_get_tdo_done (cable);
+
+    if (cable->trace != NULL)
+        urj_tap_trace_record (cable, URJ_TAP_TRACE_GET_TDO_LATE, tdo, 0, 0);
+    return tdo;
+}
+
 int
 urj_tap_cable_defer_get_tdo (urj_cable_t *cable)
 {
@@ -352,6 +438,9 @@ urj_tap_cable_defer_get_tdo (urj_cable_t *cable)
     if (i < 0)
         return URJ_STATUS_FAIL;               /* report failure */
     cable->todo.data[i].action = URJ_TAP_CABLE_GET_TDO;
+    cable->stats.items[URJ_TAP_CABLE_GET_TDO]++;
+    if (cable->trace != NULL)
+        urj_tap_trace_record (cable, URJ_TAP_TRACE_DEFER_GET_TDO, 0, 0, 0);
     urj_tap_cable_flush (cable, URJ_TAP_CABLE_OPTIONALLY);
     return URJ_STATUS_OK;                   /* success */
 }
@@ -359,8 +448,14 @@ urj_tap_cable_defer_get_tdo (urj_cable_t *cable)
 int
 urj_tap_cable_set_signal (urj_cable_t *cable, int mask, int val)
 {
+    int r;
+
     urj_tap_cable_flush (cable, URJ_TAP_CABLE_COMPLETELY);
-    return cable->driver->set_signal (cable, mask, val);
+    cable->stats.direct[URJ_TAP_CABLE_SET_SIGNAL]++;
+    r = cable->driver->set_signal (cable, mask, val);
+    if (cable->trace != NULL)
+        urj_tap_trace_record (cable, URJ_TAP_TRACE_SET_SIGNAL, mask, val, r);
+    return r;
 }
 
 int
@@ -372,6 +467,10 @@ urj_tap_cable_defer_set_signal (urj_cable_t *cable, int mask, int val)
     cable->todo.data[i].action = URJ_TAP_CABLE_SET_SIGNAL;
     cable->todo.data[i].arg.value.mask = mask;
     cable->todo.data[i].arg.value.val = val;
+    cable->stats.items[URJ_TAP_CABLE_SET_SIGNAL]++;
+    if (cable->trace != NULL)
+        urj_tap_trace_record (cable, URJ_TAP_TRACE_DEFER_SET_SIGNAL,
+                              mask, val, 0);
     urj_tap_cable_flush (cable, URJ_TAP_CABLE_OPTIONALLY);
     return URJ_STATUS_OK;                   /* success */
 }
@@ -379,12 +478,18 @@ urj_tap_cable_defer_set_signal (urj_cable_t *cable, int mask, int val)
 int
 urj_tap_cable_get_signal (urj_cable_t *cable, urj_pod_sigsel_t sig)
 {
+    int r;
+
     urj_tap_cable_flush (cable, URJ_TAP_CABLE_COMPLETELY);
-    return cable->driver->get_signal (cable, sig);
+    cable->stats.direct[URJ_TAP_CABLE_GET_SIGNAL]++;
+    r = cable->driver->get_signal (cable, sig);
+    if (cable->trace != NULL)
+        urj_tap_trace_record (cable, URJ_TAP_TRACE_GET_SIGNAL, sig, r, 0);
+    return r;
 }
 
-int
-urj_tap_cable_get_signal_late (urj_cable_t *cable, urj_pod_sigsel_t sig)
+static int
+urj_tap_cable_get_signal_done (urj_cable_t *cable, urj_pod_sigsel_t sig)
 {
     int i;
     urj_tap_cable_flush (cable, URJ_TAP_CABLE_TO_OUTPUT);
@@ -413,6 +518,16 @@ urj_tap_cable_get_signal_late (urj_cable_t *cable, urj_pod_sigsel_t sig)
     return cable->driver->get_signal (cable, sig);
 }
 
+int
+urj_tap_cable_get_signal_late (urj_cable_t *cable, urj_pod_sigsel_t sig)
+{
+    int r = urj_tap_cable_get_signal_done (cable, sig);
+
+    if (cable->trace != NULL)
+        urj_tap_trace_record (cable, URJ_TAP_TRACE_GET_SIGNAL_LATE, sig, r, 0);
+    return r;
+}
+
 int
 urj_tap_cable_defer_get_signal (urj_cable_t *cable, urj_pod_sigsel_t sig)
 {
@@ -421,6 +536,9 @@ urj_tap_cable_defer_get_signal (urj_cable_t *cable, urj_pod_sigsel_t sig)
         return URJ_STATUS_FAIL;               /* report failure */
     cable->todo.data[i].action = URJ_TAP_CABLE_GET_SIGNAL;
     cable->todo.data[i].arg.value.sig = sig;
+    cable->stats.items[URJ_TAP_CABLE_GET_SIGNAL]++;
+    if (cable->trace != NULL)
+        urj_tap_trace_record (cable, URJ_TAP_TRACE_DEFER_GET_SIGNAL, sig, 0, 0);
     urj_tap_cable_flush (cable, URJ_TAP_CABLE_OPTIONALLY);
     return URJ_STATUS_OK;                   /* success */
 }
@@ -428,8 +546,16 @@ urj_tap_cable_defer_get_signal (urj_cable_t *cable, urj_pod_sigsel_t sig)
 int
 urj_tap_cable_transfer (urj_cable_t *cable, int len, char *in, char *out)
 {
+    int r;
+
     urj_tap_cable_flush (cable, URJ_TAP_CABLE_COMPLETELY);
-    return cable->driver->transfer (cable, len, in, out);
+    cable->stats.direct[URJ_TAP_CABLE_TRANSFER]++;
+    cable->stats.bits += len;
+    r = cable->driver->transfer (cable, len, in, out);
+    if (cable->trace != NULL)
+        urj_tap_trace_record_transfer (cable, URJ_TAP_TRACE_TRANSFER,
+                                       len, in, out, r);
+    return r;
 }
 
 int
@@ -451,6 +577,13 @@ urj_tap_cable_transfer_late (urj_cable_t *cable, char *out)
             memcpy (out,
                     cable->done.data[i].arg.xferred.out,
                     cable->done.data[i].arg.xferred.len);
+        if (cable->trace != NULL)
+            urj_tap_trace_record_transfer (cable,
+                                           URJ_TAP_TRACE_TRANSFER_LATE,
+                                           cable->done.data[i].arg.xferred.len,
+                                           NULL,
+                                           cable->done.data[i].arg.xferred.out,
+                                           cable->done.data[i].arg.xferred.res);
         free (cable->done.data[i].arg.xferred.out);
         return cable->done.data[i].arg.xferred.res;
     }
@@ -512,6 +645,11 @@ urj_tap_cable_defer_transfer (urj_cable_t *cable, int len, char *in,
         memcpy (ibuf, in, len);
     cable->todo.data[i].arg.transfer.in = ibuf;
     cable->todo.data[i].arg.transfer.out = obuf;
+    cable->stats.items[URJ_TAP_CABLE_TRANSFER]++;
+    cable->stats.bits += len;
+    if (cable->trace != NULL)
+        urj_tap_trace_record_transfer (cable, URJ_TAP_TRACE_DEFER_TRANSFER,
+                                       len, in, out, 0);
     urj_tap_cable_flush (cable, URJ_TAP_CABLE_OPTIONALLY);
     return URJ_STATUS_OK;                   /* success */
 }
@@ -521,6 +659,9 @@ urj_tap_cable_set_frequency (urj_cable_t *cable, uint32_t new_frequency)
 {
     urj_tap_cable_flush (cable, URJ_TAP_CABLE_COMPLETELY);
     cable->driver->set_frequency (cable, new_frequency);
+    if (cable->trace != NULL)
+        urj_tap_trace_record (cable, URJ_TAP_TRACE_SET_FREQUENCY,
+                              new_frequency, 0, 0);
 }
 
 uint32_t
@@ -685,6 +826,12 @@ static const urj_param_descr_t cable_param[] =
     { URJ_CABLE_PARAM_KEY_INDEX,        URJ_PARAM_TYPE_LU,      "index", },
     { URJ_CABLE_PARAM_KEY_TRST,         URJ_PARAM_TYPE_LU,      "trst", },
     { URJ_CABLE_PARAM_KEY_RESET,        URJ_PARAM_TYPE_LU,      "reset", },
+    { URJ_CABLE_PARAM_KEY_CHAIN,        URJ_PARAM_TYPE_STRING,  "chain", },
+    { URJ_CABLE_PARAM_KEY_MEMFILE,      URJ_PARAM_TYPE_STRING,  "memfile", },
+    { URJ_CABLE_PARAM_KEY_MEMSIZE,      URJ_PARAM_TYPE_LU,      "memsize", },
+    { URJ_CABLE_PARAM_KEY_LATENCY,      URJ_PARAM_TYPE_LU,      "latency", },
+    { URJ_CABLE_PARAM_KEY_BANDWIDTH,    URJ_PARAM_TYPE_LU,      "bandwidth", },
+    { URJ_CABLE_PARAM_KEY_CHUNK,        URJ_PARAM_TYPE_LU,      "chunk", },
 };
 
 const urj_param_list_t urj_cable_param_list =
@@ -28,4 +28,14 @@
 #define _URJ_CABLE(cable) extern const urj_cable_driver_t urj_tap_cable_##cable##_driver;
 #include "cable_list.h"
 
+#include <urjtag/trace.h>
+
+/* Trace hooks of src/tap/trace.c; only called while cable->trace is set.
+ * The meaning of a, b and c depends on op, see urj_tap_trace_op_t */
+void urj_tap_trace_record (urj_cable_t *cable, urj_tap_trace_op_t op,
+                           int a, int b, int c);
+void urj_tap_trace_record_transfer (urj_cable_t *cable, urj_tap_trace_op_t op,
+                                    int len, const char *in, const char *out,
+                                    int res);
+
 #endif /* URJ_CABLE_CABLE_H */
@@ -32,8 +32,6 @@
 #define SIG_TRST (1 << 5)
 #define SIG_SRST (1 << 6)
 
-static uint8_t current_signals = 0;
-
 /**
  * @brief Initialize JTAG adapter
  *
@@ -149,6 +147,7 @@ static int dirtyjtag_init(urj_cable_t *cable) {
   commands[5] = 0;
 
   dirtyjtag_send(cable, commands, 6);
+  PARAM_SIGNALS(cable) = 0;
 
   return URJ_STATUS_OK;
 }
@@ -222,14 +221,14 @@ static int dirtyjtag_set_signal(urj_cable_t *cable, int mask, int val) {
   dirtyjtag_send(cable, commands, 3);
 
   /* Updating signal status */
-  current_signals &= ~mask;
-  current_signals |= val;
+  PARAM_SIGNALS(cable) &= ~mask;
+  PARAM_SIGNALS(cable) |= val;
 
   return val;
 }
 
 static int dirtyjtag_get_signal(urj_cable_t *cable, urj_pod_sigsel_t sig) {
-  return sig & current_signals;
+  return sig & PARAM_SIGNALS(cable);
 }
 
 static int dirtyjtag_transfer(urj_cable_t *cable, int len,
@@ -280,7 +279,7 @@ static int dirtyjtag_transfer(urj_cable_t *cable, int len,
   }
 
   /* TODO : update this accordingly to firmware */
-  current_signals &= ~(URJ_POD_CS_TDI | URJ_POD_CS_TCK | URJ_POD_CS_TMS);
+  PARAM_SIGNALS(cable) &= ~(URJ_POD_CS_TDI | URJ_POD_CS_TCK | URJ_POD_CS_TMS);
 
   return len;
 }
@@ -2271,12 +2271,14 @@ ft2232_flush (urj_cable_t *cable, urj_cable_flush_amount_t how_much)
             {
             case URJ_TAP_CABLE_CLOCK:
             case URJ_TAP_CABLE_CLOCK_COMPACT:
+            case URJ_TAP_CABLE_CLOCK_TMS:
                 {
                     int tdi = cable->todo.data[i].arg.clock.tdi ? 1 << 7 : 0;
                     int length = 0;
                     uint8_t byte = 0;
                     int tms = 0;
                     int cn = 0;
+                    uint32_t seq = 0;
 
                     if (cable->todo.data[i].action == URJ_TAP_CABLE_CLOCK_COMPACT)
                     {
@@ -2291,8 +2293,20 @@ ft2232_flush (urj_cable_t *cable, urj_cable_flush_amount_t how_much)
                         tms = cable->todo.data[i].arg.clock.tms ? 1 : 0;
                         cn = cable->todo.data[i].arg.clock.n;
                     }
+                    else if (cable->todo.data[i].action == URJ_TAP_CABLE_CLOCK_TMS)
+                    {
+                        /* a state change: its TMS bits go straight into
+                         * the TMS command bytes */
+                        seq = cable->todo.data[i].arg.clock.tms;
+                        cn = cable->todo.data[i].arg.clock.n;
+                    }
                     while (cn > 0)
                     {
+                        if (cable->todo.data[i].action == URJ_TAP_CABLE_CLOCK_TMS)
+                        {
+                            tms = seq & 1;
+                            seq >>= 1;
+                        }
                         byte |= tms << length;
                         cn--;
                         length++;
@@ -2304,7 +2318,8 @@ ft2232_flush (urj_cable_t *cable, urj_cable_flush_amount_t how_much)
                         }
                     }
                     if (n + 1 < cable->todo.num_items
-                        && cable->todo.data[(i + 1) % cable->todo.max_items].action == URJ_TAP_CABLE_CLOCK
+                        && (cable->todo.data[(i + 1) % cable->todo.max_items].action == URJ_TAP_CABLE_CLOCK
+                            || cable->todo.data[(i + 1) % cable->todo.max_items].action == URJ_TAP_CABLE_CLOCK_TMS)
                         && (cable->todo.data[(i + 1) % cable->todo.max_items].arg.clock.tdi ? 1 << 7 : 0) == tdi)
                     {
                         i++;
@@ -2389,6 +2404,20 @@ ft2232_flush (urj_cable_t *cable, urj_cable_flush_amount_t how_much)
                     params->last_tdo_valid = last_tdo_valid_finish = 0;
                     break;
                 }
+            case URJ_TAP_CABLE_CLOCK_TMS:
+                {
+                    post_signals &=
+                        ~(URJ_POD_CS_TCK | URJ_POD_CS_TDI | URJ_POD_CS_TMS);
+                    post_signals |=
+                        ((cable->todo.data[j].arg.clock.
+                          tms >> (cable->todo.data[j].arg.clock.n - 1)) & 1
+                         ? URJ_POD_CS_TMS : 0);
+                    post_signals |=
+                        (cable->todo.data[j].arg.clock.
+                         tdi ? URJ_POD_CS_TDI : 0);
+                    params->last_tdo_valid = last_tdo_valid_finish = 0;
+                    break;
+                }
             case URJ_TAP_CABLE_CLOCK_COMPACT:
                 {
                     post_signals &=
@@ -115,10 +115,32 @@ do_one_queued_action (urj_cable_t *cable)
                                   cable->todo.data[i].arg.clock.tdi,
                                   cable->todo.data[i].arg.clock.n);
             break;
+        case URJ_TAP_CABLE_CLOCK_TMS:
+            {
+                /* one clock() per run of equal TMS values */
+                uint32_t tms = cable->todo.data[i].arg.clock.tms;
+                int n = cable->todo.data[i].arg.clock.n;
+
+                while (n > 0)
+                {
+                    int run = 1;
+
+                    while (run < n && ((tms >> run) & 1) == (tms & 1))
+                        run++;
+                    cable->driver->clock (cable, tms & 1,
+                                          cable->todo.data[i].arg.clock.tdi,
+                                          run);
+                    tms >>= run;
+                    n -= run;
+                }
+                break;
+            }
         case URJ_TAP_CABLE_SET_SIGNAL:
-            urj_tap_cable_set_signal (cable,
-                                      cable->todo.data[i].arg.value.sig,
-                                      cable->todo.data[i].arg.value.val);
+            /* the driver directly: the public call would flush the queue
+               being drained and trace the item a second time */
+            cable->driver->set_signal (cable,
+                                       cable->todo.data[i].arg.value.mask,
+                                       cable->todo.data[i].arg.value.val);
             break;
         case URJ_TAP_CABLE_TRANSFER:
             {
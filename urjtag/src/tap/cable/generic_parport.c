@@ -93,6 +93,7 @@ urj_tap_cable_generic_parport_connect (urj_cable_t *cable,
     }
 
     cable->link.port = port;
+    port->cable = cable;
     cable->params = cable_params;
     cable->chain = NULL;
 
@@ -160,6 +160,7 @@ urj_tap_cable_generic_usbconn_connect (urj_cable_t *cable,
     }
 
     cable->link.usb = conn;
+    conn->cable = cable;
     cable->params = cable_params;
     cable->chain = NULL;
 
@@ -1055,6 +1055,7 @@ static void adi_flush (urj_cable_t *cable, urj_cable_flush_amount_t how_much)
             switch (todo_data->action)
             {   /* build the scan */
             case URJ_TAP_CABLE_CLOCK:
+            case URJ_TAP_CABLE_CLOCK_TMS:
                 build_clock_scan (cable, &i, &n);
                 break;
             case URJ_TAP_CABLE_GET_TDO:
@@ -1159,6 +1160,7 @@ static void adi_flush (urj_cable_t *cable, urj_cable_flush_amount_t how_much)
             switch (todo_data->action)
             {   /* Pick up data if need be */
             case URJ_TAP_CABLE_CLOCK:
+            case URJ_TAP_CABLE_CLOCK_TMS:
                 /* Nothing needs to be done */
                 break;
             case URJ_TAP_CABLE_GET_TDO:
@@ -1546,11 +1548,17 @@ static int build_clock_scan (urj_cable_t *cable, int32_t *start_idx, int32_t *nu
     bit_set = tap_info->bit_pos;
     scan_data = &ptr_todo->data[cur_idx];
 
-    for (n = *num_todo_items; (n < ptr_todo->num_items) && (scan_data->action == URJ_TAP_CABLE_CLOCK); n++)
+    for (n = *num_todo_items; (n < ptr_todo->num_items)
+         && (scan_data->action == URJ_TAP_CABLE_CLOCK
+             || scan_data->action == URJ_TAP_CABLE_CLOCK_TMS); n++)
     {   /* for each CABLE_CLOCK todo entry, create scan */
         for (i = 0; i < scan_data->arg.clock.n; i++)
         {
-            tap_scan->tms |= scan_data->arg.clock.tms ? bit_set : 0;
+            int tms = scan_data->action == URJ_TAP_CABLE_CLOCK_TMS
+                      ? (scan_data->arg.clock.tms >> i) & 1
+                      : scan_data->arg.clock.tms;
+
+            tap_scan->tms |= tms ? bit_set : 0;
             tap_scan->tdi |= scan_data->arg.clock.tdi ? bit_set : 0;
             bit_set >>= 1;
             if (!bit_set)
@@ -32,6 +32,7 @@
 #include <urjtag/chain.h>
 
 #include "generic.h"
+#include "cable.h"
 
 #include <urjtag/cmd.h>
 
@@ -41,24 +42,94 @@
 typedef struct
 {
     urj_jim_state_t *s;
+    int in_flush;
+    urj_jim_cable_model_t model;
 }
 jim_cable_params_t;
 
+/* Bytes a typical USB cable (FT2232 MPSSE) would move for one command:
+ * a 3 byte opcode/length header, the TDI bits packed into bytes and, if
+ * requested, as many bytes of TDO coming back */
+#define MODEL_CMD_BYTES         3
+#define MODEL_BITS_BYTES(n)     (((n) + 7) / 8)
+
+/* Accounts for one cable command; commands issued outside a flush did not
+ * go through the queue and cost a round trip of their own.  The modelled
+ * traffic also shows up in the cable statistics, there being no real link */
+static void
+jim_cable_model (urj_cable_t *cable, unsigned long bytes)
+{
+    jim_cable_params_t *jcp = cable->params;
+
+    jcp->model.bytes += MODEL_CMD_BYTES + bytes;
+    cable->stats.bytes_out += MODEL_CMD_BYTES + bytes;
+    if (!jcp->in_flush)
+    {
+        jcp->model.round_trips++;
+        cable->stats.round_trips++;
+    }
+}
+
+int
+urj_tap_cable_jim_model (urj_cable_t *cable, urj_jim_cable_model_t *model)
+{
+    jim_cable_params_t *jcp;
+
+    if (cable == NULL || cable->driver != &urj_tap_cable_jim_driver)
+    {
+        urj_error_set (URJ_ERROR_INVALID, _("cable is not JIM"));
+        return URJ_STATUS_FAIL;
+    }
+
+    jcp = cable->params;
+    *model = jcp->model;
+    model->usecs = (double) jcp->model.round_trips * jcp->model.latency;
+    if (jcp->model.bandwidth != 0)
+        model->usecs += 1E6 * jcp->model.bytes / jcp->model.bandwidth;
+
+    return URJ_STATUS_OK;
+}
+
 static int
 jim_cable_connect (urj_cable_t *cable, const urj_param_t *params[])
 {
     jim_cable_params_t *cable_params;
     urj_jim_state_t *s;
+    const char *chain = NULL;
+    const char *memfile = NULL;
+    size_t memsize = 0;
+    unsigned long latency = 0, bandwidth = 0;
+    int i;
 
-    if (urj_param_num (params) > 0)
-    {
-        urj_error_set (URJ_ERROR_SYNTAX, _("too many arguments"));
-        return URJ_STATUS_FAIL;
-    }
+    if (params != NULL)
+        for (i = 0; params[i] != NULL; i++)
+        {
+            switch (params[i]->key)
+            {
+            case URJ_CABLE_PARAM_KEY_CHAIN:
+                chain = params[i]->value.string;
+                break;
+            case URJ_CABLE_PARAM_KEY_MEMFILE:
+                memfile = params[i]->value.string;
+                break;
+            case URJ_CABLE_PARAM_KEY_MEMSIZE:
+                memsize = params[i]->value.lu;
+                break;
+            case URJ_CABLE_PARAM_KEY_LATENCY:
+                latency = params[i]->value.lu;
+                break;
+            case URJ_CABLE_PARAM_KEY_BANDWIDTH:
+                bandwidth = params[i]->value.lu;
+                break;
+            default:
+                urj_error_set (URJ_ERROR_SYNTAX, _("unknown parameter"));
+                return URJ_STATUS_FAIL;
+            }
+        }
 
     urj_warning (_("JTAG target simulator JIM - work in progress!\n"));
 
-    s = urj_jim_init ();
+    s = urj_jim_init (chain, memfile, memsize);
     if (!s)
     {
         // retain error state
@@ -74,8 +145,11 @@ jim_cable_connect (urj_cable_t *cable, const urj_param_t *params[])
         return URJ_STATUS_FAIL;
     }
 
+    memset (cable_params, 0, sizeof (jim_cable_params_t));
+    cable_params->s = s;
+    cable_params->model.latency = latency;
+    cable_params->model.bandwidth = bandwidth;
     cable->params = cable_params;
-    ((jim_cable_params_t *) (cable->params))->s = s;
     cable->chain = NULL;
 
     return URJ_STATUS_OK;
@@ -102,6 +176,16 @@ jim_cable_free (urj_cable_t *cable)
 static void
 jim_cable_done (urj_cable_t *cable)
 {
+    jim_cable_params_t *jcp = cable->params;
+    urj_jim_cable_model_t m;
+
+    if (jcp->model.latency == 0 && jcp->model.bandwidth == 0)
+        return;
+
+    urj_tap_cable_jim_model (cable, &m);
+    urj_log (URJ_LOG_LEVEL_NORMAL,
+             _("JIM cable model: %lu round trips, %llu bytes, %.6f s\n"),
+             m.round_trips, m.bytes, m.usecs / 1E6);
 }
 
 static int
@@ -116,6 +200,7 @@ jim_cable_clock (urj_cable_t *cable, int tms, int tdi, int n)
     int i;
     jim_cable_params_t *jcp = cable->params;
 
+    jim_cable_model (cable, MODEL_BITS_BYTES (n));
     for (i = 0; i < n; i++)
     {
         urj_jim_tck_rise (jcp->s, tms, tdi);
@@ -123,11 +208,22 @@ jim_cable_clock (urj_cable_t *cable, int tms, int tdi, int n)
     }
 }
 
+static int
+jim_cable_transfer (urj_cable_t *cable, int len, const char *in, char *out)
+{
+    jim_cable_params_t *jcp = cable->params;
+
+    jim_cable_model (cable, MODEL_BITS_BYTES (len)
+                     + (out ? MODEL_BITS_BYTES (len) : 0));
+    return urj_jim_shift (jcp->s, len, in, out);
+}
+
 static int
 jim_cable_get_tdo (urj_cable_t *cable)
 {
     jim_cable_params_t *jcp = cable->params;
 
+    jim_cable_model (cable, 1);
     return urj_jim_get_tdo (jcp->s);
 }
 
@@ -146,14 +242,42 @@ jim_cable_set_trst (urj_cable_t *cable, int mask, int val)
     /* XXX: Doesn't handle mask ? */
     jim_cable_params_t *jcp = cable->params;
 
+    jim_cable_model (cable, 0);
     urj_jim_set_trst (jcp->s, val);
     return urj_jim_get_trst (jcp->s);
 }
 
+/* Everything the queue holds goes out in one USB round trip */
+static void
+jim_cable_flush (urj_cable_t *cable, urj_cable_flush_amount_t how_much)
+{
+    jim_cable_params_t *jcp = cable->params;
+
+    if (how_much == URJ_TAP_CABLE_OPTIONALLY || cable->todo.num_items == 0)
+        return;
+
+    jcp->model.round_trips++;
+    cable->stats.round_trips++;
+    jcp->in_flush = 1;
+    urj_tap_cable_generic_flush_using_transfer (cable, how_much);
+    jcp->in_flush = 0;
+}
+
 static void
 jim_cable_help (urj_log_level_t ll, const char *cablename)
 {
-    urj_log (ll, _("Usage: cable %s\n"), cablename);
+    urj_log (ll, _("Usage: cable %s [chain=DEVICE[,DEVICE...]] "
+                   "[memfile=FILE] [memsize=BYTES]\n"
+                   "             [latency=USECS] [bandwidth=BYTES_PER_SEC]\n"
+                   "\n"
+                   "chain     devices, the first one closest to TDO (default some_cpu)\n"
+                   "          DEVICE is some_cpu, fjmem[:WORDS], IDCODE:IRLEN[:BSRLEN]\n"
+                   "          or a BSDL file, optionally repeated as N*DEVICE\n"
+                   "memfile   file mapped as simulated memory\n"
+                   "memsize   simulated memory size (default 16 MByte)\n"
+                   "latency   modelled USB round trip time per flush\n"
+                   "bandwidth modelled cable throughput\n"),
+             cablename);
 }
 
 const urj_cable_driver_t urj_tap_cable_jim_driver = {
@@ -168,9 +292,9 @@ const urj_cable_driver_t urj_tap_cable_jim_driver = {
     urj_tap_cable_generic_set_frequency,
     jim_cable_clock,
     jim_cable_get_tdo,
-    urj_tap_cable_generic_transfer,
+    jim_cable_transfer,
     jim_cable_set_trst,
     jim_cable_get_trst,
-    urj_tap_cable_generic_flush_using_transfer,
+    jim_cable_flush,
     jim_cable_help
 };
@@ -34,7 +34,10 @@
 
 #include <sysdep.h>
 
+#include <stdlib.h>
+
 #include <urjtag/cable.h>
+#include <urjtag/error.h>
 #include <urjtag/parport.h>
 #include <urjtag/chain.h>
 
@@ -57,8 +60,41 @@
  */
 #define TDO 7
 
-/* FIXME: having a static variable like this is probably not thread safe */
-static unsigned char unused_bits;
+/* signals comes first, so PARAM_SIGNALS (cable) keeps working */
+typedef struct
+{
+    int signals;
+    unsigned char unused_bits;
+} minimal_params_t;
+
+#define UNUSED_BITS(cable) ((minimal_params_t *) (cable)->params)->unused_bits
+
+static int
+minimal_connect (urj_cable_t *cable, urj_cable_parport_devtype_t devtype,
+                 const char *devname, const urj_param_t *params[])
+{
+    minimal_params_t *minimal_params;
+
+    if (urj_tap_cable_generic_parport_connect (cable, devtype, devname,
+                                               params) != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+
+    minimal_params = calloc (1, sizeof *minimal_params);
+    if (!minimal_params)
+    {
+        urj_error_set (URJ_ERROR_OUT_OF_MEMORY, _("calloc(%zd,%zd) fails"),
+                       (size_t) 1, sizeof *minimal_params);
+        /* as in wiggler_connect(): cable itself is freed by the caller */
+        cable->link.port->driver->parport_free (cable->link.port);
+        free (cable->params);
+        return URJ_STATUS_FAIL;
+    }
+
+    free (cable->params);
+    cable->params = minimal_params;
+
+    return URJ_STATUS_OK;
+}
 
 static int
 minimal_init (urj_cable_t *cable)
@@ -72,7 +108,7 @@ minimal_init (urj_cable_t *cable)
         return URJ_STATUS_FAIL;
 
     /* remember state of all parallel port pins except TDI, TCK and TMS */
-    unused_bits = data & (~((1 << TDI) | (1 << TCK) | (1 << TMS)));
+    UNUSED_BITS (cable) = data & (~((1 << TDI) | (1 << TCK) | (1 << TMS)));
 
     /* copy data into PARAM_SIGNALS (cable) while faking URJ_POD_CS_TRST */
     PARAM_SIGNALS (cable) = URJ_POD_CS_TRST;
@@ -95,11 +131,11 @@ minimal_clock (urj_cable_t *cable, int tms, int tdi, int n)
     {
         urj_tap_parport_set_data (cable->link.port,
                                   (tms << TMS) | (0 << TCK) | (tdi << TDI) |
-                                  unused_bits);
+                                  UNUSED_BITS (cable));
         urj_tap_cable_wait (cable);
         urj_tap_parport_set_data (cable->link.port,
                                   (tms << TMS) | (1 << TCK) | (tdi << TDI) |
-                                  unused_bits);
+                                  UNUSED_BITS (cable));
         urj_tap_cable_wait (cable);
     }
 
@@ -113,7 +149,7 @@ minimal_clock (urj_cable_t *cable, int tms, int tdi, int n)
 static int
 minimal_get_tdo (urj_cable_t *cable)
 {
-    urj_tap_parport_set_data (cable->link.port, (0 << TCK) | unused_bits);
+    urj_tap_parport_set_data (cable->link.port, (0 << TCK) | UNUSED_BITS (cable));
 
     PARAM_SIGNALS (cable) &=
         ~(URJ_POD_CS_TDI | URJ_POD_CS_TCK | URJ_POD_CS_TMS);
@@ -140,7 +176,7 @@ minimal_set_signal (urj_cable_t *cable, int mask, int val)
         data |= (sigs & URJ_POD_CS_TMS) ? (1 << TMS) : 0;
         /* do not actually set TRST on parallel port ... */
         //data |= (sigs & URJ_POD_CS_TRST) ? (1 << TRST) : 0;
-        urj_tap_parport_set_data (cable->link.port, data | unused_bits);
+        urj_tap_parport_set_data (cable->link.port, data | UNUSED_BITS (cable));
         /* ... although TRST can be marked as set in PARAM_SIGNALS (cable) */
         PARAM_SIGNALS (cable) = sigs;
     }
@@ -152,7 +188,7 @@ const urj_cable_driver_t urj_tap_cable_minimal_driver = {
     "Minimal",
     N_("Minimal Parallel Port JTAG Cable"),
     URJ_CABLE_DEVICE_PARPORT,
-    { .parport = urj_tap_cable_generic_parport_connect, },
+    { .parport = minimal_connect, },
     urj_tap_cable_generic_disconnect,
     urj_tap_cable_generic_parport_free,
     minimal_init,
@@ -59,9 +59,34 @@
 
 #define FIXED_FREQUENCY 12000000L
 
+#define PACKET_SIZE     64      /* bytes of one FT245 USB packet */
+#define MAX_SHIFT_BYTES 63      /* byte-shift count field is 6 bits */
+
 typedef struct
 {
     urj_tap_cable_cx_cmd_root_t cmd_root;
+    int queued;                 /* bytes in cmd_root */
+    int queued_recv;            /* of these, answered by the device */
+    int shifting;               /* TCK low and TMS 0 from a byte shift */
+    int want_tdo;               /* a get_tdo waits for the next clock */
+    struct
+    {
+        char tdi;
+        int slot;               /* result slot, -1 if not read */
+    } pend[MAX_SHIFT_BYTES * 8];  /* TMS=0 clocks not yet encoded */
+    int num_pend;
+    struct
+    {
+        int first;              /* slot of the lowest bit in mask */
+        uint8_t mask;
+    } *rx;                      /* one per byte the device answers */
+    int num_rx;
+    int max_rx;
+    char *result;               /* sampled TDO bits, by slot */
+    int num_slots;
+    int max_result;
+    int *item_slot;             /* first slot of each flushed queue item */
+    int max_item_slot;
 } params_t;
 
 static int
@@ -73,11 +98,11 @@ usbblaster_connect (urj_cable_t *cable, const urj_param_t *params[])
     if (urj_tap_cable_generic_usbconn_connect (cable, params) != URJ_STATUS_OK)
         return URJ_STATUS_FAIL;
 
-    cable_params = malloc (sizeof (*cable_params));
+    cable_params = calloc (1, sizeof (*cable_params));
     if (!cable_params)
     {
-        urj_error_set (URJ_ERROR_OUT_OF_MEMORY, _("malloc(%zd) fails"),
-                       sizeof (*cable_params));
+        urj_error_set (URJ_ERROR_OUT_OF_MEMORY, "calloc(%zd,%zd) fails",
+                       (size_t) 1, sizeof (*cable_params));
         /* NOTE:
          * Call the underlying usbport driver (*free) routine directly
          * not urj_tap_cable_generic_usbconn_free() since it also free's cable->params
@@ -133,366 +158,436 @@ usbblaster_cable_free (urj_cable_t *cable)
     params_t *params = cable->params;
 
     urj_tap_cable_cx_cmd_deinit (&params->cmd_root);
+    free (params->rx);
+    free (params->result);
+    free (params->item_slot);
 
     urj_tap_cable_generic_usbconn_free (cable);
 }
 
-static void
-usbblaster_clock_schedule (urj_cable_t *cable, int tms, int tdi, int n)
+/* A flush is encoded as one stream of clocks.  TMS=0 clocks collect in
+ * pend[] until a TMS=1 clock (or the end) cuts the run: its whole bytes go
+ * out in byte-shift mode, the rest is bit-banged.  Byte-shift mode only
+ * drives TDI, so TMS clocks always take two bit-banged bytes. */
+
+/** @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error */
+static int
+usbblaster_grow (void *pbuf, int *max, int need, size_t size)
+{
+    void **buf = pbuf;
+    void *p;
+    int n;
+
+    if (need <= *max)
+        return URJ_STATUS_OK;
+    n = *max ? *max : 64;
+    while (n < need)
+        n *= 2;
+    p = realloc (*buf, n * size);
+    if (p == NULL)
+    {
+        urj_error_set (URJ_ERROR_OUT_OF_MEMORY, _("realloc(%zd) fails"),
+                       n * size);
+        return URJ_STATUS_FAIL;
+    }
+    *buf = p;
+    *max = n;
+    return URJ_STATUS_OK;
+}
+
+/* Append byte d to the packet being filled; if recv, the device answers it
+ * with one byte whose bits in mask are the results for slots first.. */
+/** @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error */
+static int
+usbblaster_push (urj_cable_t *cable, uint8_t d, int recv, int first,
+                 uint8_t mask)
 {
     params_t *params = cable->params;
     urj_tap_cable_cx_cmd_root_t *cmd_root = &params->cmd_root;
-    int i, m;
-
-    tms = tms ? (1 << TMS) : 0;
-    tdi = tdi ? (1 << TDI) : 0;
 
-    // urj_log (URJ_LOG_LEVEL_COMM, "clock: %d %d %d\n", tms, tdi, n);
+    if (cmd_root->last == NULL
+        || urj_tap_cable_cx_cmd_space (cmd_root, PACKET_SIZE) == 0)
+    {
+        if (params->queued >= URJ_USBCONN_FTDX_MAXSEND
+            && params->queued_recv == 0)
+        {
+            /* hand long write-only streams to the usbconn buffer */
+            urj_tap_cable_cx_xfer (cmd_root, NULL, cable,
+                                   URJ_TAP_CABLE_TO_OUTPUT);
+            params->queued = 0;
+        }
+        if (urj_tap_cable_cx_cmd_queue (cmd_root, 0) == NULL)
+            return URJ_STATUS_FAIL;
+    }
+    if (!urj_tap_cable_cx_cmd_push (cmd_root, d))
+        return URJ_STATUS_FAIL;
+    params->queued++;
 
-    m = n;
-    if (tms == 0 && m >= 8)
+    if (recv)
     {
-        unsigned char tdis = tdi ? 0xFF : 0;
+        if (usbblaster_grow (&params->rx, &params->max_rx,
+                             params->num_rx + 1, sizeof *params->rx)
+            != URJ_STATUS_OK)
+            return URJ_STATUS_FAIL;
+        params->rx[params->num_rx].first = first;
+        params->rx[params->num_rx].mask = mask;
+        params->num_rx++;
+        cmd_root->last->to_recv++;
+        params->queued_recv++;
+    }
 
-        urj_tap_cable_cx_cmd_queue (cmd_root, 0);
-        while (m >= 8)
-        {
-            int i;
-            int chunkbytes = (m >> 3);
-            if (chunkbytes > 63)
-                chunkbytes = 63;
-
-            if (urj_tap_cable_cx_cmd_space (cmd_root,
-                                            URJ_USBCONN_FTDX_MAXSEND)
-                < chunkbytes + 1)
-            {
-                /* no space left for next clocking command
-                   transfer queued commands to device and read receive data
-                   to internal buffer */
-                urj_tap_cable_cx_xfer (cmd_root, NULL, cable,
-                                       URJ_TAP_CABLE_COMPLETELY);
-                urj_tap_cable_cx_cmd_queue (cmd_root, 0);
-            }
+    return URJ_STATUS_OK;
+}
+
+/** @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error */
+static int
+usbblaster_bitbang (urj_cable_t *cable, int tms, int tdi, int slot)
+{
+    uint8_t d = OTHERS | (tms << TMS) | (tdi << TDI);
+
+    ((params_t *) cable->params)->shifting = 0;
+    if (usbblaster_push (cable, d, 0, 0, 0) != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+    if (slot < 0)
+        return usbblaster_push (cable, d | (1 << TCK), 0, 0, 0);
+    return usbblaster_push (cable, d | (1 << TCK) | (1 << READ), 1, slot,
+                            1 << TDO);
+}
+
+/* Encode the pending TMS=0 clocks: whole bytes in byte-shift mode, and with
+ * all set the remaining bits bit-banged. */
+/** @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error */
+static int
+usbblaster_shift_pending (urj_cable_t *cable, int all)
+{
+    params_t *params = cable->params;
+    int nbytes = params->num_pend >> 3;
+    int read = 0;
+    int i, j, k;
 
+    for (i = 0; i < nbytes << 3; i++)
+        if (params->pend[i].slot >= 0)
+            read = 1;
 
-            urj_tap_cable_cx_cmd_push (cmd_root,
-                                       (1 << SHMODE) | (0 << READ) |
-                                       chunkbytes);
+    if (nbytes > 0)
+    {
+        /* byte shifts start with TCK low and keep TMS as last driven */
+        if (!params->shifting)
+            if (usbblaster_push (cable, OTHERS, 0, 0, 0) != URJ_STATUS_OK)
+                return URJ_STATUS_FAIL;
+        params->shifting = 1;
+        if (usbblaster_push (cable, (1 << SHMODE) | (read << READ) | nbytes,
+                             0, 0, 0) != URJ_STATUS_OK)
+            return URJ_STATUS_FAIL;
+
+        for (i = 0; i < nbytes; i++)
+        {
+            uint8_t b = 0, mask = 0;
+            int first = -1;
 
-            for (i = 0; i < chunkbytes; i++)
+            for (j = 0; j < 8; j++)
             {
-                urj_tap_cable_cx_cmd_push (cmd_root, tdis);
+                k = (i << 3) + j;
+                if (params->pend[k].tdi)
+                    b |= 1 << j;
+                if (params->pend[k].slot >= 0)
+                {
+                    mask |= 1 << j;
+                    if (first < 0)
+                        first = params->pend[k].slot;
+                }
             }
-
-            m -= (chunkbytes << 3);
+            if (usbblaster_push (cable, b, read, first, mask)
+                != URJ_STATUS_OK)
+                return URJ_STATUS_FAIL;
         }
+
+        params->num_pend -= nbytes << 3;
+        memmove (params->pend, params->pend + (nbytes << 3),
+                 params->num_pend * sizeof *params->pend);
     }
 
-    for (i = 0; i < m; i++)
+    if (all)
     {
-        urj_tap_cable_cx_cmd_queue (cmd_root, 0);
-        urj_tap_cable_cx_cmd_push (cmd_root, OTHERS | (0 << TCK) | tms | tdi);
-        urj_tap_cable_cx_cmd_push (cmd_root, OTHERS | (1 << TCK) | tms | tdi);
+        for (i = 0; i < params->num_pend; i++)
+            if (usbblaster_bitbang (cable, 0, params->pend[i].tdi,
+                                    params->pend[i].slot) != URJ_STATUS_OK)
+                return URJ_STATUS_FAIL;
+        params->num_pend = 0;
     }
+
+    return URJ_STATUS_OK;
 }
 
-static void
-usbblaster_clock (urj_cable_t *cable, int tms, int tdi, int n)
+/* Add one clock; with read its TDO (sampled before the rising edge) gets
+ * the next result slot.  A pending get_tdo rides on the same sample. */
+/** @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error */
+static int
+usbblaster_add (urj_cable_t *cable, int tms, int tdi, int read)
 {
     params_t *params = cable->params;
+    int slot = -1;
 
-    usbblaster_clock_schedule (cable, tms, tdi, n);
-    urj_tap_cable_cx_xfer (&params->cmd_root, NULL, cable,
-                           URJ_TAP_CABLE_COMPLETELY);
-}
+    if (read || params->want_tdo)
+    {
+        slot = params->num_slots++;
+        params->want_tdo = 0;
+    }
 
-static void
-usbblaster_get_tdo_schedule (urj_cable_t *cable)
-{
-    params_t *params = cable->params;
-    urj_tap_cable_cx_cmd_root_t *cmd_root = &params->cmd_root;
+    if (tms)
+    {
+        if (usbblaster_shift_pending (cable, 1) != URJ_STATUS_OK)
+            return URJ_STATUS_FAIL;
+        return usbblaster_bitbang (cable, 1, tdi ? 1 : 0, slot);
+    }
 
-    urj_tap_cable_cx_cmd_queue (cmd_root, 1);
-    urj_tap_cable_cx_cmd_push (cmd_root, OTHERS);       /* TCK low */
-    urj_tap_cable_cx_cmd_push (cmd_root, OTHERS | (1 << READ)); /* TCK low */
-}
+    params->pend[params->num_pend].tdi = tdi ? 1 : 0;
+    params->pend[params->num_pend].slot = slot;
+    if (++params->num_pend == MAX_SHIFT_BYTES * 8)
+        return usbblaster_shift_pending (cable, 0);
 
-static int
-usbblaster_get_tdo_finish (urj_cable_t *cable)
-{
-#if 0
-    char x = (urj_tap_cable_cx_xfer_recv (cable) & (1 << TDO)) ? 1 : 0;
-    urj_log (URJ_LOG_LEVEL_COMM, "GetTDO %d\n", x);
-    return x;
-#else
-    return (urj_tap_cable_cx_xfer_recv (cable) & (1 << TDO)) ? 1 : 0;
-#endif
+    return URJ_STATUS_OK;
 }
 
+/* The slot a get_tdo reads: that of the next clock, if there is one. */
 static int
-usbblaster_get_tdo (urj_cable_t *cable)
+usbblaster_add_get_tdo (urj_cable_t *cable)
 {
     params_t *params = cable->params;
 
-    usbblaster_get_tdo_schedule (cable);
-    urj_tap_cable_cx_xfer (&params->cmd_root, NULL, cable,
-                           URJ_TAP_CABLE_COMPLETELY);
-    return usbblaster_get_tdo_finish (cable);
+    params->want_tdo = 1;
+    return params->num_slots;
 }
 
-static int
-usbblaster_set_signal (urj_cable_t *cable, int mask, int val)
+static void
+usbblaster_begin (urj_cable_t *cable)
 {
-    return 1;
+    params_t *params = cable->params;
+
+    params->num_pend = 0;
+    params->num_slots = 0;
+    params->num_rx = 0;
+    params->want_tdo = 0;
+    params->shifting = 0;
 }
 
-static void
-usbblaster_transfer_schedule (urj_cable_t *cable, int len, const char *in,
-                              char *out)
+/* Send the stream and scatter the received bits into result[]. */
+/** @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error */
+static int
+usbblaster_run (urj_cable_t *cable, urj_cable_flush_amount_t how_much)
 {
     params_t *params = cable->params;
-    urj_tap_cable_cx_cmd_root_t *cmd_root = &params->cmd_root;
-    int in_offset = 0;
-
-    urj_tap_cable_cx_cmd_queue (cmd_root, 0);
-    urj_tap_cable_cx_cmd_push (cmd_root, OTHERS);       /* TCK low */
+    int i, j, slot;
 
-#if 0
+    if (usbblaster_shift_pending (cable, 1) != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+    if (params->want_tdo)
     {
-        int o;
-        urj_log (URJ_LOG_LEVEL_COMM, "%d in: ", len);
-        for (o = 0; o < len; o++)
-            urj_log (URJ_LOG_LEVEL_COMM, "%c", in[o] ? '1' : '0');
-        urj_log (URJ_LOG_LEVEL_COMM, "\n");
+        /* no clock follows: read TDO with TCK low */
+        slot = params->num_slots++;
+        params->want_tdo = 0;
+        params->shifting = 0;
+        if (usbblaster_push (cable, OTHERS, 0, 0, 0) != URJ_STATUS_OK
+            || usbblaster_push (cable, OTHERS | (1 << READ), 1, slot,
+                                1 << TDO) != URJ_STATUS_OK)
+            return URJ_STATUS_FAIL;
     }
-#endif
+    if (usbblaster_grow (&params->result, &params->max_result,
+                         params->num_slots, 1) != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
 
-    while (len - in_offset >= 8)
-    {
-        int i;
-        int chunkbytes = ((len - in_offset) >> 3);
-        if (chunkbytes > 63)
-            chunkbytes = 63;
+    urj_tap_cable_cx_xfer (&params->cmd_root, NULL, cable, how_much);
+    params->queued = 0;
+    params->queued_recv = 0;
 
-        if (out)
-        {
-            urj_tap_cable_cx_cmd_queue (cmd_root, chunkbytes);
-            urj_tap_cable_cx_cmd_push (cmd_root,
-                                       (1 << SHMODE) | (1 << READ) |
-                                       chunkbytes);
-        }
-        else
-        {
-            urj_tap_cable_cx_cmd_queue (cmd_root, 0);
-            urj_tap_cable_cx_cmd_push (cmd_root,
-                                       (1 << SHMODE) | (0 << READ) |
-                                       chunkbytes);
-        }
+    for (i = 0; i < params->num_rx; i++)
+    {
+        uint8_t b = urj_tap_cable_cx_xfer_recv (cable);
 
-        for (i = 0; i < chunkbytes; i++)
-        {
-            int j;
-            unsigned char b = 0;
-            for (j = 1; j < 256; j <<= 1)
-                if (in[in_offset++])
-                    b |= j;
-            urj_tap_cable_cx_cmd_push (cmd_root, b);
-        }
+        slot = params->rx[i].first;
+        for (j = 0; j < 8; j++)
+            if (params->rx[i].mask & (1 << j))
+                params->result[slot++] = (b >> j) & 1;
     }
+    params->num_rx = 0;
 
-    while (len > in_offset)
-    {
-        char tdi = in[in_offset++] ? 1 : 0;
-
-        urj_tap_cable_cx_cmd_queue (cmd_root, out ? 1 : 0);
-        urj_tap_cable_cx_cmd_push (cmd_root, OTHERS | (tdi << TDI));    /* TCK low */
-        urj_tap_cable_cx_cmd_push (cmd_root,
-                                   OTHERS | ((out) ? (1 << READ) : 0) | (1 <<
-                                                                         TCK)
-                                   | (tdi << TDI));
-    }
+    return URJ_STATUS_OK;
 }
 
-static int
-usbblaster_transfer_finish (urj_cable_t *cable, int len, char *out)
+static void
+usbblaster_clock (urj_cable_t *cable, int tms, int tdi, int n)
 {
-    params_t *params = cable->params;
-    urj_tap_cable_cx_cmd_root_t *cmd_root = &params->cmd_root;
-    int out_offset = 0;
-
-    if (out == NULL)
-        return 0;
-
-    while (len - out_offset >= 8)
-    {
-        int i;
-        int chunkbytes = ((len - out_offset) >> 3);
-        if (chunkbytes > 63)
-            chunkbytes = 63;
-
-        if (out)
-        {
-            urj_tap_cable_cx_xfer (cmd_root, NULL, cable,
-                                   URJ_TAP_CABLE_COMPLETELY);
+    int i;
 
-            for (i = 0; i < chunkbytes; i++)
-            {
-                int j;
-                unsigned char b = urj_tap_cable_cx_xfer_recv (cable);
-#if 0
-                urj_log (URJ_LOG_LEVEL_COMM, "read byte: %02X\n", b);
-#endif
-
-                for (j = 1; j < 256; j <<= 1)
-                    out[out_offset++] = (b & j) ? 1 : 0;
-            }
-        }
-    }
+    usbblaster_begin (cable);
+    for (i = 0; i < n; i++)
+        if (usbblaster_add (cable, tms, tdi, 0) != URJ_STATUS_OK)
+            break;
+    usbblaster_run (cable, URJ_TAP_CABLE_COMPLETELY);
+}
 
-    while (len > out_offset)
-        out[out_offset++] =
-            (urj_tap_cable_cx_xfer_recv (cable) & (1 << TDO)) ? 1 : 0;
+static int
+usbblaster_get_tdo (urj_cable_t *cable)
+{
+    params_t *params = cable->params;
+    int slot;
 
-#if 0
-    {
-        int o;
-        urj_log (URJ_LOG_LEVEL_COMM, "%d out: ", len);
-        for (o = 0; o < len; o++)
-            urj_log (URJ_LOG_LEVEL_COMM, "%c", out[o] ? '1' : '0');
-        urj_log (URJ_LOG_LEVEL_COMM, "\n");
-    }
-#endif
+    usbblaster_begin (cable);
+    slot = usbblaster_add_get_tdo (cable);
+    if (usbblaster_run (cable, URJ_TAP_CABLE_COMPLETELY) != URJ_STATUS_OK)
+        return -1;
+    return params->result[slot];
+}
 
-    return 0;
+static int
+usbblaster_set_signal (urj_cable_t *cable, int mask, int val)
+{
+    return 1;
 }
 
 static int
 usbblaster_transfer (urj_cable_t *cable, int len, const char *in, char *out)
 {
     params_t *params = cable->params;
+    int i;
 
-    usbblaster_transfer_schedule (cable, len, in, out);
-    urj_tap_cable_cx_xfer (&params->cmd_root, NULL, cable,
-                           URJ_TAP_CABLE_COMPLETELY);
-    return usbblaster_transfer_finish (cable, len, out);
+    usbblaster_begin (cable);
+    for (i = 0; i < len; i++)
+        if (usbblaster_add (cable, 0, in[i], out != NULL) != URJ_STATUS_OK)
+            return -1;
+    if (usbblaster_run (cable, URJ_TAP_CABLE_COMPLETELY) != URJ_STATUS_OK)
+        return -1;
+    if (out)
+        memcpy (out, params->result, len);
+
+    return 0;
 }
 
+/* All queued items share one stream, so TDI runs of several items merge
+ * into byte shifts and the device FIFO gets full packets. */
 static void
 usbblaster_flush (urj_cable_t *cable, urj_cable_flush_amount_t how_much)
 {
     params_t *params = cable->params;
+    int i, j, k, n, m, r;
 
     if (how_much == URJ_TAP_CABLE_OPTIONALLY)
         return;
 
     if (cable->todo.num_items == 0)
+    {
         urj_tap_cable_cx_xfer (&params->cmd_root, NULL, cable, how_much);
+        return;
+    }
+
+    r = usbblaster_grow (&params->item_slot, &params->max_item_slot,
+                         cable->todo.num_items, sizeof *params->item_slot);
 
-    while (cable->todo.num_items > 0)
+    usbblaster_begin (cable);
+    for (i = cable->todo.next_item, n = 0;
+         n < cable->todo.num_items && r == URJ_STATUS_OK; n++)
     {
-        int i, j, n;
+        urj_cable_queue_t *item = &cable->todo.data[i];
 
-        for (j = i = cable->todo.next_item, n = 0; n < cable->todo.num_items;
-             n++)
+        switch (item->action)
         {
+        case URJ_TAP_CABLE_CLOCK:
+            for (k = 0; k < item->arg.clock.n && r == URJ_STATUS_OK; k++)
+                r = usbblaster_add (cable, item->arg.clock.tms,
+                                    item->arg.clock.tdi, 0);
+            break;
+
+        case URJ_TAP_CABLE_CLOCK_TMS:
+            for (k = 0; k < item->arg.clock.n && r == URJ_STATUS_OK; k++)
+                r = usbblaster_add (cable, (item->arg.clock.tms >> k) & 1,
+                                    item->arg.clock.tdi, 0);
+            break;
+
+        case URJ_TAP_CABLE_GET_TDO:
+            params->item_slot[n] = usbblaster_add_get_tdo (cable);
+            break;
+
+        case URJ_TAP_CABLE_TRANSFER:
+            params->item_slot[n] = params->num_slots;
+            for (k = 0; k < item->arg.transfer.len && r == URJ_STATUS_OK; k++)
+                r = usbblaster_add (cable, 0, item->arg.transfer.in[k],
+                                    item->arg.transfer.out != NULL);
+            break;
+
+        default:
+            break;
+        }
 
-            switch (cable->todo.data[i].action)
-            {
-            case URJ_TAP_CABLE_CLOCK:
-                usbblaster_clock_schedule (cable,
-                                           cable->todo.data[i].arg.clock.tms,
-                                           cable->todo.data[i].arg.clock.tdi,
-                                           cable->todo.data[i].arg.clock.n);
-                break;
-
-            case URJ_TAP_CABLE_GET_TDO:
-                usbblaster_get_tdo_schedule (cable);
-                break;
-
-            case URJ_TAP_CABLE_TRANSFER:
-                usbblaster_transfer_schedule (cable,
-                                              cable->todo.data[i].arg.
-                                              transfer.len,
-                                              cable->todo.data[i].arg.
-                                              transfer.in,
-                                              cable->todo.data[i].arg.
-                                              transfer.out);
-                break;
-
-            default:
-                break;
-            }
+        i++;
+        if (i >= cable->todo.max_items)
+            i = 0;
+    }
 
-            i++;
-            if (i >= cable->todo.max_items)
-                i = 0;
-        }
+    if (r == URJ_STATUS_OK)
+        r = usbblaster_run (cable, how_much);
+    else
+        urj_tap_cable_cx_cmd_deinit (&params->cmd_root);
 
-        urj_tap_cable_cx_xfer (&params->cmd_root, NULL, cable, how_much);
+    for (j = cable->todo.next_item, k = 0, n = cable->todo.num_items;
+         k < n; k++)
+    {
+        urj_cable_queue_t *item = &cable->todo.data[j];
 
-        while (j != i)
+        switch (item->action)
         {
-            switch (cable->todo.data[j].action)
+        case URJ_TAP_CABLE_GET_TDO:
+            m = urj_tap_cable_add_queue_item (cable, &cable->done);
+            if (m < 0)
+                break;
+            cable->done.data[m].action = URJ_TAP_CABLE_GET_TDO;
+            cable->done.data[m].arg.value.val =
+                r == URJ_STATUS_OK ? params->result[params->item_slot[k]]
+                : -1;
+            break;
+
+        case URJ_TAP_CABLE_GET_SIGNAL:
+            m = urj_tap_cable_add_queue_item (cable, &cable->done);
+            if (m < 0)
+                break;
+            cable->done.data[m].action = URJ_TAP_CABLE_GET_SIGNAL;
+            cable->done.data[m].arg.value.sig = item->arg.value.sig;
+            if (item->arg.value.sig == URJ_POD_CS_TRST)
+                cable->done.data[m].arg.value.val = 1;
+            else
+                cable->done.data[m].arg.value.val = -1; // not supported yet
+            break;
+
+        case URJ_TAP_CABLE_TRANSFER:
+            free (item->arg.transfer.in);
+            if (item->arg.transfer.out == NULL)
+                break;
+            if (r == URJ_STATUS_OK)
+                memcpy (item->arg.transfer.out,
+                        params->result + params->item_slot[k],
+                        item->arg.transfer.len);
+            m = urj_tap_cable_add_queue_item (cable, &cable->done);
+            if (m < 0)
             {
-            case URJ_TAP_CABLE_GET_TDO:
-                {
-                    int m;
-                    m = urj_tap_cable_add_queue_item (cable, &cable->done);
-                    cable->done.data[m].action = URJ_TAP_CABLE_GET_TDO;
-                    cable->done.data[m].arg.value.val =
-                        usbblaster_get_tdo_finish (cable);
-                    break;
-                }
-            case URJ_TAP_CABLE_GET_SIGNAL:
-                {
-                    int m =
-                        urj_tap_cable_add_queue_item (cable, &cable->done);
-                    cable->done.data[m].action = URJ_TAP_CABLE_GET_SIGNAL;
-                    cable->done.data[m].arg.value.sig =
-                        cable->todo.data[j].arg.value.sig;
-                    if (cable->todo.data[j].arg.value.sig == URJ_POD_CS_TRST)
-                        cable->done.data[m].arg.value.val = 1;
-                    else
-                        cable->done.data[m].arg.value.val = -1; // not supported yet
-                    break;
-                }
-            case URJ_TAP_CABLE_TRANSFER:
-                {
-                    int r = usbblaster_transfer_finish (cable,
-                                                        cable->todo.data[j].
-                                                        arg.transfer.len,
-                                                        cable->todo.data[j].
-                                                        arg.transfer.out);
-                    free (cable->todo.data[j].arg.transfer.in);
-                    if (cable->todo.data[j].arg.transfer.out)
-                    {
-                        int m = urj_tap_cable_add_queue_item (cable,
-                                                              &cable->done);
-                        if (m < 0)
-                        {
-                            // retain error state
-                            // urj_log (URJ_LOG_LEVEL_NORMAL, "out of memory!\n");
-                        }
-                        cable->done.data[m].action = URJ_TAP_CABLE_TRANSFER;
-                        cable->done.data[m].arg.xferred.len =
-                            cable->todo.data[j].arg.transfer.len;
-                        cable->done.data[m].arg.xferred.res = r;
-                        cable->done.data[m].arg.xferred.out =
-                            cable->todo.data[j].arg.transfer.out;
-                    }
-                }
-            default:
+                free (item->arg.transfer.out);
                 break;
             }
-
-            j++;
-            if (j >= cable->todo.max_items)
-                j = 0;
-            cable->todo.num_items--;
+            cable->done.data[m].action = URJ_TAP_CABLE_TRANSFER;
+            cable->done.data[m].arg.xferred.len = item->arg.transfer.len;
+            cable->done.data[m].arg.xferred.res = r == URJ_STATUS_OK ? 0 : -1;
+            cable->done.data[m].arg.xferred.out = item->arg.transfer.out;
+            break;
+
+        default:
+            break;
         }
 
-        cable->todo.next_item = i;
+        j++;
+        if (j >= cable->todo.max_items)
+            j = 0;
+        cable->todo.num_items--;
     }
+
+    cable->todo.next_item = j;
 }
 
 const urj_cable_driver_t urj_tap_cable_usbblaster_driver = {
@@ -42,14 +42,28 @@
 
 // #define VERBOSE 1
 #undef VERBOSE
+/* 16-bit words. More than 4 currently leads to bit errors; 13 to serious problems */
+#define XPC_A6_CHUNKSIZE 4
+#define XPC_A6_MAXCHUNK  16383          /* the bit count is a 16-bit value */
+
+/* one clock of an A6 stream */
+#define XPC_BIT_TDI     0x01
+#define XPC_BIT_TMS     0x02
+#define XPC_BIT_READ    0x04
+
 typedef struct
 {
+    int signals;                /* for urj_tap_cable_generic_get_signal() */
     int last_tdo;
+    int chunk;                  /* 16-bit words per A6 request */
+    uint8_t *bits;              /* the clocks of one flush, XPC_BIT_* */
+    char *tdo;                  /* TDO of the clocks with XPC_BIT_READ */
+    int num_bits;
+    int max_bits;
+    uint8_t *buf;               /* one A6 request, chunk words */
 }
 xpc_cable_params_t;
 
-static int last_tdo;
-
 /* Connectivity on Spartan-3E starter kit:
  *
  * = FX2 Port A =
@@ -376,26 +390,14 @@ xpc_ext_init (urj_cable_t *cable)
     uint8_t zero[2] = { 0, 0 };
     int r;
 
-    free (cable->params);
-    cable->params = NULL;
-
     r = xpcu_common_init (cable);
 
     if (r == URJ_STATUS_FAIL)
         return r;
 
-    cable->params = malloc (sizeof (xpc_cable_params_t));
-    if (cable->params == NULL)
-    {
-        urj_error_set (URJ_ERROR_OUT_OF_MEMORY, "malloc(%zd) fails",
-                       sizeof (xpc_cable_params_t));
-        r = URJ_STATUS_FAIL;
-    }
-
     xpcu = ((urj_usbconn_libusb_param_t *) (cable->link.usb->params))->handle;
 
-    if (r == URJ_STATUS_OK)
-        r = xpcu_output_enable (xpcu, 0);
+    r = xpcu_output_enable (xpcu, 0);
     if (r == URJ_STATUS_OK)
         r = xpcu_request_28 (xpcu, 0x11);
     if (r == URJ_STATUS_OK)
@@ -407,14 +409,52 @@ xpc_ext_init (urj_cable_t *cable)
         r = xpcu_request_28 (xpcu, 0x12);
 
     if (r != URJ_STATUS_OK)
-    {
         libusb_close (xpcu);
 
+    return r;
+}
+
+static int
+xpc_ext_connect (urj_cable_t *cable, const urj_param_t *params[])
+{
+    xpc_cable_params_t *cable_params;
+    int chunk = XPC_A6_CHUNKSIZE;
+    int i;
+
+    if (params != NULL)
+        for (i = 0; params[i] != NULL; i++)
+            if (params[i]->key == URJ_CABLE_PARAM_KEY_CHUNK)
+                chunk = params[i]->value.lu;
+    if (chunk < 1 || chunk > XPC_A6_MAXCHUNK)
+    {
+        urj_error_set (URJ_ERROR_INVALID, _("chunk must be 1..%d words"),
+                       XPC_A6_MAXCHUNK);
+        return URJ_STATUS_FAIL;
+    }
+
+    if (urj_tap_cable_generic_usbconn_connect (cable, params) != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+
+    /* replaces the generic parameters, signals stays first */
+    cable_params = calloc (1, sizeof *cable_params);
+    if (cable_params != NULL)
+        cable_params->buf = malloc (2 * chunk);
+    if (cable_params == NULL || cable_params->buf == NULL)
+    {
+        free (cable_params);
+        urj_error_set (URJ_ERROR_OUT_OF_MEMORY, "malloc(%d) fails",
+                       2 * chunk);
+        cable->link.usb->driver->free (cable->link.usb);
         free (cable->params);
         cable->params = NULL;
+        return URJ_STATUS_FAIL;
     }
+    cable_params->chunk = chunk;
 
-    return r;
+    free (cable->params);
+    cable->params = cable_params;
+
+    return URJ_STATUS_OK;
 }
 
 /* ---------------------------------------------------------------------- */
@@ -422,10 +462,13 @@ xpc_ext_init (urj_cable_t *cable)
 static void
 xpc_ext_free (urj_cable_t *cable)
 {
-    if (cable->params)
+    xpc_cable_params_t *params = cable->params;
+
+    if (params)
     {
-        free (cable->params);
-        cable->params = NULL;
+        free (params->bits);
+        free (params->tdo);
+        free (params->buf);
     }
     urj_tap_cable_generic_usbconn_free (cable);
 }
@@ -485,149 +528,150 @@ xpc_set_signal (urj_cable_t *cable, int mask, int val)
 
 /* ---------------------------------------------------------------------- */
 
-static void
-xpc_ext_clock (urj_cable_t *cable, int tms, int tdi, int n)
-{
-    int i;
-    uint8_t tdo[2];
-    uint8_t clock[2];
-    struct libusb_device_handle *xpcu;
-
-    clock[0] = (tms ? 0x10 : 0) | (tdi ? 0x01 : 0);
-    clock[1] = 0x11;            /* clock'n read */
-
-    xpcu = ((urj_usbconn_libusb_param_t *) (cable->link.usb->params))->handle;
-
-    for (i = 0; i < n; i++)
-        xpcu_shift (xpcu, 0xA6, 1, 2, clock, 2, tdo);
-
-    last_tdo = tdo[1] ? 1 : 0;
-    // ((xpc_cable_params_t*)(cable->params))->last_tdo = tdo[1] ? 1:0;
-}
-
-/* ---------------------------------------------------------------------- */
+/* An A6 stream holds the clocks of a whole flush, one byte per clock.  It
+ * goes out in requests of at most 'chunk' words; each costs a vendor request,
+ * a bulk write and, if it reads TDO, a bulk read. */
 
+/** @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error */
 static int
-xpc_ext_get_tdo (urj_cable_t *cable)
+xpc_ext_add (urj_cable_t *cable, int tms, int tdi, int read)
 {
-    return last_tdo;
-    // return ((xpc_cable_params_t*)(cable->params))->last_tdo;
-}
+    xpc_cable_params_t *params = cable->params;
 
-/* ---------------------------------------------------------------------- */
+    if (params->num_bits == params->max_bits)
+    {
+        int max = params->max_bits ? 2 * params->max_bits : 1024;
+        uint8_t *bits = realloc (params->bits, max);
+        char *tdo;
 
-/* 16-bit words. More than 4 currently leads to bit errors; 13 to serious problems */
-#define XPC_A6_CHUNKSIZE 4
+        if (bits == NULL)
+        {
+            urj_error_set (URJ_ERROR_OUT_OF_MEMORY, "realloc(%d) fails", max);
+            return URJ_STATUS_FAIL;
+        }
+        params->bits = bits;
+        tdo = realloc (params->tdo, max);
+        if (tdo == NULL)
+        {
+            urj_error_set (URJ_ERROR_OUT_OF_MEMORY, "realloc(%d) fails", max);
+            return URJ_STATUS_FAIL;
+        }
+        params->tdo = tdo;
+        params->max_bits = max;
+    }
 
-typedef struct
-{
-    urj_cable_t *cable;
-    struct libusb_device_handle *xpcu;
-    int in_bits;
-    int out_bits;
-    int out_done;
-    uint8_t *out;
-    uint8_t buf[XPC_A6_CHUNKSIZE * 2];
-}
-xpc_ext_transfer_state_t;
+    params->bits[params->num_bits++] = (tms ? XPC_BIT_TMS : 0)
+        | (tdi ? XPC_BIT_TDI : 0) | (read ? XPC_BIT_READ : 0);
 
-/* ---------------------------------------------------------------------- */
+    return URJ_STATUS_OK;
+}
 
-/** @return 0 on success; -1 on error */
+/** @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error */
 static int
-xpcu_do_ext_transfer (xpc_ext_transfer_state_t *xts)
+xpc_ext_request (urj_cable_t *cable, int first, int n)
 {
-    int r;
-    int in_len, out_len;
-    // int last_tdo;
+    xpc_cable_params_t *params = cable->params;
+    struct libusb_device_handle *xpcu;
+    const uint8_t *bits = params->bits + first;
+    int count = n, reads = 0, words, i, r;
 
-    in_len = 2 * (xts->in_bits >> 2);
-    if ((xts->in_bits & 3) != 0)
-        in_len += 2;
+    xpcu = ((urj_usbconn_libusb_param_t *) (cable->link.usb->params))->handle;
 
-    out_len = 2 * (xts->out_bits >> 4);
-    if ((xts->out_bits & 15) != 0)
-        out_len += 2;
+    /* CPLD doesn't like multiples of 4; add one dummy bit without TCK */
+    if ((count & 3) == 0)
+        count++;
+    words = (count + 3) / 4;
 
-    if (xts->out != NULL)
-    {
-        r = xpcu_shift (xts->xpcu, 0xA6, xts->in_bits, in_len, xts->buf,
-                        out_len, xts->buf);
-    }
-    else
+    memset (params->buf, 0, 2 * words);
+    for (i = 0; i < n; i++)
     {
-        r = xpcu_shift (xts->xpcu, 0xA6, xts->in_bits, in_len, xts->buf, 0,
-                        NULL);
+        uint8_t *w = params->buf + 2 * (i >> 2);
+        int b = i & 3;
+
+        if (bits[i] & XPC_BIT_TDI)
+            w[0] |= 0x01 << b;
+        if (bits[i] & XPC_BIT_TMS)
+            w[0] |= 0x10 << b;
+        w[1] |= 0x01 << b;
+        if (bits[i] & XPC_BIT_READ)
+        {
+            w[1] |= 0x10 << b;
+            reads++;
+        }
     }
 
-    if (r != -1 && xts->out_bits > 0)
-    {
-        int out_idx = 0;
-        int out_rem = xts->out_bits;
+    r = xpcu_shift (xpcu, 0xA6, count, 2 * words, params->buf,
+                    2 * ((reads + 15) / 16), reads ? params->buf : NULL);
+    cable->stats.round_trips += reads ? 2 : 1;
+    cable->stats.bytes_out += 2 * words;
+    cable->stats.bytes_in += 2 * ((reads + 15) / 16);
+    if (r == -1)
+        return URJ_STATUS_FAIL;
 
-        while (out_rem > 0)
+    /* TDO is shifted in from the MSB; only the last word can be partial */
+    for (i = 0, r = 0; i < n; i++)
+        if (bits[i] & XPC_BIT_READ)
         {
-            uint32_t mask, rxw;
-
-            rxw = (xts->buf[out_idx + 1] << 8) | xts->buf[out_idx];
+            int word = r >> 4;
+            int left = reads - (word << 4);
+            int bit = (left >= 16 ? 0 : 16 - left) + (r & 15);
+            uint16_t rxw = (params->buf[2 * word + 1] << 8)
+                | params->buf[2 * word];
+
+            params->tdo[first + i] = (rxw >> bit) & 1;
+            r++;
+        }
 
-            /* In the last (incomplete) word, the data isn't shifted completely to LSB */
+    return URJ_STATUS_OK;
+}
 
-            mask = (out_rem >= 16) ? 1 : (1 << (16 - out_rem));
+/* Send the stream; the TDO of its last clock is what get_tdo() returns */
+/** @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error */
+static int
+xpc_ext_run (urj_cable_t *cable)
+{
+    xpc_cable_params_t *params = cable->params;
+    int max = 4 * params->chunk - 1;
+    int first, n;
 
-            while (mask <= 32768 && out_rem > 0)
-            {
-                last_tdo = (rxw & mask) ? 1 : 0;
-                xts->out[xts->out_done] = last_tdo;
-                xts->out_done++;
-                mask <<= 1;
-                out_rem--;
-            }
+    if (params->num_bits == 0)
+        return URJ_STATUS_OK;
 
-            out_idx += 2;
-        }
+    params->bits[params->num_bits - 1] |= XPC_BIT_READ;
+    for (first = 0; first < params->num_bits; first += n)
+    {
+        n = params->num_bits - first;
+        if (n > max)
+            n = max;
+        if (xpc_ext_request (cable, first, n) != URJ_STATUS_OK)
+            return URJ_STATUS_FAIL;
     }
+    params->last_tdo = params->tdo[params->num_bits - 1];
 
-    xts->in_bits = 0;
-    xts->out_bits = 0;
-
-    // ((xpc_cable_params_t*)(xts->cable->params))->last_tdo = last_tdo;
-
-    return r;
+    return URJ_STATUS_OK;
 }
 
 /* ---------------------------------------------------------------------- */
 
 static void
-xpcu_add_bit_for_ext_transfer (xpc_ext_transfer_state_t *xts, char in,
-                               char is_real)
+xpc_ext_clock (urj_cable_t *cable, int tms, int tdi, int n)
 {
-    int bit_idx = (xts->in_bits & 3);
-    int buf_idx = (xts->in_bits - bit_idx) >> 1;
-
-    if (bit_idx == 0)
-    {
-        xts->buf[buf_idx] = 0;
-        xts->buf[buf_idx + 1] = 0;
-    }
+    xpc_cable_params_t *params = cable->params;
+    int i;
 
-    xts->in_bits++;
+    params->num_bits = 0;
+    for (i = 0; i < n; i++)
+        if (xpc_ext_add (cable, tms, tdi, 0) != URJ_STATUS_OK)
+            return;
+    xpc_ext_run (cable);
+}
 
-    if (is_real)
-    {
-        if (in)
-            xts->buf[buf_idx] |= (0x01 << bit_idx);
+/* ---------------------------------------------------------------------- */
 
-        if (xts->out)
-        {
-            xts->buf[buf_idx + 1] |= (0x11 << bit_idx);
-            xts->out_bits++;
-        }
-        else
-        {
-            xts->buf[buf_idx + 1] |= (0x01 << bit_idx);
-        }
-    }
+static int
+xpc_ext_get_tdo (urj_cable_t *cable)
+{
+    return ((xpc_cable_params_t *) cable->params)->last_tdo;
 }
 
 /* ---------------------------------------------------------------------- */
@@ -640,8 +684,8 @@ xpcu_add_bit_for_ext_transfer (xpc_ext_transfer_state_t *xts, char in,
 static int
 xpc_ext_transfer (urj_cable_t *cable, int len, const char *in, char *out)
 {
-    int i, j;
-    xpc_ext_transfer_state_t xts;
+    xpc_cable_params_t *params = cable->params;
+    int i;
 
 #if VERBOSE
     urj_log (URJ_LOG_LEVEL_DETAIL, "---\n");
@@ -653,38 +697,147 @@ xpc_ext_transfer (urj_cable_t *cable, int len, const char *in, char *out)
     urj_log (URJ_LOG_LEVEL_DETAIL, "\n");
 #endif
 
-    xts.xpcu =
-        ((urj_usbconn_libusb_param_t *) (cable->link.usb->params))->handle;
-    xts.out = (uint8_t *) out;
-    xts.in_bits = 0;
-    xts.out_bits = 0;
-    xts.out_done = 0;
-    xts.cable = cable;
+    params->num_bits = 0;
+    for (i = 0; i < len; i++)
+        if (xpc_ext_add (cable, 0, in[i], out != NULL) != URJ_STATUS_OK)
+            return -1;
+    if (xpc_ext_run (cable) != URJ_STATUS_OK)
+        return -1;
+    if (out != NULL)
+        memcpy (out, params->tdo, len);
+
+    return 0;
+}
+
+/* ---------------------------------------------------------------------- */
+
+/* Everything queued goes out as one A6 stream: TMS moves, idle clocks,
+ * get_tdo and the transfers of several scans share the same requests. */
+static void
+xpc_ext_flush (urj_cable_t *cable, urj_cable_flush_amount_t how_much)
+{
+    xpc_cable_params_t *params = cable->params;
+    int i, j, n, k, pos, r, last_tdo;
+
+    if (how_much == URJ_TAP_CABLE_OPTIONALLY || cable->todo.num_items == 0)
+        return;
 
-    for (i = 0, j = 0; i < len && j >= 0; i++)
+    params->num_bits = 0;
+    r = URJ_STATUS_OK;
+    for (i = cable->todo.next_item, n = 0; n < cable->todo.num_items; n++)
     {
-        xpcu_add_bit_for_ext_transfer (&xts, in[i], 1);
-        if (xts.in_bits == (4 * XPC_A6_CHUNKSIZE - 1))
+        urj_cable_queue_t *item = &cable->todo.data[i];
+
+        switch (item->action)
         {
-            j = xpcu_do_ext_transfer (&xts);
+        case URJ_TAP_CABLE_CLOCK:
+            for (k = 0; k < item->arg.clock.n && r == URJ_STATUS_OK; k++)
+                r = xpc_ext_add (cable, item->arg.clock.tms,
+                                 item->arg.clock.tdi, 0);
+            break;
+        case URJ_TAP_CABLE_CLOCK_TMS:
+            for (k = 0; k < item->arg.clock.n && r == URJ_STATUS_OK; k++)
+                r = xpc_ext_add (cable, (item->arg.clock.tms >> k) & 1,
+                                 item->arg.clock.tdi, 0);
+            break;
+        case URJ_TAP_CABLE_GET_TDO:
+            /* the TDO read with the clock before */
+            if (params->num_bits > 0 && r == URJ_STATUS_OK)
+                params->bits[params->num_bits - 1] |= XPC_BIT_READ;
+            break;
+        case URJ_TAP_CABLE_TRANSFER:
+            for (k = 0; k < item->arg.transfer.len && r == URJ_STATUS_OK; k++)
+                r = xpc_ext_add (cable, 0, item->arg.transfer.in[k],
+                                 item->arg.transfer.out != NULL);
+            break;
+        default:
+            break;
         }
+
+        i++;
+        if (i >= cable->todo.max_items)
+            i = 0;
     }
 
-    if (xts.in_bits > 0 && j >= 0)
+    last_tdo = params->last_tdo;
+    if (r == URJ_STATUS_OK)
+        r = xpc_ext_run (cable);
+    else
+        params->num_bits = 0;
+
+    for (j = cable->todo.next_item, pos = 0, k = 0; k < n; k++)
     {
-        /* CPLD doesn't like multiples of 4; add one dummy bit */
-        if ((xts.in_bits & 3) == 0)
+        urj_cable_queue_t *item = &cable->todo.data[j];
+        int m;
+
+        switch (item->action)
         {
-            xpcu_add_bit_for_ext_transfer (&xts, 0, 0);
+        case URJ_TAP_CABLE_CLOCK:
+        case URJ_TAP_CABLE_CLOCK_TMS:
+            pos += item->arg.clock.n;
+            break;
+        case URJ_TAP_CABLE_GET_TDO:
+            m = urj_tap_cable_add_queue_item (cable, &cable->done);
+            if (m < 0)
+                break;
+            cable->done.data[m].action = URJ_TAP_CABLE_GET_TDO;
+            cable->done.data[m].arg.value.val =
+                r != URJ_STATUS_OK ? -1
+                : pos > 0 && pos <= params->num_bits ? params->tdo[pos - 1]
+                : last_tdo;
+            break;
+        case URJ_TAP_CABLE_GET_SIGNAL:
+            m = urj_tap_cable_add_queue_item (cable, &cable->done);
+            if (m < 0)
+                break;
+            cable->done.data[m].action = URJ_TAP_CABLE_GET_SIGNAL;
+            cable->done.data[m].arg.value.sig = item->arg.value.sig;
+            cable->done.data[m].arg.value.val =
+                urj_tap_cable_generic_get_signal (cable, item->arg.value.sig);
+            break;
+        case URJ_TAP_CABLE_TRANSFER:
+            free (item->arg.transfer.in);
+            if (item->arg.transfer.out != NULL)
+            {
+                if (r == URJ_STATUS_OK)
+                    memcpy (item->arg.transfer.out, params->tdo + pos,
+                            item->arg.transfer.len);
+                m = urj_tap_cable_add_queue_item (cable, &cable->done);
+                if (m >= 0)
+                {
+                    cable->done.data[m].action = URJ_TAP_CABLE_TRANSFER;
+                    cable->done.data[m].arg.xferred.len =
+                        item->arg.transfer.len;
+                    cable->done.data[m].arg.xferred.res =
+                        r == URJ_STATUS_OK ? 0 : -1;
+                    cable->done.data[m].arg.xferred.out =
+                        item->arg.transfer.out;
+                }
+            }
+            pos += item->arg.transfer.len;
+            break;
+        default:
+            break;
         }
-        j = xpcu_do_ext_transfer (&xts);
-    }
 
-    return j;
+        j++;
+        if (j >= cable->todo.max_items)
+            j = 0;
+        cable->todo.num_items--;
+    }
+    cable->todo.next_item = i;
 }
 
 /* ---------------------------------------------------------------------- */
 
+static void
+xpc_ext_help (urj_log_level_t ll, const char *cablename)
+{
+    const char *ex_short = "[chunk=WORDS]";
+    const char *ex_desc = "WORDS      16-bit words per A6 request, default 4; larger\n"
+"           values save USB round trips if the firmware copes\n";
+    urj_tap_cable_generic_usbconn_help_ex (ll, cablename, ex_short, ex_desc);
+}
 
 const urj_cable_driver_t urj_tap_cable_xpc_int_driver = {
     "xpc_int",
@@ -710,7 +863,7 @@ const urj_cable_driver_t urj_tap_cable_xpc_ext_driver = {
     "xpc_ext",
     N_("Xilinx Platform Cable USB external chain"),
     URJ_CABLE_DEVICE_USB,
-    { .usb = urj_tap_cable_generic_usbconn_connect, },
+    { .usb = xpc_ext_connect, },
     urj_tap_cable_generic_disconnect,
     xpc_ext_free,
     xpc_ext_init,
@@ -721,7 +874,7 @@ const urj_cable_driver_t urj_tap_cable_xpc_ext_driver = {
     xpc_ext_transfer,
     xpc_set_signal,
     urj_tap_cable_generic_get_signal,
-    urj_tap_cable_generic_flush_using_transfer,
-    urj_tap_cable_generic_usbconn_help
+    xpc_ext_flush,
+    xpc_ext_help
 };
 URJ_DECLARE_USBCONN_CABLE(0x03FD, 0x0008, "libusb", "xpc_ext", xpc_ext)
@@ -24,17 +24,22 @@
 
 #include <sysdep.h>
 
+#include <limits.h>
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <urjtag/cable.h>
 #include <urjtag/part.h>
 #include <urjtag/part_instruction.h>
 #include <urjtag/tap_state.h>
 #include <urjtag/tap.h>
+#include <urjtag/tap_register.h>
 #include <urjtag/data_register.h>
 #include <urjtag/cmd.h>
 #include <urjtag/bsdl.h>
+#include <urjtag/fclock.h>
 
 #include <urjtag/chain.h>
 
@@ -53,6 +58,8 @@ urj_tap_chain_alloc (void)
     chain->parts = NULL;
     chain->total_instr_len = 0;
     chain->active_part = 0;
+    chain->scan_in = NULL;
+    chain->scan_queue = NULL;
     URJ_BSDL_GLOBS_INIT (chain->bsdl);
     urj_tap_state_init (chain);
 
@@ -68,6 +75,7 @@ urj_tap_chain_free (urj_chain_t *chain)
     urj_tap_chain_disconnect (chain);
 
     urj_part_parts_free (chain->parts);
+    urj_tap_register_free (chain->scan_in);
     free (chain);
 }
 
@@ -155,9 +163,32 @@ urj_tap_chain_connect (urj_chain_t *chain, const char *drivername, char *params[
     return URJ_STATUS_OK;
 }
 
+/* A scan of several parts whose captured bits are still in the cable queue */
+struct URJ_CHAIN_SCAN
+{
+    urj_tap_register_t *out;
+    struct URJ_CHAIN_SCAN *next;
+};
+
+/* Forget the captures queued by chain_defer_scan(), e.g. with the cable */
+static void
+chain_drop_scans (urj_chain_t *chain)
+{
+    struct URJ_CHAIN_SCAN *scan;
+
+    while ((scan = chain->scan_queue) != NULL)
+    {
+        chain->scan_queue = scan->next;
+        urj_tap_register_free (scan->out);
+        free (scan);
+    }
+}
+
 void
 urj_tap_chain_disconnect (urj_chain_t *chain)
 {
+    chain_drop_scans (chain);
+
     if (!chain->cable)
         return;
 
@@ -180,8 +211,14 @@ urj_tap_chain_clock (urj_chain_t *chain, int tms, int tdi, int n)
 
     urj_tap_cable_clock (chain->cable, tms, tdi, n);
 
+    /* n may be a long RUNTEST: stop once the state stays put */
     for (i = 0; i < n; i++)
-        urj_tap_state_clock (chain, tms);
+    {
+        int state = urj_tap_state (chain);
+
+        if (urj_tap_state_clock (chain, tms) == state)
+            break;
+    }
 
     return URJ_STATUS_OK;
 }
@@ -199,8 +236,81 @@ urj_tap_chain_defer_clock (urj_chain_t *chain, int tms, int tdi, int n)
 
     urj_tap_cable_defer_clock (chain->cable, tms, tdi, n);
 
+    /* n may be a long RUNTEST: stop once the state stays put */
     for (i = 0; i < n; i++)
-        urj_tap_state_clock (chain, tms);
+    {
+        int state = urj_tap_state (chain);
+
+        if (urj_tap_state_clock (chain, tms) == state)
+            break;
+    }
+
+    return URJ_STATUS_OK;
+}
+
+int
+urj_tap_chain_defer_wait (urj_chain_t *chain, uint32_t frequency,
+                          unsigned long long clocks, double secs)
+{
+    long double end, now;
+    int n;
+
+    if (!chain || !chain->cable)
+    {
+        urj_error_set (URJ_ERROR_NO_CHAIN, "no chain or no part");
+        return URJ_STATUS_FAIL;
+    }
+
+    if (frequency > 0 && secs > 0.0 && ceil (secs * frequency) > clocks)
+        clocks = ceil (secs * frequency);
+
+    /* hours at a fast TCK do not fit in one cable clock item */
+    while (clocks > 0)
+    {
+        n = clocks > INT_MAX ? INT_MAX : clocks;
+        urj_tap_chain_defer_clock (chain, 0, 0, n);
+        clocks -= n;
+    }
+
+    if (frequency > 0 || secs <= 0.0)
+        return URJ_STATUS_OK;
+
+    urj_tap_cable_flush (chain->cable, URJ_TAP_CABLE_COMPLETELY);
+    end = urj_lib_frealtime () + secs;
+    /* usleep() need not take more than a second at a time */
+    while ((now = urj_lib_frealtime ()) < end)
+        usleep (end - now > 0.5 ? 500000 : (end - now) * 1E6 + 1);
+
+    return URJ_STATUS_OK;
+}
+
+int
+urj_tap_chain_defer_goto_state (urj_chain_t *chain, int state)
+{
+    uint32_t tms;
+    int i, n;
+
+    if (!chain || !chain->cable)
+    {
+        urj_error_set (URJ_ERROR_NO_CHAIN, "no chain or no part");
+        return URJ_STATUS_FAIL;
+    }
+
+    n = urj_tap_state_path (urj_tap_state (chain), state, &tms);
+    if (n < 0)
+    {
+        urj_error_set (URJ_ERROR_INVALID, "invalid TAP state 0x%02x", state);
+        return URJ_STATUS_FAIL;
+    }
+    if (n == 0)
+        return URJ_STATUS_OK;
+
+    if (urj_tap_cable_defer_clock_tms (chain->cable, tms, 0, n)
+        != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+
+    for (i = 0; i < n; i++)
+        urj_tap_state_clock (chain, (tms >> i) & 1);
 
     return URJ_STATUS_OK;
 }
@@ -242,6 +352,179 @@ urj_tap_chain_get_pod_signal (urj_chain_t *chain, urj_pod_sigsel_t sig)
     return urj_tap_cable_get_signal (chain->cable, sig);
 }
 
+/*
+ * Scans of a chain with several parts go out as one vector: the parts'
+ * registers are gathered into chain->scan_in, so the cable gets a single
+ * transfer instead of one per part.  The cable copies the vector when the
+ * scan is queued, so chain->scan_in is reused by the next scan and only
+ * reallocated when the path length changes.  Each capturing scan gets a
+ * vector of its own length for the result, queued on chain->scan_queue
+ * until it is picked up and scattered back into the parts.  Parts in
+ * BYPASS are gathered like any other part: their register is a single bit
+ * (or the all-ones instruction), which is not worth caching apart from the
+ * registers it is copied from.
+ */
+static urj_tap_register_t *
+chain_part_register (urj_part_t *part, int ir, int out)
+{
+    if (ir)
+        return out ? part->active_instruction->out
+            : part->active_instruction->value;
+
+    return out ? part->active_instruction->data_register->out
+        : part->active_instruction->data_register->in;
+}
+
+static int
+chain_scan_len (urj_chain_t *chain, int ir)
+{
+    urj_parts_t *ps = chain->parts;
+    int i, len = 0;
+
+    for (i = 0; i < ps->len; i++)
+        len += chain_part_register (ps->parts[i], ir, 0)->len;
+
+    return len;
+}
+
+/** @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error */
+static int
+chain_gather (urj_chain_t *chain, int ir)
+{
+    urj_parts_t *ps = chain->parts;
+    urj_tap_register_t *r;
+    int i, pos, len = chain_scan_len (chain, ir);
+
+    if (chain->scan_in == NULL || chain->scan_in->len != len)
+    {
+        urj_tap_register_free (chain->scan_in);
+        chain->scan_in = urj_tap_register_alloc (len);
+        if (chain->scan_in == NULL)
+            return URJ_STATUS_FAIL;
+    }
+
+    for (i = 0, pos = 0; i < ps->len; i++)
+    {
+        r = chain_part_register (ps->parts[i], ir, 0);
+        memcpy (chain->scan_in->data + pos, r->data, r->len);
+        pos += r->len;
+    }
+
+    return URJ_STATUS_OK;
+}
+
+/* Copy a captured vector into the parts' current output registers */
+static void
+chain_scatter (urj_chain_t *chain, int ir, const urj_tap_register_t *out)
+{
+    urj_parts_t *ps = chain->parts;
+    urj_tap_register_t *r;
+    int i, pos, len;
+
+    for (i = 0, pos = 0; i < ps->len && pos < out->len; i++)
+    {
+        len = chain_part_register (ps->parts[i], ir, 0)->len;
+        if (len > out->len - pos)
+            len = out->len - pos;
+        r = chain_part_register (ps->parts[i], ir, 1);
+        memcpy (r->data, out->data + pos, r->len < len ? r->len : len);
+        pos += len;
+    }
+}
+
+/* Append a capture of len bits to the chain; @return its vector or NULL */
+static urj_tap_register_t *
+chain_queue_scan (urj_chain_t *chain, int len)
+{
+    struct URJ_CHAIN_SCAN *scan, **last;
+
+    scan = malloc (sizeof *scan);
+    if (scan == NULL)
+    {
+        urj_error_set (URJ_ERROR_OUT_OF_MEMORY, "malloc(%zd) fails",
+                       sizeof *scan);
+        return NULL;
+    }
+
+    scan->out = urj_tap_register_alloc (len);
+    if (scan->out == NULL)
+    {
+        free (scan);
+        return NULL;
+    }
+    scan->next = NULL;
+
+    for (last = &chain->scan_queue; *last != NULL; last = &(*last)->next)
+        ;
+    *last = scan;
+
+    return scan->out;
+}
+
+/* Queue the scan of all parts; single parts are shifted in place */
+static int
+chain_defer_scan (urj_chain_t *chain, int ir, int capture_output,
+                  int chain_exit)
+{
+    urj_parts_t *ps = chain->parts;
+    urj_tap_register_t *out = NULL;
+
+    if (ps->len == 1)
+    {
+        urj_tap_defer_shift_register (chain,
+                chain_part_register (ps->parts[0], ir, 0),
+                capture_output ? chain_part_register (ps->parts[0], ir, 1)
+                    : NULL,
+                chain_exit);
+        return URJ_STATUS_OK;
+    }
+
+    if (chain_gather (chain, ir) != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+
+    if (capture_output)
+    {
+        out = chain_queue_scan (chain, chain->scan_in->len);
+        if (out == NULL)
+            return URJ_STATUS_FAIL;
+    }
+
+    urj_tap_defer_shift_register (chain, chain->scan_in, out, chain_exit);
+    return URJ_STATUS_OK;
+}
+
+/* Pick up the result of a scan queued by chain_defer_scan() */
+static void
+chain_scan_output (urj_chain_t *chain, int ir, int chain_exit)
+{
+    urj_parts_t *ps = chain->parts;
+    struct URJ_CHAIN_SCAN *scan;
+
+    if (ps->len == 1)
+    {
+        urj_tap_shift_register_output (chain,
+                chain_part_register (ps->parts[0], ir, 0),
+                chain_part_register (ps->parts[0], ir, 1),
+                chain_exit);
+        return;
+    }
+
+    scan = chain->scan_queue;
+    if (scan == NULL)
+    {
+        urj_warning (_("%s: no captured scan queued\n"), __func__);
+        return;
+    }
+    chain->scan_queue = scan->next;
+
+    /* the scan's own vector has the length it was queued with */
+    urj_tap_shift_register_output (chain, scan->out, scan->out, chain_exit);
+    chain_scatter (chain, ir, scan->out);
+
+    urj_tap_register_free (scan->out);
+    free (scan);
+}
+
 int
 urj_tap_chain_shift_instructions_mode (urj_chain_t *chain,
                                        int capture_output, int capture,
@@ -271,29 +554,13 @@ urj_tap_chain_shift_instructions_mode (urj_chain_t *chain,
     if (capture)
         urj_tap_capture_ir (chain);
 
-    /* new implementation: split into defer + retrieve part
-       shift the data register of each part in the chain one by one */
-
-    for (i = 0; i < ps->len; i++)
-    {
-        urj_tap_defer_shift_register (chain,
-                ps->parts[i]->active_instruction->value,
-                capture_output ? ps->parts[i]->active_instruction->out
-                    : NULL,
-                (i + 1) == ps->len ? chain_exit : URJ_CHAIN_EXITMODE_SHIFT);
-    }
+    /* split into defer + retrieve part */
+    if (chain_defer_scan (chain, 1, capture_output, chain_exit)
+        != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
 
     if (capture_output)
-    {
-        for (i = 0; i < ps->len; i++)
-        {
-            urj_tap_shift_register_output (chain,
-                    ps->parts[i]->active_instruction->value,
-                    ps->parts[i]->active_instruction->out,
-                    (i + 1) == ps->len ? chain_exit
-                        : URJ_CHAIN_EXITMODE_SHIFT);
-        }
-    }
+        chain_scan_output (chain, 1, chain_exit);
     else
     {
         /* give the cable driver a chance to flush if it's considered useful */
@@ -311,9 +578,9 @@ urj_tap_chain_shift_instructions (urj_chain_t *chain)
 }
 
 int
-urj_tap_chain_shift_data_registers_mode (urj_chain_t *chain,
-                                         int capture_output, int capture,
-                                         int chain_exit)
+urj_tap_chain_defer_shift_data_registers_mode (urj_chain_t *chain,
+                                               int capture_output, int capture,
+                                               int chain_exit)
 {
     int i;
     urj_parts_t *ps;
@@ -345,29 +612,28 @@ urj_tap_chain_shift_data_registers_mode (urj_chain_t *chain,
     if (capture)
         urj_tap_capture_dr (chain);
 
-    /* new implementation: split into defer + retrieve part
-       shift the data register of each part in the chain one by one */
+    /* split into defer + retrieve part */
+    return chain_defer_scan (chain, 0, capture_output, chain_exit);
+}
 
-    for (i = 0; i < ps->len; i++)
-    {
-        urj_tap_defer_shift_register (chain,
-                ps->parts[i]->active_instruction->data_register->in,
-                capture_output ?
-                    ps->parts[i]->active_instruction->data_register->out
-                    : NULL,
-                (i + 1) == ps->len ? chain_exit : URJ_CHAIN_EXITMODE_SHIFT);
-    }
+void
+urj_tap_chain_shift_data_registers_output (urj_chain_t *chain, int chain_exit)
+{
+    chain_scan_output (chain, 0, chain_exit);
+}
+
+int
+urj_tap_chain_shift_data_registers_mode (urj_chain_t *chain,
+                                         int capture_output, int capture,
+                                         int chain_exit)
+{
+    if (urj_tap_chain_defer_shift_data_registers_mode (chain, capture_output,
+                                                       capture, chain_exit)
+        != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
 
     if (capture_output)
-    {
-        for (i = 0; i < ps->len; i++)
-        {
-            urj_tap_shift_register_output (chain,
-                    ps->parts[i]->active_instruction->data_register->in,
-                    ps->parts[i]->active_instruction->data_register->out,
-                    (i + 1) == ps->len ? chain_exit : URJ_CHAIN_EXITMODE_SHIFT);
-        }
-    }
+        urj_tap_chain_shift_data_registers_output (chain, chain_exit);
     else
     {
         /* give the cable driver a chance to flush if it's considered useful */
@@ -27,6 +27,7 @@
 #include <stddef.h>
 
 #include <urjtag/parport.h>
+#include <urjtag/cable.h>
 
 #include "parport.h"
 
@@ -52,24 +53,38 @@ urj_tap_parport_close (urj_parport_t *port)
 int
 urj_tap_parport_set_data (urj_parport_t *port, const unsigned char data)
 {
+    if (port->cable != NULL)
+        port->cable->stats.bytes_out++;
     return port->driver->set_data (port, data);
 }
 
 int
 urj_tap_parport_get_data (urj_parport_t *port)
 {
+    if (port->cable != NULL)
+    {
+        port->cable->stats.round_trips++;
+        port->cable->stats.bytes_in++;
+    }
     return port->driver->get_data (port);
 }
 
 int
 urj_tap_parport_get_status (urj_parport_t *port)
 {
+    if (port->cable != NULL)
+    {
+        port->cable->stats.round_trips++;
+        port->cable->stats.bytes_in++;
+    }
     return port->driver->get_status (port);
 }
 
 int
 urj_tap_parport_set_control (urj_parport_t *port, const unsigned char data)
 {
+    if (port->cable != NULL)
+        port->cable->stats.bytes_out++;
     return port->driver->set_control (port, data);
 }
 
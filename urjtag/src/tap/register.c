@@ -291,6 +291,52 @@ urj_tap_register_set_value (urj_tap_register_t *tr, uint64_t val)
     return urj_tap_register_set_value_bit_range (tr, val, tr->len - 1, 0);
 }
 
+int
+urj_tap_register_set_bytes_bit_range (urj_tap_register_t *tr,
+                                      const uint8_t *buf, size_t buflen,
+                                      int msb, int lsb)
+{
+    int bit, i;
+    int step = msb >= lsb ? 1 : -1;
+    size_t need = ((msb - lsb) * step + 8) / 8;
+
+    if (!tr)
+    {
+        urj_error_set (URJ_ERROR_INVALID, "tr == NULL");
+        return URJ_STATUS_FAIL;
+    }
+
+    if (msb > tr->len - 1 || lsb > tr->len - 1 || msb < 0 || lsb < 0)
+    {
+        urj_error_set (URJ_ERROR_OUT_OF_BOUNDS,
+                       _("register %d:%d will not fit in %d bits"),
+                       msb, lsb, tr->len);
+        return URJ_STATUS_FAIL;
+    }
+
+    if (buflen < need)
+    {
+        urj_error_set (URJ_ERROR_OUT_OF_BOUNDS,
+                       _("need %zd bytes for %d:%d, got %zd"),
+                       need, msb, lsb, buflen);
+        return URJ_STATUS_FAIL;
+    }
+
+    /* bit 0 of buf[0] goes to lsb */
+    for (i = 0, bit = lsb; bit * step <= msb * step; bit += step, i++)
+        tr->data[bit] = (buf[i >> 3] >> (i & 7)) & 1;
+
+    return URJ_STATUS_OK;
+}
+
+int
+urj_tap_register_set_bytes (urj_tap_register_t *tr, const uint8_t *buf,
+                            size_t buflen)
+{
+    return urj_tap_register_set_bytes_bit_range (tr, buf, buflen,
+                                                 tr->len - 1, 0);
+}
+
 const char *
 urj_tap_register_get_string_bit_range (const urj_tap_register_t *tr, int msb, int lsb)
 {
@@ -367,6 +413,51 @@ urj_tap_register_get_value (const urj_tap_register_t *tr)
     return urj_tap_register_get_value_bit_range (tr, tr->len - 1, 0);
 }
 
+int
+urj_tap_register_get_bytes_bit_range (const urj_tap_register_t *tr,
+                                      uint8_t *buf, size_t buflen,
+                                      int msb, int lsb)
+{
+    int bit, i;
+    int step = msb >= lsb ? 1 : -1;
+    size_t need = ((msb - lsb) * step + 8) / 8;
+
+    if (!tr)
+    {
+        urj_error_set (URJ_ERROR_INVALID, "tr == NULL");
+        return URJ_STATUS_FAIL;
+    }
+
+    if (msb > tr->len - 1 || lsb > tr->len - 1 || msb < 0 || lsb < 0)
+    {
+        urj_error_set (URJ_ERROR_INVALID, "msb or lsb out of range");
+        return URJ_STATUS_FAIL;
+    }
+
+    if (buflen < need)
+    {
+        urj_error_set (URJ_ERROR_OUT_OF_BOUNDS,
+                       _("need %zd bytes for %d:%d, got %zd"),
+                       need, msb, lsb, buflen);
+        return URJ_STATUS_FAIL;
+    }
+
+    memset (buf, 0, need);
+    for (i = 0, bit = lsb; bit * step <= msb * step; bit += step, i++)
+        if (tr->data[bit] & 1)
+            buf[i >> 3] |= 1 << (i & 7);
+
+    return URJ_STATUS_OK;
+}
+
+int
+urj_tap_register_get_bytes (const urj_tap_register_t *tr, uint8_t *buf,
+                            size_t buflen)
+{
+    return urj_tap_register_get_bytes_bit_range (tr, buf, buflen,
+                                                 tr->len - 1, 0);
+}
+
 int
 urj_tap_register_all_bits_same_value (const urj_tap_register_t *tr)
 {
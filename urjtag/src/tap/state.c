@@ -66,6 +66,148 @@ urj_tap_state_dump_2 (int state0, int state1, int tms)
              urj_tap_state_name (state0), tms, urj_tap_state_name (state1));
 }
 
+/* The sixteen states in the order of the rows and columns of
+ * urj_tap_state_paths[][] */
+static int
+urj_tap_state_index (int state)
+{
+    switch (state)
+    {
+    case URJ_TAP_STATE_TEST_LOGIC_RESET:        return 0;
+    case URJ_TAP_STATE_RUN_TEST_IDLE:           return 1;
+    case URJ_TAP_STATE_SELECT_DR_SCAN:          return 2;
+    case URJ_TAP_STATE_CAPTURE_DR:              return 3;
+    case URJ_TAP_STATE_SHIFT_DR:                return 4;
+    case URJ_TAP_STATE_EXIT1_DR:                return 5;
+    case URJ_TAP_STATE_PAUSE_DR:                return 6;
+    case URJ_TAP_STATE_EXIT2_DR:                return 7;
+    case URJ_TAP_STATE_UPDATE_DR:               return 8;
+    case URJ_TAP_STATE_SELECT_IR_SCAN:          return 9;
+    case URJ_TAP_STATE_CAPTURE_IR:              return 10;
+    case URJ_TAP_STATE_SHIFT_IR:                return 11;
+    case URJ_TAP_STATE_EXIT1_IR:                return 12;
+    case URJ_TAP_STATE_PAUSE_IR:                return 13;
+    case URJ_TAP_STATE_EXIT2_IR:                return 14;
+    case URJ_TAP_STATE_UPDATE_IR:               return 15;
+    default:                                    return -1;
+    }
+}
+
+/* Shortest path between any two states: TMS bits, first clock in the LSB,
+ * and the number of clocks.  Between the stable states these are the
+ * paths the SVF specification prescribes for the STATE command. */
+static const struct
+{
+    uint8_t tms;
+    uint8_t len;
+}
+urj_tap_state_paths[16][16] = {
+    /* from TEST_LOGIC_RESET */
+    { { 0x00, 0 }, { 0x00, 1 }, { 0x02, 2 }, { 0x02, 3 },
+      { 0x02, 4 }, { 0x0a, 4 }, { 0x0a, 5 }, { 0x2a, 6 },
+      { 0x1a, 5 }, { 0x06, 3 }, { 0x06, 4 }, { 0x06, 5 },
+      { 0x16, 5 }, { 0x16, 6 }, { 0x56, 7 }, { 0x36, 6 } },
+    /* from RUN_TEST_IDLE */
+    { { 0x07, 3 }, { 0x00, 0 }, { 0x01, 1 }, { 0x01, 2 },
+      { 0x01, 3 }, { 0x05, 3 }, { 0x05, 4 }, { 0x15, 5 },
+      { 0x0d, 4 }, { 0x03, 2 }, { 0x03, 3 }, { 0x03, 4 },
+      { 0x0b, 4 }, { 0x0b, 5 }, { 0x2b, 6 }, { 0x1b, 5 } },
+    /* from SELECT_DR_SCAN */
+    { { 0x03, 2 }, { 0x03, 3 }, { 0x00, 0 }, { 0x00, 1 },
+      { 0x00, 2 }, { 0x02, 2 }, { 0x02, 3 }, { 0x0a, 4 },
+      { 0x06, 3 }, { 0x01, 1 }, { 0x01, 2 }, { 0x01, 3 },
+      { 0x05, 3 }, { 0x05, 4 }, { 0x15, 5 }, { 0x0d, 4 } },
+    /* from CAPTURE_DR */
+    { { 0x1f, 5 }, { 0x03, 3 }, { 0x07, 3 }, { 0x00, 0 },
+      { 0x00, 1 }, { 0x01, 1 }, { 0x01, 2 }, { 0x05, 3 },
+      { 0x03, 2 }, { 0x0f, 4 }, { 0x0f, 5 }, { 0x0f, 6 },
+      { 0x2f, 6 }, { 0x2f, 7 }, { 0xaf, 8 }, { 0x6f, 7 } },
+    /* from SHIFT_DR */
+    { { 0x1f, 5 }, { 0x03, 3 }, { 0x07, 3 }, { 0x07, 4 },
+      { 0x00, 0 }, { 0x01, 1 }, { 0x01, 2 }, { 0x05, 3 },
+      { 0x03, 2 }, { 0x0f, 4 }, { 0x0f, 5 }, { 0x0f, 6 },
+      { 0x2f, 6 }, { 0x2f, 7 }, { 0xaf, 8 }, { 0x6f, 7 } },
+    /* from EXIT1_DR */
+    { { 0x0f, 4 }, { 0x01, 2 }, { 0x03, 2 }, { 0x03, 3 },
+      { 0x02, 3 }, { 0x00, 0 }, { 0x00, 1 }, { 0x02, 2 },
+      { 0x01, 1 }, { 0x07, 3 }, { 0x07, 4 }, { 0x07, 5 },
+      { 0x17, 5 }, { 0x17, 6 }, { 0x57, 7 }, { 0x37, 6 } },
+    /* from PAUSE_DR */
+    { { 0x1f, 5 }, { 0x03, 3 }, { 0x07, 3 }, { 0x07, 4 },
+      { 0x01, 2 }, { 0x05, 3 }, { 0x00, 0 }, { 0x01, 1 },
+      { 0x03, 2 }, { 0x0f, 4 }, { 0x0f, 5 }, { 0x0f, 6 },
+      { 0x2f, 6 }, { 0x2f, 7 }, { 0xaf, 8 }, { 0x6f, 7 } },
+    /* from EXIT2_DR */
+    { { 0x0f, 4 }, { 0x01, 2 }, { 0x03, 2 }, { 0x03, 3 },
+      { 0x00, 1 }, { 0x02, 2 }, { 0x02, 3 }, { 0x00, 0 },
+      { 0x01, 1 }, { 0x07, 3 }, { 0x07, 4 }, { 0x07, 5 },
+      { 0x17, 5 }, { 0x17, 6 }, { 0x57, 7 }, { 0x37, 6 } },
+    /* from UPDATE_DR */
+    { { 0x07, 3 }, { 0x00, 1 }, { 0x01, 1 }, { 0x01, 2 },
+      { 0x01, 3 }, { 0x05, 3 }, { 0x05, 4 }, { 0x15, 5 },
+      { 0x00, 0 }, { 0x03, 2 }, { 0x03, 3 }, { 0x03, 4 },
+      { 0x0b, 4 }, { 0x0b, 5 }, { 0x2b, 6 }, { 0x1b, 5 } },
+    /* from SELECT_IR_SCAN */
+    { { 0x01, 1 }, { 0x01, 2 }, { 0x05, 3 }, { 0x05, 4 },
+      { 0x05, 5 }, { 0x15, 5 }, { 0x15, 6 }, { 0x55, 7 },
+      { 0x35, 6 }, { 0x00, 0 }, { 0x00, 1 }, { 0x00, 2 },
+      { 0x02, 2 }, { 0x02, 3 }, { 0x0a, 4 }, { 0x06, 3 } },
+    /* from CAPTURE_IR */
+    { { 0x1f, 5 }, { 0x03, 3 }, { 0x07, 3 }, { 0x07, 4 },
+      { 0x07, 5 }, { 0x17, 5 }, { 0x17, 6 }, { 0x57, 7 },
+      { 0x37, 6 }, { 0x0f, 4 }, { 0x00, 0 }, { 0x00, 1 },
+      { 0x01, 1 }, { 0x01, 2 }, { 0x05, 3 }, { 0x03, 2 } },
+    /* from SHIFT_IR */
+    { { 0x1f, 5 }, { 0x03, 3 }, { 0x07, 3 }, { 0x07, 4 },
+      { 0x07, 5 }, { 0x17, 5 }, { 0x17, 6 }, { 0x57, 7 },
+      { 0x37, 6 }, { 0x0f, 4 }, { 0x0f, 5 }, { 0x00, 0 },
+      { 0x01, 1 }, { 0x01, 2 }, { 0x05, 3 }, { 0x03, 2 } },
+    /* from EXIT1_IR */
+    { { 0x0f, 4 }, { 0x01, 2 }, { 0x03, 2 }, { 0x03, 3 },
+      { 0x03, 4 }, { 0x0b, 4 }, { 0x0b, 5 }, { 0x2b, 6 },
+      { 0x1b, 5 }, { 0x07, 3 }, { 0x07, 4 }, { 0x02, 3 },
+      { 0x00, 0 }, { 0x00, 1 }, { 0x02, 2 }, { 0x01, 1 } },
+    /* from PAUSE_IR */
+    { { 0x1f, 5 }, { 0x03, 3 }, { 0x07, 3 }, { 0x07, 4 },
+      { 0x07, 5 }, { 0x17, 5 }, { 0x17, 6 }, { 0x57, 7 },
+      { 0x37, 6 }, { 0x0f, 4 }, { 0x0f, 5 }, { 0x01, 2 },
+      { 0x05, 3 }, { 0x00, 0 }, { 0x01, 1 }, { 0x03, 2 } },
+    /* from EXIT2_IR */
+    { { 0x0f, 4 }, { 0x01, 2 }, { 0x03, 2 }, { 0x03, 3 },
+      { 0x03, 4 }, { 0x0b, 4 }, { 0x0b, 5 }, { 0x2b, 6 },
+      { 0x1b, 5 }, { 0x07, 3 }, { 0x07, 4 }, { 0x00, 1 },
+      { 0x02, 2 }, { 0x02, 3 }, { 0x00, 0 }, { 0x01, 1 } },
+    /* from UPDATE_IR */
+    { { 0x07, 3 }, { 0x00, 1 }, { 0x01, 1 }, { 0x01, 2 },
+      { 0x01, 3 }, { 0x05, 3 }, { 0x05, 4 }, { 0x15, 5 },
+      { 0x0d, 4 }, { 0x03, 2 }, { 0x03, 3 }, { 0x03, 4 },
+      { 0x0b, 4 }, { 0x0b, 5 }, { 0x2b, 6 }, { 0x00, 0 } },
+};
+
+int
+urj_tap_state_path (int from, int to, uint32_t *tms)
+{
+    int f, t, len = 0;
+
+    *tms = 0;
+    if (to == URJ_TAP_STATE_UNKNOWN_STATE)
+        to = URJ_TAP_STATE_TEST_LOGIC_RESET;
+    if ((t = urj_tap_state_index (to)) < 0)
+        return -1;
+
+    if ((f = urj_tap_state_index (from)) < 0)
+    {
+        /* unknown: five clocks with TMS=1 reach Test-Logic-Reset from
+         * anywhere */
+        *tms = 0x1f;
+        len = 5;
+        f = 0;
+    }
+
+    *tms |= (uint32_t) urj_tap_state_paths[f][t].tms << len;
+    return len + urj_tap_state_paths[f][t].len;
+}
+
 int
 urj_tap_state (urj_chain_t *chain)
 {
@@ -112,94 +254,101 @@ urj_tap_state_set_trst (urj_chain_t *chain, int old_trst, int new_trst)
 }
 
 int
-urj_tap_state_clock (urj_chain_t *chain, int tms)
+urj_tap_state_next (int state, int tms)
 {
-    int oldstate = chain->state;
-
     if (tms)
     {
-        switch (chain->state)
+        switch (state)
         {
         case URJ_TAP_STATE_TEST_LOGIC_RESET:
             break;
         case URJ_TAP_STATE_RUN_TEST_IDLE:
         case URJ_TAP_STATE_UPDATE_DR:
         case URJ_TAP_STATE_UPDATE_IR:
-            chain->state = URJ_TAP_STATE_SELECT_DR_SCAN;
+            state = URJ_TAP_STATE_SELECT_DR_SCAN;
             break;
         case URJ_TAP_STATE_SELECT_DR_SCAN:
-            chain->state = URJ_TAP_STATE_SELECT_IR_SCAN;
+            state = URJ_TAP_STATE_SELECT_IR_SCAN;
             break;
         case URJ_TAP_STATE_CAPTURE_DR:
         case URJ_TAP_STATE_SHIFT_DR:
-            chain->state = URJ_TAP_STATE_EXIT1_DR;
+            state = URJ_TAP_STATE_EXIT1_DR;
             break;
         case URJ_TAP_STATE_EXIT1_DR:
         case URJ_TAP_STATE_EXIT2_DR:
-            chain->state = URJ_TAP_STATE_UPDATE_DR;
+            state = URJ_TAP_STATE_UPDATE_DR;
             break;
         case URJ_TAP_STATE_PAUSE_DR:
-            chain->state = URJ_TAP_STATE_EXIT2_DR;
+            state = URJ_TAP_STATE_EXIT2_DR;
             break;
         case URJ_TAP_STATE_SELECT_IR_SCAN:
-            chain->state = URJ_TAP_STATE_TEST_LOGIC_RESET;
+            state = URJ_TAP_STATE_TEST_LOGIC_RESET;
             break;
         case URJ_TAP_STATE_CAPTURE_IR:
         case URJ_TAP_STATE_SHIFT_IR:
-            chain->state = URJ_TAP_STATE_EXIT1_IR;
+            state = URJ_TAP_STATE_EXIT1_IR;
             break;
         case URJ_TAP_STATE_EXIT1_IR:
         case URJ_TAP_STATE_EXIT2_IR:
-            chain->state = URJ_TAP_STATE_UPDATE_IR;
+            state = URJ_TAP_STATE_UPDATE_IR;
             break;
         case URJ_TAP_STATE_PAUSE_IR:
-            chain->state = URJ_TAP_STATE_EXIT2_IR;
+            state = URJ_TAP_STATE_EXIT2_IR;
             break;
         default:
-            chain->state = URJ_TAP_STATE_UNKNOWN_STATE;
+            state = URJ_TAP_STATE_UNKNOWN_STATE;
             break;
         }
     }
     else
     {
-        switch (chain->state)
+        switch (state)
         {
         case URJ_TAP_STATE_TEST_LOGIC_RESET:
         case URJ_TAP_STATE_RUN_TEST_IDLE:
         case URJ_TAP_STATE_UPDATE_DR:
         case URJ_TAP_STATE_UPDATE_IR:
-            chain->state = URJ_TAP_STATE_RUN_TEST_IDLE;
+            state = URJ_TAP_STATE_RUN_TEST_IDLE;
             break;
         case URJ_TAP_STATE_SELECT_DR_SCAN:
-            chain->state = URJ_TAP_STATE_CAPTURE_DR;
+            state = URJ_TAP_STATE_CAPTURE_DR;
             break;
         case URJ_TAP_STATE_CAPTURE_DR:
         case URJ_TAP_STATE_SHIFT_DR:
         case URJ_TAP_STATE_EXIT2_DR:
-            chain->state = URJ_TAP_STATE_SHIFT_DR;
+            state = URJ_TAP_STATE_SHIFT_DR;
             break;
         case URJ_TAP_STATE_EXIT1_DR:
         case URJ_TAP_STATE_PAUSE_DR:
-            chain->state = URJ_TAP_STATE_PAUSE_DR;
+            state = URJ_TAP_STATE_PAUSE_DR;
             break;
         case URJ_TAP_STATE_SELECT_IR_SCAN:
-            chain->state = URJ_TAP_STATE_CAPTURE_IR;
+            state = URJ_TAP_STATE_CAPTURE_IR;
             break;
         case URJ_TAP_STATE_CAPTURE_IR:
         case URJ_TAP_STATE_SHIFT_IR:
         case URJ_TAP_STATE_EXIT2_IR:
-            chain->state = URJ_TAP_STATE_SHIFT_IR;
+            state = URJ_TAP_STATE_SHIFT_IR;
             break;
         case URJ_TAP_STATE_EXIT1_IR:
         case URJ_TAP_STATE_PAUSE_IR:
-            chain->state = URJ_TAP_STATE_PAUSE_IR;
+            state = URJ_TAP_STATE_PAUSE_IR;
             break;
         default:
-            chain->state = URJ_TAP_STATE_UNKNOWN_STATE;
+            state = URJ_TAP_STATE_UNKNOWN_STATE;
             break;
         }
     }
 
+    return state;
+}
+
+int
+urj_tap_state_clock (urj_chain_t *chain, int tms)
+{
+    int oldstate = chain->state;
+
+    chain->state = urj_tap_state_next (oldstate, tms);
     urj_tap_state_dump_2 (oldstate, chain->state, tms);
     return chain->state;
 }
@@ -112,8 +112,8 @@ urj_tap_defer_shift_register (urj_chain_t *chain,
     /* Shift-DR, Shift-IR, Exit1-DR or Exit1-IR state */
     if (tap_exit == URJ_CHAIN_EXITMODE_IDLE)
     {
-        urj_tap_chain_defer_clock (chain, 1, 0, 1);     /* Update-DR or Update-IR */
-        urj_tap_chain_defer_clock (chain, 0, 0, 1);     /* Run-Test/Idle */
+        /* Update-DR or Update-IR, then Run-Test/Idle */
+        urj_tap_chain_defer_goto_state (chain, URJ_TAP_STATE_RUN_TEST_IDLE);
         urj_tap_chain_wait_ready (chain);
     }
     else if (tap_exit == URJ_CHAIN_EXITMODE_UPDATE)
@@ -161,8 +161,7 @@ urj_tap_capture_dr (urj_chain_t *chain)
                  urj_tap_state (chain));
 
     /* Run-Test/Idle or Update-DR or Update-IR state */
-    urj_tap_chain_defer_clock (chain, 1, 0, 1); /* Select-DR-Scan */
-    urj_tap_chain_defer_clock (chain, 0, 0, 1); /* Capture-DR */
+    urj_tap_chain_defer_goto_state (chain, URJ_TAP_STATE_CAPTURE_DR);
 }
 
 void
@@ -174,6 +173,5 @@ urj_tap_capture_ir (urj_chain_t *chain)
                  urj_tap_state (chain));
 
     /* Run-Test/Idle or Update-DR or Update-IR state */
-    urj_tap_chain_defer_clock (chain, 1, 0, 2); /* Select-DR-Scan, then Select-IR-Scan */
-    urj_tap_chain_defer_clock (chain, 0, 0, 1); /* Capture-IR */
+    urj_tap_chain_defer_goto_state (chain, URJ_TAP_STATE_CAPTURE_IR);
 }
@@ -0,0 +1,1717 @@
+/*
+ * $Id$
+ *
+ * Binary trace of cable operations
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ */
+
+#include <sysdep.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include <urjtag/log.h>
+#include <urjtag/error.h>
+#include <urjtag/cable.h>
+#include <urjtag/fclock.h>
+#include <urjtag/trace.h>
+#include <urjtag/tap_state.h>
+#include <urjtag/pod.h>
+
+#include "cable.h"
+
+#define TRACE_MAGIC     "URJTRC01"
+#define TRACE_MAGIC_LEN 8
+
+struct URJ_TAP_TRACE
+{
+    FILE *f;
+    long double last;
+};
+
+/* ---------------------------------------------------------------------- */
+/* recording */
+
+static void
+trace_put_u (FILE *f, unsigned long long v)
+{
+    while (v >= 0x80)
+    {
+        putc ((v & 0x7F) | 0x80, f);
+        v >>= 7;
+    }
+    putc (v, f);
+}
+
+static void
+trace_put_s (FILE *f, long long v)
+{
+    trace_put_u (f, ((unsigned long long) v << 1) ^ (v < 0 ? ~0ULL : 0));
+}
+
+/* one bit per char in memory, eight per byte in the file */
+static void
+trace_put_bits (FILE *f, const char *bits, int len)
+{
+    int i, byte = 0;
+
+    for (i = 0; i < len; i++)
+    {
+        if (bits != NULL && bits[i])
+            byte |= 1 << (i & 7);
+        if ((i & 7) == 7)
+        {
+            putc (byte, f);
+            byte = 0;
+        }
+    }
+    if (len & 7)
+        putc (byte, f);
+}
+
+static void
+trace_put_op (urj_tap_trace_t *t, urj_tap_trace_op_t op)
+{
+    long double now = urj_lib_frealtime ();
+
+    putc (op, t->f);
+    trace_put_u (t->f, (unsigned long long) ((now - t->last) * 1E6));
+    t->last = now;
+}
+
+void
+urj_tap_trace_record (urj_cable_t *cable, urj_tap_trace_op_t op,
+                      int a, int b, int c)
+{
+    FILE *f = cable->trace->f;
+
+    trace_put_op (cable->trace, op);
+    switch (op)
+    {
+    case URJ_TAP_TRACE_CLOCK:
+    case URJ_TAP_TRACE_DEFER_CLOCK:
+        putc (a, f);
+        putc (b, f);
+        trace_put_u (f, c);
+        break;
+    case URJ_TAP_TRACE_GET_TDO:
+    case URJ_TAP_TRACE_GET_TDO_LATE:
+        trace_put_s (f, a);
+        break;
+    case URJ_TAP_TRACE_SET_SIGNAL:
+        trace_put_u (f, a);
+        trace_put_u (f, b);
+        trace_put_s (f, c);
+        break;
+    case URJ_TAP_TRACE_DEFER_SET_SIGNAL:
+        trace_put_u (f, a);
+        trace_put_u (f, b);
+        break;
+    case URJ_TAP_TRACE_GET_SIGNAL:
+    case URJ_TAP_TRACE_GET_SIGNAL_LATE:
+        trace_put_u (f, a);
+        trace_put_s (f, b);
+        break;
+    case URJ_TAP_TRACE_DEFER_GET_SIGNAL:
+        trace_put_u (f, a);
+        break;
+    case URJ_TAP_TRACE_SET_FREQUENCY:
+        trace_put_u (f, (uint32_t) a);
+        break;
+    case URJ_TAP_TRACE_DEFER_CLOCK_TMS:
+        trace_put_u (f, (uint32_t) a);
+        putc (b, f);
+        trace_put_u (f, c);
+        break;
+    default:
+        break;
+    }
+}
+
+void
+urj_tap_trace_record_transfer (urj_cable_t *cable, urj_tap_trace_op_t op,
+                               int len, const char *in, const char *out,
+                               int res)
+{
+    FILE *f = cable->trace->f;
+
+    trace_put_op (cable->trace, op);
+    trace_put_u (f, len);
+    switch (op)
+    {
+    case URJ_TAP_TRACE_TRANSFER:
+        putc (out != NULL, f);
+        trace_put_bits (f, in, len);
+        if (out != NULL)
+            trace_put_bits (f, out, len);
+        trace_put_s (f, res);
+        break;
+    case URJ_TAP_TRACE_DEFER_TRANSFER:
+        putc (out != NULL, f);
+        trace_put_bits (f, in, len);
+        break;
+    case URJ_TAP_TRACE_TRANSFER_LATE:
+        trace_put_bits (f, out, len);
+        trace_put_s (f, res);
+        break;
+    default:
+        break;
+    }
+}
+
+int
+urj_tap_trace_start (urj_cable_t *cable, const char *filename)
+{
+    urj_tap_trace_t *t;
+
+    if (cable->trace != NULL)
+    {
+        urj_error_set (URJ_ERROR_ALREADY, _("trace already being recorded"));
+        return URJ_STATUS_FAIL;
+    }
+
+    t = malloc (sizeof *t);
+    if (t == NULL)
+    {
+        urj_error_set (URJ_ERROR_OUT_OF_MEMORY, "malloc(%zd) fails",
+                       sizeof *t);
+        return URJ_STATUS_FAIL;
+    }
+
+    t->f = fopen (filename, FOPEN_W);
+    if (t->f == NULL)
+    {
+        free (t);
+        urj_error_IO_set (_("Unable to create file `%s'"), filename);
+        return URJ_STATUS_FAIL;
+    }
+
+    /* everything queued so far belongs to the time before the trace */
+    urj_tap_cable_flush (cable, URJ_TAP_CABLE_COMPLETELY);
+
+    fwrite (TRACE_MAGIC, 1, TRACE_MAGIC_LEN, t->f);
+    t->last = urj_lib_frealtime ();
+    cable->trace = t;
+    /* lets an export turn clock counts into time */
+    if (cable->frequency != 0)
+        urj_tap_trace_record (cable, URJ_TAP_TRACE_SET_FREQUENCY,
+                              cable->frequency, 0, 0);
+
+    return URJ_STATUS_OK;
+}
+
+int
+urj_tap_trace_stop (urj_cable_t *cable)
+{
+    urj_tap_trace_t *t = cable->trace;
+    int failed;
+
+    if (t == NULL)
+    {
+        urj_error_set (URJ_ERROR_ILLEGAL_STATE, _("no trace being recorded"));
+        return URJ_STATUS_FAIL;
+    }
+
+    cable->trace = NULL;
+    failed = ferror (t->f);
+    if (fclose (t->f) != 0)
+        failed = 1;
+    free (t);
+
+    if (failed)
+    {
+        urj_error_IO_set (_("Error writing trace file"));
+        return URJ_STATUS_FAIL;
+    }
+
+    return URJ_STATUS_OK;
+}
+
+/* ---------------------------------------------------------------------- */
+/* replay */
+
+typedef struct
+{
+    FILE *f;
+    int eof;
+    char *in;
+    char *expect;
+    char *out;
+    int len;
+    long size;                  /* of the whole file */
+} trace_reader_t;
+
+static int
+trace_get_c (trace_reader_t *r)
+{
+    int c = getc (r->f);
+
+    if (c == EOF)
+        r->eof = 1;
+    return c & 0xFF;
+}
+
+static unsigned long long
+trace_get_u (trace_reader_t *r)
+{
+    unsigned long long v = 0;
+    int shift = 0, c;
+
+    do
+    {
+        c = trace_get_c (r);
+        if (shift < 64)
+            v |= (unsigned long long) (c & 0x7F) << shift;
+        shift += 7;
+    }
+    while ((c & 0x80) && !r->eof);
+
+    return v;
+}
+
+static long long
+trace_get_s (trace_reader_t *r)
+{
+    unsigned long long v = trace_get_u (r);
+
+    return (long long) (v >> 1) ^ -(long long) (v & 1);
+}
+
+/**
+ * Read the bit count of a transfer record, which must fit an int and the
+ * rest of the file.
+ *
+ * @return URJ_STATUS_OK on success; URJ_STATUS_FAIL on error
+ */
+static int
+trace_get_len (trace_reader_t *r, unsigned long record, int *len)
+{
+    unsigned long long v = trace_get_u (r);
+    long left = r->size - ftell (r->f);
+
+    if (v > INT_MAX || left < 0 || (v + 7) / 8 > (unsigned long) left)
+    {
+        urj_error_set (URJ_ERROR_INVALID,
+                       _("bad transfer length %llu at record %lu"),
+                       v, record);
+        return URJ_STATUS_FAIL;
+    }
+    *len = v;
+
+    return URJ_STATUS_OK;
+}
+
+static void
+trace_get_bits (trace_reader_t *r, char *bits, int len)
+{
+    int i, byte = 0;
+
+    for (i = 0; i < len; i++)
+    {
+        if ((i & 7) == 0)
+            byte = trace_get_c (r);
+        bits[i] = (byte >> (i & 7)) & 1;
+    }
+}
+
+static int
+trace_buffers (trace_reader_t *r, int len)
+{
+    char *in, *expect, *out;
+
+    if (len <= r->len)
+        return URJ_STATUS_OK;
+
+    in = realloc (r->in, len);
+    if (in != NULL)
+        r->in = in;
+    expect = realloc (r->expect, len);
+    if (expect != NULL)
+        r->expect = expect;
+    out = realloc (r->out, len);
+    if (out != NULL)
+        r->out = out;
+    if (in == NULL || expect == NULL || out == NULL)
+    {
+        urj_error_set (URJ_ERROR_OUT_OF_MEMORY, "realloc(%d) fails", len);
+        return URJ_STATUS_FAIL;
+    }
+    r->len = len;
+
+    return URJ_STATUS_OK;
+}
+
+static void
+trace_compare (urj_tap_trace_report_t *report, const char *what,
+               long long expected, long long got)
+{
+    if (expected == got)
+        return;
+
+    report->mismatches++;
+    if (report->first_mismatch == 0)
+        report->first_mismatch = report->records;
+    urj_log (URJ_LOG_LEVEL_DETAIL,
+             "trace record %lu: %s expected %lld, got %lld\n",
+             report->records, what, expected, got);
+}
+
+static void
+trace_compare_bits (urj_tap_trace_report_t *report, const char *expected,
+                    const char *got, int len)
+{
+    int i;
+
+    for (i = 0; i < len; i++)
+        if (expected[i] != got[i])
+            break;
+    if (i == len)
+        return;
+
+    report->mismatches++;
+    if (report->first_mismatch == 0)
+        report->first_mismatch = report->records;
+    urj_log (URJ_LOG_LEVEL_DETAIL,
+             "trace record %lu: TDO differs from bit %d of %d\n",
+             report->records, i, len);
+}
+
+int
+urj_tap_trace_replay (urj_cable_t *cable, const char *filename,
+                      urj_tap_trace_report_t *report)
+{
+    trace_reader_t r;
+    char magic[TRACE_MAGIC_LEN];
+    long double start;
+    int op, ret = URJ_STATUS_OK;
+
+    memset (report, 0, sizeof *report);
+    memset (&r, 0, sizeof r);
+
+    r.f = fopen (filename, FOPEN_R);
+    if (r.f == NULL)
+    {
+        urj_error_IO_set (_("Unable to open file `%s'"), filename);
+        return URJ_STATUS_FAIL;
+    }
+    if (fread (magic, 1, TRACE_MAGIC_LEN, r.f) != TRACE_MAGIC_LEN
+        || memcmp (magic, TRACE_MAGIC, TRACE_MAGIC_LEN) != 0)
+    {
+        fclose (r.f);
+        urj_error_set (URJ_ERROR_INVALID, _("`%s' is not a trace file"),
+                       filename);
+        return URJ_STATUS_FAIL;
+    }
+    if (fseek (r.f, 0, SEEK_END) != 0 || (r.size = ftell (r.f)) < 0
+        || fseek (r.f, TRACE_MAGIC_LEN, SEEK_SET) != 0)
+    {
+        fclose (r.f);
+        urj_error_IO_set (_("Unable to seek in file `%s'"), filename);
+        return URJ_STATUS_FAIL;
+    }
+
+    start = urj_lib_frealtime ();
+    while ((op = getc (r.f)) != EOF)
+    {
+        int a, b, c, len, has_out, res;
+
+        report->records++;
+        report->recorded_secs += trace_get_u (&r) / 1E6;
+
+        switch (op)
+        {
+        case URJ_TAP_TRACE_CLOCK:
+        case URJ_TAP_TRACE_DEFER_CLOCK:
+            a = trace_get_c (&r);
+            b = trace_get_c (&r);
+            c = trace_get_u (&r);
+            report->bits += c;
+            if (op == URJ_TAP_TRACE_CLOCK)
+                urj_tap_cable_clock (cable, a, b, c);
+            else
+                urj_tap_cable_defer_clock (cable, a, b, c);
+            break;
+
+        case URJ_TAP_TRACE_GET_TDO:
+            a = trace_get_s (&r);
+            trace_compare (report, "TDO", a, urj_tap_cable_get_tdo (cable));
+            break;
+        case URJ_TAP_TRACE_DEFER_GET_TDO:
+            urj_tap_cable_defer_get_tdo (cable);
+            break;
+        case URJ_TAP_TRACE_GET_TDO_LATE:
+            a = trace_get_s (&r);
+            trace_compare (report, "TDO", a,
+                           urj_tap_cable_get_tdo_late (cable));
+            break;
+
+        case URJ_TAP_TRACE_SET_SIGNAL:
+            a = trace_get_u (&r);
+            b = trace_get_u (&r);
+            c = trace_get_s (&r);
+            trace_compare (report, "signal", c,
+                           urj_tap_cable_set_signal (cable, a, b));
+            break;
+        case URJ_TAP_TRACE_DEFER_SET_SIGNAL:
+            a = trace_get_u (&r);
+            b = trace_get_u (&r);
+            urj_tap_cable_defer_set_signal (cable, a, b);
+            break;
+        case URJ_TAP_TRACE_GET_SIGNAL:
+            a = trace_get_u (&r);
+            b = trace_get_s (&r);
+            trace_compare (report, "signal", b,
+                           urj_tap_cable_get_signal (cable, a));
+            break;
+        case URJ_TAP_TRACE_DEFER_GET_SIGNAL:
+            a = trace_get_u (&r);
+            urj_tap_cable_defer_get_signal (cable, a);
+            break;
+        case URJ_TAP_TRACE_GET_SIGNAL_LATE:
+            a = trace_get_u (&r);
+            b = trace_get_s (&r);
+            trace_compare (report, "signal", b,
+                           urj_tap_cable_get_signal_late (cable, a));
+            break;
+
+        case URJ_TAP_TRACE_TRANSFER:
+        case URJ_TAP_TRACE_DEFER_TRANSFER:
+            if (trace_get_len (&r, report->records, &len) != URJ_STATUS_OK)
+            {
+                ret = URJ_STATUS_FAIL;
+                goto done;
+            }
+            has_out = trace_get_c (&r);
+            if (trace_buffers (&r, len) != URJ_STATUS_OK)
+            {
+                ret = URJ_STATUS_FAIL;
+                goto done;
+            }
+            trace_get_bits (&r, r.in, len);
+            report->bits += len;
+            if (op == URJ_TAP_TRACE_DEFER_TRANSFER)
+            {
+                urj_tap_cable_defer_transfer (cable, len, r.in,
+                                              has_out ? r.out : NULL);
+                break;
+            }
+            if (has_out)
+                trace_get_bits (&r, r.expect, len);
+            res = trace_get_s (&r);
+            trace_compare (report, "transfer", res,
+                           urj_tap_cable_transfer (cable, len, r.in,
+                                                   has_out ? r.out : NULL));
+            if (has_out)
+                trace_compare_bits (report, r.expect, r.out, len);
+            break;
+        case URJ_TAP_TRACE_TRANSFER_LATE:
+            if (trace_get_len (&r, report->records, &len) != URJ_STATUS_OK
+                || trace_buffers (&r, len) != URJ_STATUS_OK)
+            {
+                ret = URJ_STATUS_FAIL;
+                goto done;
+            }
+            trace_get_bits (&r, r.expect, len);
+            res = trace_get_s (&r);
+            trace_compare (report, "transfer", res,
+                           urj_tap_cable_transfer_late (cable, r.out));
+            trace_compare_bits (report, r.expect, r.out, len);
+            break;
+
+        case URJ_TAP_TRACE_SET_FREQUENCY:
+            urj_tap_cable_set_frequency (cable, trace_get_u (&r));
+            break;
+
+        case URJ_TAP_TRACE_DEFER_CLOCK_TMS:
+            a = trace_get_u (&r);
+            b = trace_get_c (&r);
+            c = trace_get_u (&r);
+            report->bits += c;
+            urj_tap_cable_defer_clock_tms (cable, a, b, c);
+            break;
+
+        default:
+            urj_error_set (URJ_ERROR_INVALID,
+                           _("unknown trace record type %d at record %lu"),
+                           op, report->records);
+            ret = URJ_STATUS_FAIL;
+            goto done;
+        }
+
+        if (r.eof)
+        {
+            urj_error_set (URJ_ERROR_INVALID,
+                           _("trace ends within record %lu"),
+                           report->records);
+            ret = URJ_STATUS_FAIL;
+            goto done;
+        }
+    }
+    urj_tap_cable_flush (cable, URJ_TAP_CABLE_COMPLETELY);
+
+ done:
+    report->replayed_secs = urj_lib_frealtime () - start;
+    fclose (r.f);
+    free (r.in);
+    free (r.expect);
+    free (r.out);
+
+    return ret;
+}
+
+/* ---------------------------------------------------------------------- */
+/* export */
+
+#define EXPORT_MAX_PERIOD       8       /* longest polling loop, in items */
+#define EXPORT_WINDOW           (2 * EXPORT_MAX_PERIOD)
+#define EXPORT_MIN_WAIT         5E-3    /* shorter host delays are latency */
+
+enum
+{
+    EXPORT_SIR,
+    EXPORT_SDR,
+    EXPORT_STATE,
+    EXPORT_RUNTEST,
+    EXPORT_TRST,
+};
+
+/* XSVF commands written by the exporter */
+enum
+{
+    XCOMPLETE = 0x00,
+    XTDOMASK = 0x01,
+    XSIR = 0x02,
+    XSDR = 0x03,
+    XRUNTEST = 0x04,
+    XREPEAT = 0x07,
+    XSDRSIZE = 0x08,
+    XSDRTDO = 0x09,
+    XSTATE = 0x12,
+    XENDIR = 0x13,
+    XENDDR = 0x14,
+    XSIR2 = 0x15,
+    XWAIT = 0x17,
+};
+
+typedef struct export_item export_item_t;
+
+/* one SVF statement; a scan is held back until the cable delivered its TDO */
+struct export_item
+{
+    export_item_t *next;
+    int kind;
+    int state;                  /* end state, STATE target or run state */
+    int trst;                   /* EXPORT_TRST: 1 asserted, 0 released */
+    int len;                    /* scan length */
+    int size;                   /* bits allocated in tdi, tdo and mask */
+    char *tdi;
+    char *tdo;
+    char *mask;                 /* 1 where the TDO is known */
+    unsigned long clocks;       /* EXPORT_RUNTEST */
+    double secs;                /* EXPORT_RUNTEST minimum time */
+    int pending;                /* TDO bits the cable still owes */
+    double start;               /* trace time of the first record */
+    double end;                 /* and of the record that completed it */
+};
+
+/* destination of one deferred cable result, in the order they come back */
+typedef struct
+{
+    export_item_t *item;        /* NULL if not part of a scan */
+    int pos;
+    int len;
+} export_slot_t;
+
+typedef struct
+{
+    urj_tap_trace_export_report_t *report;
+    FILE *f;
+    urj_tap_trace_format_t format;
+    int flags;
+    int failed;
+    double now;                 /* trace time of the current record */
+    uint32_t frequency;         /* 0 if not recorded */
+
+    /* the TAP as driven by the trace */
+    int state;
+    int ones;                   /* consecutive clocks with TMS=1 */
+    int trst;                   /* TRST line level, -1 unknown */
+    export_item_t *scan;        /* scan that has not reached its end state */
+    unsigned long idle;         /* clocks spent in the current stable state */
+    double since;               /* trace time of the arrival there */
+    int svf_state;              /* where the player is after the items */
+
+    /* items waiting for their TDO, oldest first */
+    export_item_t *head;
+    export_item_t *tail;
+    export_slot_t *slots;
+    int slot_head;
+    int nslots;
+    int slot_size;
+
+    /* polling loop detection; during a loop window[] is its first pass */
+    export_item_t *window[EXPORT_WINDOW];
+    int nwindow;
+    int period;
+    export_item_t *last[EXPORT_MAX_PERIOD];
+    export_item_t *cur[EXPORT_MAX_PERIOD];
+    int ncur;
+    unsigned long repeats;
+
+    /* output state */
+    int out_state;
+    int endir;
+    int enddr;
+    int sdrsize;
+    char *xmask;                /* last XTDOMASK, sdrsize bits */
+    int xmask_valid;
+} export_t;
+
+static void
+export_free (export_item_t *it)
+{
+    if (it == NULL)
+        return;
+    free (it->tdi);
+    free (it->tdo);
+    free (it->mask);
+    free (it);
+}
+
+static export_item_t *
+export_new (export_t *x, int kind)
+{
+    export_item_t *it = calloc (1, sizeof *it);
+
+    if (it == NULL)
+    {
+        urj_error_set (URJ_ERROR_OUT_OF_MEMORY, "calloc(%zd) fails",
+                       sizeof *it);
+        x->failed = 1;
+        return NULL;
+    }
+    it->kind = kind;
+    it->start = it->end = x->now;
+
+    if (x->tail != NULL)
+        x->tail->next = it;
+    else
+        x->head = it;
+    x->tail = it;
+
+    return it;
+}
+
+static int
+export_grow (export_t *x, export_item_t *it, int len)
+{
+    int size = it->size ? it->size : 64;
+    char *tdi, *tdo, *mask;
+
+    if (len <= it->size)
+        return URJ_STATUS_OK;
+    while (size < len)
+        size *= 2;
+
+    tdi = realloc (it->tdi, size);
+    if (tdi != NULL)
+        it->tdi = tdi;
+    tdo = realloc (it->tdo, size);
+    if (tdo != NULL)
+        it->tdo = tdo;
+    mask = realloc (it->mask, size);
+    if (mask != NULL)
+        it->mask = mask;
+    if (tdi == NULL || tdo == NULL || mask == NULL)
+    {
+        urj_error_set (URJ_ERROR_OUT_OF_MEMORY, "realloc(%d) fails", size);
+        x->failed = 1;
+        return URJ_STATUS_FAIL;
+    }
+    memset (it->tdi + it->size, 0, size - it->size);
+    memset (it->tdo + it->size, 0, size - it->size);
+    memset (it->mask + it->size, 0, size - it->size);
+    it->size = size;
+
+    return URJ_STATUS_OK;
+}
+
+/* ---- output */
+
+static const char *
+export_svf_state (int state)
+{
+    switch (state)
+    {
+    case URJ_TAP_STATE_TEST_LOGIC_RESET:
+        return "RESET";
+    case URJ_TAP_STATE_PAUSE_DR:
+        return "DRPAUSE";
+    case URJ_TAP_STATE_PAUSE_IR:
+        return "IRPAUSE";
+    default:
+        return "IDLE";
+    }
+}
+
+static int
+export_xsvf_state (int state)
+{
+    switch (state)
+    {
+    case URJ_TAP_STATE_TEST_LOGIC_RESET:
+        return 0;
+    case URJ_TAP_STATE_PAUSE_DR:
+        return 6;
+    case URJ_TAP_STATE_PAUSE_IR:
+        return 13;
+    default:
+        return 1;
+    }
+}
+
+/* SVF hex: the first bit shifted is the LSB of the last digit */
+static void
+export_svf_hex (export_t *x, const char *bits, int len)
+{
+    int digits = (len + 3) / 4;
+    int d, b;
+
+    putc ('(', x->f);
+    for (d = digits - 1; d >= 0; d--)
+    {
+        int v = 0;
+
+        for (b = 3; b >= 0; b--)
+            v = (v << 1) | (4 * d + b < len && bits[4 * d + b]);
+        putc ("0123456789ABCDEF"[v], x->f);
+        if (d > 0 && (digits - d) % 64 == 0)
+            fputs ("\n\t", x->f);
+    }
+    putc (')', x->f);
+}
+
+/* XSVF vector: the first bit shifted is the LSB of the last byte */
+static void
+export_xsvf_bits (export_t *x, const char *bits, int len)
+{
+    int k, b;
+
+    for (k = (len + 7) / 8 - 1; k >= 0; k--)
+    {
+        int v = 0;
+
+        for (b = 7; b >= 0; b--)
+            v = (v << 1) | (8 * k + b < len && bits != NULL && bits[8 * k + b]);
+        putc (v, x->f);
+    }
+}
+
+static void
+export_xsvf_u32 (export_t *x, uint32_t v)
+{
+    putc (v >> 24, x->f);
+    putc ((v >> 16) & 0xFF, x->f);
+    putc ((v >> 8) & 0xFF, x->f);
+    putc (v & 0xFF, x->f);
+}
+
+/* a scan that captured some of its TDO */
+static int
+export_reads (const export_item_t *it)
+{
+    int i;
+
+    if (it->kind != EXPORT_SIR && it->kind != EXPORT_SDR)
+        return 0;
+    for (i = 0; i < it->len; i++)
+        if (it->mask[i])
+            return 1;
+    return 0;
+}
+
+static int
+export_has_tdo (export_t *x, const export_item_t *it)
+{
+    return (x->flags & URJ_TAP_TRACE_EXPORT_TDO) && export_reads (it);
+}
+
+static void
+export_svf_item (export_t *x, const export_item_t *it, int tdo)
+{
+    int *end;
+
+    switch (it->kind)
+    {
+    case EXPORT_SIR:
+    case EXPORT_SDR:
+        end = it->kind == EXPORT_SIR ? &x->endir : &x->enddr;
+        if (*end != it->state)
+        {
+            fprintf (x->f, "%s %s;\n",
+                     it->kind == EXPORT_SIR ? "ENDIR" : "ENDDR",
+                     export_svf_state (it->state));
+            *end = it->state;
+        }
+        fprintf (x->f, "%s %d TDI ", it->kind == EXPORT_SIR ? "SIR" : "SDR",
+                 it->len);
+        export_svf_hex (x, it->tdi, it->len);
+        if (tdo)
+        {
+            fputs (" TDO ", x->f);
+            export_svf_hex (x, it->tdo, it->len);
+            fputs (" MASK ", x->f);
+            export_svf_hex (x, it->mask, it->len);
+        }
+        fputs (";\n", x->f);
+        break;
+
+    case EXPORT_STATE:
+        fprintf (x->f, "STATE %s;\n", export_svf_state (it->state));
+        break;
+
+    case EXPORT_RUNTEST:
+        fprintf (x->f, "RUNTEST %s", export_svf_state (it->state));
+        if (it->clocks)
+            fprintf (x->f, " %lu TCK", it->clocks);
+        if (it->secs > 0.0 || !it->clocks)
+            fprintf (x->f, " %.6E SEC", it->secs);
+        fprintf (x->f, " ENDSTATE %s;\n", export_svf_state (it->state));
+        break;
+
+    case EXPORT_TRST:
+        fprintf (x->f, "TRST %s;\n", it->trst ? "ON" : "OFF");
+        break;
+    }
+}
+
+/* XENDIR and XENDDR know Run-Test/Idle (0) and Pause (1) */
+static void
+export_xsvf_end (export_t *x, int cmd, int *end, int code)
+{
+    if (*end != code)
+    {
+        putc (cmd, x->f);
+        putc (code, x->f);
+        *end = code;
+    }
+}
+
+static void
+export_xsvf_item (export_t *x, const export_item_t *it, int tdo)
+{
+    double us;
+    int pause;
+
+    switch (it->kind)
+    {
+    case EXPORT_SIR:
+        pause = it->state == URJ_TAP_STATE_PAUSE_IR;
+        export_xsvf_end (x, XENDIR, &x->endir, pause);
+        if (it->len < 256)
+        {
+            putc (XSIR, x->f);
+            putc (it->len, x->f);
+        }
+        else
+        {
+            putc (XSIR2, x->f);
+            putc (it->len >> 8, x->f);
+            putc (it->len & 0xFF, x->f);
+        }
+        export_xsvf_bits (x, it->tdi, it->len);
+        if (!pause && it->state != URJ_TAP_STATE_RUN_TEST_IDLE)
+        {
+            putc (XSTATE, x->f);
+            putc (export_xsvf_state (it->state), x->f);
+        }
+        break;
+
+    case EXPORT_SDR:
+        pause = it->state == URJ_TAP_STATE_PAUSE_DR;
+        export_xsvf_end (x, XENDDR, &x->enddr, pause);
+        if (x->sdrsize != it->len)
+        {
+            char *xmask = realloc (x->xmask, it->len);
+
+            if (xmask == NULL)
+            {
+                urj_error_set (URJ_ERROR_OUT_OF_MEMORY, "realloc(%d) fails",
+                               it->len);
+                x->failed = 1;
+                return;
+            }
+            x->xmask = xmask;
+            putc (XSDRSIZE, x->f);
+            export_xsvf_u32 (x, it->len);
+            x->sdrsize = it->len;
+            x->xmask_valid = 0;
+        }
+        /* XSDR compares too; an all zero XTDOMASK makes it a plain shift */
+        if (!x->xmask_valid
+            || (tdo ? memcmp (x->xmask, it->mask, it->len) != 0
+                : memchr (x->xmask, 1, it->len) != NULL))
+        {
+            if (tdo)
+                memcpy (x->xmask, it->mask, it->len);
+            else
+                memset (x->xmask, 0, it->len);
+            putc (XTDOMASK, x->f);
+            export_xsvf_bits (x, x->xmask, it->len);
+            x->xmask_valid = 1;
+        }
+        putc (tdo ? XSDRTDO : XSDR, x->f);
+        export_xsvf_bits (x, it->tdi, it->len);
+        if (tdo)
+            export_xsvf_bits (x, it->tdo, it->len);
+        if (!pause && it->state != URJ_TAP_STATE_RUN_TEST_IDLE)
+        {
+            putc (XSTATE, x->f);
+            putc (export_xsvf_state (it->state), x->f);
+        }
+        break;
+
+    case EXPORT_STATE:
+        putc (XSTATE, x->f);
+        putc (export_xsvf_state (it->state), x->f);
+        break;
+
+    case EXPORT_RUNTEST:
+        /* XWAIT counts time only; without a frequency assume 1 MHz */
+        us = x->frequency ? it->clocks * 1E6 / x->frequency : it->clocks;
+        if (it->secs * 1E6 > us)
+            us = it->secs * 1E6;
+        putc (XWAIT, x->f);
+        putc (export_xsvf_state (it->state), x->f);
+        putc (export_xsvf_state (it->state), x->f);
+        export_xsvf_u32 (x, us + 0.999999);
+        break;
+
+    case EXPORT_TRST:
+        /* XSVF has no TRST; a reset through TMS is the closest */
+        if (it->trst)
+        {
+            putc (XSTATE, x->f);
+            putc (0, x->f);
+        }
+        break;
+    }
+}
+
+/* write and free one item */
+static void
+export_write (export_t *x, export_item_t *it, int tdo)
+{
+    if (it->kind == EXPORT_STATE && it->state == x->out_state)
+    {
+        export_free (it);
+        return;
+    }
+
+    tdo = tdo && export_has_tdo (x, it);
+    if (x->format == URJ_TAP_TRACE_XSVF)
+        export_xsvf_item (x, it, tdo);
+    else
+        export_svf_item (x, it, tdo);
+
+    if (it->kind == EXPORT_SIR || it->kind == EXPORT_SDR)
+        x->report->scans++;
+    if (it->kind == EXPORT_TRST)
+        x->out_state = URJ_TAP_STATE_TEST_LOGIC_RESET;
+    else
+        x->out_state = it->state;
+    export_free (it);
+}
+
+/* ---- polling loops */
+
+/* the same statement, and where it captured TDO the same TDO */
+static int
+export_same (const export_item_t *a, const export_item_t *b)
+{
+    int i;
+
+    if (a->kind != b->kind || a->state != b->state)
+        return 0;
+
+    switch (a->kind)
+    {
+    case EXPORT_SIR:
+    case EXPORT_SDR:
+        if (a->len != b->len || memcmp (a->tdi, b->tdi, a->len) != 0)
+            return 0;
+        for (i = 0; i < a->len; i++)
+            if (a->mask[i] != b->mask[i]
+                || (a->mask[i] && a->tdo[i] != b->tdo[i]))
+                return 0;
+        return 1;
+    case EXPORT_RUNTEST:
+        return a->clocks == b->clocks;
+    case EXPORT_STATE:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static void export_add (export_t *x, export_item_t *it);
+
+/* the first pass, a wait as long as the dropped passes took, the last pass;
+   the passes read what the device said before it was done, after a wait on
+   a faster programmer it may say something else, so do not check it */
+static void
+export_loop_end (export_t *x)
+{
+    export_item_t *cur[EXPORT_MAX_PERIOD];
+    int p = x->period, n = x->ncur, i;
+    double secs = x->last[0]->start - x->window[p - 1]->end;
+
+    for (i = 0; i < p; i++)
+        export_write (x, x->window[i], x->repeats < 2);
+    if (x->repeats >= 2)
+    {
+        export_item_t wait;
+
+        memset (&wait, 0, sizeof wait);
+        wait.kind = EXPORT_RUNTEST;
+        wait.state = x->out_state;
+        wait.secs = secs > 0.0 ? secs : 0.0;
+        if (x->format == URJ_TAP_TRACE_XSVF)
+            export_xsvf_item (x, &wait, 0);
+        else
+            export_svf_item (x, &wait, 0);
+        x->report->polls++;
+        x->report->dropped += x->repeats - 1;
+    }
+    for (i = 0; i < p; i++)
+        export_write (x, x->last[i], x->repeats < 2);
+
+    memcpy (cur, x->cur, n * sizeof *cur);
+    x->period = 0;
+    x->nwindow = 0;
+    x->ncur = 0;
+    for (i = 0; i < n; i++)
+        export_add (x, cur[i]);
+}
+
+static void
+export_add (export_t *x, export_item_t *it)
+{
+    int p, i;
+
+    if (x->period)
+    {
+        if (export_same (x->window[x->ncur], it))
+        {
+            x->cur[x->ncur++] = it;
+            if (x->ncur == x->period)
+            {
+                for (i = 0; i < x->period; i++)
+                {
+                    export_free (x->last[i]);
+                    x->last[i] = x->cur[i];
+                }
+                x->ncur = 0;
+                x->repeats++;
+            }
+            return;
+        }
+        export_loop_end (x);
+    }
+
+    if (x->nwindow == EXPORT_WINDOW)
+    {
+        export_write (x, x->window[0], 1);
+        memmove (x->window, x->window + 1,
+                 (EXPORT_WINDOW - 1) * sizeof *x->window);
+        x->nwindow--;
+    }
+    x->window[x->nwindow++] = it;
+
+    if (x->flags & URJ_TAP_TRACE_EXPORT_NOPOLL)
+        return;
+
+    /* the last p items repeat the p before them, TDO included, and read
+       something: repeated writes are not a loop, every one of them counts */
+    for (p = 1; p <= EXPORT_MAX_PERIOD && 2 * p <= x->nwindow; p++)
+    {
+        export_item_t **b = x->window + x->nwindow - p;
+        export_item_t **a = b - p;
+        int reads = 0;
+
+        for (i = 0; i < p && export_same (a[i], b[i]); i++)
+            if (export_reads (a[i]))
+                reads++;
+        if (i < p || reads == 0)
+            continue;
+
+        for (i = 0; i < x->nwindow - 2 * p; i++)
+            export_write (x, x->window[i], 1);
+        memcpy (x->last, b, p * sizeof *b);
+        memmove (x->window, a, p * sizeof *a);
+        x->nwindow = p;
+        x->period = p;
+        x->ncur = 0;
+        x->repeats = 1;
+        return;
+    }
+}
+
+/* hand on the items whose TDO is complete, in order */
+static void
+export_drain (export_t *x)
+{
+    while (x->head != NULL && x->head != x->scan && x->head->pending == 0)
+    {
+        export_item_t *it = x->head;
+
+        x->head = it->next;
+        if (x->head == NULL)
+            x->tail = NULL;
+        it->next = NULL;
+        export_add (x, it);
+    }
+}
+
+/* ---- TAP tracking */
+
+static void
+export_push_slot (export_t *x, export_item_t *item, int pos, int len)
+{
+    export_slot_t *slots;
+
+    if (x->nslots == x->slot_size)
+    {
+        if (x->slot_head > 0)
+        {
+            x->nslots -= x->slot_head;
+            memmove (x->slots, x->slots + x->slot_head,
+                     x->nslots * sizeof *x->slots);
+            x->slot_head = 0;
+        }
+        else
+        {
+            int size = x->slot_size ? 2 * x->slot_size : 64;
+
+            slots = realloc (x->slots, size * sizeof *slots);
+            if (slots == NULL)
+            {
+                urj_error_set (URJ_ERROR_OUT_OF_MEMORY, "realloc(%zd) fails",
+                               size * sizeof *slots);
+                x->failed = 1;
+                return;
+            }
+            x->slots = slots;
+            x->slot_size = size;
+        }
+    }
+
+    x->slots[x->nslots].item = item;
+    x->slots[x->nslots].pos = pos;
+    x->slots[x->nslots].len = len;
+    x->nslots++;
+    if (item != NULL)
+        item->pending += len;
+}
+
+static void
+export_set_tdo (export_t *x, export_item_t *it, int pos, const char *bits,
+                int len)
+{
+    if (it == NULL || export_grow (x, it, pos + len) != URJ_STATUS_OK)
+        return;
+    memcpy (it->tdo + pos, bits, len);
+    memset (it->mask + pos, 1, len);
+}
+
+/* a deferred result came back */
+static void
+export_pop_slot (export_t *x, const char *bits, int len)
+{
+    export_slot_t *s;
+
+    if (x->slot_head == x->nslots)
+        return;
+    s = &x->slots[x->slot_head++];
+    if (x->slot_head == x->nslots)
+        x->slot_head = x->nslots = 0;
+
+    if (s->item == NULL)
+        return;
+    if (bits != NULL)
+        export_set_tdo (x, s->item, s->pos, bits, len < s->len ? len : s->len);
+    s->item->pending -= s->len;
+}
+
+static void
+export_close_scan (export_t *x)
+{
+    export_item_t *it = x->scan;
+
+    x->scan = NULL;
+    x->svf_state = it->state;
+    /* a capture without shift: only the move to the end state remains */
+    if (it->len == 0)
+        it->kind = EXPORT_STATE;
+}
+
+/* the TAP leaves a stable state; clocks or host delays there become a wait */
+static void
+export_leave (export_t *x)
+{
+    export_item_t *it;
+    double secs = x->frequency ? (double) x->idle / x->frequency : 0.0;
+
+    if (x->now - x->since >= EXPORT_MIN_WAIT && x->now - x->since > secs)
+        secs = x->now - x->since;
+    if (x->idle == 0 && secs == 0.0)
+        return;
+
+    if (x->scan != NULL)
+        export_close_scan (x);
+    it = export_new (x, EXPORT_RUNTEST);
+    if (it == NULL)
+        return;
+    it->state = x->state;
+    it->clocks = x->idle;
+    it->secs = secs;
+    it->start = x->since;
+    x->idle = 0;
+}
+
+/* the TAP arrived at a stable state */
+static void
+export_arrive (export_t *x, int state)
+{
+    export_item_t *it;
+
+    x->state = state;
+    x->since = x->now;
+    if (x->scan != NULL)
+    {
+        x->scan->state = state;
+        x->scan->end = x->now;
+        /* a scan may still continue from its own Pause state */
+        if (x->scan->len == 0
+            || state != (x->scan->kind == EXPORT_SIR ? URJ_TAP_STATE_PAUSE_IR
+                         : URJ_TAP_STATE_PAUSE_DR))
+            export_close_scan (x);
+        return;
+    }
+
+    if (state == x->svf_state)
+        return;
+    it = export_new (x, EXPORT_STATE);
+    if (it != NULL)
+        it->state = state;
+    x->svf_state = state;
+}
+
+static void
+export_begin_scan (export_t *x, int kind)
+{
+    if (x->scan != NULL)
+        export_close_scan (x);
+    x->scan = export_new (x, kind);
+    if (x->scan != NULL)
+        x->scan->state = kind == EXPORT_SIR ? URJ_TAP_STATE_PAUSE_IR
+            : URJ_TAP_STATE_PAUSE_DR;
+}
+
+static int
+export_stable (int state)
+{
+    return state == URJ_TAP_STATE_TEST_LOGIC_RESET
+        || state == URJ_TAP_STATE_RUN_TEST_IDLE
+        || state == URJ_TAP_STATE_PAUSE_DR
+        || state == URJ_TAP_STATE_PAUSE_IR;
+}
+
+static int
+export_shifting (int state)
+{
+    return state == URJ_TAP_STATE_SHIFT_DR || state == URJ_TAP_STATE_SHIFT_IR;
+}
+
+static void
+export_clock (export_t *x, int tms, int tdi)
+{
+    int old = x->state, state;
+
+    x->ones = tms ? x->ones + 1 : 0;
+    if (old == URJ_TAP_STATE_UNKNOWN_STATE)
+    {
+        if (x->ones >= 5)
+            export_arrive (x, URJ_TAP_STATE_TEST_LOGIC_RESET);
+        return;
+    }
+
+    if (export_shifting (old) && x->scan != NULL
+        && export_grow (x, x->scan, x->scan->len + 1) == URJ_STATUS_OK)
+        x->scan->tdi[x->scan->len++] = tdi ? 1 : 0;
+
+    state = urj_tap_state_next (old, tms);
+    if (state == old)
+    {
+        if (export_stable (state) && state != URJ_TAP_STATE_TEST_LOGIC_RESET)
+            x->idle++;
+        return;
+    }
+
+    if (export_stable (old))
+        export_leave (x);
+    x->state = state;
+
+    if (state == URJ_TAP_STATE_CAPTURE_DR)
+        export_begin_scan (x, EXPORT_SDR);
+    else if (state == URJ_TAP_STATE_CAPTURE_IR)
+        export_begin_scan (x, EXPORT_SIR);
+    else if (export_shifting (state) && x->scan == NULL)
+    {
+        /* resumed after a wait in Pause; best effort is a new scan */
+        urj_log (URJ_LOG_LEVEL_NORMAL,
+                 _("trace record %lu: scan resumed after a wait, exported as a new scan\n"),
+                 x->report->records);
+        export_begin_scan (x, state == URJ_TAP_STATE_SHIFT_IR ? EXPORT_SIR
+                           : EXPORT_SDR);
+    }
+    else if (export_stable (state))
+        export_arrive (x, state);
+}
+
+/* n clocks with TMS=0; whole vectors when already shifting */
+static void
+export_transfer (export_t *x, int len, const char *in, const char *out,
+                 int deferred)
+{
+    export_item_t *scan = export_shifting (x->state) ? x->scan : NULL;
+    int pos = scan != NULL ? scan->len : 0;
+    int i;
+
+    if (out != NULL || deferred)
+    {
+        if (deferred)
+            export_push_slot (x, scan, pos, len);
+        else if (scan != NULL)
+            export_set_tdo (x, scan, pos, out, len);
+    }
+
+    if (scan != NULL)
+    {
+        if (export_grow (x, scan, pos + len) != URJ_STATUS_OK)
+            return;
+        memcpy (scan->tdi + pos, in, len);
+        scan->len += len;
+        x->ones = 0;
+        return;
+    }
+
+    for (i = 0; i < len; i++)
+        export_clock (x, 0, in[i]);
+}
+
+static void
+export_signal (export_t *x, int mask, int val)
+{
+    export_item_t *it;
+    int trst, old = x->trst;
+
+    if (!(mask & URJ_POD_CS_TRST))
+        return;
+    /* the line is active low; only a release after assertion counts */
+    trst = (val & URJ_POD_CS_TRST) ? 1 : 0;
+    x->trst = trst;
+    if (trst == old || (trst && old != 0))
+        return;
+    if (export_stable (x->state))
+        export_leave (x);
+    if (x->scan != NULL)
+        export_close_scan (x);
+    it = export_new (x, EXPORT_TRST);
+    if (it == NULL)
+        return;
+    it->trst = !trst;
+    it->state = URJ_TAP_STATE_TEST_LOGIC_RESET;
+    x->state = x->svf_state = URJ_TAP_STATE_TEST_LOGIC_RESET;
+    x->since = x->now;
+    x->ones = 0;
+}
+
+static void
+export_header (export_t *x, const char *tracefile)
+{
+    x->out_state = URJ_TAP_STATE_UNKNOWN_STATE;
+    x->endir = x->enddr = x->format == URJ_TAP_TRACE_XSVF ? 0
+        : URJ_TAP_STATE_RUN_TEST_IDLE;
+
+    if (x->format == URJ_TAP_TRACE_XSVF)
+    {
+        putc (XREPEAT, x->f);
+        putc (0, x->f);
+        putc (XRUNTEST, x->f);
+        export_xsvf_u32 (x, 0);
+        return;
+    }
+
+    fprintf (x->f, "! Converted by UrJTAG from the trace %s\n", tracefile);
+    fputs ("HDR 0;\nHIR 0;\nTDR 0;\nTIR 0;\n", x->f);
+}
+
+int
+urj_tap_trace_export (const char *tracefile, const char *outfile,
+                      urj_tap_trace_format_t format, int flags,
+                      urj_tap_trace_export_report_t *report)
+{
+    trace_reader_t r;
+    export_t x;
+    char magic[TRACE_MAGIC_LEN];
+    export_item_t *it;
+    int op, i, ret = URJ_STATUS_OK;
+
+    memset (report, 0, sizeof *report);
+    memset (&r, 0, sizeof r);
+    memset (&x, 0, sizeof x);
+    x.report = report;
+    x.format = format;
+    x.flags = flags;
+    x.state = x.svf_state = URJ_TAP_STATE_UNKNOWN_STATE;
+    x.trst = -1;
+
+    r.f = fopen (tracefile, FOPEN_R);
+    if (r.f == NULL)
+    {
+        urj_error_IO_set (_("Unable to open file `%s'"), tracefile);
+        return URJ_STATUS_FAIL;
+    }
+    if (fread (magic, 1, TRACE_MAGIC_LEN, r.f) != TRACE_MAGIC_LEN
+        || memcmp (magic, TRACE_MAGIC, TRACE_MAGIC_LEN) != 0)
+    {
+        fclose (r.f);
+        urj_error_set (URJ_ERROR_INVALID, _("`%s' is not a trace file"),
+                       tracefile);
+        return URJ_STATUS_FAIL;
+    }
+    if (fseek (r.f, 0, SEEK_END) != 0 || (r.size = ftell (r.f)) < 0
+        || fseek (r.f, TRACE_MAGIC_LEN, SEEK_SET) != 0)
+    {
+        fclose (r.f);
+        urj_error_IO_set (_("Unable to seek in file `%s'"), tracefile);
+        return URJ_STATUS_FAIL;
+    }
+    x.f = fopen (outfile, format == URJ_TAP_TRACE_XSVF ? FOPEN_W : "w");
+    if (x.f == NULL)
+    {
+        fclose (r.f);
+        urj_error_IO_set (_("Unable to create file `%s'"), outfile);
+        return URJ_STATUS_FAIL;
+    }
+    export_header (&x, tracefile);
+
+    while ((op = getc (r.f)) != EOF)
+    {
+        int a, b, c, len, has_out;
+
+        report->records++;
+        x.now += trace_get_u (&r) / 1E6;
+
+        switch (op)
+        {
+        case URJ_TAP_TRACE_CLOCK:
+        case URJ_TAP_TRACE_DEFER_CLOCK:
+            a = trace_get_c (&r);
+            b = trace_get_c (&r);
+            c = trace_get_u (&r);
+            for (i = 0; i < c && !r.eof; i++)
+                export_clock (&x, a, b);
+            break;
+        case URJ_TAP_TRACE_DEFER_CLOCK_TMS:
+            a = trace_get_u (&r);
+            b = trace_get_c (&r);
+            c = trace_get_u (&r);
+            for (i = 0; i < c && i < 32 && !r.eof; i++)
+                export_clock (&x, (a >> i) & 1, b);
+            break;
+
+        case URJ_TAP_TRACE_GET_TDO:
+            a = trace_get_s (&r);
+            if (a >= 0 && export_shifting (x.state) && x.scan != NULL)
+            {
+                char bit = a ? 1 : 0;
+
+                export_set_tdo (&x, x.scan, x.scan->len, &bit, 1);
+            }
+            break;
+        case URJ_TAP_TRACE_DEFER_GET_TDO:
+            export_push_slot (&x, export_shifting (x.state) ? x.scan : NULL,
+                              x.scan != NULL ? x.scan->len : 0, 1);
+            break;
+        case URJ_TAP_TRACE_GET_TDO_LATE:
+            a = trace_get_s (&r);
+            {
+                char bit = a ? 1 : 0;
+
+                export_pop_slot (&x, a >= 0 ? &bit : NULL, 1);
+            }
+            break;
+
+        case URJ_TAP_TRACE_SET_SIGNAL:
+            a = trace_get_u (&r);
+            b = trace_get_u (&r);
+            trace_get_s (&r);
+            export_signal (&x, a, b);
+            break;
+        case URJ_TAP_TRACE_DEFER_SET_SIGNAL:
+            a = trace_get_u (&r);
+            b = trace_get_u (&r);
+            export_signal (&x, a, b);
+            break;
+        case URJ_TAP_TRACE_GET_SIGNAL:
+            trace_get_u (&r);
+            trace_get_s (&r);
+            break;
+        case URJ_TAP_TRACE_DEFER_GET_SIGNAL:
+            trace_get_u (&r);
+            export_push_slot (&x, NULL, 0, 1);
+            break;
+        case URJ_TAP_TRACE_GET_SIGNAL_LATE:
+            trace_get_u (&r);
+            trace_get_s (&r);
+            export_pop_slot (&x, NULL, 0);
+            break;
+
+        case URJ_TAP_TRACE_TRANSFER:
+        case URJ_TAP_TRACE_DEFER_TRANSFER:
+            if (trace_get_len (&r, report->records, &len) != URJ_STATUS_OK)
+            {
+                ret = URJ_STATUS_FAIL;
+                goto done;
+            }
+            has_out = trace_get_c (&r);
+            if (trace_buffers (&r, len) != URJ_STATUS_OK)
+            {
+                ret = URJ_STATUS_FAIL;
+                goto done;
+            }
+            trace_get_bits (&r, r.in, len);
+            if (op == URJ_TAP_TRACE_TRANSFER)
+            {
+                if (has_out)
+                    trace_get_bits (&r, r.expect, len);
+                trace_get_s (&r);
+            }
+            if (!r.eof)
+                export_transfer (&x, len, r.in,
+                                 has_out ? r.expect : NULL,
+                                 has_out && op == URJ_TAP_TRACE_DEFER_TRANSFER);
+            break;
+        case URJ_TAP_TRACE_TRANSFER_LATE:
+            if (trace_get_len (&r, report->records, &len) != URJ_STATUS_OK
+                || trace_buffers (&r, len) != URJ_STATUS_OK)
+            {
+                ret = URJ_STATUS_FAIL;
+                goto done;
+            }
+            trace_get_bits (&r, r.expect, len);
+            trace_get_s (&r);
+            export_pop_slot (&x, r.expect, len);
+            break;
+
+        case URJ_TAP_TRACE_SET_FREQUENCY:
+            x.frequency = trace_get_u (&r);
+            break;
+
+        default:
+            urj_error_set (URJ_ERROR_INVALID,
+                           _("unknown trace record type %d at record %lu"),
+                           op, report->records);
+            ret = URJ_STATUS_FAIL;
+            goto done;
+        }
+
+        if (r.eof)
+        {
+            urj_error_set (URJ_ERROR_INVALID,
+                           _("trace ends within record %lu"),
+                           report->records);
+            ret = URJ_STATUS_FAIL;
+            goto done;
+        }
+        if (x.failed)
+        {
+            ret = URJ_STATUS_FAIL;
+            goto done;
+        }
+        export_drain (&x);
+    }
+
+    /* results the cable never delivered stay unchecked */
+    if (export_stable (x.state))
+        export_leave (&x);
+    if (x.scan != NULL)
+        export_close_scan (&x);
+    for (it = x.head; it != NULL; it = it->next)
+        it->pending = 0;
+    export_drain (&x);
+    if (x.period)
+        export_loop_end (&x);
+    for (i = 0; i < x.nwindow; i++)
+        export_write (&x, x.window[i], 1);
+    x.nwindow = 0;
+    if (x.format == URJ_TAP_TRACE_XSVF)
+        putc (XCOMPLETE, x.f);
+    if (x.failed)
+        ret = URJ_STATUS_FAIL;
+
+ done:
+    while (x.head != NULL)
+    {
+        it = x.head;
+        x.head = it->next;
+        export_free (it);
+    }
+    for (i = 0; i < x.nwindow; i++)
+        export_free (x.window[i]);
+    if (x.period)
+    {
+        for (i = 0; i < x.period; i++)
+            export_free (x.last[i]);
+        for (i = 0; i < x.ncur; i++)
+            export_free (x.cur[i]);
+    }
+    free (x.slots);
+    free (x.xmask);
+    fclose (r.f);
+    free (r.in);
+    free (r.expect);
+    free (r.out);
+
+    if (ferror (x.f))
+    {
+        urj_error_IO_set (_("Error writing file `%s'"), outfile);
+        ret = URJ_STATUS_FAIL;
+    }
+    if (fclose (x.f) != 0 && ret == URJ_STATUS_OK)
+    {
+        urj_error_IO_set (_("Error writing file `%s'"), outfile);
+        ret = URJ_STATUS_FAIL;
+    }
+
+    return ret;
+}
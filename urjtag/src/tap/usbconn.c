@@ -28,6 +28,7 @@
 #include <stddef.h>
 
 #include <urjtag/usbconn.h>
+#include <urjtag/cable.h>
 
 #include "usbconn.h"
 
@@ -52,17 +53,30 @@ urj_tap_usbconn_close (urj_usbconn_t *conn)
 int
 urj_tap_usbconn_read (urj_usbconn_t *conn, uint8_t *buf, int len)
 {
-    if (conn->driver->read)
-        return conn->driver->read (conn, buf, len);
-    else
+    int r;
+
+    if (!conn->driver->read)
         return 0;
+
+    r = conn->driver->read (conn, buf, len);
+    if (conn->cable != NULL && r > 0)
+    {
+        conn->cable->stats.round_trips++;
+        conn->cable->stats.bytes_in += r;
+    }
+    return r;
 }
 
 int
 urj_tap_usbconn_write (urj_usbconn_t *conn, uint8_t *buf, int len, int recv)
 {
-    if (conn->driver->write)
-        return conn->driver->write (conn, buf, len, recv);
-    else
+    int r;
+
+    if (!conn->driver->write)
         return 0;
+
+    r = conn->driver->write (conn, buf, len, recv);
+    if (conn->cable != NULL && r > 0)
+        conn->cable->stats.bytes_out += r;
+    return r;
 }
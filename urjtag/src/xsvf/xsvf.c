@@ -0,0 +1,637 @@
+/*
+ * $Id$
+ *
+ * XSVF player, see Xilinx application note XAPP503
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ */
+
+#include <sysdep.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <urjtag/error.h>
+#include <urjtag/log.h>
+#include <urjtag/cable.h>
+#include <urjtag/chain.h>
+#include <urjtag/tap.h>
+#include <urjtag/tap_state.h>
+#include <urjtag/tap_register.h>
+#include <urjtag/xsvf.h>
+
+/* XSVF commands */
+enum
+{
+    XCOMPLETE = 0x00,
+    XTDOMASK = 0x01,
+    XSIR = 0x02,
+    XSDR = 0x03,
+    XRUNTEST = 0x04,
+    XREPEAT = 0x07,
+    XSDRSIZE = 0x08,
+    XSDRTDO = 0x09,
+    XSETSDRMASKS = 0x0a,
+    XSDRINC = 0x0b,
+    XSDRB = 0x0c,
+    XSDRC = 0x0d,
+    XSDRE = 0x0e,
+    XSDRTDOB = 0x0f,
+    XSDRTDOC = 0x10,
+    XSDRTDOE = 0x11,
+    XSTATE = 0x12,
+    XENDIR = 0x13,
+    XENDDR = 0x14,
+    XSIR2 = 0x15,
+    XCOMMENT = 0x16,
+    XWAIT = 0x17,
+};
+
+/* XSTATE, XWAIT: the 16 TAP states in the order of IEEE 1149.1 */
+static const int xsvf_states[16] = {
+    URJ_TAP_STATE_TEST_LOGIC_RESET,
+    URJ_TAP_STATE_RUN_TEST_IDLE,
+    URJ_TAP_STATE_SELECT_DR_SCAN,
+    URJ_TAP_STATE_CAPTURE_DR,
+    URJ_TAP_STATE_SHIFT_DR,
+    URJ_TAP_STATE_EXIT1_DR,
+    URJ_TAP_STATE_PAUSE_DR,
+    URJ_TAP_STATE_EXIT2_DR,
+    URJ_TAP_STATE_UPDATE_DR,
+    URJ_TAP_STATE_SELECT_IR_SCAN,
+    URJ_TAP_STATE_CAPTURE_IR,
+    URJ_TAP_STATE_SHIFT_IR,
+    URJ_TAP_STATE_EXIT1_IR,
+    URJ_TAP_STATE_PAUSE_IR,
+    URJ_TAP_STATE_EXIT2_IR,
+    URJ_TAP_STATE_UPDATE_IR,
+};
+
+typedef struct
+{
+    urj_chain_t *chain;
+    FILE *f;
+    long file_size;                     /* 0 if unknown, e.g. a pipe */
+    int last_percent;                   /* of the last progress report */
+    long cmd_pos;                       /* file offset of current command */
+    int sdrsize;                        /* XSDRSIZE, 0 until set */
+    urj_tap_register_t *tdi;            /* these four are sdrsize bits */
+    urj_tap_register_t *tdo;            /* captured */
+    urj_tap_register_t *tdo_expected;
+    urj_tap_register_t *tdo_mask;
+    urj_tap_register_t *ir;             /* XSIR/XSIR2 vector */
+    unsigned char *buf;                 /* raw bytes of one vector */
+    size_t buf_len;
+    uint32_t runtest;                   /* XRUNTEST, in microseconds */
+    int max_repeat;                     /* XREPEAT */
+    int endir;                          /* XENDIR */
+    int enddr;                          /* XENDDR */
+}
+xsvf_player_t;
+
+static int
+xsvf_read (xsvf_player_t *p, void *data, size_t len)
+{
+    if (fread (data, 1, len, p->f) != len)
+    {
+        if (ferror (p->f))
+            urj_error_IO_set (_("%s: read error"), "xsvf");
+        else
+            urj_error_set (URJ_ERROR_FILEIO,
+                           _("%s: file ends within command at offset %ld"),
+                           "xsvf", p->cmd_pos);
+        return URJ_STATUS_FAIL;
+    }
+
+    return URJ_STATUS_OK;
+}
+
+/* big endian number of n bytes */
+static int
+xsvf_read_u (xsvf_player_t *p, int n, uint32_t *val)
+{
+    unsigned char b[4];
+    int i;
+
+    if (xsvf_read (p, b, n) != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+
+    *val = 0;
+    for (i = 0; i < n; i++)
+        *val = (*val << 8) | b[i];
+
+    return URJ_STATUS_OK;
+}
+
+/* Vectors are big endian numbers of (len + 7) / 8 bytes; bit 0, in the
+ * last byte, is shifted first and thus goes to reg->data[0]. */
+static int
+xsvf_read_vector (xsvf_player_t *p, urj_tap_register_t *reg)
+{
+    size_t bytes = (reg->len + 7) / 8;
+    int i;
+
+    if (bytes > p->buf_len)
+    {
+        unsigned char *buf = realloc (p->buf, bytes);
+
+        if (buf == NULL)
+        {
+            urj_error_set (URJ_ERROR_OUT_OF_MEMORY, "realloc(%zd) fails",
+                           bytes);
+            return URJ_STATUS_FAIL;
+        }
+        p->buf = buf;
+        p->buf_len = bytes;
+    }
+
+    if (xsvf_read (p, p->buf, bytes) != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+
+    for (i = 0; i < reg->len; i++)
+        reg->data[i] = (p->buf[bytes - 1 - i / 8] >> (i % 8)) & 1;
+
+    return URJ_STATUS_OK;
+}
+
+static int
+xsvf_read_state (xsvf_player_t *p, int *state)
+{
+    unsigned char s;
+
+    if (xsvf_read (p, &s, 1) != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+    if (s >= ARRAY_SIZE (xsvf_states))
+    {
+        urj_error_set (URJ_ERROR_SYNTAX,
+                       _("%s: invalid TAP state %d at offset %ld"),
+                       "xsvf", s, p->cmd_pos);
+        return URJ_STATUS_FAIL;
+    }
+    *state = xsvf_states[s];
+
+    return URJ_STATUS_OK;
+}
+
+static void
+xsvf_free_sdr (xsvf_player_t *p)
+{
+    urj_tap_register_free (p->tdi);
+    urj_tap_register_free (p->tdo);
+    urj_tap_register_free (p->tdo_expected);
+    urj_tap_register_free (p->tdo_mask);
+    p->tdi = p->tdo = p->tdo_expected = p->tdo_mask = NULL;
+}
+
+static int
+xsvf_set_sdrsize (xsvf_player_t *p, uint32_t size)
+{
+    if (size == (uint32_t) p->sdrsize)
+        return URJ_STATUS_OK;
+
+    xsvf_free_sdr (p);
+    p->sdrsize = size;
+    if (size == 0)
+        return URJ_STATUS_OK;
+
+    /* expected value and mask start out as 0: no compare before XTDOMASK */
+    if ((p->tdi = urj_tap_register_alloc (size)) == NULL
+        || (p->tdo = urj_tap_register_alloc (size)) == NULL
+        || (p->tdo_expected = urj_tap_register_alloc (size)) == NULL
+        || (p->tdo_mask = urj_tap_register_alloc (size)) == NULL)
+    {
+        xsvf_free_sdr (p);
+        p->sdrsize = 0;
+        return URJ_STATUS_FAIL;
+    }
+
+    return URJ_STATUS_OK;
+}
+
+static int
+xsvf_need_sdrsize (xsvf_player_t *p, const char *cmd)
+{
+    if (p->sdrsize > 0)
+        return URJ_STATUS_OK;
+
+    urj_error_set (URJ_ERROR_SYNTAX, _("%s: %s before XSDRSIZE at offset %ld"),
+                   "xsvf", cmd, p->cmd_pos);
+    return URJ_STATUS_FAIL;
+}
+
+/*
+ * Clocks TCK for usecs microseconds in the current state, as waitTime()
+ * of the XAPP503 reference player: Run-Test/Idle, the XENDIR/XENDDR state
+ * or Shift-DR before a retry.  Without a known TCK frequency there is one
+ * clock per microsecond and the host waits out the time after they went
+ * out.
+ */
+static void
+xsvf_wait (xsvf_player_t *p, uint32_t usecs)
+{
+    urj_chain_t *chain = p->chain;
+    uint32_t frequency = urj_tap_cable_get_frequency (chain->cable);
+
+    if (usecs == 0)
+        return;
+
+    urj_tap_chain_defer_wait (chain, frequency, frequency > 0 ? 0 : usecs,
+                              usecs / 1E6);
+}
+
+/* true if XTDOMASK selects any bit, so that TDO has to be read back */
+static int
+xsvf_masked (xsvf_player_t *p)
+{
+    int i;
+
+    for (i = 0; i < p->sdrsize; i++)
+        if (p->tdo_mask->data[i])
+            return 1;
+
+    return 0;
+}
+
+static int
+xsvf_compare (xsvf_player_t *p)
+{
+    int i;
+
+    for (i = 0; i < p->sdrsize; i++)
+        if (p->tdo_mask->data[i] && p->tdo->data[i] != p->tdo_expected->data[i])
+            return 1;
+
+    return 0;
+}
+
+/*
+ * One scan, the way the XAPP503 reference player does it: shift from
+ * start_state and leave for end_state, or stay in Shift for XSDRB/XSDRC.
+ * If compare is set, a mismatching DR scan is retried up to max_repeat
+ * times via Pause-DR and Exit2-DR, each time with 25% more run-test time.
+ * Scans without compare stay in the cable queue.
+ */
+static int
+xsvf_shift (xsvf_player_t *p, int start_state, urj_tap_register_t *tdi,
+            int compare, int end_state, uint32_t runtest, int max_repeat)
+{
+    urj_chain_t *chain = p->chain;
+    int exit_shift = start_state != end_state;
+    int exit_mode = exit_shift ? URJ_CHAIN_EXITMODE_EXIT1
+                               : URJ_CHAIN_EXITMODE_SHIFT;
+    int repeat = 0, mismatch;
+
+    if (tdi == NULL)
+    {
+        /* zero length scan */
+        xsvf_wait (p, runtest);
+        return URJ_STATUS_OK;
+    }
+
+    do
+    {
+        urj_tap_chain_defer_goto_state (chain, start_state);
+        urj_tap_defer_shift_register (chain, tdi, compare ? p->tdo : NULL,
+                                      exit_mode);
+        mismatch = 0;
+        if (compare)
+        {
+            urj_tap_shift_register_output (chain, tdi, p->tdo, exit_mode);
+            mismatch = xsvf_compare (p);
+        }
+
+        if (exit_shift)
+        {
+            if (mismatch && runtest && repeat < max_repeat)
+            {
+                /* one more clock in Shift-DR on the way back */
+                urj_tap_chain_defer_goto_state (chain,
+                                                URJ_TAP_STATE_PAUSE_DR);
+                urj_tap_chain_defer_goto_state (chain,
+                                                URJ_TAP_STATE_SHIFT_DR);
+                runtest += runtest >> 2;
+            }
+            else
+                urj_tap_chain_defer_goto_state (chain, end_state);
+
+            xsvf_wait (p, runtest);
+        }
+    }
+    while (mismatch && repeat++ < max_repeat);
+
+    if (mismatch)
+    {
+        urj_tap_register_get_string (p->tdo);
+        urj_log (URJ_LOG_LEVEL_DETAIL, "TDO %s\n", p->tdo->string);
+        urj_tap_register_get_string (p->tdo_expected);
+        urj_log (URJ_LOG_LEVEL_DETAIL, "expected %s\n",
+                 p->tdo_expected->string);
+        urj_error_set (URJ_ERROR_ILLEGAL_STATE,
+                       _("%s: TDO mismatch at offset %ld after %d attempt(s)"),
+                       "xsvf", p->cmd_pos, repeat);
+        return URJ_STATUS_FAIL;
+    }
+
+    return URJ_STATUS_OK;
+}
+
+/* XSIR and XSIR2 */
+static int
+xsvf_sir (xsvf_player_t *p, int len)
+{
+    if (len == 0)
+        return xsvf_shift (p, URJ_TAP_STATE_SHIFT_IR, NULL, 0, p->endir,
+                           p->runtest, 0);
+
+    if (p->ir == NULL || p->ir->len != len)
+    {
+        urj_tap_register_free (p->ir);
+        if ((p->ir = urj_tap_register_alloc (len)) == NULL)
+            return URJ_STATUS_FAIL;
+    }
+    if (xsvf_read_vector (p, p->ir) != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+
+    return xsvf_shift (p, URJ_TAP_STATE_SHIFT_IR, p->ir, 0, p->endir,
+                       p->runtest, 0);
+}
+
+/* XSDRB/C/E and XSDRTDOB/C/E: no XRUNTEST, no retries */
+static int
+xsvf_sdr_part (xsvf_player_t *p, int cmd, const char *name)
+{
+    int compare = cmd >= XSDRTDOB && xsvf_masked (p);
+    int first = cmd == XSDRB || cmd == XSDRTDOB;
+    int last = cmd == XSDRE || cmd == XSDRTDOE;
+
+    if (xsvf_need_sdrsize (p, name) != URJ_STATUS_OK
+        || xsvf_read_vector (p, p->tdi) != URJ_STATUS_OK)
+        return URJ_STATUS_FAIL;
+    if (cmd >= XSDRTDOB)
+    {
+        if (xsvf_read_vector (p, p->tdo_expected) != URJ_STATUS_OK)
+            return URJ_STATUS_FAIL;
+    }
+
+    if (!first && !(urj_tap_state (p->chain) & URJ_TAP_STATE_SHIFT))
+    {
+        urj_error_set (URJ_ERROR_ILLEGAL_STATE,
+                       _("%s: %s outside Shift-DR at offset %ld"),
+                       "xsvf", name, p->cmd_pos);
+        return URJ_STATUS_FAIL;
+    }
+
+    return xsvf_shift (p, URJ_TAP_STATE_SHIFT_DR, p->tdi, compare,
+                       last ? p->enddr : URJ_TAP_STATE_SHIFT_DR, 0, 0);
+}
+
+/*
+ * Progress by file offset, like the SVF player: once per percent, or every
+ * 1000 commands if the file size is unknown.
+ */
+static void
+xsvf_progress (xsvf_player_t *p, unsigned long cmds)
+{
+    int percent;
+
+    if (p->file_size <= 0)
+    {
+        if (cmds % 1000 == 0)
+        {
+            urj_log (URJ_LOG_LEVEL_DETAIL, "\r");
+            urj_log (URJ_LOG_LEVEL_DETAIL, _("Playing %8lu"), cmds);
+        }
+        return;
+    }
+
+    percent = (p->cmd_pos * 100.0) / p->file_size;
+    if (percent <= 1 || percent == p->last_percent)
+        return;
+    p->last_percent = percent;
+    urj_log (URJ_LOG_LEVEL_DETAIL, "\r");
+    urj_log (URJ_LOG_LEVEL_DETAIL, _("Playing %8lu (%3d%%)"), cmds, percent);
+}
+
+static int
+xsvf_play (xsvf_player_t *p)
+{
+    urj_chain_t *chain = p->chain;
+    unsigned long cmds = 0;
+    uint32_t val;
+    int c, state;
+
+    while ((c = getc (p->f)) != EOF)
+    {
+        p->cmd_pos = ftell (p->f) - 1;
+        cmds++;
+        xsvf_progress (p, cmds);
+
+        switch (c)
+        {
+        case XCOMPLETE:
+            urj_log (URJ_LOG_LEVEL_DETAIL, _("\r%s: XCOMPLETE after %lu commands\n"),
+                     "xsvf", cmds);
+            return URJ_STATUS_OK;
+
+        case XTDOMASK:
+            if (xsvf_need_sdrsize (p, "XTDOMASK") != URJ_STATUS_OK
+                || xsvf_read_vector (p, p->tdo_mask) != URJ_STATUS_OK)
+                return URJ_STATUS_FAIL;
+            break;
+
+        case XSIR:
+        case XSIR2:
+            if (xsvf_read_u (p, c == XSIR ? 1 : 2, &val) != URJ_STATUS_OK
+                || xsvf_sir (p, val) != URJ_STATUS_OK)
+                return URJ_STATUS_FAIL;
+            break;
+
+        case XSDR:
+        case XSDRTDO:
+            if (xsvf_need_sdrsize (p, c == XSDR ? "XSDR" : "XSDRTDO")
+                != URJ_STATUS_OK
+                || xsvf_read_vector (p, p->tdi) != URJ_STATUS_OK)
+                return URJ_STATUS_FAIL;
+            /* XSDR compares with the expected value of the last XSDRTDO;
+               with an all zero XTDOMASK nothing is read back */
+            if (c == XSDRTDO
+                && xsvf_read_vector (p, p->tdo_expected) != URJ_STATUS_OK)
+                return URJ_STATUS_FAIL;
+            if (xsvf_shift (p, URJ_TAP_STATE_SHIFT_DR, p->tdi,
+                            xsvf_masked (p), p->enddr, p->runtest,
+                            p->max_repeat) != URJ_STATUS_OK)
+                return URJ_STATUS_FAIL;
+            break;
+
+        case XRUNTEST:
+            if (xsvf_read_u (p, 4, &p->runtest) != URJ_STATUS_OK)
+                return URJ_STATUS_FAIL;
+            break;
+
+        case XREPEAT:
+            if (xsvf_read_u (p, 1, &val) != URJ_STATUS_OK)
+                return URJ_STATUS_FAIL;
+            p->max_repeat = val;
+            break;
+
+        case XSDRSIZE:
+            if (xsvf_read_u (p, 4, &val) != URJ_STATUS_OK
+                || xsvf_set_sdrsize (p, val) != URJ_STATUS_OK)
+                return URJ_STATUS_FAIL;
+            break;
+
+        case XSDRB:
+        case XSDRC:
+        case XSDRE:
+        case XSDRTDOB:
+        case XSDRTDOC:
+        case XSDRTDOE:
+            {
+                static const char * const names[] = {
+                    "XSDRB", "XSDRC", "XSDRE",
+                    "XSDRTDOB", "XSDRTDOC", "XSDRTDOE",
+                };
+
+                if (xsvf_sdr_part (p, c, names[c - XSDRB]) != URJ_STATUS_OK)
+                    return URJ_STATUS_FAIL;
+                break;
+            }
+
+        case XSTATE:
+            if (xsvf_read_state (p, &state) != URJ_STATUS_OK)
+                return URJ_STATUS_FAIL;
+            if (state == URJ_TAP_STATE_TEST_LOGIC_RESET)
+                /* always five TMS=1 clocks, whatever the state looks like */
+                urj_tap_chain_defer_clock (chain, 1, 0, 5);
+            else
+                urj_tap_chain_defer_goto_state (chain, state);
+            break;
+
+        case XENDIR:
+        case XENDDR:
+            if (xsvf_read_u (p, 1, &val) != URJ_STATUS_OK)
+                return URJ_STATUS_FAIL;
+            if (val > 1)
+            {
+                urj_error_set (URJ_ERROR_SYNTAX,
+                               _("%s: invalid end state %lu at offset %ld"),
+                               "xsvf", (unsigned long) val, p->cmd_pos);
+                return URJ_STATUS_FAIL;
+            }
+            if (c == XENDIR)
+                p->endir = val ? URJ_TAP_STATE_PAUSE_IR
+                               : URJ_TAP_STATE_RUN_TEST_IDLE;
+            else
+                p->enddr = val ? URJ_TAP_STATE_PAUSE_DR
+                               : URJ_TAP_STATE_RUN_TEST_IDLE;
+            break;
+
+        case XCOMMENT:
+            {
+                char text[256];
+                size_t n = 0;
+                int ch;
+
+                while ((ch = getc (p->f)) != EOF && ch != '\0')
+                    if (n < sizeof text - 1)
+                        text[n++] = ch;
+                text[n] = '\0';
+                urj_log (URJ_LOG_LEVEL_DETAIL, "%s\n", text);
+                break;
+            }
+
+        case XWAIT:
+            {
+                int end_state;
+
+                if (xsvf_read_state (p, &state) != URJ_STATUS_OK
+                    || xsvf_read_state (p, &end_state) != URJ_STATUS_OK
+                    || xsvf_read_u (p, 4, &val) != URJ_STATUS_OK)
+                    return URJ_STATUS_FAIL;
+                urj_tap_chain_defer_goto_state (chain, state);
+                if (state != URJ_TAP_STATE_TEST_LOGIC_RESET)
+                    xsvf_wait (p, val);
+                else
+                    /* TMS low would leave Test-Logic-Reset, the host waits */
+                    urj_tap_chain_defer_wait (chain, 0, 0, val / 1E6);
+                urj_tap_chain_defer_goto_state (chain, end_state);
+                break;
+            }
+
+        case XSETSDRMASKS:
+        case XSDRINC:
+            urj_error_set (URJ_ERROR_UNSUPPORTED,
+                           _("%s: %s at offset %ld not supported"), "xsvf",
+                           c == XSDRINC ? "XSDRINC" : "XSETSDRMASKS",
+                           p->cmd_pos);
+            return URJ_STATUS_FAIL;
+
+        default:
+            urj_error_set (URJ_ERROR_SYNTAX,
+                           _("%s: unknown command 0x%02x at offset %ld"),
+                           "xsvf", c, p->cmd_pos);
+            return URJ_STATUS_FAIL;
+        }
+    }
+
+    if (ferror (p->f))
+    {
+        urj_error_IO_set (_("%s: read error"), "xsvf");
+        return URJ_STATUS_FAIL;
+    }
+
+    /* a missing XCOMPLETE is tolerated like a missing final newline */
+    urj_log (URJ_LOG_LEVEL_DETAIL, _("\r%s: end of file after %lu commands\n"),
+             "xsvf", cmds);
+    return URJ_STATUS_OK;
+}
+
+int
+urj_xsvf_run (urj_chain_t *chain, FILE *XSVF_FILE)
+{
+    xsvf_player_t p;
+    struct stat st;
+    int r;
+
+    if (chain == NULL || chain->cable == NULL)
+    {
+        urj_error_set (URJ_ERROR_NO_CHAIN, _("%s: no cable"), "xsvf");
+        return URJ_STATUS_FAIL;
+    }
+
+    memset (&p, 0, sizeof p);
+    p.chain = chain;
+    p.f = XSVF_FILE;
+    if (fstat (fileno (XSVF_FILE), &st) == 0 && S_ISREG (st.st_mode))
+        p.file_size = st.st_size;
+    p.endir = URJ_TAP_STATE_RUN_TEST_IDLE;
+    p.enddr = URJ_TAP_STATE_RUN_TEST_IDLE;
+
+    r = xsvf_play (&p);
+
+    urj_tap_cable_flush (chain->cable, URJ_TAP_CABLE_COMPLETELY);
+
+    xsvf_free_sdr (&p);
+    urj_tap_register_free (p.ir);
+    free (p.buf);
+
+    return r;
+}
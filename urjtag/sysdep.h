@@ -85,6 +85,15 @@ extern ssize_t getline(char **line, size_t *len, FILE *f);
 
 #define ARRAY_SIZE(a) (sizeof (a) / sizeof ((a)[0]))
 
+/* Storage class of per-thread variables */
+#if defined(__GNUC__)
+#define URJ_THREAD_LOCAL __thread
+#elif defined(_MSC_VER)
+#define URJ_THREAD_LOCAL __declspec(thread)
+#else
+#define URJ_THREAD_LOCAL _Thread_local
+#endif
+
 /* "b" is needed for Windows host.  "e" is a GLIBC extension, but Windows
    does not like it.  Most C libraries on UNIX-like systems hopefully
    implement the same extension or just ignore it without causing any trouble.
@@ -92,9 +101,11 @@ extern ssize_t getline(char **line, size_t *len, FILE *f);
 #if defined(_WIN32)
 #define FOPEN_R  "rb"
 #define FOPEN_W  "wb"
+#define FOPEN_RW "w+b"
 #else
 #define FOPEN_R  "re"
 #define FOPEN_W  "we"
+#define FOPEN_RW "w+e"
 #endif
 
 #endif /* SYSDEP_H */